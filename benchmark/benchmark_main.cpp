@@ -0,0 +1,142 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "render_benchmark.h"
+
+using namespace Imagine;
+
+static void printUsage()
+{
+	fprintf(stderr, "imagine_benchmark [options]\n");
+	fprintf(stderr, "  --output <path>       JSON results file (default: benchmark_results.json)\n");
+	fprintf(stderr, "  --working-dir <path>  where render statistics and generated data go (default: current directory)\n");
+	fprintf(stderr, "  --scene <name>        only run this scene\n");
+	fprintf(stderr, "  --threads <n>         render threads (default: all)\n");
+	fprintf(stderr, "  --width <n>           image width (default: 960)\n");
+	fprintf(stderr, "  --height <n>          image height (default: 540)\n");
+	fprintf(stderr, "  --repeats <n>         renders of each phase (default: 3)\n");
+	fprintf(stderr, "  --list                list the scenes\n");
+}
+
+int main(int argc, char** argv)
+{
+	RenderBenchmark benchmark;
+
+	std::string outputPath = "benchmark_results.json";
+
+	unsigned int width = 960;
+	unsigned int height = 540;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+
+		if (strcmp(arg, "--list") == 0)
+		{
+			std::vector<std::string> aNames;
+			RenderBenchmark::getSceneNames(aNames);
+
+			std::vector<std::string>::const_iterator it = aNames.begin();
+			for (; it != aNames.end(); ++it)
+			{
+				fprintf(stdout, "%s\n", (*it).c_str());
+			}
+
+			return 0;
+		}
+		else if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0)
+		{
+			printUsage();
+			return 0;
+		}
+
+		if (!value)
+		{
+			printUsage();
+			return -1;
+		}
+
+		if (strcmp(arg, "--output") == 0)
+		{
+			outputPath = value;
+		}
+		else if (strcmp(arg, "--working-dir") == 0)
+		{
+			benchmark.setWorkingPath(value);
+		}
+		else if (strcmp(arg, "--scene") == 0)
+		{
+			benchmark.setSceneFilter(value);
+		}
+		else if (strcmp(arg, "--threads") == 0)
+		{
+			benchmark.setRenderThreads((unsigned int)atoi(value));
+		}
+		else if (strcmp(arg, "--width") == 0)
+		{
+			width = (unsigned int)atoi(value);
+		}
+		else if (strcmp(arg, "--height") == 0)
+		{
+			height = (unsigned int)atoi(value);
+		}
+		else if (strcmp(arg, "--repeats") == 0)
+		{
+			benchmark.setRepeats((unsigned int)atoi(value));
+		}
+		else
+		{
+			printUsage();
+			return -1;
+		}
+
+		// skip the value
+		i++;
+	}
+
+	if (width == 0 || height == 0)
+	{
+		fprintf(stderr, "Invalid image size.\n");
+		return -1;
+	}
+
+	benchmark.setImageSize(width, height);
+
+	if (!benchmark.run())
+	{
+		fprintf(stderr, "No benchmark scenes were run.\n");
+		return -1;
+	}
+
+	if (!benchmark.writeResults(outputPath))
+	{
+		fprintf(stderr, "Can't write benchmark results to: %s\n", outputPath.c_str());
+		return -1;
+	}
+
+	fprintf(stderr, "Benchmark results written to: %s\n", outputPath.c_str());
+
+	return 0;
+}
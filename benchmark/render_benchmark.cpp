@@ -0,0 +1,533 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#include "render_benchmark.h"
+
+#include <cmath>
+#include <cstdio>
+
+#include "scene.h"
+
+#include "objects/camera.h"
+#include "objects/primitives/cube.h"
+#include "objects/primitives/plane.h"
+#include "objects/primitives/sphere.h"
+
+#include "lights/physical_sky.h"
+
+#include "materials/standard_material.h"
+
+#include "scene_builders/menger_sponge_builder.h"
+#include "scene_builders/simple_city_builder.h"
+#include "scene_builders/terrain_builder.h"
+#include "scene_builders/point_cloud_builder.h"
+#include "scene_builders/instance_shape_builder.h"
+#include "scene_builders/instance_surface_scatter_builder.h"
+#include "scene_builders/data_chart_builder.h"
+
+#include "raytracer/raytracer.h"
+#include "raytracer/raytracer_common.h"
+
+#include "image/output_image.h"
+
+#include "global_context.h"
+
+#include "utils/params.h"
+#include "utils/system.h"
+#include "utils/high_res_clock.h"
+#include "utils/file_helpers.h"
+
+namespace Imagine
+{
+
+// all the random distributions in the builders use this, so the content's the same every run
+static const unsigned int kBenchmarkSeed = 42;
+
+// escapes quotes, backslashes (i.e. in Windows paths) and control characters, so the string can be written within a JSON string
+static std::string escapeJSONString(const std::string& value)
+{
+	std::string escaped;
+	escaped.reserve(value.size());
+
+	std::string::const_iterator it = value.begin();
+	for (; it != value.end(); ++it)
+	{
+		const char c = *it;
+
+		switch (c)
+		{
+			case '"':
+				escaped += "\\\"";
+				break;
+			case '\\':
+				escaped += "\\\\";
+				break;
+			case '\n':
+				escaped += "\\n";
+				break;
+			case '\r':
+				escaped += "\\r";
+				break;
+			case '\t':
+				escaped += "\\t";
+				break;
+			default:
+				if ((unsigned char)c < 0x20)
+				{
+					char buffer[8];
+					snprintf(buffer, sizeof(buffer), "\\u%04x", (unsigned int)(unsigned char)c);
+					escaped += buffer;
+				}
+				else
+				{
+					escaped += c;
+				}
+				break;
+		}
+	}
+
+	return escaped;
+}
+
+// the data chart's generated grid size
+static const unsigned int kDataChartItems = 128;
+
+struct BenchmarkSceneInfo
+{
+	const char*		name;
+	// whether the scene's also rendered with textured materials
+	bool			textured;
+};
+
+// in the same order as BenchmarkSceneType
+static const BenchmarkSceneInfo kBenchmarkScenes[] = {
+	{ "menger_sponge", false },
+	{ "simple_city", false },
+	{ "terrain_point_cloud", false },
+	{ "instance_shape", false },
+	{ "data_chart", false },
+	{ "textured_scatter", true },
+	{ nullptr, false }
+};
+
+RenderBenchmark::RenderBenchmark() : m_renderThreads(System::getNumberOfThreads()), m_width(960), m_height(540), m_repeats(3),
+	m_peakMemoryRSS(0)
+{
+}
+
+RenderBenchmark::~RenderBenchmark()
+{
+}
+
+void RenderBenchmark::getSceneNames(std::vector<std::string>& aNames)
+{
+	for (unsigned int i = 0; kBenchmarkScenes[i].name; i++)
+	{
+		aNames.emplace_back(kBenchmarkScenes[i].name);
+	}
+}
+
+bool RenderBenchmark::run()
+{
+	Logger& logger = GlobalContext::instance().getLogger();
+
+	m_aSceneResults.clear();
+
+	for (unsigned int i = 0; kBenchmarkScenes[i].name; i++)
+	{
+		const BenchmarkSceneInfo& sceneInfo = kBenchmarkScenes[i];
+
+		if (!m_sceneFilter.empty() && m_sceneFilter != sceneInfo.name)
+			continue;
+
+		logger.notice("Benchmark scene: %s", sceneInfo.name);
+
+		BenchmarkSceneType sceneType = (BenchmarkSceneType)i;
+
+		SceneResult sceneResult;
+		sceneResult.name = sceneInfo.name;
+
+		Scene* pScene = new Scene();
+		std::vector<Object*> aSourceObjects;
+
+		sceneResult.memoryBeforeBuild = System::getProcessCurrentMemUsage();
+
+		uint64_t buildStartTicks = HighResClock::getTicks();
+		bool built = buildScene(sceneType, *pScene, aSourceObjects);
+		sceneResult.buildSeconds = HighResClock::ticksToSeconds(HighResClock::getTicks() - buildStartTicks);
+
+		sceneResult.memoryAfterBuild = System::getProcessCurrentMemUsage();
+
+		if (!built)
+		{
+			logger.error("Couldn't build benchmark scene: %s", sceneInfo.name);
+		}
+		else
+		{
+			setupCameraAndLight(sceneType, *pScene);
+
+			// primary ray throughput: camera rays only, with the cheapest shading
+			{
+				Params settings;
+				settings.add("debugRender", true);
+
+				PhaseResult phaseResult;
+				renderPhase(*pScene, sceneResult.name, "primary_rays", settings, 1, phaseResult);
+				sceneResult.aPhases.emplace_back(phaseResult);
+			}
+
+			// full path-traced frame
+			{
+				Params settings;
+				settings.add("integrator", 1);
+				settings.add("antiAliasing", 4);
+				settings.add("rbOverall", 4);
+				settings.add("useTextureCaching", sceneInfo.textured);
+
+				PhaseResult phaseResult;
+				renderPhase(*pScene, sceneResult.name, sceneInfo.textured ? "textured_path_traced" : "path_traced", settings, 16, phaseResult);
+				sceneResult.aPhases.emplace_back(phaseResult);
+			}
+
+			if (!sceneResult.aPhases.empty())
+			{
+				sceneResult.bvhBuildSeconds = sceneResult.aPhases[0].preRenderSeconds;
+			}
+		}
+
+		delete pScene;
+
+		std::vector<Object*>::iterator itObject = aSourceObjects.begin();
+		for (; itObject != aSourceObjects.end(); ++itObject)
+		{
+			delete *itObject;
+		}
+
+		m_aSceneResults.emplace_back(sceneResult);
+	}
+
+	m_peakMemoryRSS = System::getProcessMemInfo().maxRSS;
+
+	return !m_aSceneResults.empty();
+}
+
+bool RenderBenchmark::buildScene(BenchmarkSceneType type, Scene& scene, std::vector<Object*>& aSourceObjects)
+{
+	Params builderParams;
+	builderParams.add("seed", kBenchmarkSeed);
+
+	switch (type)
+	{
+		case eSceneMengerSponge:
+		{
+			// 20^4 cubes
+			builderParams.add("iterations", 5);
+			builderParams.add("overallWidth", 10.0f);
+
+			MengerSpongeBuilder builder;
+			builder.applyParams(builderParams);
+			builder.createScene(scene);
+			return true;
+		}
+		case eSceneSimpleCity:
+		{
+			builderParams.add("width", 400);
+			builderParams.add("depth", 400);
+			builderParams.add("num_buildings", 20000);
+			builderParams.add("max_stories", 5);
+			builderParams.add("distribution", 0);
+
+			SimpleCityBuilder builder;
+			builder.applyParams(builderParams);
+			builder.createScene(scene);
+			return true;
+		}
+		case eSceneTerrainPointCloud:
+		{
+			// procedural noise terrain
+			builderParams.add("width", 200);
+			builderParams.add("depth", 200);
+			builderParams.add("x_divisions", 1024);
+			builderParams.add("y_divisions", 1024);
+			builderParams.add("max_height", 20.0f);
+			builderParams.add("height_source", 1);
+
+			TerrainBuilder terrainBuilder;
+			terrainBuilder.applyParams(builderParams);
+			terrainBuilder.createScene(scene);
+
+			// points sampled over the terrain's surface
+			Params pointParams;
+			pointParams.add("seed", kBenchmarkSeed);
+			pointParams.add("type", 0);
+			pointParams.add("distribution", 1);
+			pointParams.add("bounds_shape", 1);
+			pointParams.add("points_count", 500000);
+			pointParams.add("point_radius", 0.05f);
+			pointParams.add("sample_radius", 150.0f);
+
+			PointCloudBuilder pointCloudBuilder;
+			pointCloudBuilder.applyParams(pointParams);
+			pointCloudBuilder.createScene(scene);
+			return true;
+		}
+		case eSceneInstanceShape:
+		{
+			// a sphere filled with small spheres
+			Object* pShape = new Sphere(5.0f, 32, false);
+			pShape->constructGeometry();
+			aSourceObjects.emplace_back(pShape);
+
+			builderParams.add("scale", 0.02f);
+			builderParams.add("object", 2);
+			builderParams.add("add_to_group", true);
+			builderParams.add("parallel_build", true);
+
+			InstanceShapeBuilder builder;
+			builder.applyParams(builderParams);
+			builder.setSourceObject(pShape);
+			builder.createScene(scene);
+			return true;
+		}
+		case eSceneDataChart:
+		{
+			std::string dataPath = FileHelpers::combinePaths(m_workingPath, "benchmark_chart_data.csv");
+			if (!writeDataChartData(dataPath))
+				return false;
+
+			builderParams.add("type", 1);
+			builderParams.add("dataType", 0);
+			builderParams.add("autodetect_counts", false);
+			builderParams.add("xItems", kDataChartItems);
+			builderParams.add("yItems", kDataChartItems);
+			builderParams.add("width", 100.0f);
+			builderParams.add("depth", 100.0f);
+			builderParams.add("height", 30.0f);
+			builderParams.add("normalise_height", true);
+
+			DataChartBuilder builder;
+			builder.applyParams(builderParams);
+			builder.setDataFile(dataPath);
+			builder.createScene(scene);
+			return true;
+		}
+		case eSceneTexturedScatter:
+		{
+			// everything's got a procedural texture on it, so that each shading point does texture lookups
+			StandardMaterial* pMaterial = new StandardMaterial();
+			pMaterial->setDiffuseCheckerboard(4.0f);
+			scene.getMaterialManager().addMaterial(pMaterial);
+
+			Object* pGround = new Plane(200.0f, 200.0f);
+			pGround->setName("Ground");
+			pGround->setMaterial(pMaterial);
+			pGround->constructGeometry();
+			scene.addObject(pGround, false, true, true);
+
+			Object* pSourceCube = new Cube(0.5f);
+			pSourceCube->setMaterial(pMaterial);
+			pSourceCube->constructGeometry();
+			aSourceObjects.emplace_back(pSourceCube);
+
+			builderParams.add("width", 190.0f);
+			builderParams.add("depth", 190.0f);
+			builderParams.add("start_height", 50.0f);
+			builderParams.add("target_instance_count", 200000);
+			builderParams.add("distribution", 1);
+			builderParams.add("uscale_variation", 0.5f);
+			builderParams.add("random_y_rotation", true);
+			builderParams.add("add_to_group", true);
+
+			InstanceSurfaceScatterBuilder builder;
+			builder.applyParams(builderParams);
+			builder.setSourceObject(pSourceCube);
+			builder.createScene(scene);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void RenderBenchmark::setupCameraAndLight(BenchmarkSceneType type, Scene& scene)
+{
+	Vector cameraPosition(14.0f, 9.0f, 14.0f);
+	Point cameraTarget(0.0f, 0.0f, 0.0f);
+
+	switch (type)
+	{
+		case eSceneMengerSponge:
+			break;
+		case eSceneSimpleCity:
+			cameraPosition = Vector(150.0f, 80.0f, 150.0f);
+			break;
+		case eSceneTerrainPointCloud:
+			cameraPosition = Vector(120.0f, 70.0f, 120.0f);
+			break;
+		case eSceneInstanceShape:
+			cameraPosition = Vector(10.0f, 6.0f, 10.0f);
+			break;
+		case eSceneDataChart:
+			cameraPosition = Vector(110.0f, 80.0f, 110.0f);
+			cameraTarget = Point(50.0f, 0.0f, 50.0f);
+			break;
+		case eSceneTexturedScatter:
+			cameraPosition = Vector(40.0f, 15.0f, 40.0f);
+			break;
+	}
+
+	Camera* pCamera = scene.getRenderCamera();
+	pCamera->setPosition(cameraPosition);
+	pCamera->lookAt(cameraTarget);
+
+	// same sky as the material preview uses, which doesn't need any image files
+	PhysicalSky* pSky = new PhysicalSky();
+	pSky->setIntensity(2.0);
+	pSky->setHemiExtend(1);
+	pSky->setIntensityScales(0.03f, 1.0f);
+	pSky->generateEnvironmentImage(0.0f);
+	pSky->setRotation(Vector(0.0f, -178.0f, 0.0f));
+
+	scene.addObject(pSky, false, true, true);
+}
+
+void RenderBenchmark::renderPhase(Scene& scene, const std::string& sceneName, const std::string& phaseName, Params& settings,
+								  unsigned int samplesPerPixel, PhaseResult& result)
+{
+	settings.add("width", m_width);
+	settings.add("height", m_height);
+	settings.add("statsType", (unsigned int)eStatisticsFull);
+	settings.add("statsOutputType", (unsigned int)eStatsOutputFile);
+
+	result.name = phaseName;
+	result.samplesPerPixel = samplesPerPixel;
+	result.cameraRays = (uint64_t)m_width * (uint64_t)m_height * (uint64_t)samplesPerPixel;
+	result.statisticsPath = FileHelpers::combinePaths(m_workingPath, sceneName + "_" + phaseName + "_stats.txt");
+
+	double totalRenderSeconds = 0.0;
+
+	for (unsigned int i = 0; i < m_repeats; i++)
+	{
+		OutputImage image(m_width, m_height, COMPONENT_RGBA);
+
+		Raytracer raytracer(scene, &image, settings, false, m_renderThreads);
+		raytracer.setStatisticsOutputPath(result.statisticsPath);
+		raytracer.setAmbientColour(scene.getAmbientColour());
+
+		raytracer.renderScene(0.0f, &settings, true);
+
+		const Raytracer::RenderPhaseTimes& phaseTimes = raytracer.getLastRenderPhaseTimes();
+
+		totalRenderSeconds += phaseTimes.renderSeconds;
+
+		if (i == 0 || phaseTimes.renderSeconds < result.renderSecondsFastest)
+		{
+			result.renderSecondsFastest = phaseTimes.renderSeconds;
+			result.setupSeconds = phaseTimes.setupSeconds;
+			result.preRenderSeconds = phaseTimes.preRenderSeconds;
+		}
+	}
+
+	if (m_repeats > 0)
+	{
+		result.renderSecondsMean = totalRenderSeconds / (double)m_repeats;
+	}
+
+	result.memoryRSS = System::getProcessCurrentMemUsage();
+}
+
+bool RenderBenchmark::writeDataChartData(const std::string& path) const
+{
+	FILE* pFile = fopen(path.c_str(), "w");
+	if (!pFile)
+		return false;
+
+	// smooth, but not trivially regular, so the bars have lots of different heights
+	for (unsigned int y = 0; y < kDataChartItems; y++)
+	{
+		for (unsigned int x = 0; x < kDataChartItems; x++)
+		{
+			float value = 1.5f + std::sin((float)x * 0.11f) * std::cos((float)y * 0.07f) + 0.5f * std::sin((float)(x + y) * 0.31f);
+			fprintf(pFile, "%u,%u,%f\n", x, y, value);
+		}
+	}
+
+	bool success = !ferror(pFile);
+	fclose(pFile);
+
+	return success;
+}
+
+bool RenderBenchmark::writeResults(const std::string& path) const
+{
+	FILE* pFile = fopen(path.c_str(), "w");
+	if (!pFile)
+		return false;
+
+	System::CPUInfo cpuInfo = System::getCPUInfo();
+
+	fprintf(pFile, "{\n");
+	fprintf(pFile, "  \"system\": {\"sockets\": %u, \"cores\": %u, \"threads\": %u, \"numa_nodes\": %u, \"total_memory\": %zu, \"tsc_clock\": %s},\n",
+			cpuInfo.numSockets, cpuInfo.numCores, cpuInfo.numThreads, cpuInfo.numNUMANodes, System::getTotalMemory(),
+			HighResClock::isUsingTSC() ? "true" : "false");
+	fprintf(pFile, "  \"settings\": {\"width\": %u, \"height\": %u, \"render_threads\": %u, \"repeats\": %u, \"seed\": %u},\n",
+			m_width, m_height, m_renderThreads, m_repeats, kBenchmarkSeed);
+	fprintf(pFile, "  \"peak_memory_rss\": %zu,\n", m_peakMemoryRSS);
+	fprintf(pFile, "  \"scenes\": [");
+
+	std::vector<SceneResult>::const_iterator itScene = m_aSceneResults.begin();
+	for (; itScene != m_aSceneResults.end(); ++itScene)
+	{
+		const SceneResult& sceneResult = *itScene;
+
+		fprintf(pFile, "%s\n    {\"name\": \"%s\", \"build_seconds\": %.6f, \"bvh_build_seconds\": %.6f, ",
+				itScene == m_aSceneResults.begin() ? "" : ",", escapeJSONString(sceneResult.name).c_str(), sceneResult.buildSeconds, sceneResult.bvhBuildSeconds);
+		fprintf(pFile, "\"memory_before_build\": %zu, \"memory_after_build\": %zu,\n     \"phases\": [",
+				sceneResult.memoryBeforeBuild, sceneResult.memoryAfterBuild);
+
+		std::vector<PhaseResult>::const_iterator itPhase = sceneResult.aPhases.begin();
+		for (; itPhase != sceneResult.aPhases.end(); ++itPhase)
+		{
+			const PhaseResult& phaseResult = *itPhase;
+
+			double raysPerSecond = 0.0;
+			if (phaseResult.renderSecondsFastest > 0.0)
+			{
+				raysPerSecond = (double)phaseResult.cameraRays / phaseResult.renderSecondsFastest;
+			}
+
+			fprintf(pFile, "%s\n      {\"name\": \"%s\", \"samples_per_pixel\": %u, \"camera_rays\": %" PRIu64 ", \"camera_rays_per_second\": %.1f, ",
+					itPhase == sceneResult.aPhases.begin() ? "" : ",", escapeJSONString(phaseResult.name).c_str(), phaseResult.samplesPerPixel,
+					phaseResult.cameraRays, raysPerSecond);
+			fprintf(pFile, "\"setup_seconds\": %.6f, \"pre_render_seconds\": %.6f, \"render_seconds_fastest\": %.6f, \"render_seconds_mean\": %.6f, ",
+					phaseResult.setupSeconds, phaseResult.preRenderSeconds, phaseResult.renderSecondsFastest, phaseResult.renderSecondsMean);
+			fprintf(pFile, "\"memory_rss\": %zu, \"statistics_file\": \"%s\"}", phaseResult.memoryRSS, escapeJSONString(phaseResult.statisticsPath).c_str());
+		}
+
+		fprintf(pFile, "\n     ]}");
+	}
+
+	fprintf(pFile, "\n  ]\n}\n");
+
+	bool success = !ferror(pFile);
+	fclose(pFile);
+
+	return success;
+}
+
+} // namespace Imagine
@@ -0,0 +1,138 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#ifndef RENDER_BENCHMARK_H
+#define RENDER_BENCHMARK_H
+
+#include <string>
+#include <vector>
+#include <inttypes.h>
+
+namespace Imagine
+{
+
+class Scene;
+class Object;
+class Params;
+
+// Headless benchmark which builds a fixed set of scenes with the scene builders (so no external assets are needed,
+// and with fixed random seeds, the content's identical each run), and renders each of them in a few different
+// ways, timing the phases. The results are written as JSON, so that runs can be compared to find regressions.
+
+class RenderBenchmark
+{
+public:
+	RenderBenchmark();
+	~RenderBenchmark();
+
+	void setRenderThreads(unsigned int threads) { m_renderThreads = threads; }
+	void setImageSize(unsigned int width, unsigned int height) { m_width = width; m_height = height; }
+	// each render is done this many times, with the fastest and mean times reported
+	void setRepeats(unsigned int repeats) { m_repeats = repeats; }
+	// only run the scene with this name, i.e. "menger_sponge"
+	void setSceneFilter(const std::string& sceneName) { m_sceneFilter = sceneName; }
+	// where per-render statistics files and any generated input data go
+	void setWorkingPath(const std::string& workingPath) { m_workingPath = workingPath; }
+
+	static void getSceneNames(std::vector<std::string>& aNames);
+
+	// returns false if nothing was run
+	bool run();
+
+	bool writeResults(const std::string& path) const;
+
+protected:
+	enum BenchmarkSceneType
+	{
+		eSceneMengerSponge,
+		eSceneSimpleCity,
+		eSceneTerrainPointCloud,
+		eSceneInstanceShape,
+		eSceneDataChart,
+		eSceneTexturedScatter
+	};
+
+	struct PhaseResult
+	{
+		PhaseResult() : samplesPerPixel(0), cameraRays(0), setupSeconds(0.0), preRenderSeconds(0.0),
+			renderSecondsFastest(0.0), renderSecondsMean(0.0), memoryRSS(0)
+		{
+		}
+
+		std::string		name;
+		unsigned int	samplesPerPixel;
+		uint64_t		cameraRays;
+
+		// from the fastest of the repeats
+		double			setupSeconds;
+		double			preRenderSeconds;
+
+		double			renderSecondsFastest;
+		double			renderSecondsMean;
+
+		// in bytes, after the last repeat
+		size_t			memoryRSS;
+
+		// full RenderStatistics output of the last repeat
+		std::string		statisticsPath;
+	};
+
+	struct SceneResult
+	{
+		SceneResult() : buildSeconds(0.0), bvhBuildSeconds(0.0), memoryBeforeBuild(0), memoryAfterBuild(0)
+		{
+		}
+
+		std::string		name;
+
+		double			buildSeconds;
+		// the first render's pre-render phase, which is where the acceleration structures get built
+		double			bvhBuildSeconds;
+
+		size_t			memoryBeforeBuild;
+		size_t			memoryAfterBuild;
+
+		std::vector<PhaseResult>	aPhases;
+	};
+
+	// source objects the builders instance aren't added to the scene, so they're owned by the caller
+	bool buildScene(BenchmarkSceneType type, Scene& scene, std::vector<Object*>& aSourceObjects);
+
+	void setupCameraAndLight(BenchmarkSceneType type, Scene& scene);
+
+	void renderPhase(Scene& scene, const std::string& sceneName, const std::string& phaseName, Params& settings,
+					 unsigned int samplesPerPixel, PhaseResult& result);
+
+	bool writeDataChartData(const std::string& path) const;
+
+protected:
+	unsigned int				m_renderThreads;
+	unsigned int				m_width;
+	unsigned int				m_height;
+	unsigned int				m_repeats;
+
+	std::string					m_sceneFilter;
+	std::string					m_workingPath;
+
+	std::vector<SceneResult>	m_aSceneResults;
+	size_t						m_peakMemoryRSS;
+};
+
+} // namespace Imagine
+
+#endif // RENDER_BENCHMARK_H
@@ -21,6 +21,7 @@
 #include <cstddef>
 #include <cassert>
 #include <cmath>
+#include <algorithm>
 
 #include "output_context.h"
 
@@ -30,6 +31,77 @@
 namespace Imagine
 {
 
+bool AnimationCurve::AnimatedKeys::hasKey(float time) const
+{
+	std::vector<float>::const_iterator itFind = std::lower_bound(times.begin(), times.end(), time);
+	return itFind != times.end() && *itFind == time;
+}
+
+void AnimationCurve::AnimatedKeys::setKey(float time, float value)
+{
+	std::vector<float>::iterator itFind = std::lower_bound(times.begin(), times.end(), time);
+	size_t index = itFind - times.begin();
+
+	if (itFind != times.end() && *itFind == time)
+	{
+		values[index] = value;
+		return;
+	}
+
+	times.insert(itFind, time);
+	values.insert(values.begin() + index, value);
+}
+
+void AnimationCurve::AnimatedKeys::eraseKey(float time)
+{
+	std::vector<float>::iterator itFind = std::lower_bound(times.begin(), times.end(), time);
+	if (itFind == times.end() || *itFind != time)
+		return;
+
+	size_t index = itFind - times.begin();
+
+	times.erase(itFind);
+	values.erase(values.begin() + index);
+}
+
+void AnimationCurve::AnimatedKeys::getSegment(float time, float& lowerValue, float& upperValue, float& ratio) const
+{
+	unsigned int keyCount = (unsigned int)times.size();
+	unsigned int lastKey = keyCount - 1;
+
+	ratio = 0.0f;
+
+	// before (or at) the first key - this also catches NaN times
+	if (!(time > times[0]))
+	{
+		lowerValue = upperValue = values[0];
+		return;
+	}
+
+	// at or after the last key
+	if (time >= times[lastKey])
+	{
+		lowerValue = upperValue = values[lastKey];
+		return;
+	}
+
+	// so from here there are at least two keys, and times[0] < time < times[lastKey]
+	unsigned int index = (unsigned int)(std::upper_bound(times.begin(), times.end(), time) - times.begin()) - 1;
+
+	lowerValue = values[index];
+
+	if (time == times[index])
+	{
+		upperValue = lowerValue;
+		return;
+	}
+
+	upperValue = values[index + 1];
+
+	float timeDelta = (time - times[index]) / (times[index + 1] - times[index]);
+	ratio = getInterpolationRatio(interpolationType, timeDelta);
+}
+
 AnimationCurve::AnimationCurve() : m_tag(0)
 {
 }
@@ -107,77 +179,26 @@ float AnimationCurve::getValue(float time) const
 	if (!pKeys)
 		return m_constantValue;
 
-	const AnimatedKeys& ak = *pKeys;
-
-	size_t keyCount = ak.keys.size();
+	size_t keyCount = pKeys->getKeyCount();
 
 	if (keyCount == 1) // it's constant, so return that
-		return ak.keys.begin()->second;
-
-	float value = 0.0f;
+		return pKeys->values[0];
+	else if (keyCount == 0)
+		return 0.0f;
 
-	// see if it exists
-	std::map<float, float>::const_iterator itFind = ak.keys.find(time);
-	if (itFind != ak.keys.end())
-	{
-		value = itFind->second;
-		return value;
-	}
+	float lowerValue;
+	float upperValue;
+	float ratio;
+	pKeys->getSegment(time, lowerValue, upperValue, ratio);
 
-	std::map<float, float>::const_iterator findLower = ak.keys.lower_bound(time);
-	std::map<float, float>::const_iterator findUpper = ak.keys.upper_bound(time);
-
-	if (findLower == ak.keys.end())
-	{
-		// after last frame
-		std::map<float, float>::const_iterator itLastKey = --ak.keys.rbegin().base();
-		value = itLastKey->second;
-
-		return value;
-	}
-
-	if (findUpper == ak.keys.begin())
-	{
-		// before first frame
-		value = ak.keys.begin()->second;
-		return value;
-	}
-
-	if (findUpper != ak.keys.end())
-	{
-		std::map<float, float>::const_iterator itPrevKey = findUpper;
-		--itPrevKey;
-
-		float lowerTime = (*itPrevKey).first;
-		float lowerValue = (*itPrevKey).second;
-
-		float upperTime = (*findUpper).first;
-		float upperValue = (*findUpper).second;
-
-		float timeRatio = (time - lowerTime) / (upperTime - lowerTime);
-
-		switch (ak.interpolationType)
-		{
-			default:
-			case eLinearInterpolation:
-				value = linearTween(timeRatio, lowerValue, upperValue);
-				break;
-			case eCubicInterpolation:
-				value = cubicTween(timeRatio, lowerValue, upperValue);
-				break;
-			case eQuadraticInterpolation:
-				value = quadraticTween(timeRatio, lowerValue, upperValue);
-				break;
-		}
+	return interpolate(lowerValue, upperValue, ratio);
+}
 
-		return value;
-	}
-	else
-	{
-		assert(false);
-	}
+unsigned int AnimationCurve::getKeyCount() const
+{
+	const AnimatedKeys* pKeys = getPointer();
 
-	return 0.0f;
+	return pKeys ? (unsigned int)pKeys->getKeyCount() : 0;
 }
 
 float AnimationCurve::getValue() const
@@ -236,7 +257,7 @@ void AnimationCurve::setValue(float value, float time)
 		return;
 	}
 
-	pKeys->keys[time] = value;
+	pKeys->setKey(time, value);
 }
 
 bool AnimationCurve::isKey() const
@@ -246,7 +267,7 @@ bool AnimationCurve::isKey() const
 	if (!pKeys)
 		return false;
 
-	return pKeys->keys.count(OutputContext::instance().getFrame()) > 0;
+	return pKeys->hasKey(OutputContext::instance().getFrame());
 }
 
 AnimationCurve::CurveInterpolationType AnimationCurve::getInterpolationType() const
@@ -298,13 +319,13 @@ void AnimationCurve::deleteKey(float time)
 
 	if (pKeys)
 	{
-		if (pKeys->keys.size() == 1)
+		if (pKeys->getKeyCount() == 1)
 		{
 			// if it's the last one, just set it to not be animated
 			setAnimated(false);
 			return;
 		}
-		pKeys->keys.erase(time);
+		pKeys->eraseKey(time);
 	}
 }
 
@@ -350,6 +371,9 @@ void AnimationCurve::load(Stream* stream, unsigned int version)
 		else
 			stream->loadUInt(numKeyFrames);
 
+		pNewKeys->times.reserve(numKeyFrames);
+		pNewKeys->values.reserve(numKeyFrames);
+
 		for (unsigned int i = 0; i < numKeyFrames; i++)
 		{
 			float time;
@@ -357,7 +381,7 @@ void AnimationCurve::load(Stream* stream, unsigned int version)
 			stream->loadFloat(time);
 			stream->loadFloat(value);
 
-			pNewKeys->keys[time] = value;
+			pNewKeys->setKey(time, value);
 		}
 	}
 }
@@ -377,14 +401,13 @@ void AnimationCurve::store(Stream* stream) const
 	{
 		stream->storeEnum(pKeys->interpolationType);
 
-		unsigned int numKeyFrames = pKeys->keys.size();
+		unsigned int numKeyFrames = pKeys->getKeyCount();
 		stream->storeUInt(numKeyFrames);
 
-		std::map<float, float>::const_iterator itKeys = pKeys->keys.begin();
-		for (; itKeys != pKeys->keys.end(); ++itKeys)
+		for (unsigned int i = 0; i < numKeyFrames; i++)
 		{
-			float time = itKeys->first;
-			float value = itKeys->second;
+			float time = pKeys->times[i];
+			float value = pKeys->values[i];
 
 			stream->storeFloat(time);
 			stream->storeFloat(value);
@@ -392,42 +415,38 @@ void AnimationCurve::store(Stream* stream) const
 	}
 }
 
-float AnimationCurve::linearTween(float timeDelta, float start, float end)
-{
-	if (timeDelta > 1.0f)
-		return end;
-
-	return timeDelta * end + (1.0f - timeDelta) * start;
-}
-
-float AnimationCurve::cubicTween(float timeDelta, float start, float end)
+float AnimationCurve::getInterpolationRatio(CurveInterpolationType type, float timeDelta)
 {
-	float b = start;
-	float c = end - start;
-	float d = 1.0f;
-
 	if (timeDelta > 1.0f)
-		return end;
+		return 1.0f;
 	else if (timeDelta < 0.0f)
-		return start;
+		return 0.0f;
 
-	if ((timeDelta /= d / 2.0f) < 1.0f)
-		return c / 2.0f * powf(timeDelta, 3.0f) + b;
-
-	return c / 2.0f * (powf(timeDelta - 2.0f, 3.0f) + 2.0f) + b;
-}
-
-float AnimationCurve::quadraticTween(float timeDelta, float start, float end)
-{
-	float b = start;
-	float c = end - start;
-	float d = 1.0f;
+	switch (type)
+	{
+		default:
+		case eLinearInterpolation:
+			return timeDelta;
+		case eCubicInterpolation:
+		{
+			// ease in / out
+			timeDelta *= 2.0f;
+			if (timeDelta < 1.0f)
+				return 0.5f * timeDelta * timeDelta * timeDelta;
 
-	if ((timeDelta /= d / 2.0f) < 1.0f)
-		return c / 2.0f * timeDelta * timeDelta + b;
+			timeDelta -= 2.0f;
+			return 0.5f * (timeDelta * timeDelta * timeDelta + 2.0f);
+		}
+		case eQuadraticInterpolation:
+		{
+			timeDelta *= 2.0f;
+			if (timeDelta < 1.0f)
+				return 0.5f * timeDelta * timeDelta;
 
-	--timeDelta;
-	return -c / 2.0f * ((timeDelta) * (timeDelta - 2.0f) - 1.0f) + b;
+			timeDelta -= 1.0f;
+			return -0.5f * (timeDelta * (timeDelta - 2.0f) - 1.0f);
+		}
+	}
 }
 
 } // namespace Imagine
@@ -19,7 +19,7 @@
 #ifndef ANIMATION_CURVE_H
 #define ANIMATION_CURVE_H
 
-#include <map>
+#include <vector>
 #include <cstdio>		// needed for nullptr
 #include <stdint.h>		// needed for uintptr_t
 
@@ -71,13 +71,30 @@ public:
 		eNotAnimated
 	};
 
+	// keys are stored as sorted structure-of-arrays, so finding the segment for a time is a binary search
+	// (or a check of the last segment used, for callers which pass a segment hint) over contiguous times
 	struct AnimatedKeys
 	{
 		AnimatedKeys() : interpolationType(eLinearInterpolation)
 		{
 		}
 
-		std::map<float, float>	keys;
+		size_t getKeyCount() const
+		{
+			return times.size();
+		}
+
+		bool hasKey(float time) const;
+		void setKey(float time, float value);
+		void eraseKey(float time);
+
+		// works out the two values to interpolate between for the time, and the (interpolation-type-adjusted)
+		// ratio between them.
+		void getSegment(float time, float& lowerValue, float& upperValue, float& ratio) const;
+
+		// sorted by time
+		std::vector<float>		times;
+		std::vector<float>		values;
 		CurveInterpolationType	interpolationType;
 	};
 
@@ -87,6 +104,8 @@ public:
 	float getValue(float time) const;
 	float getValue() const;
 
+	unsigned int getKeyCount() const;
+
 	void setValue(float value);
 	void setValue(float value, float time);
 
@@ -105,9 +124,14 @@ public:
 	void store(Stream* stream) const;
 
 protected:
-	static float linearTween(float timeDelta, float start, float end);
-	static float cubicTween(float timeDelta, float start, float end);
-	static float quadraticTween(float timeDelta, float start, float end);
+	// the interpolation types are all of the form lower + (upper - lower) * f(timeDelta), so they're done
+	// as a linear interpolation with the ratio adjusted per-type
+	static float getInterpolationRatio(CurveInterpolationType type, float timeDelta);
+
+	static float interpolate(float lowerValue, float upperValue, float ratio)
+	{
+		return ratio * upperValue + (1.0f - ratio) * lowerValue;
+	}
 
 	// for internal Tagged-pointer stuff
 
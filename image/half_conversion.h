@@ -0,0 +1,126 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#ifndef HALF_CONVERSION_H
+#define HALF_CONVERSION_H
+
+#include <cstring>
+#include <inttypes.h>
+
+#include <half.h>
+
+#include "colour/colour3f.h"
+#include "colour/colour3h.h"
+
+#ifdef __F16C__
+#include <immintrin.h>
+#define USE_F16C_CONVERSION 1
+#else
+#define USE_F16C_CONVERSION 0
+#endif
+
+namespace Imagine
+{
+
+// Helpers for keeping half texture / image data as half in memory, and only converting to float at the point of
+// use (i.e. texture lookups), using F16C instructions where available. Without F16C, this falls back to half's
+// own (LUT-based) conversion.
+
+inline static void convertHalfToFloat(const half* pSrc, float* pDst, size_t count)
+{
+	size_t i = 0;
+
+#if USE_F16C_CONVERSION
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i halfValues = _mm_loadu_si128((const __m128i*)(pSrc + i));
+		_mm256_storeu_ps(pDst + i, _mm256_cvtph_ps(halfValues));
+	}
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i halfValues = _mm_loadl_epi64((const __m128i*)(pSrc + i));
+		_mm_storeu_ps(pDst + i, _mm_cvtph_ps(halfValues));
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		pDst[i] = pSrc[i];
+	}
+}
+
+inline static void convertFloatToHalf(const float* pSrc, half* pDst, size_t count)
+{
+	size_t i = 0;
+
+#if USE_F16C_CONVERSION
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i halfValues = _mm256_cvtps_ph(_mm256_loadu_ps(pSrc + i), _MM_FROUND_TO_NEAREST_INT);
+		_mm_storeu_si128((__m128i*)(pDst + i), halfValues);
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		pDst[i] = pSrc[i];
+	}
+}
+
+// converts a row of interleaved half pixels with srcChannels channels (which must be at least 3) into Colour3f values,
+// ignoring any channels after the first 3
+inline static void convertHalfPixelsToColour3f(const half* pSrc, unsigned int srcChannels, unsigned int width, Colour3f* pDst)
+{
+	if (srcChannels == 3)
+	{
+		// Colour3f is tightly-packed, so we can just do the whole row at once
+		convertHalfToFloat(pSrc, &pDst->r, (size_t)width * 3);
+		return;
+	}
+
+	for (unsigned int x = 0; x < width; x++)
+	{
+		pDst->r = pSrc[0];
+		pDst->g = pSrc[1];
+		pDst->b = pSrc[2];
+
+		pSrc += srcChannels;
+		pDst++;
+	}
+}
+
+// single value conversion for lookups - this is safe to use on the last item of a buffer, as it doesn't read beyond the 3 values
+inline static Colour3f convertColour3hToColour3f(const Colour3h& colour)
+{
+#if USE_F16C_CONVERSION
+	uint16_t halfBits[4] = { 0, 0, 0, 0 };
+	memcpy(halfBits, &colour.r, sizeof(half) * 3);
+
+	float floatValues[4];
+	_mm_storeu_ps(floatValues, _mm_cvtph_ps(_mm_loadl_epi64((const __m128i*)halfBits)));
+
+	return Colour3f(floatValues[0], floatValues[1], floatValues[2]);
+#else
+	return Colour3f(colour.r, colour.g, colour.b);
+#endif
+}
+
+} // namespace Imagine
+
+#endif // HALF_CONVERSION_H
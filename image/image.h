@@ -58,6 +58,9 @@ public:
 		IMAGE_CONSTRAINTS_MIPMAP_LEVEL_MINUS1	= 1 << 15,
 		IMAGE_CONSTRAINTS_MIPMAP_LEVEL_MINUS2	= 1 << 16,
 
+		// allows readers to return a 1x1 image if all pixels are identical, for texture use where resolution doesn't matter
+		IMAGE_FLAGS_ALLOW_CONSTANT_COLLAPSE		= 1 << 18,
+
 		IMAGE_NO_CACHING				= 1 << 24
 	};
 
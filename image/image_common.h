@@ -33,6 +33,9 @@ enum ImageComponentFlags
 	
 	COMPONENT_ID				= 1 << 6,
 
+	COMPONENT_VARIANCE			= 1 << 7,	// per-pixel sample variance from adaptive sampling
+	COMPONENT_SAMPLE_COUNT		= 1 << 8,	// number of camera samples each pixel took with adaptive sampling
+
 	COMPONENT_SAMPLES			= 1 << 15,
 
 	COMPONENT_DEEP				= 1 << 16,
@@ -0,0 +1,519 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#include "image_pixel_conversion.h"
+
+#include <cstring>
+
+#include "half_conversion.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#define USE_SSE_PIXEL_CONVERSION 1
+#else
+#define USE_SSE_PIXEL_CONVERSION 0
+#endif
+
+namespace Imagine
+{
+
+template <typename T>
+static void interleavePlanesTyped(const unsigned char* const* ppPlanes, unsigned int numPlanes, size_t startPixel, size_t numPixels, unsigned char* pDst)
+{
+	T* pTypedDst = (T*)pDst + startPixel * numPlanes;
+
+	for (unsigned int c = 0; c < numPlanes; c++)
+	{
+		const T* pPlane = (const T*)ppPlanes[c];
+		T* pChannelDst = pTypedDst + c;
+
+		for (size_t i = startPixel; i < numPixels; i++)
+		{
+			*pChannelDst = pPlane[i];
+			pChannelDst += numPlanes;
+		}
+	}
+}
+
+template <typename T>
+static void deinterleavePlanesTyped(const unsigned char* pSrc, unsigned int numPlanes, size_t numPixels, unsigned char* const* ppPlanes)
+{
+	const T* pTypedSrc = (const T*)pSrc;
+
+	for (unsigned int c = 0; c < numPlanes; c++)
+	{
+		T* pPlane = (T*)ppPlanes[c];
+		const T* pChannelSrc = pTypedSrc + c;
+
+		for (size_t i = 0; i < numPixels; i++)
+		{
+			pPlane[i] = *pChannelSrc;
+			pChannelSrc += numPlanes;
+		}
+	}
+}
+
+template <typename T>
+static void extractChannelsTyped(const unsigned char* pSrc, unsigned int srcChannels, unsigned int dstChannels, size_t numPixels, unsigned char* pDst)
+{
+	const T* pTypedSrc = (const T*)pSrc;
+	T* pTypedDst = (T*)pDst;
+
+	if (dstChannels == 3)
+	{
+		// by far the most common case, so give the compiler a fixed count
+		for (size_t i = 0; i < numPixels; i++)
+		{
+			pTypedDst[0] = pTypedSrc[0];
+			pTypedDst[1] = pTypedSrc[1];
+			pTypedDst[2] = pTypedSrc[2];
+
+			pTypedSrc += srcChannels;
+			pTypedDst += 3;
+		}
+		return;
+	}
+
+	for (size_t i = 0; i < numPixels; i++)
+	{
+		for (unsigned int c = 0; c < dstChannels; c++)
+		{
+			pTypedDst[c] = pTypedSrc[c];
+		}
+
+		pTypedSrc += srcChannels;
+		pTypedDst += dstChannels;
+	}
+}
+
+ImagePixelConversion::ImagePixelConversion()
+{
+}
+
+void ImagePixelConversion::interleavePlanes(const unsigned char* const* ppPlanes, unsigned int numPlanes, unsigned int bytesPerChannel,
+											size_t numPixels, unsigned char* pDst)
+{
+	size_t i = 0;
+
+#if USE_SSE_PIXEL_CONVERSION
+	// 4 planes (RGBA) is the common case where we can use unpacks to do a full transpose
+	if (numPlanes == 4 && bytesPerChannel == 1)
+	{
+		for (; i + 16 <= numPixels; i += 16)
+		{
+			__m128i p0 = _mm_loadu_si128((const __m128i*)(ppPlanes[0] + i));
+			__m128i p1 = _mm_loadu_si128((const __m128i*)(ppPlanes[1] + i));
+			__m128i p2 = _mm_loadu_si128((const __m128i*)(ppPlanes[2] + i));
+			__m128i p3 = _mm_loadu_si128((const __m128i*)(ppPlanes[3] + i));
+
+			__m128i p01Lo = _mm_unpacklo_epi8(p0, p1);
+			__m128i p01Hi = _mm_unpackhi_epi8(p0, p1);
+			__m128i p23Lo = _mm_unpacklo_epi8(p2, p3);
+			__m128i p23Hi = _mm_unpackhi_epi8(p2, p3);
+
+			unsigned char* pLocalDst = pDst + i * 4;
+			_mm_storeu_si128((__m128i*)(pLocalDst), _mm_unpacklo_epi16(p01Lo, p23Lo));
+			_mm_storeu_si128((__m128i*)(pLocalDst + 16), _mm_unpackhi_epi16(p01Lo, p23Lo));
+			_mm_storeu_si128((__m128i*)(pLocalDst + 32), _mm_unpacklo_epi16(p01Hi, p23Hi));
+			_mm_storeu_si128((__m128i*)(pLocalDst + 48), _mm_unpackhi_epi16(p01Hi, p23Hi));
+		}
+	}
+	else if (numPlanes == 4 && bytesPerChannel == 2)
+	{
+		for (; i + 8 <= numPixels; i += 8)
+		{
+			__m128i p0 = _mm_loadu_si128((const __m128i*)(ppPlanes[0] + i * 2));
+			__m128i p1 = _mm_loadu_si128((const __m128i*)(ppPlanes[1] + i * 2));
+			__m128i p2 = _mm_loadu_si128((const __m128i*)(ppPlanes[2] + i * 2));
+			__m128i p3 = _mm_loadu_si128((const __m128i*)(ppPlanes[3] + i * 2));
+
+			__m128i p01Lo = _mm_unpacklo_epi16(p0, p1);
+			__m128i p01Hi = _mm_unpackhi_epi16(p0, p1);
+			__m128i p23Lo = _mm_unpacklo_epi16(p2, p3);
+			__m128i p23Hi = _mm_unpackhi_epi16(p2, p3);
+
+			unsigned char* pLocalDst = pDst + i * 8;
+			_mm_storeu_si128((__m128i*)(pLocalDst), _mm_unpacklo_epi32(p01Lo, p23Lo));
+			_mm_storeu_si128((__m128i*)(pLocalDst + 16), _mm_unpackhi_epi32(p01Lo, p23Lo));
+			_mm_storeu_si128((__m128i*)(pLocalDst + 32), _mm_unpacklo_epi32(p01Hi, p23Hi));
+			_mm_storeu_si128((__m128i*)(pLocalDst + 48), _mm_unpackhi_epi32(p01Hi, p23Hi));
+		}
+	}
+	else if (numPlanes == 4 && bytesPerChannel == 4)
+	{
+		for (; i + 4 <= numPixels; i += 4)
+		{
+			__m128i p0 = _mm_loadu_si128((const __m128i*)(ppPlanes[0] + i * 4));
+			__m128i p1 = _mm_loadu_si128((const __m128i*)(ppPlanes[1] + i * 4));
+			__m128i p2 = _mm_loadu_si128((const __m128i*)(ppPlanes[2] + i * 4));
+			__m128i p3 = _mm_loadu_si128((const __m128i*)(ppPlanes[3] + i * 4));
+
+			__m128i p01Lo = _mm_unpacklo_epi32(p0, p1);
+			__m128i p01Hi = _mm_unpackhi_epi32(p0, p1);
+			__m128i p23Lo = _mm_unpacklo_epi32(p2, p3);
+			__m128i p23Hi = _mm_unpackhi_epi32(p2, p3);
+
+			unsigned char* pLocalDst = pDst + i * 16;
+			_mm_storeu_si128((__m128i*)(pLocalDst), _mm_unpacklo_epi64(p01Lo, p23Lo));
+			_mm_storeu_si128((__m128i*)(pLocalDst + 16), _mm_unpackhi_epi64(p01Lo, p23Lo));
+			_mm_storeu_si128((__m128i*)(pLocalDst + 32), _mm_unpacklo_epi64(p01Hi, p23Hi));
+			_mm_storeu_si128((__m128i*)(pLocalDst + 48), _mm_unpackhi_epi64(p01Hi, p23Hi));
+		}
+	}
+#endif
+
+	// anything else (3 planes in particular doesn't map nicely to SIMD registers) - or the remainder from above
+	switch (bytesPerChannel)
+	{
+		case 1:
+			interleavePlanesTyped<uint8_t>(ppPlanes, numPlanes, i, numPixels, pDst);
+			break;
+		case 2:
+			interleavePlanesTyped<uint16_t>(ppPlanes, numPlanes, i, numPixels, pDst);
+			break;
+		case 4:
+			interleavePlanesTyped<uint32_t>(ppPlanes, numPlanes, i, numPixels, pDst);
+			break;
+		default:
+			break;
+	}
+}
+
+void ImagePixelConversion::deinterleavePlanes(const unsigned char* pSrc, unsigned int numPlanes, unsigned int bytesPerChannel,
+											  size_t numPixels, unsigned char* const* ppPlanes)
+{
+	switch (bytesPerChannel)
+	{
+		case 1:
+			deinterleavePlanesTyped<uint8_t>(pSrc, numPlanes, numPixels, ppPlanes);
+			break;
+		case 2:
+			deinterleavePlanesTyped<uint16_t>(pSrc, numPlanes, numPixels, ppPlanes);
+			break;
+		case 4:
+			deinterleavePlanesTyped<uint32_t>(pSrc, numPlanes, numPixels, ppPlanes);
+			break;
+		default:
+			break;
+	}
+}
+
+void ImagePixelConversion::extractChannels(const unsigned char* pSrc, unsigned int srcChannels, unsigned int dstChannels,
+										   unsigned int bytesPerChannel, size_t numPixels, unsigned char* pDst)
+{
+	if (srcChannels == dstChannels)
+	{
+		memcpy(pDst, pSrc, numPixels * srcChannels * bytesPerChannel);
+		return;
+	}
+
+	switch (bytesPerChannel)
+	{
+		case 1:
+			extractChannelsTyped<uint8_t>(pSrc, srcChannels, dstChannels, numPixels, pDst);
+			break;
+		case 2:
+			extractChannelsTyped<uint16_t>(pSrc, srcChannels, dstChannels, numPixels, pDst);
+			break;
+		case 4:
+			extractChannelsTyped<uint32_t>(pSrc, srcChannels, dstChannels, numPixels, pDst);
+			break;
+		default:
+			break;
+	}
+}
+
+void ImagePixelConversion::convertUInt8ToFloat(const uint8_t* pSrc, float* pDst, size_t count, float scale)
+{
+	size_t i = 0;
+
+#if USE_SSE_PIXEL_CONVERSION
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 scaleValue = _mm_set1_ps(scale);
+
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i bytes = _mm_loadu_si128((const __m128i*)(pSrc + i));
+		__m128i shortsLo = _mm_unpacklo_epi8(bytes, zero);
+		__m128i shortsHi = _mm_unpackhi_epi8(bytes, zero);
+
+		_mm_storeu_ps(pDst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(shortsLo, zero)), scaleValue));
+		_mm_storeu_ps(pDst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(shortsLo, zero)), scaleValue));
+		_mm_storeu_ps(pDst + i + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(shortsHi, zero)), scaleValue));
+		_mm_storeu_ps(pDst + i + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(shortsHi, zero)), scaleValue));
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		pDst[i] = (float)pSrc[i] * scale;
+	}
+}
+
+void ImagePixelConversion::convertUInt16ToFloat(const uint16_t* pSrc, float* pDst, size_t count, float scale)
+{
+	size_t i = 0;
+
+#if USE_SSE_PIXEL_CONVERSION
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 scaleValue = _mm_set1_ps(scale);
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i shorts = _mm_loadu_si128((const __m128i*)(pSrc + i));
+
+		_mm_storeu_ps(pDst + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(shorts, zero)), scaleValue));
+		_mm_storeu_ps(pDst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(shorts, zero)), scaleValue));
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		pDst[i] = (float)pSrc[i] * scale;
+	}
+}
+
+void ImagePixelConversion::convertUInt16ToHalf(const uint16_t* pSrc, half* pDst, size_t count, float scale)
+{
+	// go via float in small chunks, so the intermediate stays in L1
+	float tempValues[256];
+
+	for (size_t i = 0; i < count; i += 256)
+	{
+		size_t chunkCount = (count - i < 256) ? count - i : 256;
+
+		convertUInt16ToFloat(pSrc + i, tempValues, chunkCount, scale);
+		convertFloatToHalf(tempValues, pDst + i, chunkCount);
+	}
+}
+
+void ImagePixelConversion::convertFloatToUInt8(const float* pSrc, uint8_t* pDst, size_t count, float scale)
+{
+	size_t i = 0;
+
+#if USE_SSE_PIXEL_CONVERSION
+	const __m128 scaleValue = _mm_set1_ps(scale);
+	const __m128 minValue = _mm_set1_ps(0.0f);
+	const __m128 maxValue = _mm_set1_ps(255.0f);
+	const __m128 roundOffset = _mm_set1_ps(0.5f);
+
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128 scaled0 = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(pSrc + i), scaleValue), roundOffset);
+		__m128 scaled1 = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(pSrc + i + 4), scaleValue), roundOffset);
+		__m128 scaled2 = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(pSrc + i + 8), scaleValue), roundOffset);
+		__m128 scaled3 = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(pSrc + i + 12), scaleValue), roundOffset);
+
+		// Note: the order is important here so that NaNs end up as 0
+		__m128i values0 = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(scaled0, minValue), maxValue));
+		__m128i values1 = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(scaled1, minValue), maxValue));
+		__m128i values2 = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(scaled2, minValue), maxValue));
+		__m128i values3 = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(scaled3, minValue), maxValue));
+
+		__m128i packed = _mm_packus_epi16(_mm_packs_epi32(values0, values1), _mm_packs_epi32(values2, values3));
+		_mm_storeu_si128((__m128i*)(pDst + i), packed);
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		float value = pSrc[i] * scale + 0.5f;
+		// written this way round so NaNs end up as 0
+		value = (value > 0.0f) ? value : 0.0f;
+		pDst[i] = (uint8_t)((value < 255.0f) ? value : 255.0f);
+	}
+}
+
+void ImagePixelConversion::convertFloatToUInt16(const float* pSrc, uint16_t* pDst, size_t count, float scale)
+{
+	size_t i = 0;
+
+#if USE_SSE_PIXEL_CONVERSION
+	const __m128 scaleValue = _mm_set1_ps(scale);
+	const __m128 minValue = _mm_set1_ps(0.0f);
+	const __m128 maxValue = _mm_set1_ps(65535.0f);
+	const __m128 roundOffset = _mm_set1_ps(0.5f);
+	// SSE2 only has signed saturation for packing 32-bit values, so bias around 0 and then undo it afterwards.
+	const __m128i bias32 = _mm_set1_epi32(32768);
+	const __m128i bias16 = _mm_set1_epi16((short)0x8000);
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128 scaled0 = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(pSrc + i), scaleValue), roundOffset);
+		__m128 scaled1 = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(pSrc + i + 4), scaleValue), roundOffset);
+
+		// Note: the order is important here so that NaNs end up as 0
+		scaled0 = _mm_min_ps(_mm_max_ps(scaled0, minValue), maxValue);
+		scaled1 = _mm_min_ps(_mm_max_ps(scaled1, minValue), maxValue);
+
+		__m128i values0 = _mm_sub_epi32(_mm_cvttps_epi32(scaled0), bias32);
+		__m128i values1 = _mm_sub_epi32(_mm_cvttps_epi32(scaled1), bias32);
+
+		_mm_storeu_si128((__m128i*)(pDst + i), _mm_xor_si128(_mm_packs_epi32(values0, values1), bias16));
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		float value = pSrc[i] * scale + 0.5f;
+		value = (value > 0.0f) ? value : 0.0f;
+		pDst[i] = (uint16_t)((value < 65535.0f) ? value : 65535.0f);
+	}
+}
+
+void ImagePixelConversion::swizzleBGRToRGBA8(const uint8_t* pSrc, unsigned int srcChannels, uint8_t* pDst, size_t numPixels)
+{
+	size_t i = 0;
+
+	if (srcChannels == 4)
+	{
+#if USE_SSE_PIXEL_CONVERSION
+		// swap bytes 0 and 2 of each 32-bit pixel
+		const __m128i maskAG = _mm_set1_epi32((int)0xFF00FF00);
+		const __m128i maskByte = _mm_set1_epi32(0x000000FF);
+
+		for (; i + 4 <= numPixels; i += 4)
+		{
+			__m128i pixels = _mm_loadu_si128((const __m128i*)(pSrc + i * 4));
+
+			__m128i ag = _mm_and_si128(pixels, maskAG);
+			__m128i r = _mm_and_si128(_mm_srli_epi32(pixels, 16), maskByte);
+			__m128i b = _mm_slli_epi32(_mm_and_si128(pixels, maskByte), 16);
+
+			_mm_storeu_si128((__m128i*)(pDst + i * 4), _mm_or_si128(ag, _mm_or_si128(r, b)));
+		}
+#endif
+
+		for (; i < numPixels; i++)
+		{
+			const uint8_t* pPixel = pSrc + i * 4;
+			uint8_t* pDstPixel = pDst + i * 4;
+
+			pDstPixel[0] = pPixel[2];
+			pDstPixel[1] = pPixel[1];
+			pDstPixel[2] = pPixel[0];
+			pDstPixel[3] = pPixel[3];
+		}
+	}
+	else
+	{
+		for (; i < numPixels; i++)
+		{
+			const uint8_t* pPixel = pSrc + i * 3;
+			uint8_t* pDstPixel = pDst + i * 4;
+
+			pDstPixel[0] = pPixel[2];
+			pDstPixel[1] = pPixel[1];
+			pDstPixel[2] = pPixel[0];
+			pDstPixel[3] = 255;
+		}
+	}
+}
+
+void ImagePixelConversion::byteSwap16(uint16_t* pData, size_t count)
+{
+	size_t i = 0;
+
+#if USE_SSE_PIXEL_CONVERSION
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i values = _mm_loadu_si128((const __m128i*)(pData + i));
+		_mm_storeu_si128((__m128i*)(pData + i), _mm_or_si128(_mm_slli_epi16(values, 8), _mm_srli_epi16(values, 8)));
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		pData[i] = (uint16_t)((pData[i] << 8) | (pData[i] >> 8));
+	}
+}
+
+void ImagePixelConversion::byteSwap32(uint32_t* pData, size_t count)
+{
+	size_t i = 0;
+
+#if USE_SSE_PIXEL_CONVERSION
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i values = _mm_loadu_si128((const __m128i*)(pData + i));
+
+		// swap the 16-bit halves of each value, then the bytes within those
+		values = _mm_shufflelo_epi16(values, _MM_SHUFFLE(2, 3, 0, 1));
+		values = _mm_shufflehi_epi16(values, _MM_SHUFFLE(2, 3, 0, 1));
+		values = _mm_or_si128(_mm_slli_epi16(values, 8), _mm_srli_epi16(values, 8));
+
+		_mm_storeu_si128((__m128i*)(pData + i), values);
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		uint32_t value = pData[i];
+		pData[i] = (value >> 24) | ((value >> 8) & 0x0000FF00) | ((value << 8) & 0x00FF0000) | (value << 24);
+	}
+}
+
+void ImagePixelConversion::swapRows(unsigned char* pRowA, unsigned char* pRowB, size_t rowBytes)
+{
+	size_t i = 0;
+
+#if USE_SSE_PIXEL_CONVERSION
+	for (; i + 32 <= rowBytes; i += 32)
+	{
+		__m128i a0 = _mm_loadu_si128((const __m128i*)(pRowA + i));
+		__m128i a1 = _mm_loadu_si128((const __m128i*)(pRowA + i + 16));
+		__m128i b0 = _mm_loadu_si128((const __m128i*)(pRowB + i));
+		__m128i b1 = _mm_loadu_si128((const __m128i*)(pRowB + i + 16));
+
+		_mm_storeu_si128((__m128i*)(pRowA + i), b0);
+		_mm_storeu_si128((__m128i*)(pRowA + i + 16), b1);
+		_mm_storeu_si128((__m128i*)(pRowB + i), a0);
+		_mm_storeu_si128((__m128i*)(pRowB + i + 16), a1);
+	}
+#endif
+
+	for (; i + 8 <= rowBytes; i += 8)
+	{
+		uint64_t a;
+		uint64_t b;
+		memcpy(&a, pRowA + i, 8);
+		memcpy(&b, pRowB + i, 8);
+		memcpy(pRowA + i, &b, 8);
+		memcpy(pRowB + i, &a, 8);
+	}
+
+	for (; i < rowBytes; i++)
+	{
+		unsigned char temp = pRowA[i];
+		pRowA[i] = pRowB[i];
+		pRowB[i] = temp;
+	}
+}
+
+void ImagePixelConversion::flipRowsVertically(unsigned char* pData, size_t rowBytes, unsigned int numRows)
+{
+	// only need to do half of them, as we're swapping top and bottom
+	unsigned int numSwaps = numRows / 2;
+
+	for (unsigned int i = 0; i < numSwaps; i++)
+	{
+		swapRows(pData + (size_t)i * rowBytes, pData + (size_t)(numRows - i - 1) * rowBytes, rowBytes);
+	}
+}
+
+} // namespace Imagine
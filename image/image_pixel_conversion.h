@@ -0,0 +1,74 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#ifndef IMAGE_PIXEL_CONVERSION_H
+#define IMAGE_PIXEL_CONVERSION_H
+
+#include <cstddef>
+#include <inttypes.h>
+
+#include <half.h>
+
+namespace Imagine
+{
+
+// shared (SSE2 where available) kernels for image readers to do the bulk shuffling / type conversion of raw pixel
+// data on whole scanlines or tiles at a time, rather than per-component in each reader.
+// Half <-> float conversion lives in half_conversion.h.
+
+class ImagePixelConversion
+{
+public:
+	ImagePixelConversion();
+
+	// planar (one buffer per channel) to interleaved, and back. bytesPerChannel must be 1, 2 or 4.
+	static void interleavePlanes(const unsigned char* const* ppPlanes, unsigned int numPlanes, unsigned int bytesPerChannel,
+								 size_t numPixels, unsigned char* pDst);
+	static void deinterleavePlanes(const unsigned char* pSrc, unsigned int numPlanes, unsigned int bytesPerChannel,
+								   size_t numPixels, unsigned char* const* ppPlanes);
+
+	// copies the first dstChannels channels of each srcChannels-channel pixel (i.e. to drop alpha / extra channels),
+	// so srcChannels must be >= dstChannels
+	static void extractChannels(const unsigned char* pSrc, unsigned int srcChannels, unsigned int dstChannels,
+								unsigned int bytesPerChannel, size_t numPixels, unsigned char* pDst);
+
+	// integer to float, multiplying by scale
+	static void convertUInt8ToFloat(const uint8_t* pSrc, float* pDst, size_t count, float scale);
+	static void convertUInt16ToFloat(const uint16_t* pSrc, float* pDst, size_t count, float scale);
+	static void convertUInt16ToHalf(const uint16_t* pSrc, half* pDst, size_t count, float scale);
+
+	// float to integer, multiplying by scale, then rounding and clamping to the integer type's range
+	static void convertFloatToUInt8(const float* pSrc, uint8_t* pDst, size_t count, float scale);
+	static void convertFloatToUInt16(const float* pSrc, uint16_t* pDst, size_t count, float scale);
+
+	// BGR(A) (as TGA stores) to RGBA - srcChannels must be 3 or 4, with alpha set to 255 for 3.
+	static void swizzleBGRToRGBA8(const uint8_t* pSrc, unsigned int srcChannels, uint8_t* pDst, size_t numPixels);
+
+	// in-place endian swapping
+	static void byteSwap16(uint16_t* pData, size_t count);
+	static void byteSwap32(uint32_t* pData, size_t count);
+
+	// swaps the contents of two (non-overlapping) rows without needing a temporary buffer
+	static void swapRows(unsigned char* pRowA, unsigned char* pRowB, size_t rowBytes);
+	// in-place vertical flip of contiguous rows
+	static void flipRowsVertically(unsigned char* pData, size_t rowBytes, unsigned int numRows);
+};
+
+} // namespace Imagine
+
+#endif // IMAGE_PIXEL_CONVERSION_H
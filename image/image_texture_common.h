@@ -152,7 +152,7 @@ public:
 		m_dataType(eUnknown), m_wrapMode(eClamp),
 	    m_fullWidth(0), m_fullHeight(0), m_channelCount(0), 
 	    m_flipY(false),	m_isTiled(false), m_isScanline(false), m_isMipmapped(false),
-		m_isConstant(false), m_needsPerThreadFileHandles(true)
+		m_isConstant(false), m_allowBlockCompression(false), m_needsPerThreadFileHandles(true)
 	{
 
 	}
@@ -215,6 +215,11 @@ public:
 	void setIsConstant(bool isConstant) { m_isConstant = isConstant; }
 	bool isConstant() const { return m_isConstant; }
 
+	// whether the cache is allowed to store tiles of this texture block compressed in memory (lossy, so opt-in per texture,
+	// and only for 8-bit data currently - see TextureBlockCodec)
+	void setAllowBlockCompression(bool allowBlockCompression) { m_allowBlockCompression = allowBlockCompression; }
+	bool isAllowBlockCompression() const { return m_allowBlockCompression; }
+
 	void setNeedsPerThreadFileHandles(bool needsPerThreadFileHandles) { m_needsPerThreadFileHandles = needsPerThreadFileHandles; }
 	bool isNeedsPerThreadFileHandles() const { return m_needsPerThreadFileHandles; }
 
@@ -224,6 +229,32 @@ public:
 	void setDataType(ImageDataType dataType) { m_dataType = dataType; }
 	ImageDataType getDataType() const { return m_dataType; }
 
+	// size in bytes of one channel of the given type as stored in memory - readers should store tile data in the
+	// native type (e.g. half data as half, not expanded to float), so that memory limits account for the actual size,
+	// with any conversion to float happening at lookup time.
+	static size_t getDataTypeByteSize(ImageDataType dataType)
+	{
+		switch (dataType)
+		{
+			case eFloat:
+			case eUInt32:
+			case eInt32:
+				return 4;
+			case eHalf:
+			case eUInt16:
+			case eInt16:
+				return 2;
+			case eUInt8:
+			case eInt8:
+				return 1;
+			default:
+				return 0;
+		}
+	}
+
+	// size of one pixel (data type * num channels) in bytes
+	size_t getPixelByteSize() const { return getDataTypeByteSize(m_dataType) * m_channelCount; }
+
 	void setWrapMode(ImageWrapMode wrapMode) { m_wrapMode = wrapMode; }
 	ImageWrapMode getWrapMode() const { return m_wrapMode; }
 
@@ -256,6 +287,8 @@ protected:
 	bool						m_isMipmapped; // implies tiled for the moment...
 	bool						m_isConstant;
 
+	bool						m_allowBlockCompression;
+
 	bool						m_needsPerThreadFileHandles;
 };
 
@@ -357,6 +390,11 @@ public:
 		return m_openedFile;
 	}
 
+	bool wasTileConstant() const
+	{
+		return m_tileWasConstant;
+	}
+
 	unsigned char* getConstantData()
 	{
 		if (!m_tileWasConstant || !m_pConstantData)
@@ -18,10 +18,23 @@
 
 #include "image_utils.h"
 
+#include <cstring>
+
 #include "image_colour3f.h"
 #include "image_colour3h.h"
+#include "image_colour3b.h"
 #include "image_1f.h"
 #include "image_1h.h"
+#include "image_1b.h"
+#include "image_texture_common.h"
+#include "image_pixel_conversion.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#define USE_SSE_CONSTANT_CHECK 1
+#else
+#define USE_SSE_CONSTANT_CHECK 0
+#endif
 
 namespace Imagine
 {
@@ -71,156 +84,275 @@ bool ImageUtils::flipImageVertically(Image* pImage)
 
 void ImageUtils::flipImageTileVertically(unsigned char* pData, unsigned int pixelStride, unsigned int width, unsigned int height)
 {
-	unsigned int tilePixelWidth = pixelStride * width;
-	unsigned char* pTempScanline = new unsigned char[tilePixelWidth];
+	ImagePixelConversion::flipRowsVertically(pData, (size_t)pixelStride * width, height);
+}
 
-	// only need to do half of them, as we're swapping top and bottom
-	unsigned int numRows = height / 2;
+bool ImageUtils::isDataConstant(const unsigned char* pData, unsigned int pixelByteSize, size_t numPixels)
+{
+	if (numPixels <= 1)
+		return true;
 
-	unsigned int targetScanline = height - 1;
+	// if each pixel is identical to the one after it, they're all the same, so we can just compare the buffer
+	// against itself offset by one pixel, which means we don't need to care about the pixel size for the SIMD compares.
+	const unsigned char* pA = pData;
+	const unsigned char* pB = pData + pixelByteSize;
+	const size_t compareBytes = (numPixels - 1) * pixelByteSize;
 
-	for (unsigned int i = 0; i < numRows; i++)
+	size_t i = 0;
+
+#if USE_SSE_CONSTANT_CHECK
+	for (; i + 64 <= compareBytes; i += 64)
 	{
-		unsigned char* pSrc = pData + (i * tilePixelWidth);
+		__m128i equal0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(pA + i)), _mm_loadu_si128((const __m128i*)(pB + i)));
+		__m128i equal1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(pA + i + 16)), _mm_loadu_si128((const __m128i*)(pB + i + 16)));
+		__m128i equal2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(pA + i + 32)), _mm_loadu_si128((const __m128i*)(pB + i + 32)));
+		__m128i equal3 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(pA + i + 48)), _mm_loadu_si128((const __m128i*)(pB + i + 48)));
+
+		__m128i allEqual = _mm_and_si128(_mm_and_si128(equal0, equal1), _mm_and_si128(equal2, equal3));
+		if (_mm_movemask_epi8(allEqual) != 0xFFFF)
+			return false;
+	}
 
-		memcpy(pTempScanline, pSrc, tilePixelWidth);
+	for (; i + 16 <= compareBytes; i += 16)
+	{
+		__m128i equal = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(pA + i)), _mm_loadu_si128((const __m128i*)(pB + i)));
+		if (_mm_movemask_epi8(equal) != 0xFFFF)
+			return false;
+	}
+#endif
 
-		unsigned char* pDst = pData + (targetScanline * tilePixelWidth);
+	return memcmp(pA + i, pB + i, compareBytes - i) == 0;
+}
 
-		// copy bottom to top
-		memcpy(pSrc, pDst, tilePixelWidth);
+bool ImageUtils::isImageConstant(const Image* pImage)
+{
+	unsigned int width = pImage->getWidth();
+	unsigned int height = pImage->getHeight();
 
-		// copy temp to bottom
-		memcpy(pDst, pTempScanline, tilePixelWidth);
+	if (width == 0 || height == 0)
+		return false;
 
-		targetScanline --;
-	}
+	// Note: the image classes don't have const row accessors...
+	Image* pNonConstImage = const_cast<Image*>(pImage);
+
+	unsigned int imageType = pImage->getImageType();
 
-	if (pTempScanline)
+	// check the first row is constant within itself, and then that all other rows match it
+	if (imageType == (Image::IMAGE_CHANNELS_3 | Image::IMAGE_FORMAT_FLOAT))
 	{
-		delete [] pTempScanline;
-		pTempScanline = nullptr;
+		ImageColour3f* pImageColour3f = static_cast<ImageColour3f*>(pNonConstImage);
+		const unsigned char* pFirstRow = (const unsigned char*)pImageColour3f->colourRowPtr(0);
+		if (!isDataConstant(pFirstRow, sizeof(Colour3f), width))
+			return false;
+
+		for (unsigned int y = 1; y < height; y++)
+		{
+			if (memcmp(pImageColour3f->colourRowPtr(y), pFirstRow, width * sizeof(Colour3f)) != 0)
+				return false;
+		}
 	}
+	else if (imageType == (Image::IMAGE_CHANNELS_3 | Image::IMAGE_FORMAT_HALF))
+	{
+		ImageColour3h* pImageColour3h = static_cast<ImageColour3h*>(pNonConstImage);
+		const unsigned char* pFirstRow = (const unsigned char*)pImageColour3h->colour3hRowPtr(0);
+		if (!isDataConstant(pFirstRow, sizeof(Colour3h), width))
+			return false;
+
+		for (unsigned int y = 1; y < height; y++)
+		{
+			if (memcmp(pImageColour3h->colour3hRowPtr(y), pFirstRow, width * sizeof(Colour3h)) != 0)
+				return false;
+		}
+	}
+	else if (imageType == (Image::IMAGE_CHANNELS_3 | Image::IMAGE_FORMAT_BYTE))
+	{
+		ImageColour3b* pImageColour3b = static_cast<ImageColour3b*>(pNonConstImage);
+		const unsigned char* pFirstRow = (const unsigned char*)pImageColour3b->colour3bRowPtr(0);
+		if (!isDataConstant(pFirstRow, sizeof(Colour3b), width))
+			return false;
+
+		for (unsigned int y = 1; y < height; y++)
+		{
+			if (memcmp(pImageColour3b->colour3bRowPtr(y), pFirstRow, width * sizeof(Colour3b)) != 0)
+				return false;
+		}
+	}
+	else if (imageType == (Image::IMAGE_CHANNELS_1 | Image::IMAGE_FORMAT_FLOAT))
+	{
+		Image1f* pImage1f = static_cast<Image1f*>(pNonConstImage);
+		const unsigned char* pFirstRow = (const unsigned char*)pImage1f->floatRowPtr(0);
+		if (!isDataConstant(pFirstRow, sizeof(float), width))
+			return false;
+
+		for (unsigned int y = 1; y < height; y++)
+		{
+			if (memcmp(pImage1f->floatRowPtr(y), pFirstRow, width * sizeof(float)) != 0)
+				return false;
+		}
+	}
+	else if (imageType == (Image::IMAGE_CHANNELS_1 | Image::IMAGE_FORMAT_HALF))
+	{
+		Image1h* pImage1h = static_cast<Image1h*>(pNonConstImage);
+		const unsigned char* pFirstRow = (const unsigned char*)pImage1h->halfRowPtr(0);
+		if (!isDataConstant(pFirstRow, sizeof(half), width))
+			return false;
+
+		for (unsigned int y = 1; y < height; y++)
+		{
+			if (memcmp(pImage1h->halfRowPtr(y), pFirstRow, width * sizeof(half)) != 0)
+				return false;
+		}
+	}
+	else if (imageType == (Image::IMAGE_CHANNELS_1 | Image::IMAGE_FORMAT_BYTE))
+	{
+		Image1b* pImage1b = static_cast<Image1b*>(pNonConstImage);
+		const unsigned char* pFirstRow = pImage1b->uCharRowPtr(0);
+		if (!isDataConstant(pFirstRow, sizeof(unsigned char), width))
+			return false;
+
+		for (unsigned int y = 1; y < height; y++)
+		{
+			if (memcmp(pImage1b->uCharRowPtr(y), pFirstRow, width) != 0)
+				return false;
+		}
+	}
+	else
+	{
+		return false;
+	}
+
+	return true;
 }
 
-void ImageUtils::flipImageVertically(ImageColour3f* pImage, unsigned int scanlines, unsigned int numRows, unsigned int width, unsigned int scanlineBytes)
+Image* ImageUtils::collapseConstantImage(Image* pImage, unsigned int requiredTypeFlags)
 {
-	Colour3f* pTempScanline = new Colour3f[width];
+	if (!pImage || !(requiredTypeFlags & Image::IMAGE_FLAGS_ALLOW_CONSTANT_COLLAPSE))
+		return pImage;
 
-	unsigned int targetScanline = scanlines - 1;
+	if ((pImage->getWidth() == 1 && pImage->getHeight() == 1) || !isImageConstant(pImage))
+		return pImage;
 
-	for (unsigned int i = 0; i < numRows; i++)
+	Image* pNewImage = nullptr;
+
+	unsigned int imageType = pImage->getImageType();
+
+	if (imageType == (Image::IMAGE_CHANNELS_3 | Image::IMAGE_FORMAT_FLOAT))
+	{
+		ImageColour3f* pNewImageColour3f = new ImageColour3f(1, 1, false);
+		*pNewImageColour3f->colourRowPtr(0) = *static_cast<ImageColour3f*>(pImage)->colourRowPtr(0);
+		pNewImage = pNewImageColour3f;
+	}
+	else if (imageType == (Image::IMAGE_CHANNELS_3 | Image::IMAGE_FORMAT_HALF))
 	{
-		Colour3f* pSrc = pImage->colourRowPtr(i);
+		ImageColour3h* pNewImageColour3h = new ImageColour3h(1, 1, false);
+		*pNewImageColour3h->colour3hRowPtr(0) = *static_cast<ImageColour3h*>(pImage)->colour3hRowPtr(0);
+		pNewImage = pNewImageColour3h;
+	}
+	else if (imageType == (Image::IMAGE_CHANNELS_3 | Image::IMAGE_FORMAT_BYTE))
+	{
+		ImageColour3b* pNewImageColour3b = new ImageColour3b(1, 1, false);
+		*pNewImageColour3b->colour3bRowPtr(0) = *static_cast<ImageColour3b*>(pImage)->colour3bRowPtr(0);
+		pNewImage = pNewImageColour3b;
+	}
+	else if (imageType == (Image::IMAGE_CHANNELS_1 | Image::IMAGE_FORMAT_FLOAT))
+	{
+		Image1f* pNewImage1f = new Image1f(1, 1, false);
+		*pNewImage1f->floatRowPtr(0) = *static_cast<Image1f*>(pImage)->floatRowPtr(0);
+		pNewImage = pNewImage1f;
+	}
+	else if (imageType == (Image::IMAGE_CHANNELS_1 | Image::IMAGE_FORMAT_HALF))
+	{
+		Image1h* pNewImage1h = new Image1h(1, 1, false);
+		*pNewImage1h->halfRowPtr(0) = *static_cast<Image1h*>(pImage)->halfRowPtr(0);
+		pNewImage = pNewImage1h;
+	}
+	else if (imageType == (Image::IMAGE_CHANNELS_1 | Image::IMAGE_FORMAT_BYTE))
+	{
+		Image1b* pNewImage1b = new Image1b(1, 1, false);
+		*pNewImage1b->uCharRowPtr(0) = *static_cast<Image1b*>(pImage)->uCharRowPtr(0);
+		pNewImage = pNewImage1b;
+	}
 
-		memcpy(pTempScanline, pSrc, scanlineBytes);
+	if (!pNewImage)
+		return pImage;
 
-		Colour3f* pDst = pImage->colourRowPtr(targetScanline);
+	delete pImage;
 
-		// copy bottom to top
-		memcpy(pSrc, pDst, scanlineBytes);
+	return pNewImage;
+}
 
-		// copy temp to bottom
-		memcpy(pDst, pTempScanline, scanlineBytes);
+bool ImageUtils::detectConstantTile(const ImageTextureTileReadParams& readParams, unsigned int tileWidth, unsigned int tileHeight,
+									ImageTextureTileReadResults& readResults)
+{
+	if (!isDataConstant(readParams.pData, (unsigned int)readParams.pixelSize, (size_t)tileWidth * tileHeight))
+		return false;
 
-		targetScanline --;
-	}
+	unsigned char* pConstantData = new unsigned char[readParams.pixelSize];
+	memcpy(pConstantData, readParams.pData, readParams.pixelSize);
 
-	if (pTempScanline)
-	{
-		delete [] pTempScanline;
-		pTempScanline = nullptr;
-	}
+	readResults.setTileConstant(pConstantData);
+
+	return true;
 }
 
-void ImageUtils::flipImageVertically(ImageColour3h* pImage, unsigned int scanlines, unsigned int numRows, unsigned int width, unsigned int scanlineBytes)
+void ImageUtils::flipImageVertically(ImageColour3f* pImage, unsigned int scanlines, unsigned int numRows, unsigned int width, unsigned int scanlineBytes)
 {
-	Colour3h* pTempScanline = new Colour3h[width];
-
 	unsigned int targetScanline = scanlines - 1;
 
 	for (unsigned int i = 0; i < numRows; i++)
 	{
-		Colour3h* pSrc = pImage->colour3hRowPtr(i);
-
-		memcpy(pTempScanline, pSrc, scanlineBytes);
+		unsigned char* pSrc = (unsigned char*)pImage->colourRowPtr(i);
+		unsigned char* pDst = (unsigned char*)pImage->colourRowPtr(targetScanline);
 
-		Colour3h* pDst = pImage->colour3hRowPtr(targetScanline);
-
-		// copy bottom to top
-		memcpy(pSrc, pDst, scanlineBytes);
-
-		// copy temp to bottom
-		memcpy(pDst, pTempScanline, scanlineBytes);
+		ImagePixelConversion::swapRows(pSrc, pDst, scanlineBytes);
 
 		targetScanline --;
 	}
+}
+
+void ImageUtils::flipImageVertically(ImageColour3h* pImage, unsigned int scanlines, unsigned int numRows, unsigned int width, unsigned int scanlineBytes)
+{
+	unsigned int targetScanline = scanlines - 1;
 
-	if (pTempScanline)
+	for (unsigned int i = 0; i < numRows; i++)
 	{
-		delete [] pTempScanline;
-		pTempScanline = nullptr;
+		unsigned char* pSrc = (unsigned char*)pImage->colour3hRowPtr(i);
+		unsigned char* pDst = (unsigned char*)pImage->colour3hRowPtr(targetScanline);
+
+		ImagePixelConversion::swapRows(pSrc, pDst, scanlineBytes);
+
+		targetScanline --;
 	}
 }
 
 void ImageUtils::flipImageVertically(Image1f* pImage, unsigned int scanlines, unsigned int numRows, unsigned int width, unsigned int scanlineBytes)
 {
-	float* pTempScanline = new float[width];
-
 	unsigned int targetScanline = scanlines - 1;
 
 	for (unsigned int i = 0; i < numRows; i++)
 	{
-		float* pSrc = pImage->floatRowPtr(i);
-
-		memcpy(pTempScanline, pSrc, scanlineBytes);
-
-		float* pDst = pImage->floatRowPtr(targetScanline);
-
-		// copy bottom to top
-		memcpy(pSrc, pDst, scanlineBytes);
+		unsigned char* pSrc = (unsigned char*)pImage->floatRowPtr(i);
+		unsigned char* pDst = (unsigned char*)pImage->floatRowPtr(targetScanline);
 
-		// copy temp to bottom
-		memcpy(pDst, pTempScanline, scanlineBytes);
+		ImagePixelConversion::swapRows(pSrc, pDst, scanlineBytes);
 
 		targetScanline --;
 	}
-
-	if (pTempScanline)
-	{
-		delete [] pTempScanline;
-		pTempScanline = nullptr;
-	}
 }
 
 void ImageUtils::flipImageVertically(Image1h* pImage, unsigned int scanlines, unsigned int numRows, unsigned int width, unsigned int scanlineBytes)
 {
-	half* pTempScanline = new half[width];
-
 	unsigned int targetScanline = scanlines - 1;
 
 	for (unsigned int i = 0; i < numRows; i++)
 	{
-		half* pSrc = pImage->halfRowPtr(i);
-
-		memcpy(pTempScanline, pSrc, scanlineBytes);
+		unsigned char* pSrc = (unsigned char*)pImage->halfRowPtr(i);
+		unsigned char* pDst = (unsigned char*)pImage->halfRowPtr(targetScanline);
 
-		half* pDst = pImage->halfRowPtr(targetScanline);
-
-		// copy bottom to top
-		memcpy(pSrc, pDst, scanlineBytes);
-
-		// copy temp to bottom
-		memcpy(pDst, pTempScanline, scanlineBytes);
+		ImagePixelConversion::swapRows(pSrc, pDst, scanlineBytes);
 
 		targetScanline --;
 	}
-
-	if (pTempScanline)
-	{
-		delete [] pTempScanline;
-		pTempScanline = nullptr;
-	}
 }
 
 
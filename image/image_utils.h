@@ -19,6 +19,8 @@
 #ifndef IMAGE_UTILS_H
 #define IMAGE_UTILS_H
 
+#include <cstddef>
+
 namespace Imagine
 {
 
@@ -26,7 +28,11 @@ class ImageColour3f;
 class ImageColour3h;
 class Image1f;
 class Image1h;
+class ImageColour3b;
+class Image1b;
 class Image;
+class ImageTextureTileReadParams;
+class ImageTextureTileReadResults;
 
 class ImageUtils
 {
@@ -36,6 +42,21 @@ public:
 	static bool flipImageVertically(Image* pImage);
 	static void flipImageTileVertically(unsigned char* pData, unsigned int pixelStride, unsigned int width, unsigned int height);
 
+	// whether all numPixels pixels of pixelByteSize bytes in pData are bitwise identical
+	static bool isDataConstant(const unsigned char* pData, unsigned int pixelByteSize, size_t numPixels);
+
+	// whether every pixel in the image is identical
+	static bool isImageConstant(const Image* pImage);
+
+	// if requiredTypeFlags contains IMAGE_FLAGS_ALLOW_CONSTANT_COLLAPSE and the image is constant, deletes it and returns
+	// a new 1x1 image of the same type with that value, otherwise returns the original image.
+	static Image* collapseConstantImage(Image* pImage, unsigned int requiredTypeFlags);
+
+	// for use by readers after reading a tile into readParams.pData: if the tile is constant, marks it as such
+	// in readResults, with a new single pixel allocation which the cache will own.
+	static bool detectConstantTile(const ImageTextureTileReadParams& readParams, unsigned int tileWidth, unsigned int tileHeight,
+								   ImageTextureTileReadResults& readResults);
+
 protected:
 
 	static void flipImageVertically(ImageColour3f* pImage, unsigned int scanlines, unsigned int numRows, unsigned int width, unsigned int scanlineBytes);
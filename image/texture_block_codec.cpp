@@ -0,0 +1,439 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#include "texture_block_codec.h"
+
+#include <inttypes.h>
+
+namespace Imagine
+{
+
+static const unsigned int kBlockDim = 4;
+
+static inline uint16_t packColour565(unsigned int r, unsigned int g, unsigned int b)
+{
+	// round to nearest
+	unsigned int r5 = (r * 31 + 127) / 255;
+	unsigned int g6 = (g * 63 + 127) / 255;
+	unsigned int b5 = (b * 31 + 127) / 255;
+
+	return (uint16_t)((r5 << 11) | (g6 << 5) | b5);
+}
+
+static inline void unpackColour565(uint16_t colour, unsigned char* pRGB)
+{
+	unsigned int r5 = (colour >> 11) & 0x1F;
+	unsigned int g6 = (colour >> 5) & 0x3F;
+	unsigned int b5 = colour & 0x1F;
+
+	pRGB[0] = (unsigned char)((r5 << 3) | (r5 >> 2));
+	pRGB[1] = (unsigned char)((g6 << 2) | (g6 >> 4));
+	pRGB[2] = (unsigned char)((b5 << 3) | (b5 >> 2));
+}
+
+// builds the 4-colour mode palette (we never encode the 3-colour + transparent mode)
+static inline void buildBC1Palette(uint16_t colour0, uint16_t colour1, unsigned char palette[4][3])
+{
+	unpackColour565(colour0, palette[0]);
+	unpackColour565(colour1, palette[1]);
+
+	for (unsigned int i = 0; i < 3; i++)
+	{
+		unsigned int c0 = palette[0][i];
+		unsigned int c1 = palette[1][i];
+		palette[2][i] = (unsigned char)((2 * c0 + c1) / 3);
+		palette[3][i] = (unsigned char)((c0 + 2 * c1) / 3);
+	}
+}
+
+static inline void buildBC4Palette(unsigned int value0, unsigned int value1, unsigned char palette[8])
+{
+	palette[0] = (unsigned char)value0;
+	palette[1] = (unsigned char)value1;
+
+	if (value0 > value1)
+	{
+		for (unsigned int i = 1; i < 7; i++)
+		{
+			palette[i + 1] = (unsigned char)(((7 - i) * value0 + i * value1) / 7);
+		}
+	}
+	else
+	{
+		// 6-value mode - the encoder never produces this, but handle it for completeness
+		for (unsigned int i = 1; i < 5; i++)
+		{
+			palette[i + 1] = (unsigned char)(((5 - i) * value0 + i * value1) / 5);
+		}
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+static inline unsigned int getBlockSize(unsigned int channelCount)
+{
+	return (channelCount == 4) ? 16 : 8;
+}
+
+TextureBlockCodec::TextureBlockCodec()
+{
+}
+
+bool TextureBlockCodec::canCompress(ImageTextureDetails::ImageDataType dataType, unsigned int channelCount, unsigned int tileWidth, unsigned int tileHeight)
+{
+	if (dataType != ImageTextureDetails::eUInt8)
+		return false;
+
+	if (channelCount != 1 && channelCount != 3 && channelCount != 4)
+		return false;
+
+	if (tileWidth == 0 || tileHeight == 0 || (tileWidth % kBlockDim) != 0 || (tileHeight % kBlockDim) != 0)
+		return false;
+
+	return true;
+}
+
+size_t TextureBlockCodec::getCompressedTileSize(unsigned int tileWidth, unsigned int tileHeight, unsigned int channelCount)
+{
+	size_t numBlocks = (size_t)(tileWidth / kBlockDim) * (size_t)(tileHeight / kBlockDim);
+	return numBlocks * getBlockSize(channelCount);
+}
+
+void TextureBlockCodec::compressTile(const unsigned char* pSrc, unsigned int tileWidth, unsigned int tileHeight, unsigned int channelCount,
+									 unsigned char* pDst)
+{
+	const unsigned int rowStride = tileWidth * channelCount;
+	const unsigned int blockSize = getBlockSize(channelCount);
+
+	for (unsigned int blockY = 0; blockY < tileHeight; blockY += kBlockDim)
+	{
+		for (unsigned int blockX = 0; blockX < tileWidth; blockX += kBlockDim)
+		{
+			const unsigned char* pBlockSrc = pSrc + blockY * rowStride + blockX * channelCount;
+
+			if (channelCount == 1)
+			{
+				encodeBC4Block(pBlockSrc, 1, rowStride, pDst);
+			}
+			else if (channelCount == 3)
+			{
+				encodeBC1Block(pBlockSrc, 3, rowStride, pDst);
+			}
+			else
+			{
+				encodeBC4Block(pBlockSrc + 3, 4, rowStride, pDst);
+				encodeBC1Block(pBlockSrc, 4, rowStride, pDst + 8);
+			}
+
+			pDst += blockSize;
+		}
+	}
+}
+
+void TextureBlockCodec::decompressTile(const unsigned char* pSrc, unsigned int tileWidth, unsigned int tileHeight, unsigned int channelCount,
+									   unsigned char* pDst)
+{
+	const unsigned int rowStride = tileWidth * channelCount;
+	const unsigned int blockSize = getBlockSize(channelCount);
+
+	for (unsigned int blockY = 0; blockY < tileHeight; blockY += kBlockDim)
+	{
+		for (unsigned int blockX = 0; blockX < tileWidth; blockX += kBlockDim)
+		{
+			unsigned char* pBlockDst = pDst + blockY * rowStride + blockX * channelCount;
+
+			if (channelCount == 1)
+			{
+				decodeBC4Block(pSrc, 1, rowStride, pBlockDst);
+			}
+			else if (channelCount == 3)
+			{
+				decodeBC1Block(pSrc, 3, rowStride, pBlockDst);
+			}
+			else
+			{
+				decodeBC4Block(pSrc, 4, rowStride, pBlockDst + 3);
+				decodeBC1Block(pSrc + 8, 4, rowStride, pBlockDst);
+			}
+
+			pSrc += blockSize;
+		}
+	}
+}
+
+void TextureBlockCodec::decodeTexel(const unsigned char* pSrc, unsigned int tileWidth, unsigned int channelCount, unsigned int x, unsigned int y,
+									unsigned char* pTexel)
+{
+	const unsigned int blocksPerRow = tileWidth / kBlockDim;
+	const unsigned int blockIndex = (y / kBlockDim) * blocksPerRow + (x / kBlockDim);
+	const unsigned int pixelIndex = (y & (kBlockDim - 1)) * kBlockDim + (x & (kBlockDim - 1));
+
+	const unsigned char* pBlock = pSrc + (size_t)blockIndex * getBlockSize(channelCount);
+
+	if (channelCount == 1)
+	{
+		pTexel[0] = decodeBC4Texel(pBlock, pixelIndex);
+	}
+	else if (channelCount == 3)
+	{
+		decodeBC1Texel(pBlock, pixelIndex, pTexel);
+	}
+	else
+	{
+		pTexel[3] = decodeBC4Texel(pBlock, pixelIndex);
+		decodeBC1Texel(pBlock + 8, pixelIndex, pTexel);
+	}
+}
+
+// BC1 layout: colour0 (565, LE), colour1 (565, LE), then 16 2-bit indices, pixel 0 in the low bits of the first byte
+void TextureBlockCodec::encodeBC1Block(const unsigned char* pSrc, unsigned int pixelStride, unsigned int rowStride, unsigned char* pDst)
+{
+	unsigned char pixels[16][3];
+	unsigned int minValues[3] = { 255, 255, 255 };
+	unsigned int maxValues[3] = { 0, 0, 0 };
+
+	for (unsigned int j = 0; j < kBlockDim; j++)
+	{
+		const unsigned char* pRow = pSrc + j * rowStride;
+		for (unsigned int i = 0; i < kBlockDim; i++)
+		{
+			unsigned char* pPixel = pixels[j * kBlockDim + i];
+			for (unsigned int c = 0; c < 3; c++)
+			{
+				unsigned int value = pRow[i * pixelStride + c];
+				pPixel[c] = (unsigned char)value;
+				minValues[c] = (value < minValues[c]) ? value : minValues[c];
+				maxValues[c] = (value > maxValues[c]) ? value : maxValues[c];
+			}
+		}
+	}
+
+	// inset the bounding box slightly, which reduces the error for the interpolated values
+	for (unsigned int c = 0; c < 3; c++)
+	{
+		unsigned int inset = (maxValues[c] - minValues[c]) >> 4;
+		minValues[c] += inset;
+		maxValues[c] -= inset;
+	}
+
+	uint16_t colour0 = packColour565(maxValues[0], maxValues[1], maxValues[2]);
+	uint16_t colour1 = packColour565(minValues[0], minValues[1], minValues[2]);
+
+	uint32_t indices = 0;
+
+	if (colour0 < colour1)
+	{
+		uint16_t temp = colour0;
+		colour0 = colour1;
+		colour1 = temp;
+	}
+
+	if (colour0 != colour1)
+	{
+		unsigned char palette[4][3];
+		buildBC1Palette(colour0, colour1, palette);
+
+		for (unsigned int p = 0; p < 16; p++)
+		{
+			unsigned int bestIndex = 0;
+			int bestDistance = 0x7FFFFFFF;
+
+			for (unsigned int index = 0; index < 4; index++)
+			{
+				int dR = (int)pixels[p][0] - (int)palette[index][0];
+				int dG = (int)pixels[p][1] - (int)palette[index][1];
+				int dB = (int)pixels[p][2] - (int)palette[index][2];
+				int distance = dR * dR + dG * dG + dB * dB;
+
+				if (distance < bestDistance)
+				{
+					bestDistance = distance;
+					bestIndex = index;
+				}
+			}
+
+			indices |= bestIndex << (p * 2);
+		}
+	}
+	else
+	{
+		// all the same, but if colour0 == colour1 BC1 is in 3-colour mode, where index 3 means transparent,
+		// so just leave everything pointing at colour0
+	}
+
+	pDst[0] = (unsigned char)(colour0 & 0xFF);
+	pDst[1] = (unsigned char)(colour0 >> 8);
+	pDst[2] = (unsigned char)(colour1 & 0xFF);
+	pDst[3] = (unsigned char)(colour1 >> 8);
+	pDst[4] = (unsigned char)(indices & 0xFF);
+	pDst[5] = (unsigned char)((indices >> 8) & 0xFF);
+	pDst[6] = (unsigned char)((indices >> 16) & 0xFF);
+	pDst[7] = (unsigned char)(indices >> 24);
+}
+
+// BC4 layout: value0, value1, then 16 3-bit indices packed into 48 bits (LE)
+void TextureBlockCodec::encodeBC4Block(const unsigned char* pSrc, unsigned int pixelStride, unsigned int rowStride, unsigned char* pDst)
+{
+	unsigned char values[16];
+	unsigned int minValue = 255;
+	unsigned int maxValue = 0;
+
+	for (unsigned int j = 0; j < kBlockDim; j++)
+	{
+		const unsigned char* pRow = pSrc + j * rowStride;
+		for (unsigned int i = 0; i < kBlockDim; i++)
+		{
+			unsigned int value = pRow[i * pixelStride];
+			values[j * kBlockDim + i] = (unsigned char)value;
+			minValue = (value < minValue) ? value : minValue;
+			maxValue = (value > maxValue) ? value : maxValue;
+		}
+	}
+
+	uint64_t indices = 0;
+
+	if (maxValue > minValue)
+	{
+		// value0 > value1 gives us 8-value mode, which is what we want. Indices 0 and 1 are the endpoints,
+		// with 2-7 being the interpolated values from value0 towards value1, so we can work out the nearest
+		// step along the range directly.
+		const unsigned int range = maxValue - minValue;
+
+		for (unsigned int p = 0; p < 16; p++)
+		{
+			unsigned int step = ((maxValue - values[p]) * 7 + range / 2) / range;
+			unsigned int index = (step == 0) ? 0 : ((step == 7) ? 1 : step + 1);
+
+			indices |= (uint64_t)index << (p * 3);
+		}
+	}
+
+	pDst[0] = (unsigned char)maxValue;
+	pDst[1] = (unsigned char)(maxValue > minValue ? minValue : maxValue);
+
+	for (unsigned int i = 0; i < 6; i++)
+	{
+		pDst[2 + i] = (unsigned char)((indices >> (i * 8)) & 0xFF);
+	}
+}
+
+void TextureBlockCodec::decodeBC1Block(const unsigned char* pBlock, unsigned int pixelStride, unsigned int rowStride, unsigned char* pDst)
+{
+	uint16_t colour0 = (uint16_t)(pBlock[0] | (pBlock[1] << 8));
+	uint16_t colour1 = (uint16_t)(pBlock[2] | (pBlock[3] << 8));
+	uint32_t indices = (uint32_t)pBlock[4] | ((uint32_t)pBlock[5] << 8) | ((uint32_t)pBlock[6] << 16) | ((uint32_t)pBlock[7] << 24);
+
+	unsigned char palette[4][3];
+	buildBC1Palette(colour0, colour1, palette);
+
+	for (unsigned int j = 0; j < kBlockDim; j++)
+	{
+		unsigned char* pRow = pDst + j * rowStride;
+		for (unsigned int i = 0; i < kBlockDim; i++)
+		{
+			const unsigned char* pColour = palette[indices & 0x3];
+			indices >>= 2;
+
+			unsigned char* pPixel = pRow + i * pixelStride;
+			pPixel[0] = pColour[0];
+			pPixel[1] = pColour[1];
+			pPixel[2] = pColour[2];
+		}
+	}
+}
+
+void TextureBlockCodec::decodeBC4Block(const unsigned char* pBlock, unsigned int pixelStride, unsigned int rowStride, unsigned char* pDst)
+{
+	unsigned char palette[8];
+	buildBC4Palette(pBlock[0], pBlock[1], palette);
+
+	uint64_t indices = 0;
+	for (unsigned int i = 0; i < 6; i++)
+	{
+		indices |= (uint64_t)pBlock[2 + i] << (i * 8);
+	}
+
+	for (unsigned int j = 0; j < kBlockDim; j++)
+	{
+		unsigned char* pRow = pDst + j * rowStride;
+		for (unsigned int i = 0; i < kBlockDim; i++)
+		{
+			pRow[i * pixelStride] = palette[indices & 0x7];
+			indices >>= 3;
+		}
+	}
+}
+
+void TextureBlockCodec::decodeBC1Texel(const unsigned char* pBlock, unsigned int pixelIndex, unsigned char* pDst)
+{
+	uint16_t colour0 = (uint16_t)(pBlock[0] | (pBlock[1] << 8));
+	uint16_t colour1 = (uint16_t)(pBlock[2] | (pBlock[3] << 8));
+
+	unsigned int index = (pBlock[4 + (pixelIndex >> 2)] >> ((pixelIndex & 3) * 2)) & 0x3;
+
+	unsigned char endpoints[2][3];
+	unpackColour565(colour0, endpoints[0]);
+	if (index == 0)
+	{
+		pDst[0] = endpoints[0][0];
+		pDst[1] = endpoints[0][1];
+		pDst[2] = endpoints[0][2];
+		return;
+	}
+
+	unpackColour565(colour1, endpoints[1]);
+
+	for (unsigned int c = 0; c < 3; c++)
+	{
+		unsigned int c0 = endpoints[0][c];
+		unsigned int c1 = endpoints[1][c];
+
+		pDst[c] = (index == 1) ? (unsigned char)c1 : (index == 2) ? (unsigned char)((2 * c0 + c1) / 3) : (unsigned char)((c0 + 2 * c1) / 3);
+	}
+}
+
+unsigned char TextureBlockCodec::decodeBC4Texel(const unsigned char* pBlock, unsigned int pixelIndex)
+{
+	// indices are 3 bits, so may straddle a byte boundary
+	unsigned int bitOffset = pixelIndex * 3;
+	unsigned int byteOffset = 2 + (bitOffset >> 3);
+	unsigned int twoBytes = pBlock[byteOffset] | ((byteOffset + 1 < 8) ? (pBlock[byteOffset + 1] << 8) : 0);
+	unsigned int index = (twoBytes >> (bitOffset & 7)) & 0x7;
+
+	unsigned int value0 = pBlock[0];
+	unsigned int value1 = pBlock[1];
+
+	if (index == 0)
+		return (unsigned char)value0;
+	if (index == 1)
+		return (unsigned char)value1;
+
+	if (value0 > value1)
+	{
+		unsigned int i = index - 1;
+		return (unsigned char)(((7 - i) * value0 + i * value1) / 7);
+	}
+
+	if (index >= 6)
+		return (index == 6) ? 0 : 255;
+
+	unsigned int i = index - 1;
+	return (unsigned char)(((5 - i) * value0 + i * value1) / 5);
+}
+
+} // namespace Imagine
@@ -0,0 +1,72 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#ifndef TEXTURE_BLOCK_CODEC_H
+#define TEXTURE_BLOCK_CODEC_H
+
+#include <cstddef>
+
+#include "image/image_texture_common.h"
+
+namespace Imagine
+{
+
+// CPU-side block compression of 8-bit texture tiles in memory, using the same 4x4 block formats as GPUs:
+//   1 channel  - BC4 (8 bytes per block, 2:1)
+//   3 channels - BC1 (8 bytes per block, 6:1)
+//   4 channels - BC3 (BC4 alpha + BC1 colour, 16 bytes per block, 4:1)
+// Blocks are stored in row-major order across the tile. Encoding is a fast bounding-box endpoint fit, as it's
+// done on tile load, and individual texels can be decoded directly from their block at lookup time.
+
+class TextureBlockCodec
+{
+public:
+	TextureBlockCodec();
+
+	// whether tiles of this configuration can be block compressed - currently only uint8 data is supported,
+	// and tile dimensions need to be multiples of 4
+	static bool canCompress(ImageTextureDetails::ImageDataType dataType, unsigned int channelCount, unsigned int tileWidth, unsigned int tileHeight);
+
+	// size in bytes of a compressed tile, for allocation and memory-limit accounting
+	static size_t getCompressedTileSize(unsigned int tileWidth, unsigned int tileHeight, unsigned int channelCount);
+
+	// pSrc is tightly-packed interleaved uint8 tile data, pDst must be getCompressedTileSize() bytes
+	static void compressTile(const unsigned char* pSrc, unsigned int tileWidth, unsigned int tileHeight, unsigned int channelCount,
+							 unsigned char* pDst);
+
+	static void decompressTile(const unsigned char* pSrc, unsigned int tileWidth, unsigned int tileHeight, unsigned int channelCount,
+							   unsigned char* pDst);
+
+	// decodes a single texel at tile-local coordinates x, y into pTexel (channelCount bytes)
+	static void decodeTexel(const unsigned char* pSrc, unsigned int tileWidth, unsigned int channelCount, unsigned int x, unsigned int y,
+							unsigned char* pTexel);
+
+protected:
+	static void encodeBC1Block(const unsigned char* pSrc, unsigned int pixelStride, unsigned int rowStride, unsigned char* pDst);
+	static void encodeBC4Block(const unsigned char* pSrc, unsigned int pixelStride, unsigned int rowStride, unsigned char* pDst);
+
+	static void decodeBC1Block(const unsigned char* pBlock, unsigned int pixelStride, unsigned int rowStride, unsigned char* pDst);
+	static void decodeBC4Block(const unsigned char* pBlock, unsigned int pixelStride, unsigned int rowStride, unsigned char* pDst);
+
+	static void decodeBC1Texel(const unsigned char* pBlock, unsigned int pixelIndex, unsigned char* pDst);
+	static unsigned char decodeBC4Texel(const unsigned char* pBlock, unsigned int pixelIndex);
+};
+
+} // namespace Imagine
+
+#endif // TEXTURE_BLOCK_CODEC_H
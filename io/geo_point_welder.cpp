@@ -0,0 +1,657 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#include "geo_point_welder.h"
+
+#include <algorithm>
+
+#include "utils/threads/parallel_range.h"
+
+namespace Imagine
+{
+
+// with a tolerance of 0 (or a very small one relative to the size of the points' extent), the cells are made
+// bigger than that, so each axis's cell index fits in this many bits, and the whole key in 63
+static const unsigned int kMaxCellBits = 20;
+
+static const unsigned int kRadixBits = 8;
+static const unsigned int kRadixBuckets = 1 << kRadixBits;
+
+static const size_t kMinPointsPerRange = 16384;
+
+// with cells 4x the tolerance in size, a point's only within the tolerance of a side of its cell on half of the axes
+// on average, so on average only a few neighbouring cells need checking, without too many points per cell
+static const float kCellSizeToleranceScale = 4.0f;
+
+// keys only use 63 bits, so this can't be a real key
+static const uint64_t kEmptyCellKey = ~0ULL;
+
+static unsigned int bitsNeeded(uint32_t value)
+{
+	unsigned int bits = 0;
+	while (value > 0)
+	{
+		bits++;
+		value >>= 1;
+	}
+
+	return bits;
+}
+
+// taken from MurmurHash3
+static uint64_t mixCellKey(uint64_t key)
+{
+	key ^= key >> 33;
+	key *= uint64_t(0xff51afd7ed558ccd);
+	key ^= key >> 33;
+	key *= uint64_t(0xc4ceb9fe1a85ec53);
+	key ^= key >> 33;
+
+	return key;
+}
+
+class PointBoundsFunction : public ParallelRangeFunction
+{
+public:
+	PointBoundsFunction(const Point* pPoints, unsigned int numRanges) : m_pPoints(pPoints), m_aMinimums(numRanges), m_aMaximums(numRanges)
+	{
+	}
+
+	virtual void processRange(unsigned int rangeIndex, size_t start, size_t end)
+	{
+		Point minimum = m_pPoints[start];
+		Point maximum = m_pPoints[start];
+
+		for (size_t i = start + 1; i < end; i++)
+		{
+			const Point& point = m_pPoints[i];
+
+			minimum.x = std::min(minimum.x, point.x);
+			minimum.y = std::min(minimum.y, point.y);
+			minimum.z = std::min(minimum.z, point.z);
+
+			maximum.x = std::max(maximum.x, point.x);
+			maximum.y = std::max(maximum.y, point.y);
+			maximum.z = std::max(maximum.z, point.z);
+		}
+
+		m_aMinimums[rangeIndex] = minimum;
+		m_aMaximums[rangeIndex] = maximum;
+	}
+
+	const Point*		m_pPoints;
+	std::vector<Point>	m_aMinimums;
+	std::vector<Point>	m_aMaximums;
+};
+
+class CellKeyFunction : public ParallelRangeFunction
+{
+public:
+	CellKeyFunction(GeoPointWelder::WeldState& state) : m_state(state)
+	{
+	}
+
+	virtual void processRange(unsigned int rangeIndex, size_t start, size_t end)
+	{
+		uint32_t cell[3];
+
+		for (size_t i = start; i < end; i++)
+		{
+			m_state.getPointCell(m_state.pPoints[i], cell);
+
+			m_state.aKeys[i] = m_state.cellKey(cell[0], cell[1], cell[2]);
+			m_state.aPointIndices[i] = (uint32_t)i;
+		}
+	}
+
+	GeoPointWelder::WeldState&	m_state;
+};
+
+// one pass of an LSD radix sort of (key, point index) pairs: the histogram is worked out for each range, then
+// each range scatters its items to its own offsets within each bucket, which keeps the sort stable
+class RadixSortPassFunction : public ParallelRangeFunction
+{
+public:
+	RadixSortPassFunction(unsigned int numRanges) : m_shift(0), m_scatter(false), m_pSrcKeys(nullptr), m_pSrcIndices(nullptr),
+		m_pDstKeys(nullptr), m_pDstIndices(nullptr), m_aCounts(numRanges * kRadixBuckets, 0)
+	{
+	}
+
+	virtual void processRange(unsigned int rangeIndex, size_t start, size_t end)
+	{
+		size_t* pCounts = &m_aCounts[rangeIndex * kRadixBuckets];
+
+		if (!m_scatter)
+		{
+			std::fill(pCounts, pCounts + kRadixBuckets, 0);
+
+			for (size_t i = start; i < end; i++)
+			{
+				unsigned int bucket = (unsigned int)(m_pSrcKeys[i] >> m_shift) & (kRadixBuckets - 1);
+				pCounts[bucket]++;
+			}
+		}
+		else
+		{
+			// the counts have been turned into offsets by now
+			for (size_t i = start; i < end; i++)
+			{
+				uint64_t key = m_pSrcKeys[i];
+				unsigned int bucket = (unsigned int)(key >> m_shift) & (kRadixBuckets - 1);
+
+				size_t dstIndex = pCounts[bucket]++;
+				m_pDstKeys[dstIndex] = key;
+				m_pDstIndices[dstIndex] = m_pSrcIndices[i];
+			}
+		}
+	}
+
+	// returns false if all the items are in the same bucket, in which case the pass can be skipped
+	bool convertCountsToOffsets(size_t numItems)
+	{
+		unsigned int numRanges = (unsigned int)(m_aCounts.size() / kRadixBuckets);
+
+		size_t offset = 0;
+		for (unsigned int bucket = 0; bucket < kRadixBuckets; bucket++)
+		{
+			size_t bucketTotal = 0;
+
+			for (unsigned int range = 0; range < numRanges; range++)
+			{
+				size_t& count = m_aCounts[range * kRadixBuckets + bucket];
+				size_t rangeCount = count;
+
+				count = offset;
+				offset += rangeCount;
+				bucketTotal += rangeCount;
+			}
+
+			if (bucketTotal == numItems)
+				return false;
+		}
+
+		return true;
+	}
+
+	unsigned int			m_shift;
+	bool					m_scatter;
+
+	const uint64_t*			m_pSrcKeys;
+	const uint32_t*			m_pSrcIndices;
+	uint64_t*				m_pDstKeys;
+	uint32_t*				m_pDstIndices;
+
+	// per range, per bucket
+	std::vector<size_t>		m_aCounts;
+};
+
+class LowestMatchFunction : public ParallelRangeFunction
+{
+public:
+	LowestMatchFunction(GeoPointWelder::WeldState& state) : m_state(state)
+	{
+	}
+
+	// the ranges are of sorted positions rather than original indices, so nearby points are processed together
+	virtual void processRange(unsigned int rangeIndex, size_t start, size_t end)
+	{
+		for (size_t i = start; i < end; i++)
+		{
+			uint32_t pointIndex = m_state.aPointIndices[i];
+
+			m_state.aLowestMatch[pointIndex] = m_state.findLowestMatch(pointIndex, false);
+		}
+	}
+
+	GeoPointWelder::WeldState&	m_state;
+};
+
+class LowestKeptMatchFunction : public ParallelRangeFunction
+{
+public:
+	LowestKeptMatchFunction(GeoPointWelder::WeldState& state) : m_state(state)
+	{
+	}
+
+	virtual void processRange(unsigned int rangeIndex, size_t start, size_t end)
+	{
+		for (size_t i = start; i < end; i++)
+		{
+			uint32_t pointIndex = m_state.aPointIndices[i];
+			uint32_t lowestMatch = m_state.aLowestMatch[pointIndex];
+
+			if (lowestMatch == pointIndex)
+			{
+				// it's being kept
+				m_state.aLowestKeptMatch[pointIndex] = pointIndex;
+			}
+			else if (m_state.aLowestMatch[lowestMatch] == lowestMatch)
+			{
+				// the lowest match is being kept, so it's also the lowest kept match
+				m_state.aLowestKeptMatch[pointIndex] = lowestMatch;
+			}
+			else
+			{
+				m_state.aLowestKeptMatch[pointIndex] = m_state.findLowestMatch(pointIndex, true);
+			}
+		}
+	}
+
+	GeoPointWelder::WeldState&	m_state;
+};
+
+class RemapIndicesFunction : public ParallelRangeFunction
+{
+public:
+	RemapIndicesFunction(const std::vector<uint32_t>& aRemap, std::vector<uint32_t>& aIndices) : m_aRemap(aRemap), m_aIndices(aIndices)
+	{
+	}
+
+	virtual void processRange(unsigned int rangeIndex, size_t start, size_t end)
+	{
+		for (size_t i = start; i < end; i++)
+		{
+			m_aIndices[i] = m_aRemap[m_aIndices[i]];
+		}
+	}
+
+	const std::vector<uint32_t>&	m_aRemap;
+	std::vector<uint32_t>&			m_aIndices;
+};
+
+void GeoPointWelder::WeldState::getPointCell(const Point& point, uint32_t* pCell) const
+{
+	const float* pPointValues = &point.x;
+	const float* pOriginValues = &gridOrigin.x;
+
+	for (unsigned int axis = 0; axis < 3; axis++)
+	{
+		float cellPosition = (pPointValues[axis] - pOriginValues[axis]) * invCellSize;
+
+		// this also catches NaNs
+		if (!(cellPosition > 0.0f))
+		{
+			pCell[axis] = 0;
+		}
+		else
+		{
+			pCell[axis] = std::min((uint32_t)std::min(cellPosition, (float)(cellCounts[axis] - 1)), cellCounts[axis] - 1);
+		}
+	}
+}
+
+uint32_t GeoPointWelder::WeldState::findCell(uint64_t key) const
+{
+	uint64_t hash = mixCellKey(key);
+
+	uint64_t occupancyBit = (hash >> 24) & cellOccupancyMask;
+	if ((aCellOccupancy[occupancyBit >> 6] & (1ULL << (occupancyBit & 63))) == 0)
+		return -1u;
+
+	uint64_t slot = hash & cellTableMask;
+
+	while (true)
+	{
+		const CellTableSlot& tableSlot = aCellTable[slot];
+		if (tableSlot.key == key)
+			return tableSlot.cell;
+
+		if (tableSlot.key == kEmptyCellKey)
+			return -1u;
+
+		slot = (slot + 1) & cellTableMask;
+	}
+}
+
+uint32_t GeoPointWelder::WeldState::findLowestMatch(uint32_t pointIndex, bool keptOnly) const
+{
+	const Point& point = pPoints[pointIndex];
+
+	uint32_t cell[3];
+	getPointCell(point, cell);
+
+	// only look in the neighbouring cells on the sides the point's within the tolerance of
+	int cellStart[3];
+	int cellEnd[3];
+
+	const float* pPointValues = &point.x;
+	const float* pOriginValues = &gridOrigin.x;
+
+	for (unsigned int axis = 0; axis < 3; axis++)
+	{
+		float cellMinimum = pOriginValues[axis] + (float)cell[axis] * cellSize;
+		float cellMaximum = cellMinimum + cellSize;
+
+		cellStart[axis] = (cell[axis] > 0 && (pPointValues[axis] - cellMinimum) <= tolerance) ? -1 : 0;
+		cellEnd[axis] = (cell[axis] + 1 < cellCounts[axis] && (cellMaximum - pPointValues[axis]) <= tolerance) ? 1 : 0;
+	}
+
+	uint32_t lowestMatch = keptOnly ? -1u : pointIndex;
+
+	uint32_t numCells = (uint32_t)aCellKeys.size();
+
+	for (int z = cellStart[2]; z <= cellEnd[2]; z++)
+	{
+		for (int y = cellStart[1]; y <= cellEnd[1]; y++)
+		{
+			// the cells either side of the row's middle one on the X axis are next to it in key order, so if that
+			// exists, they don't need looking up
+			uint64_t middleKey = cellKey(cell[0], cell[1] + y, cell[2] + z);
+			uint32_t middleCellIndex = findCell(middleKey);
+
+			for (int x = cellStart[0]; x <= cellEnd[0]; x++)
+			{
+				uint64_t key = middleKey + x;
+
+				uint32_t cellIndex = -1u;
+				if (middleCellIndex == -1u)
+				{
+					if (x != 0)
+					{
+						cellIndex = findCell(key);
+					}
+				}
+				else
+				{
+					cellIndex = middleCellIndex + x;
+					if (cellIndex >= numCells || aCellKeys[cellIndex] != key)
+					{
+						cellIndex = -1u;
+					}
+				}
+
+				if (cellIndex == -1u)
+					continue;
+
+				uint32_t cellItemsEnd = aCellStarts[cellIndex + 1];
+				for (uint32_t i = aCellStarts[cellIndex]; i < cellItemsEnd; i++)
+				{
+					uint32_t otherIndex = aPointIndices[i];
+					if (otherIndex >= lowestMatch || otherIndex >= pointIndex)
+						continue;
+
+					if (keptOnly && aLowestMatch[otherIndex] != otherIndex)
+						continue;
+
+					const Point& otherPoint = pPoints[otherIndex];
+
+					float deltaX = otherPoint.x - point.x;
+					float deltaY = otherPoint.y - point.y;
+					float deltaZ = otherPoint.z - point.z;
+
+					if (deltaX * deltaX + deltaY * deltaY + deltaZ * deltaZ <= toleranceSquared)
+					{
+						lowestMatch = otherIndex;
+					}
+				}
+			}
+		}
+	}
+
+	return lowestMatch;
+}
+
+GeoPointWelder::GeoPointWelder(float tolerance, unsigned int threads) : m_tolerance(std::max(tolerance, 0.0f))
+{
+	m_pRunner = new ParallelRangeRunner(threads);
+}
+
+GeoPointWelder::~GeoPointWelder()
+{
+	delete m_pRunner;
+}
+
+unsigned int GeoPointWelder::weld(const std::vector<Point>& aPoints, std::vector<uint32_t>& aRemap, std::vector<uint32_t>& aKeptPoints)
+{
+	size_t numPoints = aPoints.size();
+
+	aRemap.resize(numPoints);
+	aKeptPoints.clear();
+
+	if (numPoints == 0)
+		return 0;
+
+	m_state.pPoints = aPoints.data();
+	m_state.numPoints = numPoints;
+	m_state.tolerance = m_tolerance;
+	m_state.toleranceSquared = m_tolerance * m_tolerance;
+
+	calculateGrid();
+	sortPointsByCell();
+	buildCellTable();
+
+	m_state.aLowestMatch.resize(numPoints);
+	m_state.aLowestKeptMatch.resize(numPoints);
+
+	unsigned int numRanges = m_pRunner->getRangeCount(numPoints, kMinPointsPerRange);
+
+	LowestMatchFunction lowestMatchFunction(m_state);
+	m_pRunner->run(lowestMatchFunction, numPoints, numRanges);
+
+	LowestKeptMatchFunction lowestKeptMatchFunction(m_state);
+	m_pRunner->run(lowestKeptMatchFunction, numPoints, numRanges);
+
+	// the matches are always lower indices, so their new indices are known by the time they're needed
+	uint32_t keptCount = 0;
+	for (size_t i = 0; i < numPoints; i++)
+	{
+		uint32_t lowestKeptMatch = m_state.aLowestKeptMatch[i];
+
+		if (lowestKeptMatch == i)
+		{
+			aRemap[i] = keptCount++;
+			aKeptPoints.emplace_back((uint32_t)i);
+		}
+		else if (lowestKeptMatch != -1u)
+		{
+			aRemap[i] = aRemap[lowestKeptMatch];
+		}
+		else
+		{
+			// none of the points within the tolerance are being kept, so go with what the lowest one's merged into
+			aRemap[i] = aRemap[m_state.aLowestMatch[i]];
+		}
+	}
+
+	// free the working memory, as this is generally used on very big meshes
+	std::vector<uint32_t>().swap(m_state.aPointIndices);
+	std::vector<GeoPointWelder::WeldState::CellTableSlot>().swap(m_state.aCellTable);
+	std::vector<uint64_t>().swap(m_state.aCellKeys);
+	std::vector<uint64_t>().swap(m_state.aCellOccupancy);
+	std::vector<uint32_t>().swap(m_state.aCellStarts);
+	std::vector<uint32_t>().swap(m_state.aLowestMatch);
+	std::vector<uint32_t>().swap(m_state.aLowestKeptMatch);
+
+	return keptCount;
+}
+
+void GeoPointWelder::remapIndices(const std::vector<uint32_t>& aRemap, std::vector<uint32_t>& aIndices)
+{
+	RemapIndicesFunction remapFunction(aRemap, aIndices);
+	m_pRunner->run(remapFunction, aIndices.size(), m_pRunner->getRangeCount(aIndices.size(), kMinPointsPerRange));
+}
+
+void GeoPointWelder::calculateGrid()
+{
+	unsigned int numRanges = m_pRunner->getRangeCount(m_state.numPoints, kMinPointsPerRange);
+
+	PointBoundsFunction boundsFunction(m_state.pPoints, numRanges);
+	m_pRunner->run(boundsFunction, m_state.numPoints, numRanges);
+
+	Point minimum = boundsFunction.m_aMinimums[0];
+	Point maximum = boundsFunction.m_aMaximums[0];
+
+	for (unsigned int i = 1; i < numRanges; i++)
+	{
+		const Point& rangeMinimum = boundsFunction.m_aMinimums[i];
+		const Point& rangeMaximum = boundsFunction.m_aMaximums[i];
+
+		minimum.x = std::min(minimum.x, rangeMinimum.x);
+		minimum.y = std::min(minimum.y, rangeMinimum.y);
+		minimum.z = std::min(minimum.z, rangeMinimum.z);
+
+		maximum.x = std::max(maximum.x, rangeMaximum.x);
+		maximum.y = std::max(maximum.y, rangeMaximum.y);
+		maximum.z = std::max(maximum.z, rangeMaximum.z);
+	}
+
+	float extent[3] = { maximum.x - minimum.x, maximum.y - minimum.y, maximum.z - minimum.z };
+	float maxExtent = std::max(extent[0], std::max(extent[1], extent[2]));
+
+	float cellSize = std::max(m_state.tolerance * kCellSizeToleranceScale, maxExtent / (float)(1 << kMaxCellBits));
+	if (!(cellSize > 0.0f))
+	{
+		// all the points are the same
+		cellSize = 1.0f;
+	}
+
+	m_state.gridOrigin = minimum;
+	m_state.cellSize = cellSize;
+	m_state.invCellSize = 1.0f / cellSize;
+
+	for (unsigned int axis = 0; axis < 3; axis++)
+	{
+		float cellCount = extent[axis] * m_state.invCellSize;
+		m_state.cellCounts[axis] = (cellCount > 0.0f) ? std::min((uint32_t)cellCount, (uint32_t)(1 << kMaxCellBits)) + 1 : 1;
+		m_state.cellBits[axis] = bitsNeeded(m_state.cellCounts[axis] - 1);
+	}
+}
+
+void GeoPointWelder::sortPointsByCell()
+{
+	size_t numPoints = m_state.numPoints;
+
+	m_state.aKeys.resize(numPoints);
+	m_state.aPointIndices.resize(numPoints);
+
+	unsigned int numRanges = m_pRunner->getRangeCount(numPoints, kMinPointsPerRange);
+
+	CellKeyFunction keyFunction(m_state);
+	m_pRunner->run(keyFunction, numPoints, numRanges);
+
+	unsigned int keyBits = m_state.cellBits[0] + m_state.cellBits[1] + m_state.cellBits[2];
+
+	std::vector<uint64_t> aTempKeys(numPoints);
+	std::vector<uint32_t> aTempIndices(numPoints);
+
+	RadixSortPassFunction sortPassFunction(numRanges);
+
+	uint64_t* pSrcKeys = m_state.aKeys.data();
+	uint32_t* pSrcIndices = m_state.aPointIndices.data();
+	uint64_t* pDstKeys = aTempKeys.data();
+	uint32_t* pDstIndices = aTempIndices.data();
+
+	for (unsigned int shift = 0; shift < keyBits; shift += kRadixBits)
+	{
+		sortPassFunction.m_shift = shift;
+		sortPassFunction.m_pSrcKeys = pSrcKeys;
+		sortPassFunction.m_pSrcIndices = pSrcIndices;
+		sortPassFunction.m_pDstKeys = pDstKeys;
+		sortPassFunction.m_pDstIndices = pDstIndices;
+
+		sortPassFunction.m_scatter = false;
+		m_pRunner->run(sortPassFunction, numPoints, numRanges);
+
+		if (!sortPassFunction.convertCountsToOffsets(numPoints))
+			continue;
+
+		sortPassFunction.m_scatter = true;
+		m_pRunner->run(sortPassFunction, numPoints, numRanges);
+
+		std::swap(pSrcKeys, pDstKeys);
+		std::swap(pSrcIndices, pDstIndices);
+	}
+
+	// make sure the sorted items end up in the state's vectors
+	if (pSrcKeys != m_state.aKeys.data())
+	{
+		m_state.aKeys.swap(aTempKeys);
+		m_state.aPointIndices.swap(aTempIndices);
+	}
+}
+
+void GeoPointWelder::buildCellTable()
+{
+	size_t numPoints = m_state.numPoints;
+
+	const std::vector<uint64_t>& aKeys = m_state.aKeys;
+
+	m_state.aCellStarts.clear();
+	m_state.aCellStarts.emplace_back(0);
+	m_state.aCellKeys.clear();
+	m_state.aCellKeys.emplace_back(aKeys[0]);
+
+	for (size_t i = 1; i < numPoints; i++)
+	{
+		if (aKeys[i] != aKeys[i - 1])
+		{
+			m_state.aCellStarts.emplace_back((uint32_t)i);
+			m_state.aCellKeys.emplace_back(aKeys[i]);
+		}
+	}
+
+	size_t numCells = m_state.aCellStarts.size();
+	m_state.aCellStarts.emplace_back((uint32_t)numPoints);
+
+	// keep the table at most half full
+	uint64_t tableSize = 2;
+	while (tableSize < numCells * 2)
+	{
+		tableSize <<= 1;
+	}
+
+	GeoPointWelder::WeldState::CellTableSlot emptySlot;
+	emptySlot.key = kEmptyCellKey;
+	emptySlot.cell = -1u;
+
+	m_state.aCellTable.assign(tableSize, emptySlot);
+	m_state.cellTableMask = tableSize - 1;
+
+	// 8 bits per cell (rounded up) keeps false positives to around 1 in 8
+	uint64_t occupancyBits = 64;
+	while (occupancyBits < numCells * 8)
+	{
+		occupancyBits <<= 1;
+	}
+
+	m_state.aCellOccupancy.assign(occupancyBits / 64, 0);
+	m_state.cellOccupancyMask = occupancyBits - 1;
+
+	for (size_t i = 0; i < numCells; i++)
+	{
+		uint64_t key = m_state.aCellKeys[i];
+		uint64_t hash = mixCellKey(key);
+
+		uint64_t occupancyBit = (hash >> 24) & m_state.cellOccupancyMask;
+		m_state.aCellOccupancy[occupancyBit >> 6] |= 1ULL << (occupancyBit & 63);
+
+		uint64_t slot = hash & m_state.cellTableMask;
+		while (m_state.aCellTable[slot].key != kEmptyCellKey)
+		{
+			slot = (slot + 1) & m_state.cellTableMask;
+		}
+
+		m_state.aCellTable[slot].key = key;
+		m_state.aCellTable[slot].cell = (uint32_t)i;
+	}
+
+	// the keys aren't needed any more, only the order of the points
+	std::vector<uint64_t>().swap(m_state.aKeys);
+}
+
+} // namespace Imagine
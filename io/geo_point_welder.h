@@ -0,0 +1,134 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#ifndef GEO_POINT_WELDER_H
+#define GEO_POINT_WELDER_H
+
+#include <vector>
+#include <inttypes.h>
+
+#include "core/point.h"
+
+namespace Imagine
+{
+
+class ParallelRangeRunner;
+
+// Merges points which are within a distance tolerance of each other (or exactly equal, with a tolerance of 0),
+// for welding imported meshes which have split vertices, in parallel:
+//   - points are quantised to a grid of cells a few times the tolerance in size, and the (point index, cell key) pairs are
+//     radix sorted by cell key, so each cell's points are contiguous.
+//   - each point then finds the lowest-indexed point within the tolerance, looking in the neighbouring cells only on the
+//     sides the point's within the tolerance of.
+//   - points which didn't find a lower one are kept, and the others are remapped to the lowest kept point within
+//     the tolerance (or the one the point they found was remapped to, for chains of points each within the tolerance
+//     of the next, but not all of each other).
+// The results only depend on the points and tolerance, not on the number of threads.
+
+class GeoPointWelder
+{
+public:
+	GeoPointWelder(float tolerance, unsigned int threads = 0);
+	~GeoPointWelder();
+
+	// aRemap is set to the index of each point in the welded list, and aKeptPoints to the original indices of the
+	// points kept (in original order). Returns the number of points kept.
+	unsigned int weld(const std::vector<Point>& aPoints, std::vector<uint32_t>& aRemap, std::vector<uint32_t>& aKeptPoints);
+
+	// for remapping index lists in parallel (i.e. polygon indices) after weld()
+	void remapIndices(const std::vector<uint32_t>& aRemap, std::vector<uint32_t>& aIndices);
+
+	ParallelRangeRunner& getRunner()
+	{
+		return *m_pRunner;
+	}
+
+	// working data, shared with the parallel range functions
+	struct WeldState
+	{
+		const Point*		pPoints;
+		size_t				numPoints;
+
+		float				tolerance;
+		float				toleranceSquared;
+
+		Point				gridOrigin;
+		float				cellSize;
+		float				invCellSize;
+		uint32_t			cellCounts[3];
+		unsigned int		cellBits[3];
+
+		// sorted by cell key
+		std::vector<uint64_t>	aKeys;
+		std::vector<uint32_t>	aPointIndices;
+
+		struct CellTableSlot
+		{
+			uint64_t		key;
+			uint32_t		cell;
+		};
+
+		// cell key -> cell index, open addressed with linear probing
+		std::vector<CellTableSlot>	aCellTable;
+		uint64_t				cellTableMask;
+
+		// most neighbouring cells looked up are empty, so a bit per (hashed) cell, in much less memory than the table,
+		// lets most of those lookups be skipped without a cache miss in the table
+		std::vector<uint64_t>	aCellOccupancy;
+		uint64_t				cellOccupancyMask;
+
+		// per cell, in key order, so the cells either side on the X axis (key +/- 1) are next to each other
+		std::vector<uint64_t>	aCellKeys;
+		// with an extra item at the end for the end of the last cell
+		std::vector<uint32_t>	aCellStarts;
+
+		// per original point
+		std::vector<uint32_t>	aLowestMatch;
+		std::vector<uint32_t>	aLowestKeptMatch;
+
+		uint64_t cellKey(uint32_t cellX, uint32_t cellY, uint32_t cellZ) const
+		{
+			return (uint64_t)cellX | ((uint64_t)cellY << cellBits[0]) | ((uint64_t)cellZ << (cellBits[0] + cellBits[1]));
+		}
+
+		void getPointCell(const Point& point, uint32_t* pCell) const;
+
+		// returns -1u if the cell's empty
+		uint32_t findCell(uint64_t key) const;
+
+		// lowest point index within the tolerance of the point (including itself), optionally only considering
+		// points which are being kept. Returns -1u if there isn't one.
+		uint32_t findLowestMatch(uint32_t pointIndex, bool keptOnly) const;
+	};
+
+protected:
+	void calculateGrid();
+	void sortPointsByCell();
+	void buildCellTable();
+
+protected:
+	float					m_tolerance;
+
+	ParallelRangeRunner*	m_pRunner;
+
+	WeldState				m_state;
+};
+
+} // namespace Imagine
+
+#endif // GEO_POINT_WELDER_H
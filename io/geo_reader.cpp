@@ -18,21 +18,225 @@
 
 #include "geo_reader.h"
 
+#include <cmath>
+#include <algorithm>
+
 #include "objects/mesh.h"
 #include "objects/compound_object.h"
 
 #include "settings.h"
+#include "global_context.h"
 
 #include "core/hash.h"
 
 #include "geometry/standard_geometry_instance.h"
 
-#include "utils/maths/fixed.h"
-#include "utils/maths/fixed.cpp"
+#include "geo_point_welder.h"
+
+#include "utils/threads/parallel_range.h"
 
 namespace Imagine
 {
 
+static const size_t kMinFacesPerRange = 4096;
+static const uint32_t kNoGeometry = ~0u;
+
+// remaps face vertex indices to welded points, and recalculates the face normals
+class FaceRemapFunction : public ParallelRangeFunction
+{
+public:
+	FaceRemapFunction(EditableGeometryInstance* pGeoInstance, const std::vector<uint32_t>& aRemap, unsigned int numRanges)
+		: m_pGeoInstance(pGeoInstance), m_aRemap(aRemap), m_aDegenerateFaces(numRanges, 0)
+	{
+	}
+
+	virtual void processRange(unsigned int rangeIndex, size_t start, size_t end)
+	{
+		std::deque<Face>& aFaces = m_pGeoInstance->getFaces();
+
+		std::vector<unsigned int> aNewFaceIndexes;
+
+		unsigned int degenerateFaces = 0;
+
+		for (size_t faceIndex = start; faceIndex < end; faceIndex++)
+		{
+			Face& face = aFaces[faceIndex];
+
+			aNewFaceIndexes.clear();
+
+			unsigned int vertexCount = face.getVertexCount();
+			for (unsigned int i = 0; i < vertexCount; i++)
+			{
+				aNewFaceIndexes.emplace_back(m_aRemap[face.getVertexPosition(i)]);
+			}
+
+			// welding can merge neighbouring vertices of small faces
+			for (unsigned int i = 0; i < vertexCount; i++)
+			{
+				if (aNewFaceIndexes[i] == aNewFaceIndexes[(i + 1) % vertexCount])
+				{
+					degenerateFaces++;
+					break;
+				}
+			}
+
+			face.clear();
+
+			for (unsigned int i = 0; i < vertexCount; i++)
+			{
+				face.addVertex(aNewFaceIndexes[i]);
+			}
+
+			face.calculateNormal(m_pGeoInstance);
+		}
+
+		m_aDegenerateFaces[rangeIndex] = degenerateFaces;
+	}
+
+	unsigned int getDegenerateFaceCount() const
+	{
+		unsigned int total = 0;
+		std::vector<unsigned int>::const_iterator it = m_aDegenerateFaces.begin();
+		for (; it != m_aDegenerateFaces.end(); ++it)
+		{
+			total += *it;
+		}
+
+		return total;
+	}
+
+protected:
+	EditableGeometryInstance*		m_pGeoInstance;
+	const std::vector<uint32_t>&	m_aRemap;
+
+	// per range
+	std::vector<unsigned int>		m_aDegenerateFaces;
+};
+
+static Point getPointsMinimum(const std::deque<Point>& aPoints)
+{
+	Point minimum = aPoints.empty() ? Point(0.0f, 0.0f, 0.0f) : aPoints.front();
+
+	std::deque<Point>::const_iterator it = aPoints.begin();
+	for (; it != aPoints.end(); ++it)
+	{
+		const Point& point = *it;
+		minimum.x = std::min(minimum.x, point.x);
+		minimum.y = std::min(minimum.y, point.y);
+		minimum.z = std::min(minimum.z, point.z);
+	}
+
+	return minimum;
+}
+
+static long long quantiseComponent(float value, float minimum, float scale)
+{
+	return (long long)std::floor((value - minimum) * scale + 0.5f);
+}
+
+// hashes point and face counts, quantised points relative to the bbox minimum, and face vertex indices,
+// so only identical geometry (to the precision) at different positions gets the same signature
+class GeometrySignatureFunction : public ParallelRangeFunction
+{
+public:
+	GeometrySignatureFunction(const std::vector<EditableGeometryInstance*>& aGeoInstances, float quantiseScale,
+							  std::vector<HashValue>& aSignatures)
+		: m_aGeoInstances(aGeoInstances), m_quantiseScale(quantiseScale), m_aSignatures(aSignatures)
+	{
+	}
+
+	virtual void processRange(unsigned int rangeIndex, size_t start, size_t end)
+	{
+		for (size_t i = start; i < end; i++)
+		{
+			EditableGeometryInstance* pGeoInstance = m_aGeoInstances[i];
+
+			const std::deque<Point>& aPoints = pGeoInstance->getPoints();
+			std::deque<Face>& aFaces = pGeoInstance->getFaces();
+
+			Hash signature;
+			signature.addUInt((unsigned int)aPoints.size());
+			signature.addUInt((unsigned int)aFaces.size());
+
+			Point minimum = getPointsMinimum(aPoints);
+
+			std::deque<Point>::const_iterator itPoint = aPoints.begin();
+			for (; itPoint != aPoints.end(); ++itPoint)
+			{
+				const Point& point = *itPoint;
+				signature.addLongLong(quantiseComponent(point.x, minimum.x, m_quantiseScale));
+				signature.addLongLong(quantiseComponent(point.y, minimum.y, m_quantiseScale));
+				signature.addLongLong(quantiseComponent(point.z, minimum.z, m_quantiseScale));
+			}
+
+			std::deque<Face>::iterator itFace = aFaces.begin();
+			for (; itFace != aFaces.end(); ++itFace)
+			{
+				Face& face = *itFace;
+
+				unsigned int vertexCount = face.getVertexCount();
+				signature.addUInt(vertexCount);
+				for (unsigned int j = 0; j < vertexCount; j++)
+				{
+					signature.addUInt(face.getVertexPosition(j));
+				}
+			}
+
+			m_aSignatures[i] = signature.getHash();
+		}
+	}
+
+protected:
+	const std::vector<EditableGeometryInstance*>&	m_aGeoInstances;
+	float											m_quantiseScale;
+
+	std::vector<HashValue>&							m_aSignatures;
+};
+
+// full comparison of what GeometrySignatureFunction hashes
+static bool isSameGeometry(EditableGeometryInstance* pGeoInstanceA, EditableGeometryInstance* pGeoInstanceB, float quantiseScale)
+{
+	const std::deque<Point>& aPointsA = pGeoInstanceA->getPoints();
+	const std::deque<Point>& aPointsB = pGeoInstanceB->getPoints();
+	std::deque<Face>& aFacesA = pGeoInstanceA->getFaces();
+	std::deque<Face>& aFacesB = pGeoInstanceB->getFaces();
+
+	if (aPointsA.size() != aPointsB.size() || aFacesA.size() != aFacesB.size())
+		return false;
+
+	Point minimumA = getPointsMinimum(aPointsA);
+	Point minimumB = getPointsMinimum(aPointsB);
+
+	for (size_t i = 0; i < aPointsA.size(); i++)
+	{
+		const Point& pointA = aPointsA[i];
+		const Point& pointB = aPointsB[i];
+
+		if (quantiseComponent(pointA.x, minimumA.x, quantiseScale) != quantiseComponent(pointB.x, minimumB.x, quantiseScale) ||
+			quantiseComponent(pointA.y, minimumA.y, quantiseScale) != quantiseComponent(pointB.y, minimumB.y, quantiseScale) ||
+			quantiseComponent(pointA.z, minimumA.z, quantiseScale) != quantiseComponent(pointB.z, minimumB.z, quantiseScale))
+			return false;
+	}
+
+	for (size_t i = 0; i < aFacesA.size(); i++)
+	{
+		Face& faceA = aFacesA[i];
+		Face& faceB = aFacesB[i];
+
+		unsigned int vertexCount = faceA.getVertexCount();
+		if (vertexCount != faceB.getVertexCount())
+			return false;
+
+		for (unsigned int j = 0; j < vertexCount; j++)
+		{
+			if (faceA.getVertexPosition(j) != faceB.getVertexPosition(j))
+				return false;
+		}
+	}
+
+	return true;
+}
+
 GeoReader::GeoReader() : m_newObject(nullptr), m_pScene(nullptr)
 {
 }
@@ -78,66 +282,84 @@ void GeoReader::postProcess()
 	}
 }
 
-void GeoReader::removeDuplicatePoints(Object* pObject)
+void GeoReader::removeDuplicatePoints(Object* pObject, float tolerance)
 {
 	GeometryInstanceGathered* pGeoInstance = pObject->getGeometryInstance();
-	if (!pGeoInstance || pGeoInstance->getTypeID() != 1)
+	if (!pGeoInstance)
 		return;
 
-	EditableGeometryInstance* pEditableGeoInstance = reinterpret_cast<EditableGeometryInstance*>(pGeoInstance);
+	GeoPointWelder welder(tolerance);
 
-	std::deque<Point>& aObjectPoints = pEditableGeoInstance->getPoints();
-//	std::deque<Normal>& aVertexNormals = getObjectVertexNormals();
-	std::deque<Face>& aObjectFaces = pEditableGeoInstance->getFaces();
+	std::vector<uint32_t> aRemap;
+	std::vector<uint32_t> aKeptPoints;
 
-	Hash mainHash; // dummy object
+	size_t originalPointCount = 0;
+	unsigned int keptPointCount = 0;
 
-	std::map<HashValue, unsigned int> aPointsMap;
+	if (pGeoInstance->getTypeID() == 1)
+	{
+		EditableGeometryInstance* pEditableGeoInstance = reinterpret_cast<EditableGeometryInstance*>(pGeoInstance);
 
-	// map which points to replace
-	std::map<unsigned int, unsigned int> aReplacementIndices;
+		std::deque<Point>& aObjectPoints = pEditableGeoInstance->getPoints();
+		std::deque<Face>& aObjectFaces = pEditableGeoInstance->getFaces();
 
-	unsigned int duplicatePoints = 0;
+		originalPointCount = aObjectPoints.size();
 
-	unsigned int pointIndex = 0;
+		// the welder wants contiguous points
+		std::vector<Point> aPoints(aObjectPoints.begin(), aObjectPoints.end());
 
-	std::deque<Point>::iterator it = aObjectPoints.begin();
-	for (; it != aObjectPoints.end(); ++it)
-	{
-		Point& point = *it;
+		keptPointCount = welder.weld(aPoints, aRemap, aKeptPoints);
+		if (keptPointCount == originalPointCount)
+			return;
 
-		HashValue pointHash = mainHash.hashPoint(point);
+		aObjectPoints.clear();
 
-		std::map<HashValue, unsigned int>::iterator itFind = aPointsMap.find(pointHash);
-		if (itFind == aPointsMap.end())
+		std::vector<uint32_t>::const_iterator itKept = aKeptPoints.begin();
+		for (; itKept != aKeptPoints.end(); ++itKept)
 		{
-			aPointsMap[pointHash] = pointIndex;
+			aObjectPoints.emplace_back(aPoints[*itKept]);
 		}
-		else
-		{
-			// we've got it already, so add this point map
-			unsigned int replacementPointIndex = (*itFind).second;
 
-			aReplacementIndices[pointIndex] = replacementPointIndex;
+		ParallelRangeRunner& runner = welder.getRunner();
+		unsigned int numRanges = runner.getRangeCount(aObjectFaces.size(), kMinFacesPerRange);
 
-			duplicatePoints ++;
-		}
+		FaceRemapFunction faceRemap(pEditableGeoInstance, aRemap, numRanges);
+		runner.run(faceRemap, aObjectFaces.size(), numRanges);
 
-		pointIndex++;
+		unsigned int degenerateFaces = faceRemap.getDegenerateFaceCount();
+		if (degenerateFaces > 0)
+		{
+			GlobalContext::instance().getLogger().warning("%u faces have collapsed edges after welding points.", degenerateFaces);
+		}
 	}
+	else if (pGeoInstance->getTypeID() == 3)
+	{
+		StandardGeometryInstance* pStandardGeoInstance = reinterpret_cast<StandardGeometryInstance*>(pGeoInstance);
 
-	if (aReplacementIndices.empty())
-		return;
+		std::vector<Point>& aObjectPoints = pStandardGeoInstance->getPoints();
 
-	// otherwise, replace
+		originalPointCount = aObjectPoints.size();
 
-	std::deque<Face>::iterator itFace = aObjectFaces.begin();
-	for (; itFace != aObjectFaces.end(); ++itFace)
-	{
+		keptPointCount = welder.weld(aObjectPoints, aRemap, aKeptPoints);
+		if (keptPointCount == originalPointCount)
+			return;
 
+		// kept points are in ascending original order, so this can be done in place
+		for (unsigned int i = 0; i < keptPointCount; i++)
+		{
+			aObjectPoints[i] = aObjectPoints[aKeptPoints[i]];
+		}
+		aObjectPoints.resize(keptPointCount);
+		aObjectPoints.shrink_to_fit();
+
+		welder.remapIndices(aRemap, pStandardGeoInstance->getPolygonIndices());
+	}
+	else
+	{
+		return;
 	}
 
-	fprintf(stderr, "duplicate points: %u\t in %zu\n", duplicatePoints, aObjectPoints.size());
+	GlobalContext::instance().getLogger().info("Welded %zu duplicate points of %zu.", originalPointCount - keptPointCount, originalPointCount);
 }
 
 void GeoReader::discardDuplicateGeometry(unsigned short precisionThreshold)
@@ -148,10 +370,8 @@ void GeoReader::discardDuplicateGeometry(unsigned short precisionThreshold)
 	if (!pCO)
 		return;
 
-	// note: due to float accuracy issues, this isn't very exact...
-
-	// first of all, see if any Geometry Instances have boundary boxes of the same volume
-	std::map<fixedpoint<2>, GeoInstanceOverview> aVolumes;
+	std::vector<Object*> aCandidateObjects;
+	std::vector<EditableGeometryInstance*> aCandidateGeoInstances;
 
 	unsigned int subObjectCount = pCO->getSubObjectCount();
 	for (unsigned int i = 0; i < subObjectCount; i++)
@@ -163,55 +383,87 @@ void GeoReader::discardDuplicateGeometry(unsigned short precisionThreshold)
 		if (!pGeoInstance || pGeoInstance->getTypeID() != 1)
 			continue;
 
-		EditableGeometryInstance* pEditableGeoInstance = reinterpret_cast<EditableGeometryInstance*>(pGeoInstance);
+		aCandidateObjects.emplace_back(pSubObject);
+		aCandidateGeoInstances.emplace_back(reinterpret_cast<EditableGeometryInstance*>(pGeoInstance));
+	}
+
+	size_t numCandidates = aCandidateGeoInstances.size();
+	if (numCandidates < 2)
+		return;
 
-//		float bbVolume = pGeoInstance->getBoundaryBox().volume();
-		float bbVolume = pGeoInstance->getBoundaryBox().fixedVolume(precisionThreshold);
+	// points are compared relative to their bbox minimum, so translated copies match
+	float quantiseScale = std::pow(10.0f, (float)precisionThreshold);
 
-		fprintf(stderr, "GeoInst: %d\t volume: %f\n", i, bbVolume);
+	// hash the full geometry of each in parallel
+	std::vector<HashValue> aSignatures(numCandidates);
 
-		fixedpoint<2> fbbVolume = bbVolume;
+	ParallelRangeRunner runner;
+	GeometrySignatureFunction signatureFunction(aCandidateGeoInstances, quantiseScale, aSignatures);
+	runner.run(signatureFunction, numCandidates, runner.getRangeCount(numCandidates, 1));
 
-		std::map<fixedpoint<2>, GeoInstanceOverview>::iterator itFind = aVolumes.find(fbbVolume);
-		if (itFind == aVolumes.end())
+	// group by signature in a flat open addressed table, with the members of each group chained through aNextInGroup
+	size_t tableSize = 16;
+	while (tableSize < numCandidates * 2)
+		tableSize *= 2;
+	size_t tableMask = tableSize - 1;
+
+	std::vector<uint32_t> aSignatureTable(tableSize, kNoGeometry);
+	std::vector<uint32_t> aNextInGroup(numCandidates, kNoGeometry);
+	std::vector<uint32_t> aLastInGroup(numCandidates, kNoGeometry);
+
+	for (uint32_t i = 0; i < (uint32_t)numCandidates; i++)
+	{
+		size_t slot = (size_t)aSignatures[i] & tableMask;
+		while (aSignatureTable[slot] != kNoGeometry && aSignatures[aSignatureTable[slot]] != aSignatures[i])
+		{
+			slot = (slot + 1) & tableMask;
+		}
+
+		uint32_t firstInGroup = aSignatureTable[slot];
+		if (firstInGroup == kNoGeometry)
 		{
-			GeoInstanceOverview newItem;
-			newItem.add(pEditableGeoInstance, pSubObject);
-			aVolumes[bbVolume] = newItem;
+			aSignatureTable[slot] = i;
+			aLastInGroup[i] = i;
 		}
 		else
 		{
-			GeoInstanceOverview& item = itFind->second;
-			item.add(pEditableGeoInstance, pSubObject);
+			aNextInGroup[aLastInGroup[firstInGroup]] = i;
+			aLastInGroup[firstInGroup] = i;
 		}
 	}
 
 	std::vector<GeoInstanceOverview> aFinalList;
 
-	// now filter out items with only one, or ones where the boundary boxes aren't exactly the same size...
-	std::map<fixedpoint<2>, GeoInstanceOverview>::iterator it = aVolumes.begin();
-	for (; it != aVolumes.end(); ++it)
-	{
-		GeoInstanceOverview& overviewItem = it->second;
+	// now check the members of each group are really the same as the first one, in case of hash collisions
+	unsigned int duplicateCount = 0;
 
-		if (overviewItem.count <= 1)
+	std::vector<uint32_t>::const_iterator itSlot = aSignatureTable.begin();
+	for (; itSlot != aSignatureTable.end(); ++itSlot)
+	{
+		uint32_t firstInGroup = *itSlot;
+		if (firstInGroup == kNoGeometry || aNextInGroup[firstInGroup] == kNoGeometry)
 			continue;
 
-		// check bbox exactly
+		GeoInstanceOverview overviewItem;
+		overviewItem.add(aCandidateGeoInstances[firstInGroup], aCandidateObjects[firstInGroup]);
 
-		bool allMatch = true;
-		BoundaryBox firstBB = overviewItem.aGeoInstances[0]->getBoundaryBox();
-		for (unsigned int i = 1; i < overviewItem.count; i++)
+		for (uint32_t index = aNextInGroup[firstInGroup]; index != kNoGeometry; index = aNextInGroup[index])
 		{
-			if (!overviewItem.aGeoInstances[i]->getBoundaryBox().fixedHasSameVolume(firstBB, precisionThreshold))
-				allMatch = false;
+			if (isSameGeometry(aCandidateGeoInstances[firstInGroup], aCandidateGeoInstances[index], quantiseScale))
+			{
+				overviewItem.add(aCandidateGeoInstances[index], aCandidateObjects[index]);
+			}
 		}
 
-		if (allMatch)
-			aFinalList.emplace_back(overviewItem);
+		if (overviewItem.count <= 1)
+			continue;
+
+		duplicateCount += overviewItem.count - 1;
+		aFinalList.emplace_back(overviewItem);
 	}
 
-	fprintf(stderr, "Final list: %zu items.\n", aFinalList.size());
+	GlobalContext::instance().getLogger().info("Found %u duplicate geometry instances of %zu, in %zu groups.", duplicateCount, numCandidates,
+											   aFinalList.size());
 
 	// now swap out Duplicate GeoInstances, and offset parentObjects' positions to compensate
 	std::vector<GeoInstanceOverview>::iterator itFinal = aFinalList.begin();
@@ -61,7 +61,8 @@ struct GeoReaderOptions
 		rotate90NegX(false), centreObject(true), scaleToFit(true), scaleToFitSize(10.0f), standObjectOnPlane(true),
 		setBBoxDrawMode(false),
 		importFrame(1), useInstances(false),
-		pointSize(0.001f), meshType(eEditableMesh)
+		pointSize(0.001f), meshType(eEditableMesh),
+		weldPoints(false), weldTolerance(0.0f)
 	{
 	}
 
@@ -86,6 +87,10 @@ struct GeoReaderOptions
 	float				pointSize;
 
 	GeoReaderMeshType	meshType;
+
+	// merge duplicate points (within the tolerance) of each imported mesh
+	bool				weldPoints;
+	float				weldTolerance;
 };
 
 struct GeoInstanceOverview
@@ -118,7 +123,8 @@ public:
 
 	void postProcess();
 
-	void removeDuplicatePoints(Object* pObject);
+	// welds points within tolerance of each other (only exact duplicates with a tolerance of 0), remapping the faces
+	void removeDuplicatePoints(Object* pObject, float tolerance = 0.0f);
 	void discardDuplicateGeometry(unsigned short precisionThreshold);
 
 	void applyMatrixToMesh(Matrix4& matrix, Mesh* pMesh, bool recalculateNormals);
@@ -428,7 +428,8 @@ bool GeoReaderObj::readFileEditableMesh(const std::string& path, const GeoReader
 	{
 		// just the one object
 		m_newObject = subObjects[0];
-//		removeDuplicatePoints(m_newObject);
+		if (m_readOptions.weldPoints)
+			removeDuplicatePoints(m_newObject, m_readOptions.weldTolerance);
 	}
 	else
 	{
@@ -438,7 +439,8 @@ bool GeoReaderObj::readFileEditableMesh(const std::string& path, const GeoReader
 		for (; it != subObjects.end(); ++it)
 		{
 			Object* pObject = *it;
-//			removeDuplicatePoints(pObject);
+			if (m_readOptions.weldPoints)
+				removeDuplicatePoints(pObject, m_readOptions.weldTolerance);
 			pCO->addObject(pObject);
 		}
 
@@ -869,7 +871,8 @@ bool GeoReaderObj::readFileStandardMesh(const std::string& path, const GeoReader
 	{
 		// just the one object
 		m_newObject = subObjects[0];
-//		removeDuplicatePoints(m_newObject);
+		if (m_readOptions.weldPoints)
+			removeDuplicatePoints(m_newObject, m_readOptions.weldTolerance);
 	}
 	else
 	{
@@ -879,7 +882,8 @@ bool GeoReaderObj::readFileStandardMesh(const std::string& path, const GeoReader
 		for (; it != subObjects.end(); ++it)
 		{
 			Object* pObject = *it;
-//			removeDuplicatePoints(pObject);
+			if (m_readOptions.weldPoints)
+				removeDuplicatePoints(pObject, m_readOptions.weldTolerance);
 			pCO->addObject(pObject);
 		}
 
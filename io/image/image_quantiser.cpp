@@ -0,0 +1,265 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#include "image_quantiser.h"
+
+#include "colour/colour4f.h"
+#include "colour/colour_space.h"
+
+#include "utils/io/data_conversion.h"
+#include "utils/maths/maths.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#define USE_SSE_QUANTISE 1
+#else
+#define USE_SSE_QUANTISE 0
+#endif
+
+namespace Imagine
+{
+
+// 4x4 Bayer matrix, pre-scaled to thresholds within [0, 1), which are added before truncation.
+// Without dithering, 0.5 is used, which just rounds.
+static const float kDitherThresholds[4][4] = {
+	{  0.5f / 16.0f,  8.5f / 16.0f,  2.5f / 16.0f, 10.5f / 16.0f },
+	{ 12.5f / 16.0f,  4.5f / 16.0f, 14.5f / 16.0f,  6.5f / 16.0f },
+	{  3.5f / 16.0f, 11.5f / 16.0f,  1.5f / 16.0f,  9.5f / 16.0f },
+	{ 15.5f / 16.0f,  7.5f / 16.0f, 13.5f / 16.0f,  5.5f / 16.0f }
+};
+
+static const float kNoDitherThresholds[4] = { 0.5f, 0.5f, 0.5f, 0.5f };
+
+#if USE_SSE_QUANTISE
+
+// polynomial approximations based on José Fonseca's SSE pow() - combined, these are accurate
+// to within ~0.2 of a 16-bit LSB in the [0, 1] sRGB range, which is all we need here.
+static inline __m128 log2SSE(__m128 x)
+{
+	const __m128i expMask = _mm_set1_epi32(0x7F800000);
+	const __m128i mantMask = _mm_set1_epi32(0x007FFFFF);
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	__m128i i = _mm_castps_si128(x);
+
+	__m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(_mm_and_si128(i, expMask), 23), _mm_set1_epi32(127)));
+	__m128 m = _mm_or_ps(_mm_castsi128_ps(_mm_and_si128(i, mantMask)), one);
+
+	__m128 p = _mm_set1_ps(-3.4436006e-2f);
+	p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(3.1821337e-1f));
+	p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(-1.2315303f));
+	p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(2.5988452f));
+	p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(-3.3241990f));
+	p = _mm_add_ps(_mm_mul_ps(p, m), _mm_set1_ps(3.1157899f));
+
+	p = _mm_mul_ps(p, _mm_sub_ps(m, one));
+
+	return _mm_add_ps(p, e);
+}
+
+static inline __m128 exp2SSE(__m128 x)
+{
+	x = _mm_min_ps(x, _mm_set1_ps(129.00000f));
+	x = _mm_max_ps(x, _mm_set1_ps(-126.99999f));
+
+	__m128i iPart = _mm_cvtps_epi32(_mm_sub_ps(x, _mm_set1_ps(0.5f)));
+	__m128 fPart = _mm_sub_ps(x, _mm_cvtepi32_ps(iPart));
+
+	__m128 expIPart = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(iPart, _mm_set1_epi32(127)), 23));
+
+	__m128 p = _mm_set1_ps(1.8775767e-3f);
+	p = _mm_add_ps(_mm_mul_ps(p, fPart), _mm_set1_ps(8.9893397e-3f));
+	p = _mm_add_ps(_mm_mul_ps(p, fPart), _mm_set1_ps(5.5826318e-2f));
+	p = _mm_add_ps(_mm_mul_ps(p, fPart), _mm_set1_ps(2.4015361e-1f));
+	p = _mm_add_ps(_mm_mul_ps(p, fPart), _mm_set1_ps(6.9315308e-1f));
+	p = _mm_add_ps(_mm_mul_ps(p, fPart), _mm_set1_ps(9.9999994e-1f));
+
+	return _mm_mul_ps(expIPart, p);
+}
+
+static inline __m128 clampUnitSSE(__m128 value)
+{
+	// Note: the order is important here so that NaNs end up as 0.0
+	return _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+}
+
+// converts rgb to sRGB, but leaves alpha (the 4th component) linear, clamping all components to [0, 1]
+static inline __m128 linearToSRGBKeepAlphaSSE(__m128 value)
+{
+	const __m128 linearThreshold = _mm_set1_ps(0.0031308f);
+
+	value = clampUnitSSE(value);
+
+	__m128 linearValue = _mm_mul_ps(value, _mm_set1_ps(12.92f));
+
+	// clamp the input to pow so we don't feed it denormals or 0.0
+	__m128 powInput = _mm_max_ps(value, linearThreshold);
+	__m128 powValue = exp2SSE(_mm_mul_ps(log2SSE(powInput), _mm_set1_ps(0.4166667f)));
+	powValue = _mm_sub_ps(_mm_mul_ps(powValue, _mm_set1_ps(1.055f)), _mm_set1_ps(0.055f));
+
+	__m128 useLinear = _mm_cmple_ps(value, linearThreshold);
+	__m128 srgbValue = _mm_or_ps(_mm_and_ps(useLinear, linearValue), _mm_andnot_ps(useLinear, powValue));
+
+	const __m128 alphaMask = _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0));
+	srgbValue = _mm_or_ps(_mm_and_ps(alphaMask, value), _mm_andnot_ps(alphaMask, srgbValue));
+
+	// the polynomials can very slightly overshoot 1.0
+	return _mm_min_ps(srgbValue, _mm_set1_ps(1.0f));
+}
+
+static inline __m128i quantisePixel8SSE(const Colour4f& pixel, float threshold)
+{
+	__m128 value = linearToSRGBKeepAlphaSSE(_mm_loadu_ps(&pixel.r));
+	value = _mm_add_ps(_mm_mul_ps(value, _mm_set1_ps(255.0f)), _mm_set1_ps(threshold));
+
+	return _mm_cvttps_epi32(value);
+}
+
+static inline __m128i quantisePixel16SSE(const Colour4f& pixel)
+{
+	__m128 value = linearToSRGBKeepAlphaSSE(_mm_loadu_ps(&pixel.r));
+	value = _mm_add_ps(_mm_mul_ps(value, _mm_set1_ps(65535.0f)), _mm_set1_ps(0.5f));
+
+	return _mm_cvttps_epi32(value);
+}
+
+// packs two pixels of 32-bit ints in [0, 65535] into 8 big-endian uint16_t values.
+// SSE2 only has signed saturation for packing 32-bit values, so bias around 0 and then undo it afterwards.
+static inline __m128i packPixels16BESSE(__m128i pixel0, __m128i pixel1)
+{
+	const __m128i bias32 = _mm_set1_epi32(32768);
+	const __m128i bias16 = _mm_set1_epi16((short)0x8000);
+
+	__m128i packed = _mm_packs_epi32(_mm_sub_epi32(pixel0, bias32), _mm_sub_epi32(pixel1, bias32));
+	packed = _mm_xor_si128(packed, bias16);
+
+	return _mm_or_si128(_mm_slli_epi16(packed, 8), _mm_srli_epi16(packed, 8));
+}
+
+#endif
+
+ImageQuantiser::ImageQuantiser()
+{
+}
+
+void ImageQuantiser::quantiseRowSRGB8(const Colour4f* pSrc, unsigned int width, unsigned int y, bool alpha, bool dither, uint8_t* pDst)
+{
+	const float* pThresholds = dither ? kDitherThresholds[y & 3] : kNoDitherThresholds;
+
+	unsigned int x = 0;
+
+#if USE_SSE_QUANTISE
+	for (; x + 4 <= width; x += 4)
+	{
+		__m128i pixel0 = quantisePixel8SSE(pSrc[x], pThresholds[0]);
+		__m128i pixel1 = quantisePixel8SSE(pSrc[x + 1], pThresholds[1]);
+		__m128i pixel2 = quantisePixel8SSE(pSrc[x + 2], pThresholds[2]);
+		__m128i pixel3 = quantisePixel8SSE(pSrc[x + 3], pThresholds[3]);
+
+		__m128i packed = _mm_packus_epi16(_mm_packs_epi32(pixel0, pixel1), _mm_packs_epi32(pixel2, pixel3));
+
+		if (alpha)
+		{
+			_mm_storeu_si128((__m128i*)pDst, packed);
+			pDst += 16;
+		}
+		else
+		{
+			uint8_t temp[16];
+			_mm_storeu_si128((__m128i*)temp, packed);
+
+			for (unsigned int i = 0; i < 4; i++)
+			{
+				*pDst++ = temp[i * 4];
+				*pDst++ = temp[i * 4 + 1];
+				*pDst++ = temp[i * 4 + 2];
+			}
+		}
+	}
+#endif
+
+	for (; x < width; x++)
+	{
+		const Colour4f& pixel = pSrc[x];
+		float threshold = pThresholds[x & 3];
+
+		float r = ColourSpace::convertLinearToSRGBAccurate(clamp(pixel.r));
+		float g = ColourSpace::convertLinearToSRGBAccurate(clamp(pixel.g));
+		float b = ColourSpace::convertLinearToSRGBAccurate(clamp(pixel.b));
+
+		*pDst++ = (uint8_t)(clamp(r) * 255.0f + threshold);
+		*pDst++ = (uint8_t)(clamp(g) * 255.0f + threshold);
+		*pDst++ = (uint8_t)(clamp(b) * 255.0f + threshold);
+
+		if (alpha)
+		{
+			*pDst++ = (uint8_t)(clamp(pixel.a) * 255.0f + threshold);
+		}
+	}
+}
+
+void ImageQuantiser::quantiseRowSRGB16BE(const Colour4f* pSrc, unsigned int width, bool alpha, uint16_t* pDst)
+{
+	unsigned int x = 0;
+
+#if USE_SSE_QUANTISE
+	for (; x + 2 <= width; x += 2)
+	{
+		__m128i packed = packPixels16BESSE(quantisePixel16SSE(pSrc[x]), quantisePixel16SSE(pSrc[x + 1]));
+
+		if (alpha)
+		{
+			_mm_storeu_si128((__m128i*)pDst, packed);
+			pDst += 8;
+		}
+		else
+		{
+			uint16_t temp[8];
+			_mm_storeu_si128((__m128i*)temp, packed);
+
+			*pDst++ = temp[0];
+			*pDst++ = temp[1];
+			*pDst++ = temp[2];
+			*pDst++ = temp[4];
+			*pDst++ = temp[5];
+			*pDst++ = temp[6];
+		}
+	}
+#endif
+
+	for (; x < width; x++)
+	{
+		const Colour4f& pixel = pSrc[x];
+
+		float r = ColourSpace::convertLinearToSRGBAccurate(clamp(pixel.r));
+		float g = ColourSpace::convertLinearToSRGBAccurate(clamp(pixel.g));
+		float b = ColourSpace::convertLinearToSRGBAccurate(clamp(pixel.b));
+
+		// TODO: this reversing should only be done on marchs which need it...
+		*pDst++ = reverseUInt16Bytes((uint16_t)(clamp(r) * 65535.0f + 0.5f));
+		*pDst++ = reverseUInt16Bytes((uint16_t)(clamp(g) * 65535.0f + 0.5f));
+		*pDst++ = reverseUInt16Bytes((uint16_t)(clamp(b) * 65535.0f + 0.5f));
+
+		if (alpha)
+		{
+			*pDst++ = reverseUInt16Bytes((uint16_t)(clamp(pixel.a) * 65535.0f + 0.5f));
+		}
+	}
+}
+
+} // namespace Imagine
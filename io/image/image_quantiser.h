@@ -0,0 +1,47 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#ifndef IMAGE_QUANTISER_H
+#define IMAGE_QUANTISER_H
+
+#include <inttypes.h>
+
+namespace Imagine
+{
+
+class Colour4f;
+
+// converts rows of linear float output image pixels into sRGB integer pixels for the
+// LDR image writers, using SSE where available. Alpha is quantised linearly.
+
+class ImageQuantiser
+{
+public:
+	ImageQuantiser();
+
+	// writes either RGB or RGBA bytes (depending on alpha) to pDst. y is needed to index the
+	// ordered dither pattern, so that it stays consistent when rows are processed in separate bands.
+	static void quantiseRowSRGB8(const Colour4f* pSrc, unsigned int width, unsigned int y, bool alpha, bool dither, uint8_t* pDst);
+
+	// writes either RGB or RGBA big-endian (as PNG wants) uint16_t values to pDst.
+	static void quantiseRowSRGB16BE(const Colour4f* pSrc, unsigned int width, bool alpha, uint16_t* pDst);
+};
+
+} // namespace Imagine
+
+#endif // IMAGE_QUANTISER_H
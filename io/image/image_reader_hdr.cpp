@@ -25,6 +25,7 @@
 #include "global_context.h"
 
 #include "image/image_colour3f.h"
+#include "image/image_utils.h"
 #include "colour/colour_space.h"
 
 namespace Imagine
@@ -122,7 +123,7 @@ Image* ImageReaderHDR::readColourImage(const std::string& filePath, unsigned int
 	delete [] pScanline;
 	fclose(pFile);
 
-	return pImage;
+	return ImageUtils::collapseConstantImage(pImage, requiredTypeFlags);
 }
 
 bool ImageReaderHDR::processScanline(RGBE* pScanline, unsigned int length, FILE* pFile)
@@ -19,10 +19,13 @@
 #include "image_reader_hgt.h"
 
 #include <cstdio>
+#include <vector>
 #include <sys/types.h>
 #include <sys/stat.h>
 
 #include "image/image_1f.h"
+#include "image/image_utils.h"
+#include "image/image_pixel_conversion.h"
 
 #include "utils/maths/maths.h"
 
@@ -58,28 +61,37 @@ Image* ImageReaderHGT::readGreyscaleImage(const std::string& filePath, unsigned
 	// TODO: fix lat/long aspect ratio distortion - probably best to do it in a dedicated reader which
 	//       creates geo at the same time rather than here...
 
+	// read the whole file in one go, rather than two bytes at a time
+	size_t numValues = (size_t)numRows * numRows;
+	std::vector<uint16_t> aRawValues(numValues);
+	if (fread(aRawValues.data(), sizeof(uint16_t), numValues, pFile) != numValues)
+	{
+		fclose(pFile);
+		return nullptr;
+	}
+
+	// values are big-endian
+	// TODO: this reversing should only be done on marchs which need it...
+	ImagePixelConversion::byteSwap16(aRawValues.data(), numValues);
+
 	Image1f* pNewImage = new Image1f(imageWidth, imageHeight, false);
 
+	std::vector<float> aElevationRow(numRows);
+
 	// TODO: which axis is first?
 	for (unsigned int x = 0; x < numRows; x++)
 	{
-//		float* pDst = pNewImage->floatRowPtr()
+		ImagePixelConversion::convertUInt16ToFloat(aRawValues.data() + (size_t)x * numRows, aElevationRow.data(), numRows, 1.0f);
+
 		for (unsigned int y = 0; y < numRows; y++)
 		{
-			unsigned char mainVal = 0;
-			unsigned char secVal = 0;
-
-			fread(&mainVal, 1, 1, pFile);
-			fread(&secVal, 1, 1, pFile);
-
-			float elevation = (float)((float)mainVal * 256.0f) + (float)secVal;
-			pNewImage->floatAt(x, y) = elevation;
+			pNewImage->floatAt(x, y) = aElevationRow[y];
 		}
 	}
 
 	fclose(pFile);
 
-	return pNewImage;
+	return ImageUtils::collapseConstantImage(pNewImage, requiredTypeFlags);
 }
 
 
@@ -26,6 +26,7 @@
 #include "image/image_1b.h"
 #include "image/image_colour3f.h"
 #include "image/image_colour3b.h"
+#include "image/image_utils.h"
 
 #include "colour/colour_space.h"
 
@@ -216,7 +217,7 @@ Image* ImageReaderJPEG::readColourImage(const std::string& filePath, unsigned in
 
 	Image* pFinalImage = (makeFloat) ? static_cast<Image*>(pImage3f) : static_cast<Image*>(pImage3b);
 
-	return pFinalImage;
+	return ImageUtils::collapseConstantImage(pFinalImage, requiredTypeFlags);
 }
 
 
@@ -557,7 +558,7 @@ Image* ImageReaderJPEG::readGreyscaleImage(const std::string& filePath, unsigned
 
 	Image* pFinalImage = (makeFloat) ? static_cast<Image*>(pImage1f) : static_cast<Image*>(pImage1b);
 
-	return pFinalImage;
+	return ImageUtils::collapseConstantImage(pFinalImage, requiredTypeFlags);
 }
 
 } // namespace Imagine
@@ -24,6 +24,7 @@
 #include "image/image_colour3b.h"
 #include "image/image_1f.h"
 #include "image/image_1b.h"
+#include "image/image_utils.h"
 
 #include "global_context.h"
 
@@ -250,7 +251,7 @@ Image* ImageReaderPNG::readColourImage(const std::string& filePath, unsigned int
 
 	Image* pFinalImage = (makeFloat) ? static_cast<Image*>(pImage3f) : static_cast<Image*>(pImage3b);
 
-	return pFinalImage;
+	return ImageUtils::collapseConstantImage(pFinalImage, requiredTypeFlags);
 }
 
 Image* ImageReaderPNG::readColourImageAndByteCopy(const std::string& filePath, ImageColour3b* pImageColour3b, unsigned int requiredTypeFlags)
@@ -588,7 +589,7 @@ Image* ImageReaderPNG::readGreyscaleImage(const std::string& filePath, unsigned
 
 	Image* pFinalImage = (makeFloat) ? static_cast<Image*>(pImage1f) : static_cast<Image*>(pImage1b);
 
-	return pFinalImage;
+	return ImageUtils::collapseConstantImage(pFinalImage, requiredTypeFlags);
 }
 
 } // namespace Imagine
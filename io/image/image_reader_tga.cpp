@@ -18,10 +18,14 @@
 
 #include "image_reader_tga.h"
 
+#include <vector>
+
 #include "image/image_colour3f.h"
 #include "image/image_colour3b.h"
 #include "image/image_1f.h"
 #include "image/image_1b.h"
+#include "image/image_utils.h"
+#include "image/image_pixel_conversion.h"
 
 #include "global_context.h"
 
@@ -117,7 +121,7 @@ Image* ImageReaderTGA::readColourImage(const std::string& filePath, unsigned int
 
 	Image* pFinalImage = (makeFloat) ? static_cast<Image*>(pImage3f) : static_cast<Image*>(pImage3b);
 
-	return pFinalImage;
+	return ImageUtils::collapseConstantImage(pFinalImage, requiredTypeFlags);
 }
 
 // reads in a float image for either brightness (bump mapping) or alpha
@@ -359,7 +363,7 @@ Image* ImageReaderTGA::readGreyscaleImage(const std::string& filePath, unsigned
 
 	Image* pFinalImage = (makeFloat) ? static_cast<Image*>(pImage1f) : static_cast<Image*>(pImage1b);
 
-	return pFinalImage;
+	return ImageUtils::collapseConstantImage(pFinalImage, requiredTypeFlags);
 }
 
 bool ImageReaderTGA::readData(const std::string& filePath, TGAInfra& infra)
@@ -418,6 +422,26 @@ bool ImageReaderTGA::readData(const std::string& filePath, TGAInfra& infra)
 	// skip unneeded data
 	fseek(infra.pFile, skipDataLength, SEEK_CUR);
 
+	if (infra.header.dataTypeCode == 2 && bytesToRead >= 3)
+	{
+		// uncompressed 24/32-bit data can be read and swizzled in bulk
+		size_t numPixels = (size_t)infra.header.width * (size_t)infra.header.height;
+		std::vector<unsigned char> aRawData(numPixels * bytesToRead);
+
+		if (fread(aRawData.data(), 1, aRawData.size(), infra.pFile) != aRawData.size())
+		{
+			GlobalContext::instance().getLogger().error("Can't read TGA file: %s...", filePath.c_str());
+			fclose(infra.pFile);
+			delete [] infra.pBuffer;
+			return false;
+		}
+
+		ImagePixelConversion::swizzleBGRToRGBA8(aRawData.data(), (unsigned int)bytesToRead, (uint8_t*)infra.pBuffer, numPixels);
+
+		fclose(infra.pFile);
+		return true;
+	}
+
 	unsigned int n = 0;
 	while (n < (unsigned int)infra.header.width * (unsigned int)infra.header.height)
 	{
@@ -18,6 +18,9 @@
 
 #include "image_reader_tiff.h"
 
+#include <algorithm>
+#include <vector>
+
 #include <tiffio.h>
 
 #include "image/image_1f.h"
@@ -25,6 +28,9 @@
 #include "image/image_colour3f.h"
 #include "image/image_colour3h.h"
 #include "image/image_colour3b.h"
+#include "image/image_utils.h"
+#include "image/image_pixel_conversion.h"
+#include "image/half_conversion.h"
 
 #include "colour/colour_space.h"
 
@@ -60,6 +66,8 @@ bool ImageReaderTIFF::readInfo(TIFF* pTiff, TiffInfo& tiffInfo)
 	TIFFGetField(pTiff, TIFFTAG_ROWSPERSTRIP, &tiffInfo.rowsPerStrip);
 	TIFFGetFieldDefaulted(pTiff, TIFFTAG_SAMPLEFORMAT, &tiffInfo.sampleFormat);
 
+	tiffInfo.halfFloat = tiffInfo.bitDepth == 16 && tiffInfo.sampleFormat == SAMPLEFORMAT_IEEEFP;
+
 	uint16_t planarConfig = 0;
 	TIFFGetFieldDefaulted(pTiff, TIFFTAG_PLANARCONFIG, &planarConfig);
 	if (planarConfig == PLANARCONFIG_SEPARATE && tiffInfo.channelCount > 1)
@@ -117,14 +125,17 @@ Image* ImageReaderTIFF::readColourImage(const std::string& filePath, unsigned in
 		return nullptr;
 	}
 
+	Image* pImage = nullptr;
 	if (!tiffInfo.isTiled)
 	{
-		return readScanlineColourImage(filePath, pTiff, tiffInfo, requiredTypeFlags);
+		pImage = readScanlineColourImage(filePath, pTiff, tiffInfo, requiredTypeFlags);
 	}
 	else
 	{
-		return readTiledColourImage(filePath, pTiff, tiffInfo, requiredTypeFlags);
+		pImage = readTiledColourImage(filePath, pTiff, tiffInfo, requiredTypeFlags);
 	}
+
+	return ImageUtils::collapseConstantImage(pImage, requiredTypeFlags);
 }
 
 Image* ImageReaderTIFF::readScanlineColourImage(const std::string& filePath, TIFF* pTiff, TiffInfo& tiffInfo, unsigned int requiredTypeFlags)
@@ -257,6 +268,15 @@ Image* ImageReaderTIFF::readScanlineColourImage(const std::string& filePath, TIF
 
 		const float invShortConvert = 1.0f / 65536.0f;
 
+		// temporary row buffers for the bulk conversions of 16-bit data
+		std::vector<uint16_t> aTempUShortRow;
+		std::vector<Colour3f> aTempColourRow;
+		if (tiffInfo.bitDepth == 16 && !tiffInfo.halfFloat)
+		{
+			aTempUShortRow.resize(tiffInfo.imageWidth * 3);
+			aTempColourRow.resize(tiffInfo.imageWidth);
+		}
+
 		unsigned int targetY = 0;
 
 		for (unsigned int strip = 0; strip < numStrips; strip++)
@@ -265,34 +285,61 @@ Image* ImageReaderTIFF::readScanlineColourImage(const std::string& filePath, TIF
 
 			for (unsigned int tY = 0; tY < tiffInfo.rowsPerStrip; tY++)
 			{
-				if (tiffInfo.bitDepth == 16 && bitDepthToCreate == 32)
+				if (tiffInfo.halfFloat)
 				{
-					// TODO: there's got to be a better way to handle this... Return value of TIFFReadEncodedStrip()?
 					if (targetY >= tiffInfo.imageHeight)
 						break;
 
-					const uint16* pUShortLine = (uint16*)pRawBuffer + (tY * tiffInfo.imageWidth * tiffInfo.channelCount);
+					// half data is already linear, so either keep it as half, or convert the whole row to float in one go
+					const half* pHalfLine = (half*)pRawBuffer + (tY * tiffInfo.imageWidth * tiffInfo.channelCount);
 
 					// reverse Y
 					unsigned int actualY = tiffInfo.imageHeight - targetY - 1;
-					Colour3f* pImageRow = pImage3f->colourRowPtr(actualY);
 
-					for (unsigned int x = 0; x < tiffInfo.imageWidth; x++)
+					if (bitDepthToCreate == 16)
+					{
+						Colour3h* pImageRow = pImage3h->colour3hRowPtr(actualY);
+
+						for (unsigned int x = 0; x < tiffInfo.imageWidth; x++)
+						{
+							pImageRow->r = pHalfLine[0];
+							pImageRow->g = pHalfLine[1];
+							pImageRow->b = pHalfLine[2];
+
+							pHalfLine += tiffInfo.channelCount;
+							pImageRow++;
+						}
+					}
+					else
 					{
-						uint16_t red = *pUShortLine++;
-						uint16_t green = *pUShortLine++;
-						uint16_t blue = *pUShortLine++;
+						convertHalfPixelsToColour3f(pHalfLine, tiffInfo.channelCount, tiffInfo.imageWidth, pImage3f->colourRowPtr(actualY));
+					}
+				}
+				else if (tiffInfo.bitDepth == 16 && bitDepthToCreate == 32)
+				{
+					// TODO: there's got to be a better way to handle this... Return value of TIFFReadEncodedStrip()?
+					if (targetY >= tiffInfo.imageHeight)
+						break;
 
-						// TODO: LUT for ushort format
+					const uint16_t* pUShortLine = (uint16_t*)pRawBuffer + (tY * tiffInfo.imageWidth * tiffInfo.channelCount);
+					if (tiffInfo.channelCount > 3)
+					{
+						ImagePixelConversion::extractChannels((const unsigned char*)pUShortLine, tiffInfo.channelCount, 3, sizeof(uint16_t),
+															  tiffInfo.imageWidth, (unsigned char*)aTempUShortRow.data());
+						pUShortLine = aTempUShortRow.data();
+					}
 
-						pImageRow->r = (float)red * invShortConvert;
-						pImageRow->g = (float)green * invShortConvert;
-						pImageRow->b = (float)blue * invShortConvert;
+					// reverse Y
+					unsigned int actualY = tiffInfo.imageHeight - targetY - 1;
+					Colour3f* pImageRow = pImage3f->colourRowPtr(actualY);
 
-						// convert to linear
-						ColourSpace::convertSRGBToLinearAccurate(*pImageRow);
+					ImagePixelConversion::convertUInt16ToFloat(pUShortLine, &pImageRow->r, tiffInfo.imageWidth * 3, invShortConvert);
 
-						pImageRow++;
+					// TODO: LUT for ushort format
+					for (unsigned int x = 0; x < tiffInfo.imageWidth; x++)
+					{
+						// convert to linear
+						ColourSpace::convertSRGBToLinearAccurate(pImageRow[x]);
 					}
 				}
 				else if (tiffInfo.bitDepth == 16 && bitDepthToCreate == 16)
@@ -301,29 +348,30 @@ Image* ImageReaderTIFF::readScanlineColourImage(const std::string& filePath, TIF
 					if (targetY >= tiffInfo.imageHeight)
 						break;
 
-					const uint16_t* pUShortLine = (uint16*)pRawBuffer + (tY * tiffInfo.imageWidth * tiffInfo.channelCount);
+					const uint16_t* pUShortLine = (uint16_t*)pRawBuffer + (tY * tiffInfo.imageWidth * tiffInfo.channelCount);
+					if (tiffInfo.channelCount > 3)
+					{
+						ImagePixelConversion::extractChannels((const unsigned char*)pUShortLine, tiffInfo.channelCount, 3, sizeof(uint16_t),
+															  tiffInfo.imageWidth, (unsigned char*)aTempUShortRow.data());
+						pUShortLine = aTempUShortRow.data();
+					}
 
 					// reverse Y
 					unsigned int actualY = tiffInfo.imageHeight - targetY - 1;
 					Colour3h* pImageRow = pImage3h->colour3hRowPtr(actualY);
 
+					// do the sRGB conversion at full float precision, then convert the whole row to half
+					Colour3f* pTempRow = aTempColourRow.data();
+					ImagePixelConversion::convertUInt16ToFloat(pUShortLine, &pTempRow->r, tiffInfo.imageWidth * 3, invShortConvert);
+
+					// TODO: LUT for ushort format
 					for (unsigned int x = 0; x < tiffInfo.imageWidth; x++)
 					{
-						uint16_t red = *pUShortLine++;
-						uint16_t green = *pUShortLine++;
-						uint16_t blue = *pUShortLine++;
-
-						// TODO: LUT for ushort format
-
-						pImageRow->r = (float)red * invShortConvert;
-						pImageRow->g = (float)green * invShortConvert;
-						pImageRow->b = (float)blue * invShortConvert;
-
 						// convert to linear
-						ColourSpace::convertSRGBToLinearAccurate(*pImageRow);
-
-						pImageRow++;
+						ColourSpace::convertSRGBToLinearAccurate(pTempRow[x]);
 					}
+
+					convertFloatToHalf(&pTempRow->r, &pImageRow->r, tiffInfo.imageWidth * 3);
 				}
 				else
 				{
@@ -336,14 +384,8 @@ Image* ImageReaderTIFF::readScanlineColourImage(const std::string& filePath, TIF
 					unsigned int actualY = tiffInfo.imageHeight - targetY - 1;
 					Colour3f* pImageRow = pImage3f->colourRowPtr(actualY);
 
-					for (unsigned int x = 0; x < tiffInfo.imageWidth; x++)
-					{
-						pImageRow->r = *pFloatLine++;
-						pImageRow->g = *pFloatLine++;
-						pImageRow->b = *pFloatLine++;
-
-						pImageRow++;
-					}
+					ImagePixelConversion::extractChannels((const unsigned char*)pFloatLine, tiffInfo.channelCount, 3, sizeof(float),
+														  tiffInfo.imageWidth, (unsigned char*)pImageRow);
 				}
 
 				targetY += 1;
@@ -416,8 +458,8 @@ Image* ImageReaderTIFF::readTiledColourImage(const std::string& filePath, TIFF*
 		return nullptr;
 	}
 
-	// allocate memory to store a single tile
-	unsigned int tileLineSize = (bitDepthToCreate / 8) * tiffInfo.tileWidth * tiffInfo.channelCount;
+	// allocate memory to store a single tile - this needs to be big enough for the data in the file as well
+	unsigned int tileLineSize = (std::max(bitDepthToCreate, (unsigned int)tiffInfo.bitDepth) / 8) * tiffInfo.tileWidth * tiffInfo.channelCount;
 	unsigned int tileByteSize = tileLineSize * tiffInfo.tileHeight;
 
 	unsigned char* pTileBuffer = new unsigned char[tileByteSize];
@@ -444,6 +486,15 @@ Image* ImageReaderTIFF::readTiledColourImage(const std::string& filePath, TIFF*
 
 	const float invShortConvert = 1.0f / 65536.0f;
 
+	// temporary row buffers for the bulk conversions of 16-bit data
+	std::vector<uint16_t> aTempUShortRow;
+	std::vector<Colour3f> aTempColourRow;
+	if (tiffInfo.bitDepth == 16 && !tiffInfo.halfFloat)
+	{
+		aTempUShortRow.resize(tiffInfo.tileWidth * 3);
+		aTempColourRow.resize(tiffInfo.tileWidth);
+	}
+
 	// we need to read each tile individually and copy it into the destination image - this is not going to be too efficient...
 	// TODO: need to work out if tile order makes a difference - rows first or columns?
 
@@ -473,7 +524,41 @@ Image* ImageReaderTIFF::readTiledColourImage(const std::string& filePath, TIFF*
 
 			// now copy the data into our image in the correct position...
 
-			if (bitDepthToCreate == 32)
+			if (tiffInfo.halfFloat)
+			{
+				// cast to the type the data actually is...
+				const half* pSrcTileBuffer = (half*)pTileBuffer;
+
+				for (unsigned int localY = 0; localY < localTileHeight; localY++)
+				{
+					// reverse Y
+					unsigned int actualY = tiffInfo.imageHeight - (localYStartPos + localY + 1);
+
+					const half* pLocalSrcTileBuffer = pSrcTileBuffer + (localY * tiffInfo.tileWidth * tiffInfo.channelCount); // need to use tileWidth here
+
+					if (bitDepthToCreate == 16)
+					{
+						Colour3h* pDst = pImage3h->colour3hRowPtr(actualY) + tilePosX;
+
+						for (unsigned int localX = 0; localX < localTileWidth; localX++)
+						{
+							pDst->r = pLocalSrcTileBuffer[0];
+							pDst->g = pLocalSrcTileBuffer[1];
+							pDst->b = pLocalSrcTileBuffer[2];
+
+							pLocalSrcTileBuffer += tiffInfo.channelCount;
+							pDst++;
+						}
+					}
+					else
+					{
+						Colour3f* pDst = pImage3f->colourRowPtr(actualY) + tilePosX;
+
+						convertHalfPixelsToColour3f(pLocalSrcTileBuffer, tiffInfo.channelCount, localTileWidth, pDst);
+					}
+				}
+			}
+			else if (bitDepthToCreate == 32)
 			{
 				// cast to the type the data should be...
 				const Colour3f* pSrcTileBuffer = (Colour3f*)pTileBuffer;
@@ -510,21 +595,25 @@ Image* ImageReaderTIFF::readTiledColourImage(const std::string& filePath, TIFF*
 					// offset to X pos
 					pDst += tilePosX;
 
-					const uint16_t* pLocalSrcTileBuffer = pSrcTileBuffer + (localY * tiffInfo.tileWidth * 3); // need to use tileWidth here
-
-					for (unsigned int localX = 0; localX < localTileWidth; localX++)
+					const uint16_t* pLocalSrcTileBuffer = pSrcTileBuffer + (localY * tiffInfo.tileWidth * tiffInfo.channelCount); // need to use tileWidth here
+					if (tiffInfo.channelCount > 3)
 					{
-						uint16_t red = *pLocalSrcTileBuffer++;
-						uint16_t green = *pLocalSrcTileBuffer++;
-						uint16_t blue = *pLocalSrcTileBuffer++;
+						ImagePixelConversion::extractChannels((const unsigned char*)pLocalSrcTileBuffer, tiffInfo.channelCount, 3, sizeof(uint16_t),
+															  localTileWidth, (unsigned char*)aTempUShortRow.data());
+						pLocalSrcTileBuffer = aTempUShortRow.data();
+					}
 
-						pDst->r = (float)red * invShortConvert;
-						pDst->g = (float)green * invShortConvert;
-						pDst->b = (float)blue * invShortConvert;
+					// do the sRGB conversion at full float precision, then convert the whole row to half
+					Colour3f* pTempRow = aTempColourRow.data();
+					ImagePixelConversion::convertUInt16ToFloat(pLocalSrcTileBuffer, &pTempRow->r, localTileWidth * 3, invShortConvert);
 
+					for (unsigned int localX = 0; localX < localTileWidth; localX++)
+					{
 						// convert to linear
-						ColourSpace::convertSRGBToLinearAccurate(*pDst++);
+						ColourSpace::convertSRGBToLinearAccurate(pTempRow[localX]);
 					}
+
+					convertFloatToHalf(&pTempRow->r, &pDst->r, localTileWidth * 3);
 				}
 			}
 			else if (bitDepthToCreate == 8)
@@ -541,20 +630,10 @@ Image* ImageReaderTIFF::readTiledColourImage(const std::string& filePath, TIFF*
 					// offset to X pos
 					pDst += tilePosX;
 
-					const uint8_t* pLocalSrcTileBuffer = pSrcTileBuffer + (localY * tiffInfo.tileWidth * 3); // need to use tileWidth here
-
-					for (unsigned int localX = 0; localX < localTileWidth; localX++)
-					{
-						uint8_t red = *pLocalSrcTileBuffer++;
-						uint8_t green = *pLocalSrcTileBuffer++;
-						uint8_t blue = *pLocalSrcTileBuffer++;
-
-						pDst->r = red;
-						pDst->g = green;
-						pDst->b = blue;
+					const uint8_t* pLocalSrcTileBuffer = pSrcTileBuffer + (localY * tiffInfo.tileWidth * tiffInfo.channelCount); // need to use tileWidth here
 
-						pDst++;
-					}
+					ImagePixelConversion::extractChannels(pLocalSrcTileBuffer, tiffInfo.channelCount, 3, sizeof(uint8_t), localTileWidth,
+														  (unsigned char*)pDst);
 				}
 			}
 		}
@@ -602,14 +681,17 @@ Image* ImageReaderTIFF::readGreyscaleImage(const std::string& filePath, unsigned
 		return nullptr;
 	}
 
+	Image* pImage = nullptr;
 	if (!tiffInfo.isTiled)
 	{
-		return readScanlineGreyscaleImage(filePath, pTiff, tiffInfo, requiredTypeFlags);
+		pImage = readScanlineGreyscaleImage(filePath, pTiff, tiffInfo, requiredTypeFlags);
 	}
 	else
 	{
-		return readTiledGreyscaleImage(filePath, pTiff, tiffInfo, requiredTypeFlags);
+		pImage = readTiledGreyscaleImage(filePath, pTiff, tiffInfo, requiredTypeFlags);
 	}
+
+	return ImageUtils::collapseConstantImage(pImage, requiredTypeFlags);
 }
 
 Image* ImageReaderTIFF::readScanlineGreyscaleImage(const std::string& filePath, TIFF* pTiff, TiffInfo& tiffInfo, unsigned int requiredTypeFlags)
@@ -803,6 +885,15 @@ Image* ImageReaderTIFF::readScanlineGreyscaleImage(const std::string& filePath,
 
 		const float invShortConvert = 1.0f / 65536.0f;
 
+		// temporary row buffers for the bulk conversions of 16-bit data
+		std::vector<uint16_t> aTempUShortRow;
+		std::vector<Colour3f> aTempColourRow;
+		if (tiffInfo.bitDepth == 16)
+		{
+			aTempUShortRow.resize(tiffInfo.imageWidth * 3);
+			aTempColourRow.resize(tiffInfo.imageWidth);
+		}
+
 		unsigned int targetY = 0;
 
 		for (unsigned int strip = 0; strip < numStrips; strip++)
@@ -817,7 +908,7 @@ Image* ImageReaderTIFF::readScanlineGreyscaleImage(const std::string& filePath,
 					if (targetY >= tiffInfo.imageHeight)
 						break;
 
-					const uint16* pUShortLine = (uint16*)pRawBuffer + (tY * tiffInfo.imageWidth * tiffInfo.channelCount);
+					const uint16_t* pUShortLine = (uint16_t*)pRawBuffer + (tY * tiffInfo.imageWidth * tiffInfo.channelCount);
 
 					// flip Y
 					unsigned int actualY = tiffInfo.imageHeight - targetY - 1;
@@ -825,93 +916,70 @@ Image* ImageReaderTIFF::readScanlineGreyscaleImage(const std::string& filePath,
 
 					if (requiredTypeFlags & Image::IMAGE_FLAGS_ALPHA)
 					{
-						uint16_t alpha = 0;
-
 						if (tiffInfo.channelCount == 1)
 						{
-							for (unsigned int x = 0; x < tiffInfo.imageWidth; x++)
-							{
-								alpha = *pUShortLine++;
-
-								*pFloatRow++ = (float)alpha * invShortConvert;
-							}
-						}
-						else if (tiffInfo.channelCount == 3)
-						{
-							for (unsigned int x = 0; x < tiffInfo.imageWidth; x++)
-							{
-								// get red one
-								alpha = *pUShortLine++;
-								pUShortLine++;
-								pUShortLine++;
-
-								*pFloatRow++ = (float)alpha * invShortConvert;
-							}
+							ImagePixelConversion::convertUInt16ToFloat(pUShortLine, pFloatRow, tiffInfo.imageWidth, invShortConvert);
 						}
 						else
 						{
+							// use red for 3-channel images, otherwise the last (alpha) channel
+							unsigned int channelOffset = (tiffInfo.channelCount == 3) ? 0 : tiffInfo.channelCount - 1;
+							uint16_t* pTempRow = aTempUShortRow.data();
 							for (unsigned int x = 0; x < tiffInfo.imageWidth; x++)
 							{
-								// ignore first 3
-								pUShortLine++;
-								pUShortLine++;
-								pUShortLine++;
-
-								alpha = *pUShortLine++;
-
-								*pFloatRow++ = (float)alpha * invShortConvert;
+								pTempRow[x] = pUShortLine[x * tiffInfo.channelCount + channelOffset];
 							}
+
+							ImagePixelConversion::convertUInt16ToFloat(pTempRow, pFloatRow, tiffInfo.imageWidth, invShortConvert);
 						}
 					}
 					else if (requiredTypeFlags & Image::IMAGE_FLAGS_BRIGHTNESS)
 					{
-						for (unsigned int x = 0; x < tiffInfo.imageWidth; x++)
+						if (tiffInfo.channelCount == 1)
 						{
-							float brightness = 0.0f;
-
-							if (tiffInfo.channelCount == 1)
+							ImagePixelConversion::convertUInt16ToFloat(pUShortLine, pFloatRow, tiffInfo.imageWidth, invShortConvert);
+						}
+						else if (tiffInfo.channelCount == 2)
+						{
+							// greyscale with alpha, so just use the grey channel
+							uint16_t* pTempRow = aTempUShortRow.data();
+							for (unsigned int x = 0; x < tiffInfo.imageWidth; x++)
 							{
-								uint16_t rawValue = *pUShortLine++;
-
-								brightness = (float)rawValue * invShortConvert;
+								pTempRow[x] = pUShortLine[x * 2];
 							}
-							else
-							{
-								uint16_t red = *pUShortLine++;
-								uint16_t green = *pUShortLine++;
-								uint16_t blue = *pUShortLine++;
 
-								float fRed = (float)red * invShortConvert;
-								float fGreen = (float)green * invShortConvert;
-								float fBlue = (float)blue * invShortConvert;
+							ImagePixelConversion::convertUInt16ToFloat(pTempRow, pFloatRow, tiffInfo.imageWidth, invShortConvert);
+						}
+						else
+						{
+							if (tiffInfo.channelCount > 3)
+							{
+								ImagePixelConversion::extractChannels((const unsigned char*)pUShortLine, tiffInfo.channelCount, 3, sizeof(uint16_t),
+																	  tiffInfo.imageWidth, (unsigned char*)aTempUShortRow.data());
+								pUShortLine = aTempUShortRow.data();
+							}
 
-								Colour3f colour(fRed, fGreen, fBlue);
+							Colour3f* pTempColourRow = aTempColourRow.data();
+							ImagePixelConversion::convertUInt16ToFloat(pUShortLine, &pTempColourRow->r, tiffInfo.imageWidth * 3, invShortConvert);
 
-								brightness = colour.brightness();
+							for (unsigned int x = 0; x < tiffInfo.imageWidth; x++)
+							{
+								pFloatRow[x] = pTempColourRow[x].brightness();
 							}
-
-							*pFloatRow++ = brightness;
 						}
 					}
 					else
 					{
-						for (unsigned int x = 0; x < tiffInfo.imageWidth; x++)
+						// exact copy - assume 1 channel for the moment
+						if (tiffInfo.channelCount == 1)
 						{
-							// exact copy - assume 1 channel for the moment
-							float value = 0.0f;
-
-							if (tiffInfo.channelCount == 1)
-							{
-								uint16_t rawValue = *pUShortLine++;
-
-								value = (float)rawValue * invShortConvert;
-							}
-
-							*pFloatRow++ = value;
+							ImagePixelConversion::convertUInt16ToFloat(pUShortLine, pFloatRow, tiffInfo.imageWidth, invShortConvert);
+						}
+						else
+						{
+							std::fill(pFloatRow, pFloatRow + tiffInfo.imageWidth, 0.0f);
 						}
 					}
-
-					pFloatRow++;
 				}
 				else
 				{
@@ -1014,7 +1082,8 @@ bool ImageReaderTIFF::readImageDetails(const std::string& filePath, ImageTexture
 	}
 	else if (info.bitDepth == 16)
 	{
-		dataType = ImageTextureDetails::eUInt16;
+		// keep half data as half in the cache - it gets converted to float at lookup time
+		dataType = info.halfFloat ? ImageTextureDetails::eHalf : ImageTextureDetails::eUInt16;
 	}
 	else if (info.bitDepth == 32)
 	{
@@ -1170,29 +1239,16 @@ bool ImageReaderTIFF::readImageTile(const ImageTextureTileReadParams& readParams
 			pTilePlaneData += tilePlaneSize;
 		}
 
-		unsigned char* __restrict pDst = readParams.pData;
-		unsigned char* __restrict pSrc = pTempData;
-
 		// now re-order the pixels in interleaved fashion
-
-		// we're probably going to thrash the caches anyway, regardless of the order we do this...
-
-		for (unsigned int y = 0; y < tileHeight; y++)
+		std::vector<const unsigned char*> aPlanes(textureDetails.getChannelCount());
+		for (unsigned int i = 0; i < textureDetails.getChannelCount(); i++)
 		{
-			for (unsigned int x = 0; x < tileWidth; x++)
-			{
-				for (unsigned int c = 0; c < textureDetails.getChannelCount(); c++)
-				{
-					// we could cache some of this above in the individual loops...
-					pSrc = pTempData + (tilePlaneSize * c) + (y * tileWidth * singleChannelPixelByte) + (x * singleChannelPixelByte);
-
-					memcpy(pDst, pSrc, singleChannelPixelByte);
-
-					pDst += singleChannelPixelByte;
-				}
-			}
+			aPlanes[i] = pTempData + (tilePlaneSize * i);
 		}
 
+		ImagePixelConversion::interleavePlanes(aPlanes.data(), textureDetails.getChannelCount(), (unsigned int)singleChannelPixelByte,
+											   (size_t)tileWidth * tileHeight, readParams.pData);
+
 		if (pTempData)
 		{
 			delete [] pTempData;
@@ -1211,6 +1267,9 @@ bool ImageReaderTIFF::readImageTile(const ImageTextureTileReadParams& readParams
 
 	TIFFClose(pTiff);
 
+	// uniform tiles (very common with masks) only need a single pixel stored
+	ImageUtils::detectConstantTile(readParams, tileWidth, tileHeight, readResults);
+
 	return true;
 }
 
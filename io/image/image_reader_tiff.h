@@ -37,7 +37,7 @@ public:
 	struct TiffInfo
 	{
 		TiffInfo() : imageHeight(0), imageWidth(0), rowsPerStrip(0), bitDepth(0), channelCount(0), orientation(0),
-			sampleFormat(0), compression(0), separatePlanes(false), isTiled(false), tileWidth(0), tileHeight(0), tileDepth(0)
+			sampleFormat(0), compression(0), halfFloat(false), separatePlanes(false), isTiled(false), tileWidth(0), tileHeight(0), tileDepth(0)
 		{
 		}
 
@@ -51,6 +51,8 @@ public:
 		uint16_t	sampleFormat;
 		uint32_t	compression;
 
+		bool		halfFloat; // 16-bit IEEE floating point data, as opposed to uint16
+
 		bool		separatePlanes; // each channel is stored in separate planes
 
 		uint32_t	xPos;
@@ -0,0 +1,79 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#include "image_writer_band_pool.h"
+
+#include <algorithm>
+
+#include "utils/system.h"
+
+namespace Imagine
+{
+
+ImageWriterBandPool::ImageWriterBandPool(unsigned int threads) : ThreadPool(threads, false)
+{
+}
+
+ImageWriterBandPool::~ImageWriterBandPool()
+{
+}
+
+unsigned int ImageWriterBandPool::calculateBands(unsigned int height, unsigned int minBandRows, unsigned int rowMultiple, unsigned int& bandRows)
+{
+	unsigned int threads = System::getNumberOfThreads();
+
+	unsigned int numBands = std::min(threads, height / minBandRows);
+	if (numBands <= 1)
+	{
+		bandRows = height;
+		return 1;
+	}
+
+	bandRows = (height + numBands - 1) / numBands;
+	// round up to the row multiple
+	bandRows = ((bandRows + rowMultiple - 1) / rowMultiple) * rowMultiple;
+
+	// rounding up might mean we need fewer bands now
+	numBands = (height + bandRows - 1) / bandRows;
+
+	return numBands;
+}
+
+void ImageWriterBandPool::processBands(unsigned int numBands)
+{
+	for (unsigned int i = 0; i < numBands; i++)
+	{
+		addTaskNoLock(new BandTask(i));
+	}
+
+	startPool(POOL_WAIT_FOR_COMPLETION);
+}
+
+bool ImageWriterBandPool::doTask(ThreadPoolTask* pTask, unsigned int threadID)
+{
+	if (!pTask)
+		return false;
+
+	BandTask* pBandTask = static_cast<BandTask*>(pTask);
+
+	processBand(pBandTask->m_bandIndex);
+
+	return true;
+}
+
+} // namespace Imagine
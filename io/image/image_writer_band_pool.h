@@ -0,0 +1,63 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#ifndef IMAGE_WRITER_BAND_POOL_H
+#define IMAGE_WRITER_BAND_POOL_H
+
+#include "utils/threads/thread_pool.h"
+
+namespace Imagine
+{
+
+// Stand-alone thread pool for image writers which can encode horizontal bands of rows
+// independently (and then stitch the results together), so that large images don't
+// have to be quantised and compressed on a single thread.
+
+class ImageWriterBandPool : public ThreadPool
+{
+public:
+	ImageWriterBandPool(unsigned int threads);
+	virtual ~ImageWriterBandPool();
+
+	// works out how many bands of at least minBandRows rows (and a multiple of rowMultiple rows)
+	// to split the image into, and how many rows each one should have. The last band can be shorter.
+	static unsigned int calculateBands(unsigned int height, unsigned int minBandRows, unsigned int rowMultiple, unsigned int& bandRows);
+
+	// blocks until processBand() has been called for all bands
+	void processBands(unsigned int numBands);
+
+protected:
+	class BandTask : public ThreadPoolTask
+	{
+	public:
+		BandTask(unsigned int bandIndex) : m_bandIndex(bandIndex)
+		{
+		}
+
+		unsigned int	m_bandIndex;
+	};
+
+	virtual bool doTask(ThreadPoolTask* pTask, unsigned int threadID);
+
+	// called on worker threads, so implementations must only write to per-band state
+	virtual void processBand(unsigned int bandIndex) = 0;
+};
+
+} // namespace Imagine
+
+#endif // IMAGE_WRITER_BAND_POOL_H
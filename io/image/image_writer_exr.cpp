@@ -140,6 +140,19 @@ bool ImageWriterEXR::writeStandardImage(const std::string& filePath, const Outpu
 		header.channels().insert("shadows.r", Imf::Channel(pixelType));
 	}
 
+	// adaptive sampling convergence channels
+	if (!(image.getComponents() & COMPONENT_VARIANCE))
+		channels = channels & ~ImageWriter::VARIANCE;
+
+	if (channels & ImageWriter::VARIANCE)
+		header.channels().insert("variance.r", Imf::Channel(pixelType));
+
+	if (!(image.getComponents() & COMPONENT_SAMPLE_COUNT))
+		channels = channels & ~ImageWriter::SAMPLE_COUNT;
+
+	if (channels & ImageWriter::SAMPLE_COUNT)
+		header.channels().insert("sampleCount.r", Imf::Channel(pixelType));
+
 	unsigned int rgbStride = (channels & ImageWriter::ALPHA) ? 4 : 3;
 
 	T* rgba = nullptr;
@@ -157,12 +170,20 @@ bool ImageWriterEXR::writeStandardImage(const std::string& filePath, const Outpu
 	T* pShadows = nullptr;
 	if (channels & ImageWriter::SHADOWS)
 		pShadows = new T[width * height];
+	T* pVariance = nullptr;
+	if (channels & ImageWriter::VARIANCE)
+		pVariance = new T[width * height];
+	T* pSampleCount = nullptr;
+	if (channels & ImageWriter::SAMPLE_COUNT)
+		pSampleCount = new T[width * height];
 
 	const Colour4f* pRow = nullptr;
 	const float* pDepthRow = nullptr;
 	const Colour3f* pNormalRow = nullptr;
 	const Colour3f* pWPPRow = nullptr;
 	const float* pShadowsRow = nullptr;
+	const float* pVarianceRow = nullptr;
+	const float* pSampleCountRow = nullptr;
 
 	for (unsigned int y = 0; y < height; y++)
 	{
@@ -180,6 +201,12 @@ bool ImageWriterEXR::writeStandardImage(const std::string& filePath, const Outpu
 		if (channels & ImageWriter::SHADOWS)
 			pShadowsRow = image.shadowsRowPtr(y);
 
+		if (channels & ImageWriter::VARIANCE)
+			pVarianceRow = image.varianceRowPtr(y);
+
+		if (channels & ImageWriter::SAMPLE_COUNT)
+			pSampleCountRow = image.sampleCountRowPtr(y);
+
 		unsigned int rgbStartPos = width * y * rgbStride;
 		unsigned int normalStartPos = width * y * 3;
 		unsigned int wppStartPos = width * y * 3;
@@ -247,6 +274,16 @@ bool ImageWriterEXR::writeStandardImage(const std::string& filePath, const Outpu
 				pShadows[(width * y) + x] = *pShadowsRow++;
 			}
 
+			if (channels & ImageWriter::VARIANCE)
+			{
+				pVariance[(width * y) + x] = *pVarianceRow++;
+			}
+
+			if (channels & ImageWriter::SAMPLE_COUNT)
+			{
+				pSampleCount[(width * y) + x] = *pSampleCountRow++;
+			}
+
 			pRow++;
 		}
 	}
@@ -286,6 +323,16 @@ bool ImageWriterEXR::writeStandardImage(const std::string& filePath, const Outpu
 		fb.insert("shadows.r", Imf::Slice(pixelType, (char *)pShadows, sizeof(T), width * sizeof(T)));
 	}
 
+	if (channels & ImageWriter::VARIANCE)
+	{
+		fb.insert("variance.r", Imf::Slice(pixelType, (char *)pVariance, sizeof(T), width * sizeof(T)));
+	}
+
+	if (channels & ImageWriter::SAMPLE_COUNT)
+	{
+		fb.insert("sampleCount.r", Imf::Slice(pixelType, (char *)pSampleCount, sizeof(T), width * sizeof(T)));
+	}
+
 	Imf::OutputFile file(filePath.c_str(), header);
 	file.setFrameBuffer(fb);
 	file.writePixels(height);
@@ -300,6 +347,10 @@ bool ImageWriterEXR::writeStandardImage(const std::string& filePath, const Outpu
 		delete [] pWPP;
 	if (pShadows)
 		delete [] pShadows;
+	if (pVariance)
+		delete [] pVariance;
+	if (pSampleCount)
+		delete [] pSampleCount;
 
 	return true;
 }
@@ -19,20 +19,238 @@
 #include "image_writer_jpeg.h"
 
 #include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
 
 #include <jpeglib.h>
 
 #include "image/output_image.h"
 
-#include "colour/colour_space.h"
-
 #include "global_context.h"
 
-#include "utils/maths/maths.h"
+#include "image_quantiser.h"
+#include "image_writer_band_pool.h"
 
 namespace Imagine
 {
 
+// below this, it's not worth splitting the image into separately-encoded bands
+static const unsigned int kMinJPEGBandRows = 128;
+
+// restart intervals are stored as a uint16_t in the DRI marker
+static const unsigned int kMaxRestartIntervalMCUs = 65535;
+
+static void setupJPEGCompressor(jpeg_compress_struct& compressInfo, unsigned int width, unsigned int height, float quality)
+{
+	compressInfo.image_width = width;
+	compressInfo.image_height = height;
+	compressInfo.input_components = 3;
+	compressInfo.in_color_space = JCS_RGB;
+
+	jpeg_set_defaults(&compressInfo);
+
+	// set actual options we want...
+	int intQuality = (int)(quality * 100.0f);
+	jpeg_set_quality(&compressInfo, intQuality, TRUE);
+
+	unsigned int chromaSubSamplingType = 0;
+	// 0 = 4:1:1, 1 = 4:2:2, 2 = 4:4:4
+	compressInfo.comp_info[0].h_samp_factor = (chromaSubSamplingType < 2) ? 2 : 1;
+	compressInfo.comp_info[0].v_samp_factor = (chromaSubSamplingType < 1) ? 2 : 1;
+}
+
+// returns the offset of the entropy-coded data after the SOS marker segment, or 0 if it couldn't be found.
+// If newHeight is non-zero, the image height in the SOF marker segment will be changed to that.
+static size_t findJPEGScanDataStart(unsigned char* pData, size_t size, unsigned int newHeight)
+{
+	// skip SOI
+	size_t pos = 2;
+
+	while (pos + 4 <= size)
+	{
+		if (pData[pos] != 0xFF)
+			return 0;
+
+		unsigned char marker = pData[pos + 1];
+		size_t length = ((size_t)pData[pos + 2] << 8) | (size_t)pData[pos + 3];
+
+		if (newHeight > 0 && marker >= 0xC0 && marker <= 0xC2 && pos + 7 <= size)
+		{
+			pData[pos + 5] = (unsigned char)((newHeight >> 8) & 0xFF);
+			pData[pos + 6] = (unsigned char)(newHeight & 0xFF);
+		}
+
+		pos += 2 + length;
+
+		if (marker == 0xDA)
+			return pos;
+	}
+
+	return 0;
+}
+
+// Encodes horizontal bands of the image as separate JPEG streams in parallel, using identical settings (so identical
+// quantisation and standard huffman tables) and a restart interval which evenly divides the band height. As DC prediction
+// is reset at every restart marker, the entropy-coded data of each band can then be concatenated with RSTn markers
+// between them (renumbering any markers within bands) under the header of the first band, with its height patched.
+class JPEGBandEncoder : public ImageWriterBandPool
+{
+public:
+	JPEGBandEncoder(const OutputImage& image, float quality, bool dither, unsigned int bandRows, unsigned int numBands,
+					unsigned int restartIntervalMCUs, unsigned int intervalsPerBand) :
+		ImageWriterBandPool(numBands), m_image(image), m_quality(quality), m_dither(dither), m_bandRows(bandRows), m_numBands(numBands),
+		m_restartIntervalMCUs(restartIntervalMCUs), m_intervalsPerBand(intervalsPerBand)
+	{
+		m_aBandResults.resize(numBands);
+	}
+
+	virtual ~JPEGBandEncoder()
+	{
+		for (BandResult& band : m_aBandResults)
+		{
+			if (band.pBuffer)
+			{
+				free(band.pBuffer);
+				band.pBuffer = nullptr;
+			}
+		}
+	}
+
+	bool encode()
+	{
+		processBands(m_numBands);
+
+		for (unsigned int i = 0; i < m_numBands; i++)
+		{
+			if (!m_aBandResults[i].pBuffer || m_aBandResults[i].scanDataStart == 0)
+				return false;
+		}
+
+		// the first band provides the headers for the whole image
+		BandResult& firstBand = m_aBandResults[0];
+		return findJPEGScanDataStart(firstBand.pBuffer, firstBand.bufferSize, m_image.getHeight()) == firstBand.scanDataStart;
+	}
+
+	bool writeToFile(FILE* pFile) const
+	{
+		const BandResult& firstBand = m_aBandResults[0];
+		if (fwrite(firstBand.pBuffer, 1, firstBand.scanDataStart, pFile) != firstBand.scanDataStart)
+			return false;
+
+		for (unsigned int i = 0; i < m_numBands; i++)
+		{
+			const BandResult& band = m_aBandResults[i];
+
+			if (i > 0)
+			{
+				// this marker follows the last interval of the previous band
+				unsigned int previousInterval = (i * m_intervalsPerBand) - 1;
+				unsigned char restartMarker[2] = { 0xFF, (unsigned char)(0xD0 + (previousInterval & 7)) };
+				fwrite(restartMarker, 1, 2, pFile);
+			}
+
+			// skip the EOI marker at the end
+			size_t scanDataSize = band.bufferSize - 2 - band.scanDataStart;
+			if (fwrite(band.pBuffer + band.scanDataStart, 1, scanDataSize, pFile) != scanDataSize)
+				return false;
+		}
+
+		unsigned char endMarker[2] = { 0xFF, 0xD9 };
+		return fwrite(endMarker, 1, 2, pFile) == 2;
+	}
+
+protected:
+	struct BandResult
+	{
+		BandResult() : pBuffer(nullptr), bufferSize(0), scanDataStart(0)
+		{
+		}
+
+		unsigned char*	pBuffer;
+		unsigned long	bufferSize;
+		size_t			scanDataStart;
+	};
+
+	virtual void processBand(unsigned int bandIndex)
+	{
+		BandResult& result = m_aBandResults[bandIndex];
+
+		unsigned int width = m_image.getWidth();
+		unsigned int startRow = bandIndex * m_bandRows;
+		unsigned int endRow = std::min(startRow + m_bandRows, m_image.getHeight());
+
+		struct jpeg_compress_struct compressInfo;
+		struct jpeg_error_mgr jerr;
+
+		compressInfo.err = jpeg_std_error(&jerr);
+		jpeg_create_compress(&compressInfo);
+
+		jpeg_mem_dest(&compressInfo, &result.pBuffer, &result.bufferSize);
+
+		setupJPEGCompressor(compressInfo, width, endRow - startRow, m_quality);
+		compressInfo.restart_interval = m_restartIntervalMCUs;
+
+		jpeg_start_compress(&compressInfo, TRUE);
+
+		std::vector<unsigned char> tempRow(width * 3);
+
+		JSAMPROW rowPointer[1];
+		rowPointer[0] = tempRow.data();
+
+		for (unsigned int y = startRow; y < endRow; y++)
+		{
+			ImageQuantiser::quantiseRowSRGB8(m_image.colourRowPtr(y), width, y, false, m_dither, tempRow.data());
+
+			jpeg_write_scanlines(&compressInfo, rowPointer, 1);
+		}
+
+		jpeg_finish_compress(&compressInfo);
+		jpeg_destroy_compress(&compressInfo);
+
+		if (!result.pBuffer || result.bufferSize < 4)
+			return;
+
+		result.scanDataStart = findJPEGScanDataStart(result.pBuffer, result.bufferSize, 0);
+		if (result.scanDataStart == 0)
+			return;
+
+		// renumber any restart markers within this band so they continue on from the previous bands' ones
+		unsigned int intervalIndex = bandIndex * m_intervalsPerBand;
+		unsigned char* pScanData = result.pBuffer + result.scanDataStart;
+		size_t scanDataSize = result.bufferSize - 2 - result.scanDataStart;
+
+		for (size_t i = 0; i + 1 < scanDataSize; i++)
+		{
+			if (pScanData[i] != 0xFF)
+				continue;
+
+			unsigned char marker = pScanData[i + 1];
+			if (marker >= 0xD0 && marker <= 0xD7)
+			{
+				pScanData[i + 1] = (unsigned char)(0xD0 + (intervalIndex & 7));
+				intervalIndex++;
+			}
+
+			// skip the marker code (or 0x00 stuffed byte)
+			i++;
+		}
+	}
+
+protected:
+	const OutputImage&		m_image;
+	float					m_quality;
+	bool					m_dither;
+
+	unsigned int			m_bandRows;
+	unsigned int			m_numBands;
+
+	unsigned int			m_restartIntervalMCUs;
+	unsigned int			m_intervalsPerBand;
+
+	std::vector<BandResult>	m_aBandResults;
+};
+
 ImageWriterJPEG::ImageWriterJPEG() : ImageWriter()
 {
 	
@@ -42,15 +260,35 @@ bool ImageWriterJPEG::writeImage(const std::string& filePath, const OutputImage&
 {
 	unsigned int width = image.getWidth();
 	unsigned int height = image.getHeight();
-	
+
+	float quality = 0.95f;
+
+	bool dither = !(flags & ImageWriter::NO_DITHER);
+
 	struct jpeg_compress_struct compressInfo;
 	struct jpeg_error_mgr jerr;
-	
-	jpeg_create_compress(&compressInfo);
+
 	compressInfo.err = jpeg_std_error(&jerr);
-	
-	float quality = 0.95f;	
-	
+	jpeg_create_compress(&compressInfo);
+
+	// work out the MCU layout, so we can decide whether it's worth encoding bands in parallel
+	setupJPEGCompressor(compressInfo, width, height, quality);
+
+	unsigned int mcuWidth = 8 * compressInfo.comp_info[0].h_samp_factor;
+	unsigned int mcuHeight = 8 * compressInfo.comp_info[0].v_samp_factor;
+	unsigned int mcusPerRow = (width + mcuWidth - 1) / mcuWidth;
+
+	unsigned int bandRows = height;
+	unsigned int numBands = ImageWriterBandPool::calculateBands(height, kMinJPEGBandRows, mcuHeight, bandRows);
+
+	unsigned int restartRows = bandRows / mcuHeight;
+	if (numBands > 1 && restartRows * mcusPerRow > kMaxRestartIntervalMCUs)
+	{
+		// we need restart markers within bands as well, so the band height needs to be a multiple of the interval
+		restartRows = std::max(1u, kMaxRestartIntervalMCUs / mcusPerRow);
+		numBands = ImageWriterBandPool::calculateBands(height, kMinJPEGBandRows, mcuHeight * restartRows, bandRows);
+	}
+
 	FILE* pFile = fopen(filePath.c_str(), "wb");
 	if (!pFile)
 	{
@@ -58,25 +296,29 @@ bool ImageWriterJPEG::writeImage(const std::string& filePath, const OutputImage&
 		GlobalContext::instance().getLogger().error("Error writing file: %s", filePath.c_str());
 		return false;
 	}
-	
+
+	if (numBands > 1)
+	{
+		jpeg_destroy_compress(&compressInfo);
+
+		unsigned int intervalsPerBand = (bandRows / mcuHeight) / restartRows;
+
+		JPEGBandEncoder bandEncoder(image, quality, dither, bandRows, numBands, restartRows * mcusPerRow, intervalsPerBand);
+
+		bool success = bandEncoder.encode() && bandEncoder.writeToFile(pFile);
+
+		fclose(pFile);
+
+		if (!success)
+		{
+			GlobalContext::instance().getLogger().error("Error encoding JPEG image data for file: %s", filePath.c_str());
+		}
+
+		return success;
+	}
+
 	jpeg_stdio_dest(&compressInfo, pFile);
-	
-	compressInfo.image_width = width;
-	compressInfo.image_height = height;
-	compressInfo.input_components = 3;
-	compressInfo.in_color_space = JCS_RGB;
-	
-	jpeg_set_defaults(&compressInfo);
-	
-	// set actual options we want...
-	int intQuality = (int)(quality * 100.0f);
-	jpeg_set_quality(&compressInfo, intQuality, TRUE);
-	
-	unsigned int chromaSubSamplingType = 0;
-	// 0 = 4:1:1, 1 = 4:2:2, 2 = 4:4:4
-	compressInfo.comp_info[0].h_samp_factor = (chromaSubSamplingType < 2) ? 2 : 1;
-	compressInfo.comp_info[0].v_samp_factor = (chromaSubSamplingType < 1) ? 2 : 1;
-	
+
 	jpeg_start_compress(&compressInfo, TRUE);
 	
 	// allocate for only one scanline currently
@@ -86,27 +328,8 @@ bool ImageWriterJPEG::writeImage(const std::string& filePath, const OutputImage&
 	
 	for (unsigned int y = 0; y < height; y++)
 	{
-		const Colour4f* pRow = image.colourRowPtr(y);
-		
-		unsigned char* pTempScanline = pTempRow;
+		ImageQuantiser::quantiseRowSRGB8(image.colourRowPtr(y), width, y, false, dither, pTempRow);
 
-		for (unsigned int x = 0; x < width; x++)
-		{
-			float r = ColourSpace::convertLinearToSRGBAccurate(pRow->r);
-			float g = ColourSpace::convertLinearToSRGBAccurate(pRow->g);
-			float b = ColourSpace::convertLinearToSRGBAccurate(pRow->b);
-
-			unsigned char red = clamp(r) * 255;
-			unsigned char green = clamp(g) * 255;
-			unsigned char blue = clamp(b) * 255;
-
-			*pTempScanline++ = red;
-			*pTempScanline++ = green;
-			*pTempScanline++ = blue;
-
-			pRow++;
-		}
-		
 		rowPointer[0] = pTempRow;
 		jpeg_write_scanlines(&compressInfo, rowPointer, 1);
 	}
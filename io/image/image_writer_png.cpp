@@ -19,21 +19,282 @@
 #include "image_writer_png.h"
 
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <vector>
 
 #include <png.h>
+#include <zlib.h>
 
 #include "image/output_image.h"
 
-#include "colour/colour_space.h"
-
 #include "global_context.h"
 
-#include "utils/io/data_conversion.h"
-#include "utils/maths/maths.h"
+#include "image_quantiser.h"
+#include "image_writer_band_pool.h"
 
 namespace Imagine
 {
 
+// below this, it's not worth splitting the image into separate deflate streams
+static const unsigned int kMinPNGBandRows = 64;
+
+static inline unsigned char paethPredictor(int a, int b, int c)
+{
+	int p = a + b - c;
+	int pa = std::abs(p - a);
+	int pb = std::abs(p - b);
+	int pc = std::abs(p - c);
+
+	if (pa <= pb && pa <= pc)
+		return (unsigned char)a;
+	else if (pb <= pc)
+		return (unsigned char)b;
+
+	return (unsigned char)c;
+}
+
+// Encodes horizontal bands of the image as separate raw deflate streams in parallel, which are then concatenated
+// (with a zlib header and the combined adler32 checksum) and written as IDAT chunks. Each band apart from the last
+// is terminated with a sync flush, so is byte-aligned with no final block, so the result is a single valid zlib stream,
+// just without any back-references across band boundaries.
+// Row filtering still uses the previous row across band boundaries (each band re-quantises the row before it),
+// with the same minimum sum of absolute differences heuristic libpng uses to pick the filter type per row.
+class PNGBandEncoder : public ImageWriterBandPool
+{
+public:
+	PNGBandEncoder(const OutputImage& image, bool alpha, bool save16Bit, bool dither, unsigned int bandRows, unsigned int numBands) :
+		ImageWriterBandPool(numBands), m_image(image), m_alpha(alpha), m_save16Bit(save16Bit), m_dither(dither),
+		m_bandRows(bandRows), m_numBands(numBands)
+	{
+		m_bytesPerPixel = (alpha ? 4 : 3) * (save16Bit ? 2 : 1);
+		m_rowBytes = (size_t)image.getWidth() * m_bytesPerPixel;
+
+		m_aBandResults.resize(numBands);
+	}
+
+	// returns false if any of the bands failed to compress
+	bool encode()
+	{
+		processBands(m_numBands);
+
+		uLong combinedAdler = adler32(0L, Z_NULL, 0);
+
+		for (unsigned int i = 0; i < m_numBands; i++)
+		{
+			const BandResult& band = m_aBandResults[i];
+			if (!band.success)
+				return false;
+
+			combinedAdler = adler32_combine(combinedAdler, band.adler, (z_off_t)band.uncompressedSize);
+		}
+
+		std::vector<unsigned char>& finalData = m_aBandResults[m_numBands - 1].compressedData;
+		finalData.push_back((unsigned char)((combinedAdler >> 24) & 0xFF));
+		finalData.push_back((unsigned char)((combinedAdler >> 16) & 0xFF));
+		finalData.push_back((unsigned char)((combinedAdler >> 8) & 0xFF));
+		finalData.push_back((unsigned char)(combinedAdler & 0xFF));
+
+		return true;
+	}
+
+	unsigned int getNumBands() const
+	{
+		return m_numBands;
+	}
+
+	const std::vector<unsigned char>& getBandData(unsigned int bandIndex) const
+	{
+		return m_aBandResults[bandIndex].compressedData;
+	}
+
+protected:
+	struct BandResult
+	{
+		BandResult() : adler(0), uncompressedSize(0), success(false)
+		{
+		}
+
+		std::vector<unsigned char>	compressedData;
+		uLong						adler;
+		size_t						uncompressedSize;
+		bool						success;
+	};
+
+	void quantiseRow(unsigned int y, unsigned char* pDst) const
+	{
+		const Colour4f* pRow = m_image.colourRowPtr(y);
+
+		if (m_save16Bit)
+		{
+			ImageQuantiser::quantiseRowSRGB16BE(pRow, m_image.getWidth(), m_alpha, (uint16_t*)pDst);
+		}
+		else
+		{
+			ImageQuantiser::quantiseRowSRGB8(pRow, m_image.getWidth(), y, m_alpha, m_dither, pDst);
+		}
+	}
+
+	// writes the filter type byte followed by the filtered row to pDst
+	void filterRow(const unsigned char* pRow, const unsigned char* pPrevRow, unsigned char* pCandidate, unsigned char* pDst) const
+	{
+		const size_t bpp = m_bytesPerPixel;
+
+		// None
+		unsigned char bestFilter = 0;
+		size_t bestSum = 0;
+		for (size_t i = 0; i < m_rowBytes; i++)
+		{
+			bestSum += std::abs((int)(signed char)pRow[i]);
+		}
+		memcpy(pDst + 1, pRow, m_rowBytes);
+
+		for (unsigned char filter = 1; filter <= 4; filter++)
+		{
+			size_t sum = 0;
+			for (size_t i = 0; i < m_rowBytes; i++)
+			{
+				int left = (i >= bpp) ? pRow[i - bpp] : 0;
+				int up = pPrevRow[i];
+				int upLeft = (i >= bpp) ? pPrevRow[i - bpp] : 0;
+
+				unsigned char predicted;
+				switch (filter)
+				{
+					case 1:
+						predicted = (unsigned char)left;
+						break;
+					case 2:
+						predicted = (unsigned char)up;
+						break;
+					case 3:
+						predicted = (unsigned char)((left + up) >> 1);
+						break;
+					default:
+						predicted = paethPredictor(left, up, upLeft);
+						break;
+				}
+
+				unsigned char value = pRow[i] - predicted;
+				pCandidate[i] = value;
+				sum += std::abs((int)(signed char)value);
+			}
+
+			if (sum < bestSum)
+			{
+				bestSum = sum;
+				bestFilter = filter;
+				memcpy(pDst + 1, pCandidate, m_rowBytes);
+			}
+		}
+
+		pDst[0] = bestFilter;
+	}
+
+	virtual void processBand(unsigned int bandIndex)
+	{
+		BandResult& result = m_aBandResults[bandIndex];
+
+		unsigned int height = m_image.getHeight();
+		unsigned int startRow = bandIndex * m_bandRows;
+		unsigned int endRow = std::min(startRow + m_bandRows, height);
+
+		std::vector<unsigned char> prevRow(m_rowBytes, 0);
+		std::vector<unsigned char> currentRow(m_rowBytes);
+		std::vector<unsigned char> candidateRow(m_rowBytes);
+
+		if (startRow > 0)
+		{
+			quantiseRow(startRow - 1, prevRow.data());
+		}
+
+		const size_t filteredRowBytes = m_rowBytes + 1;
+		std::vector<unsigned char> filteredData(filteredRowBytes * (endRow - startRow));
+
+		unsigned char* pFiltered = filteredData.data();
+		for (unsigned int y = startRow; y < endRow; y++)
+		{
+			quantiseRow(y, currentRow.data());
+			filterRow(currentRow.data(), prevRow.data(), candidateRow.data(), pFiltered);
+
+			pFiltered += filteredRowBytes;
+			prevRow.swap(currentRow);
+		}
+
+		result.uncompressedSize = filteredData.size();
+		result.adler = adler32(adler32(0L, Z_NULL, 0), filteredData.data(), (uInt)filteredData.size());
+
+		z_stream stream;
+		memset(&stream, 0, sizeof(z_stream));
+
+		// raw deflate, same settings libpng uses by default
+		if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_FILTERED) != Z_OK)
+			return;
+
+		// the first band needs the zlib header
+		size_t headerSize = (bandIndex == 0) ? 2 : 0;
+
+		std::vector<unsigned char>& output = result.compressedData;
+		output.resize(headerSize + deflateBound(&stream, filteredData.size()) + 64);
+
+		if (bandIndex == 0)
+		{
+			output[0] = 0x78;
+			output[1] = 0x9C;
+		}
+
+		bool lastBand = (bandIndex == m_numBands - 1);
+		int flushType = lastBand ? Z_FINISH : Z_SYNC_FLUSH;
+
+		stream.next_in = filteredData.data();
+		stream.avail_in = (uInt)filteredData.size();
+		stream.next_out = output.data() + headerSize;
+		stream.avail_out = (uInt)(output.size() - headerSize);
+
+		while (true)
+		{
+			int ret = deflate(&stream, flushType);
+			if (ret == Z_STREAM_ERROR)
+			{
+				deflateEnd(&stream);
+				return;
+			}
+
+			if (lastBand ? (ret == Z_STREAM_END) : (stream.avail_in == 0 && stream.avail_out != 0))
+				break;
+
+			if (stream.avail_out == 0)
+			{
+				size_t used = output.size();
+				output.resize(used * 2);
+				stream.next_out = output.data() + used;
+				stream.avail_out = (uInt)(output.size() - used);
+			}
+		}
+
+		output.resize(headerSize + stream.total_out);
+
+		deflateEnd(&stream);
+
+		result.success = true;
+	}
+
+protected:
+	const OutputImage&		m_image;
+	bool					m_alpha;
+	bool					m_save16Bit;
+	bool					m_dither;
+
+	unsigned int			m_bandRows;
+	unsigned int			m_numBands;
+
+	unsigned int			m_bytesPerPixel;
+	size_t					m_rowBytes;
+
+	std::vector<BandResult>	m_aBandResults;
+};
+
 ImageWriterPNG::ImageWriterPNG() : ImageWriter()
 {
 }
@@ -48,18 +309,40 @@ bool ImageWriterPNG::writeImage(const std::string& filePath, const OutputImage&
 	
 	// be very cheeky and assume we want to write 16-bit PNGs if full float precision was requested.
 	bool save16Bit = (flags & ImageWriter::FLOAT32);
+	bool saveAlpha = (channels & ImageWriter::ALPHA);
+	bool dither = !save16Bit && !(flags & ImageWriter::NO_DITHER);
 
-	png_byte colourType = (channels & ImageWriter::ALPHA) ? PNG_COLOR_TYPE_RGBA : PNG_COLOR_TYPE_RGB;
+	png_byte colourType = saveAlpha ? PNG_COLOR_TYPE_RGBA : PNG_COLOR_TYPE_RGB;
 	png_byte bitDepth = save16Bit ? 16 : 8;
 
+	// if the image's big enough, do the quantisation and compression in parallel bands first
+	unsigned int bandRows = height;
+	unsigned int numBands = ImageWriterBandPool::calculateBands(height, kMinPNGBandRows, 1, bandRows);
+
+	PNGBandEncoder* pBandEncoder = nullptr;
+	if (numBands > 1)
+	{
+		pBandEncoder = new PNGBandEncoder(image, saveAlpha, save16Bit, dither, bandRows, numBands);
+		if (!pBandEncoder->encode())
+		{
+			delete pBandEncoder;
+			GlobalContext::instance().getLogger().error("Error compressing PNG image data for file: %s", filePath.c_str());
+			return false;
+		}
+	}
+
 	pPNG = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
 	if (!pPNG)
+	{
+		delete pBandEncoder;
 		return false;
+	}
 
 	pInfo = png_create_info_struct(pPNG);
 	if (!pInfo)
 	{
 		png_destroy_write_struct(&pPNG, nullptr);
+		delete pBandEncoder;
 		return false;
 	}
 
@@ -69,21 +352,29 @@ bool ImageWriterPNG::writeImage(const std::string& filePath, const OutputImage&
 	if (!pFile)
 	{
 		png_destroy_write_struct(&pPNG, &pInfo);
+		delete pBandEncoder;
 		GlobalContext::instance().getLogger().error("Error writing PNG file: %s", filePath.c_str());
 		return false;
 	}
 
-	png_byte** pRows = new png_byte*[height * sizeof(png_byte*)];
-	if (!pRows)
+	png_byte** pRows = nullptr;
+	if (!pBandEncoder)
 	{
-		png_destroy_write_struct(&pPNG, &pInfo);
-		fclose(pFile);
-		return false;
+		pRows = new png_byte*[height];
+		memset(pRows, 0, sizeof(png_byte*) * height);
 	}
 
 	if (setjmp(png_jmpbuf(pPNG)))
 	{
-		delete [] pRows;
+		if (pRows)
+		{
+			for (unsigned int y = 0; y < height; y++)
+			{
+				delete [] pRows[y];
+			}
+			delete [] pRows;
+		}
+		delete pBandEncoder;
 		png_destroy_write_struct(&pPNG, &pInfo);
 		fclose(pFile);
 		return false;
@@ -95,126 +386,53 @@ bool ImageWriterPNG::writeImage(const std::string& filePath, const OutputImage&
 				 PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
 
 	png_write_info(pPNG, pInfo);
-	
-	size_t pixelBytes = save16Bit ? 2 : 1;
-	size_t byteCount = width * pixelBytes;
-	
-	if (channels & ImageWriter::ALPHA)
+
+	if (pBandEncoder)
 	{
-		for (unsigned int y = 0; y < height; y++)
+		// the bands already form a complete zlib stream, so just write them out as is
+		for (unsigned int i = 0; i < pBandEncoder->getNumBands(); i++)
 		{
-			uint8_t* row = new uint8_t[byteCount * 4];	
-			pRows[y] = row;
-			const Colour4f* pRow = image.colourRowPtr(y);
-			
-			if (save16Bit)
-			{
-				uint16_t* typedRow = (uint16_t*)row;
-				for (unsigned int x = 0; x < width; x++)
-				{
-					float r = ColourSpace::convertLinearToSRGBAccurate(pRow->r);
-					float g = ColourSpace::convertLinearToSRGBAccurate(pRow->g);
-					float b = ColourSpace::convertLinearToSRGBAccurate(pRow->b);
-	
-					uint16_t red = clamp(r) * 65535;
-					uint16_t green = clamp(g) * 65535;
-					uint16_t blue = clamp(b) * 65535;
-					uint16_t alpha = clamp(pRow->a) * 65535;
-	
-					// TODO: this reversing should only be done on marchs which need it...
-					*typedRow++ = reverseUInt16Bytes(red);
-					*typedRow++ = reverseUInt16Bytes(green);
-					*typedRow++ = reverseUInt16Bytes(blue);
-					*typedRow++ = reverseUInt16Bytes(alpha);
-	
-					pRow++;
-				}
-			}
-			else
-			{
-				for (unsigned int x = 0; x < width; x++)
-				{
-					float r = ColourSpace::convertLinearToSRGBAccurate(pRow->r);
-					float g = ColourSpace::convertLinearToSRGBAccurate(pRow->g);
-					float b = ColourSpace::convertLinearToSRGBAccurate(pRow->b);
-	
-					unsigned char red = clamp(r) * 255;
-					unsigned char green = clamp(g) * 255;
-					unsigned char blue = clamp(b) * 255;
-					unsigned char alpha = clamp(pRow->a) * 255;
-	
-					*row++ = red;
-					*row++ = green;
-					*row++ = blue;
-					*row++ = alpha;
-	
-					pRow++;
-				}
-			}
+			const std::vector<unsigned char>& bandData = pBandEncoder->getBandData(i);
+			png_write_chunk(pPNG, (png_const_bytep)"IDAT", bandData.data(), bandData.size());
 		}
+
+		// png_write_end() would complain that libpng didn't write any IDATs itself...
+		png_write_chunk(pPNG, (png_const_bytep)"IEND", nullptr, 0);
+
+		delete pBandEncoder;
 	}
 	else
 	{
+		size_t pixelBytes = save16Bit ? 2 : 1;
+		size_t byteCount = width * pixelBytes * (saveAlpha ? 4 : 3);
+
 		for (unsigned int y = 0; y < height; y++)
 		{
-			uint8_t* row = new uint8_t[byteCount * 3];	
+			uint8_t* row = new uint8_t[byteCount];
 			pRows[y] = row;
 			const Colour4f* pRow = image.colourRowPtr(y);
-			
+
 			if (save16Bit)
 			{
-				uint16_t* typedRow = (uint16_t*)row;
-				for (unsigned int x = 0; x < width; x++)
-				{
-					float r = ColourSpace::convertLinearToSRGBAccurate(pRow->r);
-					float g = ColourSpace::convertLinearToSRGBAccurate(pRow->g);
-					float b = ColourSpace::convertLinearToSRGBAccurate(pRow->b);
-	
-					uint16_t red = clamp(r) * 65535;
-					uint16_t green = clamp(g) * 65535;
-					uint16_t blue = clamp(b) * 65535;
-	
-					// TODO: this reversing should only be done on marchs which need it...
-					*typedRow++ = reverseUInt16Bytes(red);
-					*typedRow++ = reverseUInt16Bytes(green);
-					*typedRow++ = reverseUInt16Bytes(blue);
-	
-					pRow++;
-				}
+				ImageQuantiser::quantiseRowSRGB16BE(pRow, width, saveAlpha, (uint16_t*)row);
 			}
 			else
 			{
-				for (unsigned int x = 0; x < width; x++)
-				{
-					float r = ColourSpace::convertLinearToSRGBAccurate(pRow->r);
-					float g = ColourSpace::convertLinearToSRGBAccurate(pRow->g);
-					float b = ColourSpace::convertLinearToSRGBAccurate(pRow->b);
-	
-					unsigned char red = clamp(r) * 255;
-					unsigned char green = clamp(g) * 255;
-					unsigned char blue = clamp(b) * 255;
-	
-					*row++ = red;
-					*row++ = green;
-					*row++ = blue;
-	
-					pRow++;
-				}
+				ImageQuantiser::quantiseRowSRGB8(pRow, width, y, saveAlpha, dither, row);
 			}
 		}
-	}
-	
-	png_write_image(pPNG, pRows);
 
-	for (unsigned int y = 0; y < height; y++)
-	{
-		delete [] pRows[y];
-	}
-	delete [] pRows;
+		png_write_image(pPNG, pRows);
 
-	///
-	
-	png_write_end(pPNG, pInfo); // info ptr isn't really needed, but...
+		png_write_end(pPNG, pInfo); // info ptr isn't really needed, but...
+
+		// Note: this is done after png_write_end() so the setjmp() cleanup can't double-free rows
+		for (unsigned int y = 0; y < height; y++)
+		{
+			delete [] pRows[y];
+		}
+		delete [] pRows;
+	}
 
 	png_destroy_write_struct(&pPNG, &pInfo);
 
@@ -45,13 +45,17 @@ public:
 
 		DEEP =		1 << 6,
 
+		VARIANCE =		1 << 7,
+		SAMPLE_COUNT =	1 << 8,
+
 		RGBA = RGB | ALPHA,
-		ALL = RGB | ALPHA | DEPTH | NORMALS | WPP | SHADOWS
+		ALL = RGB | ALPHA | DEPTH | NORMALS | WPP | SHADOWS | VARIANCE | SAMPLE_COUNT
 	};
 
 	enum WriteFlags
 	{
-		FLOAT32		=	1 << 0
+		FLOAT32		=	1 << 0,
+		NO_DITHER	=	1 << 1	// 8-bit LDR writers use ordered dithering by default
 	};
 
 	virtual bool writeImage(const std::string& filePath, const OutputImage& image, unsigned int channels, unsigned int flags) = 0;
@@ -22,9 +22,49 @@
 #include "image/output_image.h"
 #include "image/output_image_tile.h"
 
+#include "raytracer_common.h"
+
+#include "utils/variance_tracker.h"
+
 namespace Imagine
 {
 
+// the extra channels can't be filtered or averaged (depth discontinuities, IDs), so all accumulators just set them
+inline void setTilePixelExtraChannelsFromHit(const PrimaryHitChannels& primaryHit, unsigned int extraChannels,
+											 OutputImageTile* pOutputTile, unsigned int x, unsigned int y)
+{
+	if (extraChannels & COMPONENT_DEPTH)
+		pOutputTile->setDepthAt(x, y, primaryHit.depth);
+
+	if (extraChannels & COMPONENT_NORMAL)
+	{
+		Colour3f normal(primaryHit.shaderNormal.x, primaryHit.shaderNormal.y, primaryHit.shaderNormal.z);
+		pOutputTile->setNormalAt(x, y, normal);
+	}
+
+	if (extraChannels & COMPONENT_WPP)
+	{
+		Colour3f wpp(primaryHit.hitPoint.x, primaryHit.hitPoint.y, primaryHit.hitPoint.z);
+		pOutputTile->setWPPAt(x, y, wpp);
+	}
+
+	if (extraChannels & COMPONENT_ID)
+		pOutputTile->setIDAt(x, y, (float)primaryHit.objID);
+}
+
+// Adaptive sampling keeps a running estimate of the variance of each pixel's sample luminance, so that pixels (and tiles)
+// can stop being sampled once their relative error is low enough. The estimate and the number of samples taken can be
+// output as extra channels, to show where the samples went.
+inline void setTilePixelConvergenceChannelsFromVariance(const VarianceTracker& pixelVariance, unsigned int extraChannels,
+														OutputImageTile* pOutputTile, unsigned int x, unsigned int y)
+{
+	if (extraChannels & COMPONENT_VARIANCE)
+		pOutputTile->setVarianceAt(x, y, pixelVariance.getVariance());
+
+	if (extraChannels & COMPONENT_SAMPLE_COUNT)
+		pOutputTile->setSampleCountAt(x, y, (float)pixelVariance.getSampleCount());
+}
+
 class Colour4fStandard
 {
 public:
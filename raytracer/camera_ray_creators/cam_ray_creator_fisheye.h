@@ -19,12 +19,16 @@
 #ifndef CAM_RAY_CREATOR_FISHEYE_H
 #define CAM_RAY_CREATOR_FISHEYE_H
 
+#include <algorithm>
+
 #include "camera_ray_creator.h"
+#include "camera_ray_batch_creator.h"
+#include "cam_ray_directions.h"
 
 namespace Imagine
 {
 
-class CamRayCreatorFishEye : public CameraRayCreator
+class CamRayCreatorFishEye : public CameraRayCreator, public CameraRayBatchCreator
 {
 public:
 	virtual void init(const Params& params)
@@ -48,11 +52,8 @@ public:
 			return ray1;
 		}
 
-		const float phi = rad * m_fovRadians * 0.5f;
-		const float theta = atan2f(offsetY, offsetX);
-		const float sinPhi = sinf(phi);
-
-		Normal newDirection(sinPhi * cosf(theta), sinPhi * sinf(theta), -cosf(phi));
+		Normal newDirection;
+		calculateFishEyeDirection(offsetX, offsetY, rad, m_fovRadians * 0.5f, newDirection);
 
 		Ray ray1(Point(), newDirection, RAY_CAMERA);
 		ray1 = m_transform.transform(ray1);
@@ -93,11 +94,8 @@ public:
 			return ray1;
 		}
 
-		const float phi = rad * m_fovRadians * 0.5f;
-		const float theta = atan2f(offsetY, offsetX);
-		const float sinPhi = sinf(phi);
-
-		Normal newDirection(sinPhi * cosf(theta), sinPhi * sinf(theta), -cosf(phi));
+		Normal newDirection;
+		calculateFishEyeDirection(offsetX, offsetY, rad, m_fovRadians * 0.5f, newDirection);
 
 		Ray ray1(Point(), newDirection, RAY_CAMERA);
 		ray1 = m_transform.transform(ray1);
@@ -122,6 +120,70 @@ public:
 		return ray1;
 	}
 
+	// creates count rays (as createBasicCameraRay() would) for the raster positions pX / pY at once, generating
+	// the directions (and the x + 1 / y + 1 differential directions) 4 at a time with SIMD trig.
+	virtual void createBasicCameraRays(const float* pX, const float* pY, unsigned int count, Ray* pRays) const
+	{
+		const float halfFOVRadians = m_fovRadians * 0.5f;
+
+		float diffX[kCameraRayBatchSize];
+		float diffY[kCameraRayBatchSize];
+
+		Normal directions[kCameraRayBatchSize];
+		Normal diffXDirections[kCameraRayBatchSize];
+		Normal diffYDirections[kCameraRayBatchSize];
+		unsigned char valid[kCameraRayBatchSize];
+		unsigned char diffValid[kCameraRayBatchSize];
+
+		for (unsigned int start = 0; start < count; start += kCameraRayBatchSize)
+		{
+			const unsigned int batchCount = std::min(count - start, kCameraRayBatchSize);
+
+			calculateFishEyeDirections(pX + start, pY + start, batchCount, m_invWidth, m_invHeight, halfFOVRadians, directions, valid);
+
+			if (m_createDifferentials)
+			{
+				for (unsigned int i = 0; i < batchCount; i++)
+				{
+					diffX[i] = pX[start + i] + 1.0f;
+					diffY[i] = pY[start + i] + 1.0f;
+				}
+
+				// differentials are allowed to go outside the circle
+				calculateFishEyeDirections(diffX, pY + start, batchCount, m_invWidth, m_invHeight, halfFOVRadians, diffXDirections, diffValid);
+				calculateFishEyeDirections(pX + start, diffY, batchCount, m_invWidth, m_invHeight, halfFOVRadians, diffYDirections, diffValid);
+			}
+
+			for (unsigned int i = 0; i < batchCount; i++)
+			{
+				Ray& ray1 = pRays[start + i];
+
+				if (!valid[i])
+				{
+					// can't sample this direction
+					ray1 = Ray(Point(), Normal(0.0f, 0.0f, 0.0f), RAY_UNDEFINED);
+					continue;
+				}
+
+				ray1 = Ray(Point(), directions[i], RAY_CAMERA);
+				ray1 = m_transform.transform(ray1);
+				ray1.direction.normalise();
+
+				ray1.tMin = m_nearClippingPlane;
+
+				if (m_createDifferentials)
+				{
+					Normal diffXDir = m_transform.transform(diffXDirections[i]);
+					diffXDir.normalise();
+					Normal diffYDir = m_transform.transform(diffYDirections[i]);
+					diffYDir.normalise();
+
+					ray1.setRayDifferentials(ray1.startPosition, ray1.startPosition, diffXDir, diffYDir);
+				}
+			}
+		}
+	}
+
 protected:
 	void calculateDifferentials(float x, float y, float offsetX, float offsetY, Normal& diffXDir, Normal& diffYDir) const
 	{
@@ -133,15 +195,8 @@ protected:
 		float diffYRad = (offsetX * offsetX) + (diffYOffset * diffYOffset);
 		diffYRad = sqrtf(diffYRad);
 
-		const float diffXPhi = diffXRad * m_fovRadians * 0.5f;
-		const float diffYPhi = diffYRad * m_fovRadians * 0.5f;
-		const float diffXTheta = atan2f(offsetY, diffXOffset);
-		const float diffYTheta = atan2f(diffYOffset, offsetX);
-		const float diffXSinPhi = sinf(diffXPhi);
-		const float diffYSinPhi = sinf(diffYPhi);
-
-		diffXDir = Normal(diffXSinPhi * cosf(diffXTheta), diffXSinPhi * sinf(diffXTheta), -cosf(diffXPhi));
-		diffYDir = Normal(diffYSinPhi * cosf(diffYTheta), diffYSinPhi * sinf(diffYTheta), -cosf(diffYPhi));
+		calculateFishEyeDirection(diffXOffset, offsetY, diffXRad, m_fovRadians * 0.5f, diffXDir);
+		calculateFishEyeDirection(offsetX, diffYOffset, diffYRad, m_fovRadians * 0.5f, diffYDir);
 	}
 
 protected:
@@ -168,11 +223,8 @@ public:
 			return ray1;
 		}
 
-		const float phi = rad * m_fovRadians * 0.5f;
-		const float theta = atan2f(offsetY, offsetX);
-		const float sinPhi = sinf(phi);
-
-		Normal newDirection(sinPhi * cosf(theta), sinPhi * sinf(theta), -cosf(phi));
+		Normal newDirection;
+		calculateFishEyeDirection(offsetX, offsetY, rad, m_fovRadians * 0.5f, newDirection);
 
 		float time = sampleBundle.getTimeSample(sampleIndex);
 		float timeFull = time;
@@ -225,11 +277,8 @@ public:
 			return ray1;
 		}
 
-		const float phi = rad * m_fovRadians * 0.5f;
-		const float theta = atan2f(offsetY, offsetX);
-		const float sinPhi = sinf(phi);
-
-		Normal newDirection(sinPhi * cosf(theta), sinPhi * sinf(theta), -cosf(phi));
+		Normal newDirection;
+		calculateFishEyeDirection(offsetX, offsetY, rad, m_fovRadians * 0.5f, newDirection);
 
 		float time = sampleBundle.getTimeSample(sampleIndex);
 		float timeFull = time;
@@ -19,25 +19,38 @@
 #ifndef CAM_RAY_CREATOR_SPHERICAL_H
 #define CAM_RAY_CREATOR_SPHERICAL_H
 
+#include <algorithm>
+
 #include "camera_ray_creator.h"
+#include "camera_ray_batch_creator.h"
+#include "cam_ray_directions.h"
+
+#include "utils/params.h"
 
 namespace Imagine
 {
 
-class CamRayCreatorSpherical : public CameraRayCreator
+class CamRayCreatorSpherical : public CameraRayCreator, public CameraRayBatchCreator
 {
 public:
-	virtual Ray createBasicCameraRay(float x, float y) const
+	virtual void init(const Params& params)
 	{
-		const float theta = kPI * y * m_invHeight;
-		const float phi = kPITimes2 * (m_width - x) * m_invWidth;
+		// the table's sub-pixel perturbation relies on the per-pixel angles being small, which isn't the case
+		// for tiny images, but they're not worth optimising anyway.
+		static const ParamKey kCameraDirectionTableKey("cameraDirectionTable");
 
-		const float sinTheta = sinf(theta);
-		const float sinPhi = sinf(phi);
-		const float cosPhi = cosf(phi);
-		const float cosTheta = cosf(theta);
+		if (params.getBool(kCameraDirectionTableKey, true) && m_width >= 64 && m_height >= 64)
+		{
+			m_directionTable.build((unsigned int)m_width, (unsigned int)m_height);
+		}
+	}
 
-		Normal newDirection(sinTheta * sinPhi, cosTheta, sinTheta * cosPhi);
+	virtual Ray createBasicCameraRay(float x, float y) const
+	{
+		Normal newDirection;
+		Normal diffXDirection;
+		Normal diffYDirection;
+		calculateDirections(x, y, newDirection, diffXDirection, diffYDirection);
 
 		Ray ray1(Point(), newDirection, RAY_CAMERA);
 		ray1 = m_transform.transform(ray1);
@@ -47,14 +60,6 @@ public:
 
 		if (m_createDifferentials)
 		{
-			float diffTheta = kPI * (y + 1.0f) * m_invHeight;
-			float diffPhi = kPITimes2 * (m_width - (x + 1)) * m_invWidth;
-
-			float diffSinTheta = sinf(diffTheta);
-
-			Normal diffXDirection(sinTheta * sinf(diffPhi), cosTheta, sinTheta * cosf(diffPhi));
-			Normal diffYDirection(diffSinTheta * sinPhi, cosf(diffTheta), diffSinTheta * cosPhi);
-
 			diffXDirection = m_transform.transform(diffXDirection);
 			diffXDirection.normalise();
 
@@ -69,15 +74,10 @@ public:
 
 	virtual Ray createCameraRay(float x, float y, SampleBundle& sampleBundle, unsigned int sampleIndex) const
 	{
-		const float theta = kPI * y * m_invHeight;
-		const float phi = kPITimes2 * (m_width - x) * m_invWidth;
-
-		const float sinTheta = sinf(theta);
-		const float sinPhi = sinf(phi);
-		const float cosPhi = cosf(phi);
-		const float cosTheta = cosf(theta);
-
-		Normal newDirection(sinTheta * sinPhi, cosTheta, sinTheta * cosPhi);
+		Normal newDirection;
+		Normal diffXDirection;
+		Normal diffYDirection;
+		calculateDirections(x, y, newDirection, diffXDirection, diffYDirection);
 
 		Ray ray1(Point(), newDirection, RAY_CAMERA);
 		ray1 = m_transform.transform(ray1);
@@ -87,14 +87,6 @@ public:
 
 		if (m_createDifferentials)
 		{
-			float diffTheta = kPI * (y + 1.0f) * m_invHeight;
-			float diffPhi = kPITimes2 * (m_width - (x + 1)) * m_invWidth;
-
-			float diffSinTheta = sinf(diffTheta);
-
-			Normal diffXDirection(sinTheta * sinf(diffPhi), cosTheta, sinTheta * cosf(diffPhi));
-			Normal diffYDirection(diffSinTheta * sinPhi, cosf(diffTheta), diffSinTheta * cosPhi);
-
 			diffXDirection = m_transform.transform(diffXDirection);
 			diffXDirection.normalise();
 
@@ -106,14 +98,64 @@ public:
 
 		return ray1;
 	}
-};
 
-// Camera static, but varying time per-ray
-class CamRayCreatorSphericalMB : public CamRayCreatorSpherical
-{
-public:
-	virtual Ray createCameraRay(float x, float y, SampleBundle& sampleBundle, unsigned int sampleIndex) const
+	// creates count rays (as createBasicCameraRay() would) for the raster positions pX / pY at once, generating
+	// the directions 4 at a time with SIMD trig.
+	virtual void createBasicCameraRays(const float* pX, const float* pY, unsigned int count, Ray* pRays) const
 	{
+		Normal directions[kCameraRayBatchSize];
+		Normal diffXDirections[kCameraRayBatchSize];
+		Normal diffYDirections[kCameraRayBatchSize];
+
+		for (unsigned int start = 0; start < count; start += kCameraRayBatchSize)
+		{
+			const unsigned int batchCount = std::min(count - start, kCameraRayBatchSize);
+
+			calculateSphericalDirections(pX + start, pY + start, batchCount, m_width, m_invWidth, m_invHeight, directions,
+										 m_createDifferentials ? diffXDirections : nullptr, m_createDifferentials ? diffYDirections : nullptr);
+
+			for (unsigned int i = 0; i < batchCount; i++)
+			{
+				Ray& ray1 = pRays[start + i];
+
+				ray1 = Ray(Point(), directions[i], RAY_CAMERA);
+				ray1 = m_transform.transform(ray1);
+				ray1.direction.normalise();
+
+				ray1.tMin = m_nearClippingPlane;
+
+				if (m_createDifferentials)
+				{
+					Normal diffXDirection = m_transform.transform(diffXDirections[i]);
+					diffXDirection.normalise();
+
+					Normal diffYDirection = m_transform.transform(diffYDirections[i]);
+					diffYDirection.normalise();
+
+					ray1.setRayDifferentials(ray1.startPosition, ray1.startPosition, diffXDirection, diffYDirection);
+				}
+			}
+		}
+	}
+
+protected:
+	// camera-space direction for the raster position, and the x + 1 / y + 1 directions if differentials are enabled
+	void calculateDirections(float x, float y, Normal& direction, Normal& diffXDirection, Normal& diffYDirection) const
+	{
+		if (m_directionTable.isBuilt() && m_directionTable.isWithinTable(x, y))
+		{
+			if (m_createDifferentials)
+			{
+				m_directionTable.getDirectionWithDifferentials(x, y, direction, diffXDirection, diffYDirection);
+			}
+			else
+			{
+				m_directionTable.getDirection(x, y, direction);
+			}
+			return;
+		}
+
+		// no table, or outside the image (pixel filter widths can put samples there), so calculate it directly
 		const float theta = kPI * y * m_invHeight;
 		const float phi = kPITimes2 * (m_width - x) * m_invWidth;
 
@@ -122,7 +164,34 @@ public:
 		const float cosPhi = cosf(phi);
 		const float cosTheta = cosf(theta);
 
-		Normal newDirection(sinTheta * sinPhi, cosTheta, sinTheta * cosPhi);
+		direction = Normal(sinTheta * sinPhi, cosTheta, sinTheta * cosPhi);
+
+		if (m_createDifferentials)
+		{
+			float diffTheta = kPI * (y + 1.0f) * m_invHeight;
+			float diffPhi = kPITimes2 * (m_width - (x + 1)) * m_invWidth;
+
+			float diffSinTheta = sinf(diffTheta);
+
+			diffXDirection = Normal(sinTheta * sinf(diffPhi), cosTheta, sinTheta * cosf(diffPhi));
+			diffYDirection = Normal(diffSinTheta * sinPhi, cosf(diffTheta), diffSinTheta * cosPhi);
+		}
+	}
+
+protected:
+	SphericalDirectionTable		m_directionTable;
+};
+
+// Camera static, but varying time per-ray
+class CamRayCreatorSphericalMB : public CamRayCreatorSpherical
+{
+public:
+	virtual Ray createCameraRay(float x, float y, SampleBundle& sampleBundle, unsigned int sampleIndex) const
+	{
+		Normal newDirection;
+		Normal diffXDirection;
+		Normal diffYDirection;
+		calculateDirections(x, y, newDirection, diffXDirection, diffYDirection);
 
 		float time = sampleBundle.getTimeSample(sampleIndex);
 		float timeFull = time;
@@ -139,14 +208,6 @@ public:
 
 		if (m_createDifferentials)
 		{
-			float diffTheta = kPI * (y + 1.0f) * m_invHeight;
-			float diffPhi = kPITimes2 * (m_width - (x + 1)) * m_invWidth;
-
-			float diffSinTheta = sinf(diffTheta);
-
-			Normal diffXDirection(sinTheta * sinf(diffPhi), cosTheta, sinTheta * cosf(diffPhi));
-			Normal diffYDirection(diffSinTheta * sinPhi, cosf(diffTheta), diffSinTheta * cosPhi);
-
 			diffXDirection = m_transform.transform(diffXDirection);
 			diffXDirection.normalise();
 
@@ -166,15 +227,10 @@ class CamRayCreatorSphericalMBFull : public CamRayCreatorSpherical
 public:
 	virtual Ray createCameraRay(float x, float y, SampleBundle& sampleBundle, unsigned int sampleIndex) const
 	{
-		const float theta = kPI * y * m_invHeight;
-		const float phi = kPITimes2 * (m_width - x) * m_invWidth;
-
-		const float sinTheta = sinf(theta);
-		const float sinPhi = sinf(phi);
-		const float cosPhi = cosf(phi);
-		const float cosTheta = cosf(theta);
-
-		Normal newDirection(sinTheta * sinPhi, cosTheta, sinTheta * cosPhi);
+		Normal newDirection;
+		Normal diffXDirection;
+		Normal diffYDirection;
+		calculateDirections(x, y, newDirection, diffXDirection, diffYDirection);
 
 		float time = sampleBundle.getTimeSample(sampleIndex);
 		float timeFull = time;
@@ -195,14 +251,6 @@ public:
 
 		if (m_createDifferentials)
 		{
-			float diffTheta = kPI * (y + 1.0f) * m_invHeight;
-			float diffPhi = kPITimes2 * (m_width - (x + 1)) * m_invWidth;
-
-			float diffSinTheta = sinf(diffTheta);
-
-			Normal diffXDirection(sinTheta * sinf(diffPhi), cosTheta, sinTheta * cosf(diffPhi));
-			Normal diffYDirection(diffSinTheta * sinPhi, cosf(diffTheta), diffSinTheta * cosPhi);
-
 			diffXDirection = ssT.m_transform.transform(diffXDirection);
 			diffXDirection.normalise();
 
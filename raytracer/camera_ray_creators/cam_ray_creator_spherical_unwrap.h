@@ -19,12 +19,16 @@
 #ifndef CAM_RAY_CREATOR_SPHERICAL_UNWRAP_H
 #define CAM_RAY_CREATOR_SPHERICAL_UNWRAP_H
 
+#include <algorithm>
+
 #include "camera_ray_creator.h"
+#include "camera_ray_batch_creator.h"
+#include "cam_ray_directions.h"
 
 namespace Imagine
 {
 
-class CamRayCreatorSphericalUnwrap : public CameraRayCreator
+class CamRayCreatorSphericalUnwrap : public CameraRayCreator, public CameraRayBatchCreator
 {
 public:
 	CamRayCreatorSphericalUnwrap() : CameraRayCreator(),
@@ -40,29 +44,39 @@ public:
 
 	virtual Ray createBasicCameraRay(float x, float y) const
 	{
-		const float theta = kPI * y * m_invHeight;
-		const float phi = kPITimes2 * (m_width - x) * m_invWidth;
+		Normal newDirection;
+		calculateSphericalDirections(&x, &y, 1, m_width, m_invWidth, m_invHeight, &newDirection, nullptr, nullptr);
 
-		const float sinTheta = sinf(theta);
-		const float sinPhi = sinf(phi);
-		const float cosPhi = cosf(phi);
-		const float cosTheta = cosf(theta);
+		Ray ray1 = createRayFromDirection(newDirection);
+/*
+		if (m_createDifferentials)
+		{
+			float diffTheta = kPI * (y + 1.0f) * m_invHeight;
+			float diffPhi = kPITimes2 * (m_width - (x + 1)) * m_invWidth;
 
-		Normal newDirection(sinTheta * sinPhi, cosTheta, sinTheta * cosPhi);
-//		newDirection = m_transform.transform(newDirection);
+			float diffSinTheta = sinf(diffTheta);
 
-		Point position = (Point)newDirection;
-		position *= m_distanceFromOrigin;
+			Normal diffXDirection(sinTheta * sinf(diffPhi), cosTheta, sinTheta * cosf(diffPhi));
+			Normal diffYDirection(diffSinTheta * sinPhi, cosf(diffTheta), diffSinTheta * cosPhi);
 
-		Point targetPoint(0.0f, 0.0f, 0.0f);
+			diffXDirection = m_transform.transform(diffXDirection);
+			diffXDirection.normalise();
 
-//		position = m_transform.transform(position);
-//		targetPoint = m_transform.transform(targetPoint);
+			diffYDirection = m_transform.transform(diffYDirection);
+			diffYDirection.normalise();
 
-		newDirection = (Normal)(targetPoint - position);
+			ray1.setRayDifferentials(ray1.startPosition, ray1.startPosition, diffXDirection, diffYDirection);
+		}
+*/
+		return ray1;
+	}
 
-		Ray ray1(position, newDirection, RAY_CAMERA);
-		ray1.direction.normalise();
+	virtual Ray createCameraRay(float x, float y, SampleBundle& sampleBundle, unsigned int sampleIndex) const
+	{
+		Normal newDirection;
+		calculateSphericalDirections(&x, &y, 1, m_width, m_invWidth, m_invHeight, &newDirection, nullptr, nullptr);
+
+		Ray ray1 = createRayFromDirection(newDirection);
 /*
 		if (m_createDifferentials)
 		{
@@ -86,17 +100,30 @@ public:
 		return ray1;
 	}
 
-	virtual Ray createCameraRay(float x, float y, SampleBundle& sampleBundle, unsigned int sampleIndex) const
+	// creates count rays (as createBasicCameraRay() would) for the raster positions pX / pY at once, generating
+	// the directions 4 at a time with SIMD trig.
+	virtual void createBasicCameraRays(const float* pX, const float* pY, unsigned int count, Ray* pRays) const
 	{
-		const float theta = kPI * y * m_invHeight;
-		const float phi = kPITimes2 * (m_width - x) * m_invWidth;
+		Normal directions[kCameraRayBatchSize];
+
+		for (unsigned int start = 0; start < count; start += kCameraRayBatchSize)
+		{
+			const unsigned int batchCount = std::min(count - start, kCameraRayBatchSize);
 
-		const float sinTheta = sinf(theta);
-		const float sinPhi = sinf(phi);
-		const float cosPhi = cosf(phi);
-		const float cosTheta = cosf(theta);
+			calculateSphericalDirections(pX + start, pY + start, batchCount, m_width, m_invWidth, m_invHeight, directions, nullptr, nullptr);
+
+			for (unsigned int i = 0; i < batchCount; i++)
+			{
+				pRays[start + i] = createRayFromDirection(directions[i]);
+			}
+		}
+	}
 
-		Normal newDirection(sinTheta * sinPhi, cosTheta, sinTheta * cosPhi);
+protected:
+	// rays start on the sphere and point in towards the origin
+	Ray createRayFromDirection(const Normal& sphereDirection) const
+	{
+		Normal newDirection = sphereDirection;
 //		newDirection = m_transform.transform(newDirection);
 
 		Point position = (Point)newDirection;
@@ -111,26 +138,7 @@ public:
 
 		Ray ray1(position, newDirection, RAY_CAMERA);
 		ray1.direction.normalise();
-/*
-		if (m_createDifferentials)
-		{
-			float diffTheta = kPI * (y + 1.0f) * m_invHeight;
-			float diffPhi = kPITimes2 * (m_width - (x + 1)) * m_invWidth;
 
-			float diffSinTheta = sinf(diffTheta);
-
-			Normal diffXDirection(sinTheta * sinf(diffPhi), cosTheta, sinTheta * cosf(diffPhi));
-			Normal diffYDirection(diffSinTheta * sinPhi, cosf(diffTheta), diffSinTheta * cosPhi);
-
-			diffXDirection = m_transform.transform(diffXDirection);
-			diffXDirection.normalise();
-
-			diffYDirection = m_transform.transform(diffYDirection);
-			diffYDirection.normalise();
-
-			ray1.setRayDifferentials(ray1.startPosition, ray1.startPosition, diffXDirection, diffYDirection);
-		}
-*/
 		return ray1;
 	}
 
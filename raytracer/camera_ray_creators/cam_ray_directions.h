@@ -0,0 +1,408 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#ifndef CAM_RAY_DIRECTIONS_H
+#define CAM_RAY_DIRECTIONS_H
+
+#include <cmath>
+#include <vector>
+
+#include "core/normal.h"
+
+#include "utils/maths/maths.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#define USE_SSE_CAMERA_DIRECTIONS 1
+#else
+#define USE_SSE_CAMERA_DIRECTIONS 0
+#endif
+
+namespace Imagine
+{
+
+// Helpers for generating the camera-space directions of the non-planar (spherical / fisheye) camera projections
+// without per-ray calls to libm's trig functions: batches of directions are generated 4 at a time using polynomial
+// sin / cos approximations, and single rays can use a table of pixel-centre angles with the sub-pixel offset applied
+// as a small rotation.
+
+#if USE_SSE_CAMERA_DIRECTIONS
+
+// sin and cos of 4 angles at once, using the Cephes sinf() / cosf() range reduction and minimax polynomials.
+// Accurate to within a couple of float ULPs for |angle| < 8192.
+inline static void sinCosSSE(__m128 angle, __m128& sinOut, __m128& cosOut)
+{
+	const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+
+	__m128 signSin = _mm_and_ps(angle, signMask);
+	__m128 x = _mm_andnot_ps(signMask, angle);
+
+	// octant the angle is in, rounded up to an even number
+	__m128i octant = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(1.27323954473516f))); // 4 / pi
+	octant = _mm_and_si128(_mm_add_epi32(octant, _mm_set1_epi32(1)), _mm_set1_epi32(~1));
+	__m128 y = _mm_cvtepi32_ps(octant);
+
+	// octants 2, 3 (modulo 4) use the opposite polynomial, and octants 4 onwards (modulo 8) flip the sign
+	__m128 swapPolys = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(octant, _mm_set1_epi32(2)), _mm_setzero_si128()));
+	signSin = _mm_xor_ps(signSin, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(octant, _mm_set1_epi32(4)), 29)));
+	__m128 signCos = _mm_castsi128_ps(_mm_slli_epi32(_mm_andnot_si128(_mm_sub_epi32(octant, _mm_set1_epi32(2)), _mm_set1_epi32(4)), 29));
+
+	// extended precision modular arithmetic: x - y * pi / 4
+	x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(0.78515625f)));
+	x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(2.4187564849853515625e-4f)));
+	x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(3.77489497744594108e-8f)));
+
+	__m128 z = _mm_mul_ps(x, x);
+
+	__m128 cosPoly = _mm_set1_ps(2.443315711809948e-5f);
+	cosPoly = _mm_add_ps(_mm_mul_ps(cosPoly, z), _mm_set1_ps(-1.388731625493765e-3f));
+	cosPoly = _mm_add_ps(_mm_mul_ps(cosPoly, z), _mm_set1_ps(4.166664568298827e-2f));
+	cosPoly = _mm_mul_ps(_mm_mul_ps(cosPoly, z), z);
+	cosPoly = _mm_sub_ps(cosPoly, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+	cosPoly = _mm_add_ps(cosPoly, _mm_set1_ps(1.0f));
+
+	__m128 sinPoly = _mm_set1_ps(-1.9515295891e-4f);
+	sinPoly = _mm_add_ps(_mm_mul_ps(sinPoly, z), _mm_set1_ps(8.3321608736e-3f));
+	sinPoly = _mm_add_ps(_mm_mul_ps(sinPoly, z), _mm_set1_ps(-1.6666654611e-1f));
+	sinPoly = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sinPoly, z), x), x);
+
+	__m128 sinValue = _mm_or_ps(_mm_and_ps(swapPolys, sinPoly), _mm_andnot_ps(swapPolys, cosPoly));
+	__m128 cosValue = _mm_or_ps(_mm_and_ps(swapPolys, cosPoly), _mm_andnot_ps(swapPolys, sinPoly));
+
+	sinOut = _mm_xor_ps(sinValue, signSin);
+	cosOut = _mm_xor_ps(cosValue, signCos);
+}
+
+inline static void storeDirectionsSSE(__m128 dirX, __m128 dirY, __m128 dirZ, Normal* pDirections)
+{
+	float values[3][4];
+	_mm_storeu_ps(values[0], dirX);
+	_mm_storeu_ps(values[1], dirY);
+	_mm_storeu_ps(values[2], dirZ);
+
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		pDirections[i] = Normal(values[0][i], values[1][i], values[2][i]);
+	}
+}
+
+#endif
+
+// rotates the angle whose sin and cos are given by the angle whose sin and cos are given
+inline static void rotateSinCos(float sinA, float cosA, float sinB, float cosB, float& sinOut, float& cosOut)
+{
+	sinOut = sinA * cosB + cosA * sinB;
+	cosOut = cosA * cosB - sinA * sinB;
+}
+
+// rotates the angle whose sin and cos are given by a small delta angle (|delta| < ~0.1 radians) using Taylor series
+// for the sin and cos of the delta, which are accurate to float precision within that range.
+inline static void perturbSinCos(float sinA, float cosA, float delta, float& sinOut, float& cosOut)
+{
+	const float delta2 = delta * delta;
+	const float sinDelta = delta * (1.0f - delta2 * (1.0f / 6.0f) * (1.0f - delta2 * (1.0f / 20.0f)));
+	const float cosDelta = 1.0f - delta2 * 0.5f * (1.0f - delta2 * (1.0f / 12.0f));
+
+	rotateSinCos(sinA, cosA, sinDelta, cosDelta, sinOut, cosOut);
+}
+
+// number of rays the batched camera ray creation functions generate directions for at once
+static const unsigned int kCameraRayBatchSize = 16;
+
+// Spherical (lat-long) projection: theta = pi * y / height, phi = 2 * pi * (width - x) / width.
+// Generates count directions for raster positions pX / pY, and if pDiffXDirections and pDiffYDirections are
+// non-null, the directions for x + 1 and y + 1 as well, which are got by rotating by a constant one pixel step.
+inline static void calculateSphericalDirections(const float* pX, const float* pY, unsigned int count,
+												float width, float invWidth, float invHeight, Normal* pDirections,
+												Normal* pDiffXDirections, Normal* pDiffYDirections)
+{
+	const bool differentials = pDiffXDirections && pDiffYDirections;
+
+	float phiStepSin = 0.0f;
+	float phiStepCos = 1.0f;
+	float thetaStepSin = 0.0f;
+	float thetaStepCos = 1.0f;
+	if (differentials)
+	{
+		// phi goes backwards with x
+		phiStepSin = sinf(-kPITimes2 * invWidth);
+		phiStepCos = cosf(-kPITimes2 * invWidth);
+		thetaStepSin = sinf(kPI * invHeight);
+		thetaStepCos = cosf(kPI * invHeight);
+	}
+
+	unsigned int i = 0;
+
+#if USE_SSE_CAMERA_DIRECTIONS
+	const __m128 thetaScale = _mm_set1_ps(kPI * invHeight);
+	const __m128 phiScale = _mm_set1_ps(kPITimes2 * invWidth);
+	const __m128 widthValue = _mm_set1_ps(width);
+	const __m128 phiStepSinValue = _mm_set1_ps(phiStepSin);
+	const __m128 phiStepCosValue = _mm_set1_ps(phiStepCos);
+	const __m128 thetaStepSinValue = _mm_set1_ps(thetaStepSin);
+	const __m128 thetaStepCosValue = _mm_set1_ps(thetaStepCos);
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 theta = _mm_mul_ps(_mm_loadu_ps(pY + i), thetaScale);
+		__m128 phi = _mm_mul_ps(_mm_sub_ps(widthValue, _mm_loadu_ps(pX + i)), phiScale);
+
+		__m128 sinTheta;
+		__m128 cosTheta;
+		sinCosSSE(theta, sinTheta, cosTheta);
+
+		__m128 sinPhi;
+		__m128 cosPhi;
+		sinCosSSE(phi, sinPhi, cosPhi);
+
+		storeDirectionsSSE(_mm_mul_ps(sinTheta, sinPhi), cosTheta, _mm_mul_ps(sinTheta, cosPhi), pDirections + i);
+
+		if (differentials)
+		{
+			__m128 diffSinPhi = _mm_add_ps(_mm_mul_ps(sinPhi, phiStepCosValue), _mm_mul_ps(cosPhi, phiStepSinValue));
+			__m128 diffCosPhi = _mm_sub_ps(_mm_mul_ps(cosPhi, phiStepCosValue), _mm_mul_ps(sinPhi, phiStepSinValue));
+			__m128 diffSinTheta = _mm_add_ps(_mm_mul_ps(sinTheta, thetaStepCosValue), _mm_mul_ps(cosTheta, thetaStepSinValue));
+			__m128 diffCosTheta = _mm_sub_ps(_mm_mul_ps(cosTheta, thetaStepCosValue), _mm_mul_ps(sinTheta, thetaStepSinValue));
+
+			storeDirectionsSSE(_mm_mul_ps(sinTheta, diffSinPhi), cosTheta, _mm_mul_ps(sinTheta, diffCosPhi), pDiffXDirections + i);
+			storeDirectionsSSE(_mm_mul_ps(diffSinTheta, sinPhi), diffCosTheta, _mm_mul_ps(diffSinTheta, cosPhi), pDiffYDirections + i);
+		}
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		const float theta = kPI * pY[i] * invHeight;
+		const float phi = kPITimes2 * (width - pX[i]) * invWidth;
+
+		const float sinTheta = sinf(theta);
+		const float cosTheta = cosf(theta);
+		const float sinPhi = sinf(phi);
+		const float cosPhi = cosf(phi);
+
+		pDirections[i] = Normal(sinTheta * sinPhi, cosTheta, sinTheta * cosPhi);
+
+		if (differentials)
+		{
+			float diffSinPhi;
+			float diffCosPhi;
+			rotateSinCos(sinPhi, cosPhi, phiStepSin, phiStepCos, diffSinPhi, diffCosPhi);
+			float diffSinTheta;
+			float diffCosTheta;
+			rotateSinCos(sinTheta, cosTheta, thetaStepSin, thetaStepCos, diffSinTheta, diffCosTheta);
+
+			pDiffXDirections[i] = Normal(sinTheta * diffSinPhi, cosTheta, sinTheta * diffCosPhi);
+			pDiffYDirections[i] = Normal(diffSinTheta * sinPhi, diffCosTheta, diffSinTheta * cosPhi);
+		}
+	}
+}
+
+// Equidistant fisheye projection: the radius from the centre of the image maps linearly to the angle from the view
+// direction (up to fovRadians / 2 at the edge of the inscribed circle), and the angle around the view direction is
+// just that of the offset from the centre, so its sin and cos can be got from the normalised offset without atan2().
+inline static void calculateFishEyeDirection(float offsetX, float offsetY, float rad, float halfFOVRadians, Normal& direction)
+{
+	const float phi = rad * halfFOVRadians;
+	const float sinPhi = sinf(phi);
+
+	// sinPhi / rad is the scale for the (unnormalised) offset, and tends to halfFOVRadians at the centre
+	const float offsetScale = (rad > 0.0f) ? sinPhi / rad : halfFOVRadians;
+
+	direction = Normal(offsetX * offsetScale, offsetY * offsetScale, -cosf(phi));
+}
+
+// pValid is set to 0 for positions outside of the circle, for which the direction is undefined.
+inline static void calculateFishEyeDirections(const float* pX, const float* pY, unsigned int count,
+											  float invWidth, float invHeight, float halfFOVRadians,
+											  Normal* pDirections, unsigned char* pValid)
+{
+	unsigned int i = 0;
+
+#if USE_SSE_CAMERA_DIRECTIONS
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 two = _mm_set1_ps(2.0f);
+	const __m128 invWidthValue = _mm_set1_ps(invWidth);
+	const __m128 invHeightValue = _mm_set1_ps(invHeight);
+	const __m128 halfFOV = _mm_set1_ps(halfFOVRadians);
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 offsetX = _mm_sub_ps(_mm_mul_ps(_mm_mul_ps(invWidthValue, _mm_loadu_ps(pX + i)), two), one);
+		// need to invert Y
+		__m128 offsetY = _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(invHeightValue, _mm_loadu_ps(pY + i))), two), one);
+
+		__m128 rad = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(offsetX, offsetX), _mm_mul_ps(offsetY, offsetY)));
+
+		__m128 sinPhi;
+		__m128 cosPhi;
+		sinCosSSE(_mm_mul_ps(rad, halfFOV), sinPhi, cosPhi);
+
+		// avoid the divide by zero at the exact centre
+		__m128 centre = _mm_cmple_ps(rad, _mm_setzero_ps());
+		__m128 offsetScale = _mm_div_ps(sinPhi, _mm_or_ps(_mm_and_ps(centre, one), _mm_andnot_ps(centre, rad)));
+		offsetScale = _mm_or_ps(_mm_and_ps(centre, halfFOV), _mm_andnot_ps(centre, offsetScale));
+
+		storeDirectionsSSE(_mm_mul_ps(offsetX, offsetScale), _mm_mul_ps(offsetY, offsetScale),
+						   _mm_xor_ps(cosPhi, _mm_castsi128_ps(_mm_set1_epi32(0x80000000))), pDirections + i);
+
+		int validMask = _mm_movemask_ps(_mm_cmple_ps(rad, one));
+		pValid[i] = (validMask & 1) ? 1 : 0;
+		pValid[i + 1] = (validMask & 2) ? 1 : 0;
+		pValid[i + 2] = (validMask & 4) ? 1 : 0;
+		pValid[i + 3] = (validMask & 8) ? 1 : 0;
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		const float offsetX = ((invWidth * pX[i]) * 2.0f) - 1.0f;
+		const float offsetY = ((1.0f - (invHeight * pY[i])) * 2.0f) - 1.0f;
+
+		const float rad = sqrtf((offsetX * offsetX) + (offsetY * offsetY));
+
+		calculateFishEyeDirection(offsetX, offsetY, rad, halfFOVRadians, pDirections[i]);
+		pValid[i] = (rad <= 1.0f) ? 1 : 0;
+	}
+}
+
+// Per-frame table of the spherical projection's theta and phi sin / cos values at the pixel centres of each row and
+// column (the projection is separable, so this is only (width + height) entries, even for 8K x 8K renders).
+// Directions for sub-pixel positions are then got by rotating the pixel centre angles by the small offset, and
+// the x + 1 / y + 1 differential directions by rotating by a constant one pixel step, so no trig is needed per ray.
+class SphericalDirectionTable
+{
+public:
+	SphericalDirectionTable() : m_width(0), m_height(0), m_phiScale(0.0f), m_thetaScale(0.0f)
+	{
+	}
+
+	void build(unsigned int width, unsigned int height)
+	{
+		m_width = width;
+		m_height = height;
+
+		m_phiScale = kPITimes2 / (float)width;
+		m_thetaScale = kPI / (float)height;
+
+		m_aColumns.resize(width);
+		for (unsigned int i = 0; i < width; i++)
+		{
+			// phi goes backwards with x
+			const float phi = m_phiScale * ((float)width - ((float)i + 0.5f));
+			m_aColumns[i].sinValue = sinf(phi);
+			m_aColumns[i].cosValue = cosf(phi);
+		}
+
+		m_aRows.resize(height);
+		for (unsigned int i = 0; i < height; i++)
+		{
+			const float theta = m_thetaScale * ((float)i + 0.5f);
+			m_aRows[i].sinValue = sinf(theta);
+			m_aRows[i].cosValue = cosf(theta);
+		}
+
+		m_phiStep.sinValue = sinf(-m_phiScale);
+		m_phiStep.cosValue = cosf(-m_phiScale);
+		m_thetaStep.sinValue = sinf(m_thetaScale);
+		m_thetaStep.cosValue = cosf(m_thetaScale);
+	}
+
+	bool isBuilt() const
+	{
+		return !m_aColumns.empty();
+	}
+
+	// whether the raster position is one the table can be used for - pixel filters can place samples outside
+	// the image, which need to be calculated directly.
+	bool isWithinTable(float x, float y) const
+	{
+		return x >= 0.0f && y >= 0.0f && x < (float)m_width && y < (float)m_height;
+	}
+
+	// x and y must be within the table
+	void getDirection(float x, float y, Normal& direction) const
+	{
+		SinCos phi;
+		SinCos theta;
+		getAngles(x, y, phi, theta);
+
+		direction = Normal(theta.sinValue * phi.sinValue, theta.cosValue, theta.sinValue * phi.cosValue);
+	}
+
+	// x and y must be within the table
+	void getDirectionWithDifferentials(float x, float y, Normal& direction, Normal& diffXDirection, Normal& diffYDirection) const
+	{
+		SinCos phi;
+		SinCos theta;
+		getAngles(x, y, phi, theta);
+
+		direction = Normal(theta.sinValue * phi.sinValue, theta.cosValue, theta.sinValue * phi.cosValue);
+
+		SinCos diffPhi;
+		rotateSinCos(phi.sinValue, phi.cosValue, m_phiStep.sinValue, m_phiStep.cosValue, diffPhi.sinValue, diffPhi.cosValue);
+		SinCos diffTheta;
+		rotateSinCos(theta.sinValue, theta.cosValue, m_thetaStep.sinValue, m_thetaStep.cosValue, diffTheta.sinValue, diffTheta.cosValue);
+
+		diffXDirection = Normal(theta.sinValue * diffPhi.sinValue, theta.cosValue, theta.sinValue * diffPhi.cosValue);
+		diffYDirection = Normal(diffTheta.sinValue * phi.sinValue, diffTheta.cosValue, diffTheta.sinValue * phi.cosValue);
+	}
+
+	size_t getMemorySize() const
+	{
+		return sizeof(*this) + (m_aColumns.capacity() + m_aRows.capacity()) * sizeof(SinCos);
+	}
+
+protected:
+	struct SinCos
+	{
+		float	sinValue;
+		float	cosValue;
+	};
+
+	void getAngles(float x, float y, SinCos& phi, SinCos& theta) const
+	{
+		const unsigned int column = (unsigned int)x;
+		const unsigned int row = (unsigned int)y;
+
+		const float deltaPhi = -m_phiScale * (x - ((float)column + 0.5f));
+		const float deltaTheta = m_thetaScale * (y - ((float)row + 0.5f));
+
+		const SinCos& columnValues = m_aColumns[column];
+		const SinCos& rowValues = m_aRows[row];
+
+		perturbSinCos(columnValues.sinValue, columnValues.cosValue, deltaPhi, phi.sinValue, phi.cosValue);
+		perturbSinCos(rowValues.sinValue, rowValues.cosValue, deltaTheta, theta.sinValue, theta.cosValue);
+	}
+
+protected:
+	unsigned int		m_width;
+	unsigned int		m_height;
+
+	float				m_phiScale;		// radians per pixel
+	float				m_thetaScale;
+
+	SinCos				m_phiStep;		// one pixel step in x (phi decreases with x)
+	SinCos				m_thetaStep;
+
+	std::vector<SinCos>	m_aColumns;		// per-column phi at the pixel centre
+	std::vector<SinCos>	m_aRows;		// per-row theta at the pixel centre
+};
+
+} // namespace Imagine
+
+#endif // CAM_RAY_DIRECTIONS_H
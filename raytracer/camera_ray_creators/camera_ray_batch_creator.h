@@ -0,0 +1,84 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#ifndef CAMERA_RAY_BATCH_CREATOR_H
+#define CAMERA_RAY_BATCH_CREATOR_H
+
+#include <algorithm>
+
+#include "camera_ray_creator.h"
+#include "cam_ray_directions.h"
+
+namespace Imagine
+{
+
+// Implemented by CameraRayCreators which can create many basic camera rays at once more cheaply than one
+// at a time, i.e. by doing the direction trig with SIMD.
+
+class CameraRayBatchCreator
+{
+public:
+	CameraRayBatchCreator()
+	{
+	}
+
+	virtual ~CameraRayBatchCreator()
+	{
+	}
+
+	// creates count rays, as createBasicCameraRay() would, for the raster positions pX / pY
+	virtual void createBasicCameraRays(const float* pX, const float* pY, unsigned int count, Ray* pRays) const = 0;
+};
+
+// creates the basic camera rays for the centres of count pixels along row y from startX, in batches if
+// the CameraRayCreator supports it
+inline void createPixelCentreCameraRays(const CameraRayCreator* pCamRayCreator, unsigned int startX, unsigned int y,
+										unsigned int count, Ray* pRays)
+{
+	const float pixelYPos = (float)y + 0.5f;
+
+	const CameraRayBatchCreator* pBatchCreator = dynamic_cast<const CameraRayBatchCreator*>(pCamRayCreator);
+	if (!pBatchCreator)
+	{
+		for (unsigned int i = 0; i < count; i++)
+		{
+			pRays[i] = pCamRayCreator->createBasicCameraRay((float)(startX + i) + 0.5f, pixelYPos);
+		}
+		return;
+	}
+
+	float aX[kCameraRayBatchSize];
+	float aY[kCameraRayBatchSize];
+	std::fill(aY, aY + kCameraRayBatchSize, pixelYPos);
+
+	for (unsigned int start = 0; start < count; start += kCameraRayBatchSize)
+	{
+		const unsigned int batchCount = std::min(count - start, kCameraRayBatchSize);
+
+		for (unsigned int i = 0; i < batchCount; i++)
+		{
+			aX[i] = (float)(startX + start + i) + 0.5f;
+		}
+
+		pBatchCreator->createBasicCameraRays(aX, aY, batchCount, pRays + start);
+	}
+}
+
+} // namespace Imagine
+
+#endif // CAMERA_RAY_BATCH_CREATOR_H
@@ -26,6 +26,7 @@
 #include "bsdfs/baked_bsdf.h"
 
 #include "raytracer/camera_ray_creators/camera_ray_creator.h"
+#include "raytracer/camera_ray_creators/camera_ray_batch_creator.h"
 #include "raytracer/render_thread_context.h"
 #include "raytracer/accumulators.h"
 
@@ -39,18 +40,54 @@
 
 #include "utils/maths/rng.h"
 #include "utils/params.h"
+#include "utils/variance_tracker.h"
+#include "utils/profiler.h"
 
 namespace Imagine
 {
 
 #define USE_SAMPLED_AO 1
 
+static const unsigned int kAdaptiveMinSamples = 16;
+static const float kAdaptiveErrorThreshold = 0.02f;
+// floor for the pixel mean when calculating the relative error, so near-black pixels aren't sampled forever
+static const float kAdaptiveMinMean = 0.01f;
+
+// an integrator is created for each render thread, so avoid looking the settings up by name each time
+static const ParamKey kAntiAliasingKey("antiAliasing");
+static const ParamKey kAdaptiveSamplingKey("adaptiveSampling");
+static const ParamKey kAdaptiveMinSamplesKey("adaptiveMinSamples");
+static const ParamKey kAdaptiveErrorThresholdKey("adaptiveErrorThreshold");
+static const ParamKey kDiffuseReflectionKey("diffuseReflection");
+static const ParamKey kDiffuseReflectionSamplesKey("diffuseReflectionSamples");
+static const ParamKey kAmbientOcclusionKey("ambientOcclusion");
+static const ParamKey kAmbientOcclusionSamplesKey("ambientOcclusionSamples");
+static const ParamKey kAmbientOcclusionDistanceAttenuationKey("ambientOcclusionDistanceAttenuation");
+
+static unsigned int greatestCommonDivisor(unsigned int a, unsigned int b)
+{
+	while (b != 0)
+	{
+		unsigned int remainder = a % b;
+		a = b;
+		b = remainder;
+	}
+
+	return a;
+}
+
+static bool pixelHasConverged(const VarianceTracker& pixelVariance, float errorThreshold)
+{
+	return pixelVariance.getRelativeStandardError(kAdaptiveMinMean) <= errorThreshold;
+}
+
 // old original raytracer, which is effectively direct lighting + ambient occlusion
 
 template <typename Accumulator>
 DirectIllumination<Accumulator>::DirectIllumination(Raytracer& rt, const Params& settings) : Renderer(rt, settings),
 	m_rtAmbientOcclusion(&getScene(), &rt),
-	m_ambientOnly(false), m_totalTasks(0), m_tasksDone(0), m_roughSampleBundle(0.0f, 0.0f)
+	m_ambientOnly(false), m_centreSample(0), m_adaptiveSampling(false), m_adaptiveMinSamples(0), m_adaptiveErrorThreshold(0.0f),
+	m_totalTasks(0), m_tasksDone(0), m_roughSampleBundle(0.0f, 0.0f)
 {
 	uint32_t rngSeed = getTimeSeed();
 
@@ -60,7 +97,7 @@ DirectIllumination<Accumulator>::DirectIllumination(Raytracer& rt, const Params&
 
 	RNG rng(rngSeed);
 
-	m_antiAliasing = settings.getUInt("antiAliasing");
+	m_antiAliasing = settings.getUInt(kAntiAliasingKey);
 	m_samplesPerPixel = m_antiAliasing * m_antiAliasing;
 	m_antiAliasingSamples = (float)m_samplesPerPixel;
 
@@ -69,14 +106,53 @@ DirectIllumination<Accumulator>::DirectIllumination(Raytracer& rt, const Params&
 	{
 		SamplerStratified cameraSampleGenerator;
 		cameraSampleGenerator.generateSamples(m_cameraSamples, m_samplesPerPixel, rng);
+
+		// the extra channels are taken from the primary hit of the sample closest to the pixel centre, so that
+		// they match what a single centre sample would give as closely as possible
+		float closestDistance = 2.0f;
+		for (unsigned int i = 0; i < m_samplesPerPixel; i++)
+		{
+			const Sample2D& samplePos = m_cameraSamples.get2DSample(i);
+			float deltaX = samplePos.x - 0.5f;
+			float deltaY = samplePos.y - 0.5f;
+			float distance = deltaX * deltaX + deltaY * deltaY;
+			if (distance < closestDistance)
+			{
+				closestDistance = distance;
+				m_centreSample = i;
+			}
+		}
 	}
 
 	m_invSamplesPerIt = 1.0f / m_samplesPerPixel;
 
-	m_diffuseReflection = settings.getBool("diffuseReflection");
+	// adaptive sampling only makes sense with multiple samples per pixel, and isn't supported for progressive renders
+	m_adaptiveSampling = settings.getBool(kAdaptiveSamplingKey, false) && m_samplesPerPixel > 1 && !rt.isProgressive();
+	if (m_adaptiveSampling)
+	{
+		m_adaptiveMinSamples = std::min(std::max(settings.getUInt(kAdaptiveMinSamplesKey, kAdaptiveMinSamples), 2u), m_samplesPerPixel);
+		m_adaptiveErrorThreshold = settings.getFloat(kAdaptiveErrorThresholdKey, kAdaptiveErrorThreshold);
+
+		// step through the (row-major) strata with a stride of roughly the golden ratio of the count, coprime with it,
+		// so that each successive sample lands far from the previous ones and all strata get used exactly once.
+		// Start with the centre sample, as every pixel takes the first one, and the extra channels come from it.
+		unsigned int stride = (unsigned int)((float)m_samplesPerPixel * 0.618034f);
+		while (greatestCommonDivisor(stride, m_samplesPerPixel) != 1)
+		{
+			stride++;
+		}
+
+		m_aAdaptiveSampleOrder.resize(m_samplesPerPixel);
+		for (unsigned int i = 0; i < m_samplesPerPixel; i++)
+		{
+			m_aAdaptiveSampleOrder[i] = (m_centreSample + i * stride) % m_samplesPerPixel;
+		}
+	}
+
+	m_diffuseReflection = settings.getBool(kDiffuseReflectionKey);
 	if (m_diffuseReflection)
 	{
-		m_diffuseReflectionSamples = settings.getUInt("diffuseReflectionSamples");
+		m_diffuseReflectionSamples = settings.getUInt(kDiffuseReflectionSamplesKey);
 		m_invDiffReflectionSamples = 1.0f / (float)m_diffuseReflectionSamples;
 		m_invTotalDiffReflectionSamples = 1.0f / (float)(m_diffuseReflectionSamples * m_diffuseReflectionSamples);
 		m_cachedSampleIncrements.resize(m_diffuseReflectionSamples);
@@ -86,13 +162,13 @@ DirectIllumination<Accumulator>::DirectIllumination(Raytracer& rt, const Params&
 		}
 	}
 
-	m_ambientOcclusion = settings.getBool("ambientOcclusion");
+	m_ambientOcclusion = settings.getBool(kAmbientOcclusionKey);
 	m_ambientOcclusionSamples = 0;
 	if (m_ambientOcclusion)
 	{
-		m_ambientOcclusionSamples = settings.getUInt("ambientOcclusionSamples");
+		m_ambientOcclusionSamples = settings.getUInt(kAmbientOcclusionSamplesKey);
 		m_rtAmbientOcclusion.setSampleCount(m_ambientOcclusionSamples);
-		m_rtAmbientOcclusion.setDistanceAttenuation(settings.getFloat("ambientOcclusionDistanceAttenuation"));
+		m_rtAmbientOcclusion.setDistanceAttenuation(settings.getFloat(kAmbientOcclusionDistanceAttenuationKey));
 	}
 }
 
@@ -130,6 +206,8 @@ void DirectIllumination<Accumulator>::initialise()
 template <typename Accumulator>
 bool DirectIllumination<Accumulator>::processTask(RenderTask* pRTask, unsigned int threadID)
 {
+	PROFILE_SCOPE("DirectIllumination");
+
 	if (m_raytracer.isProgressive())
 	{
 		return doProgressiveTask(pRTask, threadID);
@@ -205,10 +283,17 @@ bool DirectIllumination<Accumulator>::doProgressiveTask(RenderTask* pTask, unsig
 	}
 	else if (currentState == eTSInitial) // initial centre ray has been fired
 	{
+		// these are the same pixel-centre camera rays that the extra channels use, so get their values from them
+		const unsigned int extraChannels = m_raytracer.getExtraChannels();
+
+		std::vector<Ray> aRowRays(tileWidth);
+
 		for (unsigned int y = 0; y < tileHeight; y++)
 		{
 			float pixelYPos = (float)(y + startY) + 0.5f;
 
+			createPixelCentreCameraRays(pCamRayCreator, startX, y + startY, tileWidth, &aRowRays[0]);
+
 			for (unsigned int x = 0; x < tileWidth; x++)
 			{
 				float pixelXPos = (float)(x + startX) + 0.5f;
@@ -216,17 +301,24 @@ bool DirectIllumination<Accumulator>::doProgressiveTask(RenderTask* pTask, unsig
 				SampleBundle samples(pixelXPos, pixelYPos);
 				sampleGenerator.generateSampleBundle(samples);
 
-				Ray viewRay = pCamRayCreator->createBasicCameraRay((float)(pixelXPos), (float)(pixelYPos));
+				const Ray& viewRay = aRowRays[x];
 
 				PathState pathState(getBounceLimitOverall());
 
-				Colour4f colour = processRayRecurse(*pRenderThreadCtx, shadingContext, viewRay, RENDER_NORMAL, pathState, rng, samples, 0);
+				PrimaryHitChannels primaryHit;
+				Colour4f colour = processRayRecurse(*pRenderThreadCtx, shadingContext, viewRay, RENDER_NORMAL, pathState, rng, samples, 0,
+													extraChannels ? &primaryHit : nullptr);
 
 				pOurImage->colourAt(x, y) = colour;
+
+				if (extraChannels)
+				{
+					setTilePixelExtraChannelsFromHit(primaryHit, extraChannels, pOurImage, x, y);
+				}
 			}
 		}
 
-		m_raytracer.processExtraChannels(pTask, threadID);
+		m_raytracer.copyExtraChannelsTile(pTask, threadID);
 
 		m_raytracer.m_pOutputImage->setTileSamples(startX, startY, tileWidth, tileHeight, 1.0f);
 		m_raytracer.m_pOutputImage->copyColourTile(startX - m_raytracer.m_renderWindowX, startY - m_raytracer.m_renderWindowY,
@@ -286,6 +378,10 @@ bool DirectIllumination<Accumulator>::doProgressiveTask(RenderTask* pTask, unsig
 		if (!m_ambientOcclusion)
 			return true;
 
+		// the occlusion for the primary hits is calculated for the whole tile at once afterwards. The renderer is
+		// shared between all the render threads, so this needs to be local to the task
+		DeferredOcclusion deferredOcclusion;
+
 		for (unsigned int y = 0; y < tileHeight; y++)
 		{
 			float pixelYPos = (float)(y + startY);
@@ -299,15 +395,22 @@ bool DirectIllumination<Accumulator>::doProgressiveTask(RenderTask* pTask, unsig
 				SampleBundle samples(pixelXPos, pixelYPos);
 				sampleGenerator.generateSampleBundle(samples);
 
+				deferredOcclusion.pixelIndex = y * tileWidth + x;
+
 				if (m_antiAliasing == 1) // no anti-aliasing
 				{
 					Ray viewRay = pCamRayCreator->createBasicCameraRay(pixelXPos, pixelYPos);
 
+					deferredOcclusion.sampleWeight = 1.0f;
+
 					PathState pathState(getBounceLimitOverall());
-					colour = processRayRecurse(*pRenderThreadCtx, shadingContext, viewRay, RENDER_AMBIENT_OCCLUSION, pathState, rng, samples, 0);
+					colour = processRayRecurse(*pRenderThreadCtx, shadingContext, viewRay, RENDER_AMBIENT_OCCLUSION, pathState, rng, samples, 0,
+											   nullptr, &deferredOcclusion);
 				}
 				else
 				{
+					deferredOcclusion.sampleWeight = m_invSamplesPerIt;
+
 					for (unsigned int sample = 0; sample < m_samplesPerPixel; sample++)
 					{
 						const Sample2D& samplePos = m_cameraSamples.get2DSample(sample);
@@ -322,7 +425,8 @@ bool DirectIllumination<Accumulator>::doProgressiveTask(RenderTask* pTask, unsig
 
 						PathState pathState(getBounceLimitOverall());
 
-						colour += processRayRecurse(*pRenderThreadCtx, shadingContext, viewRay, RENDER_AMBIENT_OCCLUSION, pathState, rng, samples, sample);
+						colour += processRayRecurse(*pRenderThreadCtx, shadingContext, viewRay, RENDER_AMBIENT_OCCLUSION, pathState, rng, samples, sample,
+													nullptr, &deferredOcclusion);
 					}
 
 					colour *= m_invSamplesPerIt;
@@ -335,6 +439,8 @@ bool DirectIllumination<Accumulator>::doProgressiveTask(RenderTask* pTask, unsig
 			}
 		}
 
+		resolveDeferredOcclusion(deferredOcclusion, pOurImage, tileWidth, rng);
+
 		// copy our finished tile into the output image
 		m_raytracer.m_pOutputImage->addColourTile(startX, startY, tileWidth, tileHeight, 0, 0, *pOurImage);
 	}
@@ -343,6 +449,31 @@ bool DirectIllumination<Accumulator>::doProgressiveTask(RenderTask* pTask, unsig
 	return true;
 }
 
+template <typename Accumulator>
+void DirectIllumination<Accumulator>::resolveDeferredOcclusion(DeferredOcclusion& deferredOcclusion, OutputImageTile* pOurImage,
+															   unsigned int tileWidth, RNG& rng) const
+{
+	unsigned int numPoints = (unsigned int)deferredOcclusion.aPoints.size();
+	if (numPoints == 0)
+		return;
+
+	deferredOcclusion.aOcclusion.resize(numPoints);
+	m_rtAmbientOcclusion.getOcclusionAtPoints(deferredOcclusion.aPoints.data(), numPoints, rng, deferredOcclusion.aStreamRays,
+											  deferredOcclusion.aNumOccluded, deferredOcclusion.aOcclusion.data());
+
+	for (unsigned int i = 0; i < numPoints; i++)
+	{
+		unsigned int pixelIndex = deferredOcclusion.aPixelIndices[i];
+		unsigned int x = pixelIndex % tileWidth;
+		unsigned int y = pixelIndex / tileWidth;
+
+		Colour3f ambientColour = deferredOcclusion.aAmbientColours[i];
+		ambientColour *= (1.0f - deferredOcclusion.aOcclusion[i]);
+
+		pOurImage->colourAt(x, y) += ambientColour;
+	}
+}
+
 #define USE_ACCUMULATOR 0
 
 #define ENABLE_SAMPLE_BUNDLE_REUSE 1
@@ -386,12 +517,20 @@ bool DirectIllumination<Accumulator>::doFullTask(RenderTask* pTask, unsigned int
 
 	const CameraRayCreator* pCamRayCreator = this->getCameraRayCreator();
 
+	// the extra channels are taken from the sample nearest each pixel's centre (m_centreSample), rather than tracing another
+	// camera ray for them
+	const unsigned int extraChannels = m_raytracer.getExtraChannels();
+
 	if (m_samplesPerPixel == 1)
 	{
+		std::vector<Ray> aRowRays(tileWidth);
+
 		for (unsigned int y = 0; y < tileHeight; y++)
 		{
 			float pixelYPos = (float)(y + startY);
 
+			createPixelCentreCameraRays(pCamRayCreator, startX, y + startY, tileWidth, &aRowRays[0]);
+
 			for (unsigned int x = 0; x < tileWidth; x++)
 			{
 				float pixelXPos = (float)(x + startX);
@@ -406,19 +545,28 @@ bool DirectIllumination<Accumulator>::doFullTask(RenderTask* pTask, unsigned int
 				sampleGenerator.generateSampleBundle(samples);
 #endif
 
-				float fPixelXPos = pixelXPos + 0.5f;
-				float fPixelYPos = pixelYPos + 0.5f;
-
-				Ray viewRay = pCamRayCreator->createBasicCameraRay(fPixelXPos, fPixelYPos);
+				const Ray& viewRay = aRowRays[x];
 
 				PathState pathState(getBounceLimitOverall());
 
-				colour += processRayRecurse(*pRenderThreadCtx, shadingContext, viewRay, RENDER_ALL, pathState, rng, samples, 0);
+				PrimaryHitChannels primaryHit;
+				colour += processRayRecurse(*pRenderThreadCtx, shadingContext, viewRay, RENDER_ALL, pathState, rng, samples, 0,
+											extraChannels ? &primaryHit : nullptr);
 
 				pOurImage->colourAt(x, y) = colour;
+
+				if (extraChannels)
+				{
+					setTilePixelExtraChannelsFromHit(primaryHit, extraChannels, pOurImage, x, y);
+				}
 			}
 		}
 	}
+	else if (m_adaptiveSampling)
+	{
+		if (!renderTileAdaptive(pTask, pOurImage, *pRenderThreadCtx, shadingContext, sampleGenerator, rng, extraChannels))
+			return true;
+	}
 	else
 	{
 		for (unsigned int y = 0; y < tileHeight; y++)
@@ -442,6 +590,8 @@ bool DirectIllumination<Accumulator>::doFullTask(RenderTask* pTask, unsigned int
 				sampleGenerator.generateSampleBundle(samples);
 #endif
 
+				PrimaryHitChannels primaryHit;
+
 				for (unsigned int sample = 0; sample < m_samplesPerPixel; sample++)
 				{
 					const Sample2D& samplePos = m_cameraSamples.get2DSample(sample);
@@ -453,7 +603,10 @@ bool DirectIllumination<Accumulator>::doFullTask(RenderTask* pTask, unsigned int
 
 					PathState pathState(getBounceLimitOverall());
 
-					Colour4f localColour = processRayRecurse(*pRenderThreadCtx, shadingContext, viewRay, RENDER_ALL, pathState, rng, samples, sample);
+					PrimaryHitChannels* pPrimaryHit = (sample == m_centreSample && extraChannels) ? &primaryHit : nullptr;
+
+					Colour4f localColour = processRayRecurse(*pRenderThreadCtx, shadingContext, viewRay, RENDER_ALL, pathState, rng, samples, sample,
+															 pPrimaryHit);
 #if USE_ACCUMULATOR
 					m_accumulator.accumulateSample(localColour, pOurImage, x, y, samplePos);
 					m_accumulator.addColour(localColour, colour);
@@ -469,11 +622,16 @@ bool DirectIllumination<Accumulator>::doFullTask(RenderTask* pTask, unsigned int
 
 				pOurImage->colourAt(x, y) = colour;
 #endif
+
+				if (extraChannels)
+				{
+					setTilePixelExtraChannelsFromHit(primaryHit, extraChannels, pOurImage, x, y);
+				}
 			}
 		}
 	}
 
-	m_raytracer.processExtraChannels(pTask, threadID);
+	m_raytracer.copyExtraChannelsTile(pTask, threadID);
 #if USE_ACCUMULATOR
 	m_accumulator.addTileToOutputImage(pOurImage, getOutputImage(), startX - getRenderWindowX(), startY - getRenderWindowY(),
 									   tileWidth, tileHeight);
@@ -486,9 +644,126 @@ bool DirectIllumination<Accumulator>::doFullTask(RenderTask* pTask, unsigned int
 	return true;
 }
 
+template <typename Accumulator>
+bool DirectIllumination<Accumulator>::renderTileAdaptive(RenderTask* pTask, OutputImageTile* pOurImage, RenderThreadContext& rtc,
+														 ShadingContext& shadingContext, SampleGeneratorStratified& sampleGenerator,
+														 RNG& rng, unsigned int extraChannels)
+{
+	unsigned int startX = pTask->getStartX();
+	unsigned int startY = pTask->getStartY();
+
+	unsigned int tileWidth = pTask->getWidth();
+	unsigned int tileHeight = pTask->getHeight();
+
+	const CameraRayCreator* pCamRayCreator = this->getCameraRayCreator();
+
+#if ENABLE_SAMPLE_BUNDLE_REUSE
+	SampleBundleReuse samples;
+	sampleGenerator.allocateSampleBundleReuse(samples);
+#endif
+
+	const unsigned int numPixels = tileWidth * tileHeight;
+	std::vector<VarianceTracker> aPixelVariance(numPixels);
+	std::vector<Colour4f> aPixelColour(numPixels);
+	std::vector<unsigned char> aPixelConverged(numPixels, 0);
+
+	unsigned int unconvergedPixels = 0;
+
+	// The first pass takes the minimum number of samples for every pixel, after which the whole tile is retired if all
+	// of its pixels have converged. The second pass continues sampling the pixels that haven't until they do, or they
+	// reach the full sample count, checking again every m_adaptiveMinSamples samples.
+	for (unsigned int pass = 0; pass < 2; pass++)
+	{
+		if (pass == 1 && unconvergedPixels == 0)
+			break;
+
+		const unsigned int endSample = (pass == 0) ? m_adaptiveMinSamples : m_samplesPerPixel;
+
+		for (unsigned int y = 0; y < tileHeight; y++)
+		{
+			float pixelYPos = (float)(y + startY);
+
+			for (unsigned int x = 0; x < tileWidth; x++)
+			{
+				if (!pTask->isActive())
+					return false;
+
+				const unsigned int pixelIndex = y * tileWidth + x;
+				if (aPixelConverged[pixelIndex])
+					continue;
+
+				float pixelXPos = (float)(x + startX);
+
+#if ENABLE_SAMPLE_BUNDLE_REUSE
+				samples.setNextPixel(pixelXPos, pixelYPos);
+				sampleGenerator.generateSampleBundleReuse(samples);
+#else
+				SampleBundle samples(pixelXPos, pixelYPos);
+				sampleGenerator.generateSampleBundle(samples);
+#endif
+
+				VarianceTracker& pixelVariance = aPixelVariance[pixelIndex];
+				Colour4f& pixelColour = aPixelColour[pixelIndex];
+
+				PrimaryHitChannels primaryHit;
+
+				for (unsigned int sample = pixelVariance.getSampleCount(); sample < endSample; sample++)
+				{
+					const unsigned int sampleIndex = m_aAdaptiveSampleOrder[sample];
+					const Sample2D& samplePos = m_cameraSamples.get2DSample(sampleIndex);
+
+					float fPixelXPos = pixelXPos + samplePos.x;
+					float fPixelYPos = pixelYPos + samplePos.y;
+
+					Ray viewRay = pCamRayCreator->createCameraRay(fPixelXPos, fPixelYPos, samples, sampleIndex);
+
+					PathState pathState(getBounceLimitOverall());
+
+					PrimaryHitChannels* pPrimaryHit = (sample == 0 && extraChannels) ? &primaryHit : nullptr;
+
+					Colour4f localColour = processRayRecurse(rtc, shadingContext, viewRay, RENDER_ALL, pathState, rng, samples, sampleIndex,
+															 pPrimaryHit);
+
+					pixelVariance.addValue(localColour.brightness());
+					pixelColour += localColour;
+
+					if (pass == 1 && ((sample + 1) % m_adaptiveMinSamples) == 0 &&
+						pixelHasConverged(pixelVariance, m_adaptiveErrorThreshold))
+					{
+						break;
+					}
+				}
+
+				if (pass == 0)
+				{
+					if (pixelHasConverged(pixelVariance, m_adaptiveErrorThreshold))
+						aPixelConverged[pixelIndex] = 1;
+					else
+						unconvergedPixels++;
+
+					if (extraChannels)
+					{
+						setTilePixelExtraChannelsFromHit(primaryHit, extraChannels, pOurImage, x, y);
+					}
+				}
+
+				pOurImage->colourAt(x, y) = pixelColour * (1.0f / (float)pixelVariance.getSampleCount());
+
+				if (extraChannels)
+				{
+					setTilePixelConvergenceChannelsFromVariance(pixelVariance, extraChannels, pOurImage, x, y);
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
 template <typename Accumulator>
 Colour4f DirectIllumination<Accumulator>::processRayRecurse(RenderThreadContext& rtc, ShadingContext& shadingContext, const Ray& ray,
-															unsigned int flags, PathState& pathState, RNG& rng, SampleBundle& samples, unsigned int sampleIndex)
+															unsigned int flags, PathState& pathState, RNG& rng, SampleBundle& samples, unsigned int sampleIndex,
+															PrimaryHitChannels* pPrimaryHit, DeferredOcclusion* pDeferredAO)
 {
 	Colour4f colour;
 
@@ -500,8 +775,6 @@ Colour4f DirectIllumination<Accumulator>::processRayRecurse(RenderThreadContext&
 	Ray localRay(ray);
 	localRay.tMin = std::max(getRayEpsilon(), localRay.tMin);
 
-	const Object* pHitObject;
-
 	bool didHit = m_raytracer.m_scene.didHitObject(localRay, t, hitResult);
 
 	// if we didn't hit anything, skip
@@ -512,7 +785,7 @@ Colour4f DirectIllumination<Accumulator>::processRayRecurse(RenderThreadContext&
 
 	// get the actual hitObject from the hitResult so that if a compound object with sub-objects
 	// was hit, we get the correct material
-	pHitObject = hitResult.pObject;
+	const Object* pHitObject = hitResult.pObject;
 
 	const Material* pMaterial = pHitObject->getMaterial();
 
@@ -520,6 +793,12 @@ Colour4f DirectIllumination<Accumulator>::processRayRecurse(RenderThreadContext&
 
 	// shade the material to get the shader normal at the surface
 	pMaterial->shade(localRay, hitResult, &availableBSDF);
+
+	if (pPrimaryHit)
+	{
+		uint32_t objectID = (hitResult.objID == -1u) ? pHitObject->getObjectID() : hitResult.objID;
+		pPrimaryHit->setFromHit(hitResult, t, objectID);
+	}
 	
 	if (pathState.bounceLevel == 0 && hitResult.pLight && (hitResult.pLight->getRenderVisibilityFlags() & localRay.type))
 	{
@@ -537,14 +816,31 @@ Colour4f DirectIllumination<Accumulator>::processRayRecurse(RenderThreadContext&
 		ambMatColour *= 0.9f;
 
 		ambMatColour *= m_raytracer.m_ambientColour;
+
+		if (pDeferredAO)
+		{
+			RaytracerAmbientOcclusion::OcclusionPoint point;
+			point.position = hitResult.hitPoint;
+			point.normal = hitResult.shaderNormal;
+			point.tMin = hitResult.intersectionError * getRayEpsilon();
+
+			ambMatColour *= pDeferredAO->sampleWeight;
+
+			pDeferredAO->aPoints.push_back(point);
+			pDeferredAO->aAmbientColours.push_back(ambMatColour);
+			pDeferredAO->aPixelIndices.push_back(pDeferredAO->pixelIndex);
+		}
+		else
+		{
 #if USE_SAMPLED_AO
-		float occlusion = m_rtAmbientOcclusion.getOcclusionAtPointExistingSamples(hitResult, samples, sampleIndex);
+			float occlusion = m_rtAmbientOcclusion.getOcclusionAtPointExistingSamples(hitResult, samples, sampleIndex);
 #else
-		float occlusion = m_rtAmbientOcclusion.getOcclusionAtPoint(hitResult, rng);
+			float occlusion = m_rtAmbientOcclusion.getOcclusionAtPoint(hitResult, rng);
 #endif
-		ambMatColour *= (1.0f - occlusion);
+			ambMatColour *= (1.0f - occlusion);
 
-		colour += ambMatColour;
+			colour += ambMatColour;
+		}
 	}
 /*	else
 	{
@@ -715,10 +1011,12 @@ float DirectIllumination<Accumulator>::calculateProgress() const
 
 	if (!m_raytracer.isProgressive())
 	{
-		unsigned int activeThreads = m_raytracer.m_controller.threadsActive();
-		float tasksRemaining = (float)(m_raytracer.m_aTasks.size() + activeThreads);
-
-		percentDone = ((m_raytracer.m_fOriginalNumberOfTasks - tasksRemaining) * m_raytracer.m_invOriginalNumTasks) * 100.0f;
+		// tiles released by remote clients can be rendered locally as well, so this can overshoot slightly
+		if (m_raytracer.m_progressTotalPixels > 0)
+		{
+			float pixelsDone = (float)m_raytracer.m_progressPixelsDone.load(std::memory_order_relaxed);
+			percentDone = std::min((pixelsDone / (float)m_raytracer.m_progressTotalPixels) * 100.0f, 100.0f);
+		}
 	}
 	else
 	{
@@ -19,6 +19,9 @@
 #ifndef DIRECT_ILLUMINATION_H
 #define DIRECT_ILLUMINATION_H
 
+#include <vector>
+#include <inttypes.h>
+
 #include "renderer.h"
 
 #include "raytracer_common.h"
@@ -32,6 +35,8 @@ namespace Imagine
 class RNG;
 class Params;
 class RenderThreadContext;
+class SampleGeneratorStratified;
+class OutputImageTile;
 
 template <typename Accumulator>
 class DirectIllumination : public Renderer
@@ -42,6 +47,24 @@ public:
 	{
 	}
 
+	// ambient occlusion points from the primary hits of a whole tile, so the occlusion rays can all be traced as one stream
+	struct DeferredOcclusion
+	{
+		std::vector<RaytracerAmbientOcclusion::OcclusionPoint>	aPoints;
+		// the material's ambient colour at each point, already scaled by the sample weight
+		std::vector<Colour3f>		aAmbientColours;
+		std::vector<unsigned int>	aPixelIndices;
+
+		// working storage for getOcclusionAtPoints()
+		std::vector<RaytracerAmbientOcclusion::OcclusionStreamRay>	aStreamRays;
+		std::vector<unsigned int>	aNumOccluded;
+		std::vector<float>			aOcclusion;
+
+		// set by the caller before each camera ray
+		unsigned int				pixelIndex;
+		float						sampleWeight;
+	};
+
 	virtual void initialise();
 
 	virtual bool processTask(RenderTask* pRTask, unsigned int threadID);
@@ -49,11 +72,23 @@ public:
 	bool doProgressiveTask(RenderTask* pTask, unsigned int threadID);
 	bool doFullTask(RenderTask* pTask, unsigned int threadID);
 
+	// doFullTask()'s multiple samples per pixel, but stopping sampling pixels (and whole tiles) once their relative error
+	// is below the threshold. Returns false if the task was cancelled.
+	bool renderTileAdaptive(RenderTask* pTask, OutputImageTile* pOurImage, RenderThreadContext& rtc, ShadingContext& shadingContext,
+							SampleGeneratorStratified& sampleGenerator, RNG& rng, unsigned int extraChannels);
+
+	// if pPrimaryHit is non-null, the values for the extra channels are set in it from the first hit.
+	// if pDeferredAO is non-null, the first hit's ambient occlusion is added to it instead of being calculated
 	Colour4f processRayRecurse(RenderThreadContext& rtc, ShadingContext& shadingContext, const Ray& ray, unsigned int flags, PathState& pathState,
-								  RNG& rng, SampleBundle& samples, unsigned int sampleIndex);
+								  RNG& rng, SampleBundle& samples, unsigned int sampleIndex, PrimaryHitChannels* pPrimaryHit = nullptr,
+								  DeferredOcclusion* pDeferredAO = nullptr);
 
 	virtual float calculateProgress() const;
 
+protected:
+	// calculates the occlusion for all the points collected for the tile, and adds the ambient colour to their pixels
+	void resolveDeferredOcclusion(DeferredOcclusion& deferredOcclusion, OutputImageTile* pOurImage, unsigned int tileWidth, RNG& rng) const;
+
 protected:
 	Accumulator						m_accumulator;
 	RaytracerAmbientOcclusion		m_rtAmbientOcclusion;
@@ -73,10 +108,18 @@ protected:
 	std::vector<float>	m_cachedSampleIncrements;
 
 	Sample2DPacket		m_cameraSamples;
+	// index of the camera sample closest to the pixel centre
+	unsigned int		m_centreSample;
 
 	unsigned int		m_samplesPerPixel;
 	float				m_invSamplesPerIt;
 
+	bool				m_adaptiveSampling;
+	unsigned int		m_adaptiveMinSamples;
+	float				m_adaptiveErrorThreshold;
+	// order to use the stratified camera samples in, so that any number of them taken from the start are spread over the pixel
+	std::vector<unsigned int>	m_aAdaptiveSampleOrder;
+
 	unsigned int		m_totalTasks;
 	mutable unsigned int		m_tasksDone;
 
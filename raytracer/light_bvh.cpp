@@ -0,0 +1,608 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#include "light_bvh.h"
+
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+#include "utils/maths/maths.h"
+
+namespace Imagine
+{
+
+static const unsigned int kLightBVHBuckets = 12;
+// leaves can be at most this deep, so that their bit trails fit in 64 bits without ever matching kInvalidBitTrail
+static const unsigned int kLightBVHMaxDepth = 63;
+static const uint64_t kInvalidBitTrail = ~0ull;
+static const float kOneMinusEpsilon = 0.99999994f;
+
+static inline float getComponent(const Point& point, unsigned int dim)
+{
+	return (dim == 0) ? point.x : ((dim == 1) ? point.y : point.z);
+}
+
+// the depth median splits need to get down to single lights
+static inline unsigned int medianSplitDepth(unsigned int numItems)
+{
+	unsigned int depth = 0;
+	uint64_t capacity = 1;
+	while (capacity < numItems)
+	{
+		capacity <<= 1;
+		depth++;
+	}
+	return depth;
+}
+
+static inline float safeSqrt(float value)
+{
+	return sqrtf(std::max(value, 0.0f));
+}
+
+static inline float safeACos(float value)
+{
+	return acosf(std::min(std::max(value, -1.0f), 1.0f));
+}
+
+static inline Vector crossVectors(const Vector& a, const Vector& b)
+{
+	return Vector((a.y * b.z) - (a.z * b.y), (a.z * b.x) - (a.x * b.z), (a.x * b.y) - (a.y * b.x));
+}
+
+static inline float distanceSquared(const Point& a, const Point& b)
+{
+	float dX = a.x - b.x;
+	float dY = a.y - b.y;
+	float dZ = a.z - b.z;
+	return (dX * dX) + (dY * dY) + (dZ * dZ);
+}
+
+// cos(max(0, a - b)) from the sin and cos of the angles
+static inline float cosSubClamped(float sinThetaA, float cosThetaA, float sinThetaB, float cosThetaB)
+{
+	if (cosThetaA > cosThetaB)
+		return 1.0f;
+
+	return (cosThetaA * cosThetaB) + (sinThetaA * sinThetaB);
+}
+
+// sin(max(0, a - b)) from the sin and cos of the angles
+static inline float sinSubClamped(float sinThetaA, float cosThetaA, float sinThetaB, float cosThetaB)
+{
+	if (cosThetaA > cosThetaB)
+		return 0.0f;
+
+	return (sinThetaA * cosThetaB) - (cosThetaA * sinThetaB);
+}
+
+// rotates vector around the (normalised) axis by angle radians
+static inline Vector rotateAroundAxis(const Vector& vector, const Vector& axis, float angle)
+{
+	float sinAngle = sinf(angle);
+	float cosAngle = cosf(angle);
+
+	Vector result = vector * cosAngle;
+	result += crossVectors(axis, vector) * sinAngle;
+	result += axis * (Vector::dot(axis, vector) * (1.0f - cosAngle));
+
+	return result;
+}
+
+static inline float surfaceArea(const Point& boundsMin, const Point& boundsMax)
+{
+	float dX = boundsMax.x - boundsMin.x;
+	float dY = boundsMax.y - boundsMin.y;
+	float dZ = boundsMax.z - boundsMin.z;
+
+	return 2.0f * ((dX * dY) + (dX * dZ) + (dY * dZ));
+}
+
+LightBVH::LightBounds::LightBounds(const LightBVHItem& item) : boundsMin(item.boundsMin), boundsMax(item.boundsMax), axis(item.axis),
+	cosThetaO(item.cosThetaO), cosThetaE(item.cosThetaE), power(item.power), empty(false)
+{
+}
+
+void LightBVH::LightBounds::add(const LightBounds& other)
+{
+	if (other.empty)
+		return;
+
+	if (empty)
+	{
+		*this = other;
+		return;
+	}
+
+	boundsMin = Point(std::min(boundsMin.x, other.boundsMin.x), std::min(boundsMin.y, other.boundsMin.y), std::min(boundsMin.z, other.boundsMin.z));
+	boundsMax = Point(std::max(boundsMax.x, other.boundsMax.x), std::max(boundsMax.y, other.boundsMax.y), std::max(boundsMax.z, other.boundsMax.z));
+
+	power += other.power;
+	cosThetaE = std::min(cosThetaE, other.cosThetaE);
+
+	// union of the two normal cones
+	if (cosThetaO == -1.0f || other.cosThetaO == -1.0f)
+	{
+		cosThetaO = -1.0f;
+		return;
+	}
+
+	float thetaA = safeACos(cosThetaO);
+	float thetaB = safeACos(other.cosThetaO);
+	float thetaD = safeACos(Vector::dot(axis, other.axis));
+
+	if (std::min(thetaD + thetaB, kPI) <= thetaA)
+	{
+		// other is within our cone already
+		return;
+	}
+
+	if (std::min(thetaD + thetaA, kPI) <= thetaB)
+	{
+		axis = other.axis;
+		cosThetaO = other.cosThetaO;
+		return;
+	}
+
+	float thetaO = (thetaA + thetaD + thetaB) * 0.5f;
+	if (thetaO >= kPI)
+	{
+		cosThetaO = -1.0f;
+		return;
+	}
+
+	Vector rotationAxis = crossVectors(axis, other.axis);
+	if (rotationAxis.lengthSquared() == 0.0f)
+	{
+		cosThetaO = -1.0f;
+		return;
+	}
+
+	rotationAxis.normalise();
+
+	axis = rotateAroundAxis(axis, rotationAxis, thetaO - thetaA);
+	axis.normalise();
+	cosThetaO = cosf(thetaO);
+}
+
+float LightBVH::LightBounds::importance(const Point& position, const Vector& normal) const
+{
+	Point centre = centroid();
+
+	float radiusSquared = distanceSquared(boundsMin, boundsMax) * 0.25f;
+
+	// clamp the distance to the bounds' extent, so that we don't get huge values for points within or very close to it
+	float distSquared = distanceSquared(position, centre);
+	distSquared = std::max(distSquared, std::max(radiusSquared, 1.0e-6f));
+
+	float invDist = 1.0f / sqrtf(distSquared);
+	Vector wi((position.x - centre.x) * invDist, (position.y - centre.y) * invDist, (position.z - centre.z) * invDist);
+
+	float cosThetaW = Vector::dot(axis, wi);
+	float sinThetaW = safeSqrt(1.0f - cosThetaW * cosThetaW);
+
+	// angle the bounds subtend from the position
+	float cosThetaB = -1.0f;
+	float centreDistSquared = distanceSquared(position, centre);
+	if (centreDistSquared >= radiusSquared && centreDistSquared > 0.0f)
+	{
+		cosThetaB = safeSqrt(1.0f - (radiusSquared / centreDistSquared));
+	}
+	float sinThetaB = safeSqrt(1.0f - cosThetaB * cosThetaB);
+
+	// minimum angle between the emitter normals and the direction to the position
+	float sinThetaO = safeSqrt(1.0f - cosThetaO * cosThetaO);
+	float cosThetaX = cosSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+	float sinThetaX = sinSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+	float cosThetaP = cosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+
+	if (cosThetaP <= cosThetaE)
+		return 0.0f;
+
+	float result = power * cosThetaP / distSquared;
+
+	if (normal.x != 0.0f || normal.y != 0.0f || normal.z != 0.0f)
+	{
+		// account for the incident angle at the surface
+		float cosThetaI = fabsf(Vector::dot(wi, normal));
+		float sinThetaI = safeSqrt(1.0f - cosThetaI * cosThetaI);
+		result *= cosSubClamped(sinThetaI, cosThetaI, sinThetaB, cosThetaB);
+	}
+
+	return std::max(result, 0.0f);
+}
+
+// the "surface area orientation heuristic" cost of a node with the given bounds
+static float evaluateSplitCost(const Point& boundsMin, const Point& boundsMax, float cosThetaO, float cosThetaE, float power,
+							   float overallExtentRatio)
+{
+	float thetaO = safeACos(cosThetaO);
+	float thetaE = safeACos(cosThetaE);
+	float thetaW = std::min(thetaO + thetaE, kPI);
+	float sinThetaO = safeSqrt(1.0f - cosThetaO * cosThetaO);
+
+	float orientationCost = 2.0f * kPI * (1.0f - cosThetaO) +
+			kPI * 0.5f * (2.0f * thetaW * sinThetaO - cosf(thetaO - 2.0f * thetaW) - 2.0f * thetaO * sinThetaO + cosThetaO);
+
+	return power * orientationCost * overallExtentRatio * surfaceArea(boundsMin, boundsMax);
+}
+
+class LightCentroidComparator
+{
+public:
+	LightCentroidComparator(const std::vector<LightBVH::LightBounds>& aBounds, unsigned int dim) : m_aBounds(aBounds), m_dim(dim)
+	{
+	}
+
+	bool operator()(uint32_t lhs, uint32_t rhs) const
+	{
+		return getComponent(m_aBounds[lhs].centroid(), m_dim) < getComponent(m_aBounds[rhs].centroid(), m_dim);
+	}
+
+protected:
+	const std::vector<LightBVH::LightBounds>&	m_aBounds;
+	unsigned int								m_dim;
+};
+
+LightBVH::LightBVH() : m_numLights(0)
+{
+}
+
+LightBVH::~LightBVH()
+{
+}
+
+bool LightBVH::build(const std::vector<LightBVHItem>& aLights)
+{
+	m_aNodes.clear();
+	m_aItemLightIndices.clear();
+	m_aInfiniteLights.clear();
+
+	m_numLights = 0;
+	std::vector<LightBVHItem>::const_iterator itLight = aLights.begin();
+	for (; itLight != aLights.end(); ++itLight)
+	{
+		m_numLights = std::max(m_numLights, itLight->lightIndex + 1);
+	}
+
+	m_aLightBitTrails.assign(m_numLights, kInvalidBitTrail);
+	m_aLightIsInfinite.assign(m_numLights, 0);
+
+	std::vector<LightBounds> aBounds;
+	std::vector<uint32_t> aItemIndices;
+
+	for (itLight = aLights.begin(); itLight != aLights.end(); ++itLight)
+	{
+		const LightBVHItem& item = *itLight;
+
+		if (item.infinite)
+		{
+			m_aInfiniteLights.emplace_back(item.lightIndex);
+			m_aLightIsInfinite[item.lightIndex] = 1;
+			continue;
+		}
+
+		// lights which can't contribute don't need to be in the tree
+		if (item.power <= 0.0f)
+			continue;
+
+		aItemIndices.emplace_back((uint32_t)aBounds.size());
+		aBounds.emplace_back(LightBounds(item));
+		m_aItemLightIndices.emplace_back(item.lightIndex);
+	}
+
+	if (!aBounds.empty())
+	{
+		m_aNodes.reserve(aBounds.size() * 2 - 1);
+		buildRecursive(aBounds, aItemIndices, 0, (unsigned int)aBounds.size(), 0, 0);
+	}
+
+	return !m_aNodes.empty() || !m_aInfiniteLights.empty();
+}
+
+uint32_t LightBVH::buildRecursive(std::vector<LightBounds>& aBounds, std::vector<uint32_t>& aItemIndices, unsigned int start, unsigned int end,
+								  uint64_t bitTrail, unsigned int depth)
+{
+	uint32_t nodeIndex = (uint32_t)m_aNodes.size();
+	m_aNodes.emplace_back(Node());
+
+	if (end - start == 1)
+	{
+		uint32_t itemIndex = aItemIndices[start];
+
+		Node& leafNode = m_aNodes[nodeIndex];
+		leafNode.bounds = aBounds[itemIndex];
+		leafNode.index = itemIndex;
+		leafNode.isLeaf = true;
+
+		m_aLightBitTrails[m_aItemLightIndices[itemIndex]] = bitTrail;
+
+		return nodeIndex;
+	}
+
+	LightBounds overallBounds;
+	Point centroidMin = aBounds[aItemIndices[start]].centroid();
+	Point centroidMax = centroidMin;
+
+	for (unsigned int i = start; i < end; i++)
+	{
+		const LightBounds& bounds = aBounds[aItemIndices[i]];
+		overallBounds.add(bounds);
+
+		Point centroid = bounds.centroid();
+		centroidMin = Point(std::min(centroidMin.x, centroid.x), std::min(centroidMin.y, centroid.y), std::min(centroidMin.z, centroid.z));
+		centroidMax = Point(std::max(centroidMax.x, centroid.x), std::max(centroidMax.y, centroid.y), std::max(centroidMax.z, centroid.z));
+	}
+
+	float overallExtents[3] = { overallBounds.boundsMax.x - overallBounds.boundsMin.x,
+								overallBounds.boundsMax.y - overallBounds.boundsMin.y,
+								overallBounds.boundsMax.z - overallBounds.boundsMin.z };
+	float maxOverallExtent = std::max(overallExtents[0], std::max(overallExtents[1], overallExtents[2]));
+
+	float bestCost = std::numeric_limits<float>::max();
+	int bestDim = -1;
+	unsigned int bestBucket = 0;
+
+	// SAH splits can be very unbalanced, so only use them while there's enough depth left to fall back to median
+	// splits below (which are always balanced), so no leaf ends up deeper than kLightBVHMaxDepth
+	if (depth + medianSplitDepth(end - start) < kLightBVHMaxDepth)
+	{
+		for (unsigned int dim = 0; dim < 3; dim++)
+		{
+			float dimMin = getComponent(centroidMin, dim);
+			float dimMax = getComponent(centroidMax, dim);
+
+			if (dimMax == dimMin)
+				continue;
+
+			float bucketScale = (float)kLightBVHBuckets / (dimMax - dimMin);
+
+			LightBounds buckets[kLightBVHBuckets];
+			for (unsigned int i = start; i < end; i++)
+			{
+				const LightBounds& bounds = aBounds[aItemIndices[i]];
+				unsigned int bucket = (unsigned int)((getComponent(bounds.centroid(), dim) - dimMin) * bucketScale);
+				bucket = std::min(bucket, kLightBVHBuckets - 1);
+
+				buckets[bucket].add(bounds);
+			}
+
+			float extentRatio = (overallExtents[dim] > 0.0f) ? maxOverallExtent / overallExtents[dim] : 1.0f;
+
+			for (unsigned int split = 1; split < kLightBVHBuckets; split++)
+			{
+				LightBounds below;
+				LightBounds above;
+
+				for (unsigned int i = 0; i < split; i++)
+				{
+					below.add(buckets[i]);
+				}
+
+				for (unsigned int i = split; i < kLightBVHBuckets; i++)
+				{
+					above.add(buckets[i]);
+				}
+
+				if (below.empty || above.empty)
+					continue;
+
+				float cost = evaluateSplitCost(below.boundsMin, below.boundsMax, below.cosThetaO, below.cosThetaE, below.power, extentRatio) +
+							 evaluateSplitCost(above.boundsMin, above.boundsMax, above.cosThetaO, above.cosThetaE, above.power, extentRatio);
+
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestDim = (int)dim;
+					bestBucket = split;
+				}
+			}
+		}
+	}
+
+	unsigned int mid = start;
+
+	if (bestDim != -1)
+	{
+		float dimMin = getComponent(centroidMin, bestDim);
+		float bucketScale = (float)kLightBVHBuckets / (getComponent(centroidMax, bestDim) - dimMin);
+
+		for (unsigned int i = start; i < end; i++)
+		{
+			const LightBounds& bounds = aBounds[aItemIndices[i]];
+			unsigned int bucket = (unsigned int)((getComponent(bounds.centroid(), bestDim) - dimMin) * bucketScale);
+			bucket = std::min(bucket, kLightBVHBuckets - 1);
+
+			if (bucket < bestBucket)
+			{
+				std::swap(aItemIndices[i], aItemIndices[mid]);
+				mid++;
+			}
+		}
+	}
+
+	if (mid == start || mid == end)
+	{
+		// either the centroids are all the same, or we're too deep, so just split the lights in half
+		// along the longest centroid axis
+		Vector centroidExtent(centroidMax.x - centroidMin.x, centroidMax.y - centroidMin.y, centroidMax.z - centroidMin.z);
+		unsigned int dim = centroidExtent.biggestAxis();
+
+		mid = (start + end) / 2;
+
+		std::vector<uint32_t>::iterator itStart = aItemIndices.begin() + start;
+		std::nth_element(itStart, aItemIndices.begin() + mid, aItemIndices.begin() + end, LightCentroidComparator(aBounds, dim));
+	}
+
+	buildRecursive(aBounds, aItemIndices, start, mid, bitTrail, depth + 1);
+	uint32_t secondChildIndex = buildRecursive(aBounds, aItemIndices, mid, end, bitTrail | (1ull << depth), depth + 1);
+
+	// m_aNodes may have been re-allocated by now, so don't hold on to a reference from before
+	Node& interiorNode = m_aNodes[nodeIndex];
+	interiorNode.bounds = overallBounds;
+	interiorNode.index = secondChildIndex;
+	interiorNode.isLeaf = false;
+
+	return nodeIndex;
+}
+
+float LightBVH::getInfiniteLightProbability() const
+{
+	if (m_aInfiniteLights.empty())
+		return 0.0f;
+
+	if (m_aNodes.empty())
+		return 1.0f;
+
+	// treat the tree as one more light
+	float numInfinite = (float)m_aInfiniteLights.size();
+	return numInfinite / (numInfinite + 1.0f);
+}
+
+bool LightBVH::sampleLight(const Point& position, const Vector& normal, float sample, unsigned int& lightIndex, float& pdf) const
+{
+	float infiniteProbability = getInfiniteLightProbability();
+
+	if (sample < infiniteProbability)
+	{
+		unsigned int numInfinite = (unsigned int)m_aInfiniteLights.size();
+		unsigned int index = std::min((unsigned int)(sample / infiniteProbability * (float)numInfinite), numInfinite - 1);
+
+		lightIndex = m_aInfiniteLights[index];
+		pdf = infiniteProbability / (float)numInfinite;
+		return true;
+	}
+
+	if (m_aNodes.empty())
+		return false;
+
+	sample = std::min((sample - infiniteProbability) / (1.0f - infiniteProbability), kOneMinusEpsilon);
+
+	float pmf = 1.0f - infiniteProbability;
+	uint32_t nodeIndex = 0;
+
+	while (true)
+	{
+		const Node& node = m_aNodes[nodeIndex];
+
+		if (node.isLeaf)
+		{
+			// the root being a leaf won't have had its importance checked yet
+			if (nodeIndex > 0 || node.bounds.importance(position, normal) > 0.0f)
+			{
+				lightIndex = m_aItemLightIndices[node.index];
+				pdf = pmf;
+				return true;
+			}
+
+			return false;
+		}
+
+		uint32_t child0 = nodeIndex + 1;
+		uint32_t child1 = node.index;
+
+		float importance0 = m_aNodes[child0].bounds.importance(position, normal);
+		float importance1 = m_aNodes[child1].bounds.importance(position, normal);
+
+		if (importance0 == 0.0f && importance1 == 0.0f)
+			return false;
+
+		float probability0 = importance0 / (importance0 + importance1);
+
+		if (sample < probability0)
+		{
+			nodeIndex = child0;
+			pmf *= probability0;
+			sample = std::min(sample / probability0, kOneMinusEpsilon);
+		}
+		else
+		{
+			nodeIndex = child1;
+			pmf *= (1.0f - probability0);
+			sample = std::min((sample - probability0) / (1.0f - probability0), kOneMinusEpsilon);
+		}
+	}
+
+	return false;
+}
+
+float LightBVH::getLightPDF(unsigned int lightIndex, const Point& position, const Vector& normal) const
+{
+	if (lightIndex >= m_numLights)
+		return 0.0f;
+
+	float infiniteProbability = getInfiniteLightProbability();
+
+	if (m_aLightIsInfinite[lightIndex])
+	{
+		return infiniteProbability / (float)m_aInfiniteLights.size();
+	}
+
+	uint64_t bitTrail = m_aLightBitTrails[lightIndex];
+	if (bitTrail == kInvalidBitTrail)
+		return 0.0f;
+
+	float pmf = 1.0f - infiniteProbability;
+	uint32_t nodeIndex = 0;
+
+	while (!m_aNodes[nodeIndex].isLeaf)
+	{
+		const Node& node = m_aNodes[nodeIndex];
+
+		uint32_t child0 = nodeIndex + 1;
+		uint32_t child1 = node.index;
+
+		float importance0 = m_aNodes[child0].bounds.importance(position, normal);
+		float importance1 = m_aNodes[child1].bounds.importance(position, normal);
+
+		float totalImportance = importance0 + importance1;
+		if (totalImportance == 0.0f)
+			return 0.0f;
+
+		if (bitTrail & 1)
+		{
+			pmf *= importance1 / totalImportance;
+			nodeIndex = child1;
+		}
+		else
+		{
+			pmf *= importance0 / totalImportance;
+			nodeIndex = child0;
+		}
+
+		bitTrail >>= 1;
+	}
+
+	return pmf;
+}
+
+size_t LightBVH::getMemorySize() const
+{
+	size_t memSize = sizeof(*this);
+
+	memSize += m_aNodes.capacity() * sizeof(Node);
+	memSize += m_aItemLightIndices.capacity() * sizeof(unsigned int);
+	memSize += m_aLightBitTrails.capacity() * sizeof(uint64_t);
+	memSize += m_aInfiniteLights.capacity() * sizeof(unsigned int);
+	memSize += m_aLightIsInfinite.capacity() * sizeof(unsigned char);
+
+	return memSize;
+}
+
+} // namespace Imagine
@@ -0,0 +1,139 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#ifndef LIGHT_BVH_H
+#define LIGHT_BVH_H
+
+#include <vector>
+#include <inttypes.h>
+
+#include "core/point.h"
+#include "core/vector.h"
+
+namespace Imagine
+{
+
+// description of a single light for building the LightBVH from
+struct LightBVHItem
+{
+	LightBVHItem() : axis(0.0f, 0.0f, 1.0f), cosThetaO(-1.0f), cosThetaE(0.0f), power(0.0f), lightIndex(0), infinite(false)
+	{
+	}
+
+	Point			boundsMin;
+	Point			boundsMax;
+
+	Vector			axis;		// (normalised) average direction of the surface normals
+	float			cosThetaO;	// cos of the angle around axis the normals are within - -1.0 for omni-directional lights
+	float			cosThetaE;	// cos of the angle beyond the normals light is emitted - 0.0 for one-sided diffuse emitters
+
+	float			power;
+
+	unsigned int	lightIndex;	// index of the light in the renderer's LightsAndSamples / light distribution
+
+	bool			infinite;	// environment / distant lights - these aren't put in the tree, but are sampled uniformly
+};
+
+// Tree of light bounds with orientation cones, which allows picking a light to sample proportionally to an estimate of its
+// contribution at a shading point in O(log n) time (for n lights), rather than the linear cost of the other LightSamplingTypes,
+// which is important for scenes with thousands of (mostly distant and occluded) emissive objects.
+// See "Importance Sampling of Many Lights with Adaptive Tree Splitting", Conty Estevez and Kulla, 2018.
+// Nothing selects this as a LightSamplingType yet: the light selection in the integrators needs to pass the hit position
+// and normal through to sampleLight() / getLightPDF(), and lights need to provide their emission cones (rather than being
+// treated as omni-directional) for the orientation bounds to help.
+
+class LightBVH
+{
+public:
+	LightBVH();
+	~LightBVH();
+
+	// returns false if there were no lights which could be sampled
+	bool build(const std::vector<LightBVHItem>& aLights);
+
+	// normal can be a zero vector for points within volumes. Returns false if no light could contribute.
+	bool sampleLight(const Point& position, const Vector& normal, float sample, unsigned int& lightIndex, float& pdf) const;
+
+	// the probability of sampleLight() having picked the light
+	float getLightPDF(unsigned int lightIndex, const Point& position, const Vector& normal) const;
+
+	unsigned int getNumLights() const { return m_numLights; }
+
+	size_t getMemorySize() const;
+
+	struct LightBounds
+	{
+		LightBounds() : cosThetaO(1.0f), cosThetaE(1.0f), power(0.0f), empty(true)
+		{
+		}
+
+		LightBounds(const LightBVHItem& item);
+
+		void add(const LightBounds& other);
+
+		float importance(const Point& position, const Vector& normal) const;
+
+		Point	centroid() const
+		{
+			return Point((boundsMin.x + boundsMax.x) * 0.5f, (boundsMin.y + boundsMax.y) * 0.5f, (boundsMin.z + boundsMax.z) * 0.5f);
+		}
+
+		Point	boundsMin;
+		Point	boundsMax;
+		Vector	axis;
+		float	cosThetaO;
+		float	cosThetaE;
+		float	power;
+		bool	empty;
+	};
+
+protected:
+	struct Node
+	{
+		LightBounds		bounds;
+		// for interior nodes, the first child is always the next node, so this is the index of the second child.
+		// For leaves, it's the index of the light item.
+		uint32_t		index;
+		bool			isLeaf;
+	};
+
+	uint32_t buildRecursive(std::vector<LightBounds>& aBounds, std::vector<uint32_t>& aItemIndices, unsigned int start, unsigned int end,
+							uint64_t bitTrail, unsigned int depth);
+
+	float getInfiniteLightProbability() const;
+
+protected:
+	std::vector<Node>			m_aNodes;
+
+	// light index of each leaf's item
+	std::vector<unsigned int>	m_aItemLightIndices;
+
+	// per light index (for lights in the tree), the path of child choices from the root down to its leaf, so that
+	// we can calculate PDFs without searching the tree. ~0 for lights not in the tree.
+	std::vector<uint64_t>		m_aLightBitTrails;
+
+	std::vector<unsigned int>	m_aInfiniteLights;
+	// per light index, whether the light is an infinite one
+	std::vector<unsigned char>	m_aLightIsInfinite;
+
+	unsigned int				m_numLights;
+};
+
+} // namespace Imagine
+
+#endif // LIGHT_BVH_H
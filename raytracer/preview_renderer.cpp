@@ -38,6 +38,7 @@
 #include "utils/maths/rng.h"
 #include "utils/params.h"
 #include "utils/time_counter.h"
+#include "utils/profiler.h"
 
 #define ENABLE_SAMPLE_BUNDLE_REUSE 1
 #define ENABLE_CACHED_SAMPLE_BUNDLE_REUSE 1
@@ -50,6 +51,8 @@ namespace Imagine
 template <typename Integrator, typename Accumulator, typename TimeCounter>
 bool PreviewRenderer<Integrator, Accumulator, TimeCounter>::processTask(RenderTask* pRTask, unsigned int threadID)
 {
+	PROFILE_SCOPE("PreviewRenderer");
+
 	OutputImageTile* pOurImage = this->getThreadTempImage(threadID);
 
 	pOurImage->resetSamples();
@@ -103,6 +106,67 @@ bool PreviewRenderer<Integrator, Accumulator, TimeCounter>::processTask(RenderTa
 		IntegratorState draftIntegratorState(*this, this->getScene(), rng);
 		float totalAlphaForTile = 0.0f;
 
+		unsigned int draftScale = pRTask->getDraftScale();
+		if (draftScale > 1)
+		{
+			// time-budgeted reduced resolution draft - one ray per draftScale x draftScale block of pixels, with the colour
+			// duplicated over the block. Each finer pass (and then the full resolution one) replaces the previous one in
+			// the output image, so the pixel-doubled colours don't end up in the final image.
+			for (unsigned int blockY = 0; blockY < tileHeight; blockY += draftScale)
+			{
+				unsigned int blockHeight = std::min(draftScale, tileHeight - blockY);
+				float fPixelYPos = (float)(blockY + startY) + (float)blockHeight * 0.5f;
+
+				for (unsigned int blockX = 0; blockX < tileWidth; blockX += draftScale)
+				{
+					if (!pRTask->isActive())
+					{
+						pRTask->setDiscard(true);
+						return true;
+					}
+
+					unsigned int blockWidth = std::min(draftScale, tileWidth - blockX);
+					float fPixelXPos = (float)(blockX + startX) + (float)blockWidth * 0.5f;
+
+					colour = Colour4f();
+
+					Ray viewRay = pCamRayCreator->createBasicCameraRay(fPixelXPos, fPixelYPos);
+
+					if (viewRay.type != RAY_UNDEFINED)
+					{
+#if ENABLE_SAMPLE_BUNDLE_REUSE
+						samples.setNextPixel(fPixelXPos, fPixelYPos);
+						sampleGenerator.generateSampleBundleReuse(samples);
+#else
+						SampleBundle samples(fPixelXPos, fPixelYPos);
+						sampleGenerator.generateSampleBundle(samples);
+#endif
+
+						colour = this->m_integrator.processRay(*pRenderThreadCtx, shadingContext, viewRay, draftIntegratorState, samples, 0);
+					}
+
+					for (unsigned int y = blockY; y < blockY + blockHeight; y++)
+					{
+						for (unsigned int x = blockX; x < blockX + blockWidth; x++)
+						{
+							pOurImage->colourAt(x, y) = colour;
+							pOurImage->setSamplesAt(x, y, 1.0f);
+						}
+					}
+				}
+			}
+
+			this->getOutputImage()->setTileSamples(startX, startY, tileWidth, tileHeight, 1.0f);
+			this->getOutputImage()->copyColourTile(startX - this->getRenderWindowX(), startY - this->getRenderWindowY(),
+												   tileWidth, tileHeight, 0, 0, *pOurImage);
+
+			// re-queue it for the next finer draft pass, down to the normal full resolution one
+			pRTask->setDraftScale(draftScale / 2);
+			return false;
+		}
+
+		TimerCounter draftTimer(true);
+
 		for (unsigned int y = 0; y < tileHeight; y++)
 		{
 			float fPixelYPos = (float)y + startY + 0.5f;
@@ -122,7 +186,11 @@ bool PreviewRenderer<Integrator, Accumulator, TimeCounter>::processTask(RenderTa
 				Ray viewRay = pCamRayCreator->createBasicCameraRay(fPixelXPos, fPixelYPos);
 
 				if (viewRay.type == RAY_UNDEFINED)
+				{
+					// the whole tile's copied to the output image, so this pixel needs clearing
+					pOurImage->colourAt(x, y) = colour;
 					continue;
+				}
 
 #if ENABLE_SAMPLE_BUNDLE_REUSE
 				samples.setNextPixel(fPixelXPos, fPixelYPos);
@@ -141,9 +209,12 @@ bool PreviewRenderer<Integrator, Accumulator, TimeCounter>::processTask(RenderTa
 			}
 		}
 
-		// copy our finished tile into the output image
-		this->getOutputImage()->addColourTile(startX - this->getRenderWindowX(), startY - this->getRenderWindowY(),
-												  tileWidth, tileHeight, 0, 0, *pOurImage);
+		this->m_raytracer.recordPreviewDraftCost(draftTimer.stopReset(), tileWidth * tileHeight);
+
+		// copy our finished tile into the output image, replacing any reduced resolution draft of it
+		this->getOutputImage()->setTileSamples(startX, startY, tileWidth, tileHeight, 1.0f);
+		this->getOutputImage()->copyColourTile(startX - this->getRenderWindowX(), startY - this->getRenderWindowY(),
+											   tileWidth, tileHeight, 0, 0, *pOurImage);
 		
 		// on for ID-picking in Katana...
 		// do extra channels that can't be anti-aliased or averaged
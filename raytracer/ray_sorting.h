@@ -0,0 +1,55 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#ifndef RAY_SORTING_H
+#define RAY_SORTING_H
+
+#include <inttypes.h>
+
+#include "core/normal.h"
+
+namespace Imagine
+{
+
+// Helpers for building sort keys for batches of rays, so that they can be traced in a more coherent order.
+
+// 0 - 7 from the signs of the direction's components: rays in the same octant visit BVH children in the same order
+inline uint32_t getRayDirectionOctant(const Normal& direction)
+{
+	return (direction.x < 0.0f ? 1 : 0) | (direction.y < 0.0f ? 2 : 0) | (direction.z < 0.0f ? 4 : 0);
+}
+
+// spreads the lower 10 bits out so there are two zero bits between each
+inline uint32_t expandMortonBits(uint32_t value)
+{
+	value = (value * 0x00010001u) & 0xFF0000FFu;
+	value = (value * 0x00000101u) & 0x0F00F00Fu;
+	value = (value * 0x00000011u) & 0xC30C30C3u;
+	value = (value * 0x00000005u) & 0x49249249u;
+	return value;
+}
+
+// 30-bit Morton code from 10-bit (0 - 1023) quantised coordinates
+inline uint32_t calculateMortonCode(uint32_t x, uint32_t y, uint32_t z)
+{
+	return (expandMortonBits(x) << 2) | (expandMortonBits(y) << 1) | expandMortonBits(z);
+}
+
+} // namespace Imagine
+
+#endif // RAY_SORTING_H
@@ -33,6 +33,7 @@
 #include "bsdfs/baked_bsdf.h"
 
 #include "raytracer/camera_ray_creators/camera_ray_creator.h"
+#include "raytracer/camera_ray_creators/camera_ray_batch_creator.h"
 
 #include "global_context.h"
 #include "output_context.h"
@@ -83,13 +84,15 @@
 
 #include "utils/time_counter.h"
 #include "utils/system.h"
+#include "utils/high_res_clock.h"
+#include "utils/profiler.h"
 
 namespace Imagine
 {
 
 RenderTask::RenderTask(unsigned int startX, unsigned int startY, unsigned int width, unsigned int height, TileState state, unsigned int taskIndex)
 	: m_state(state), m_startX(startX), m_startY(startY), m_width(width), m_height(height), m_extraChannelsDone(false), m_iterationCount(0),
-	  m_taskIndex(taskIndex), m_discard(false)
+	  m_taskIndex(taskIndex), m_discard(false), m_draftScale(1)
 {
 }
 
@@ -98,14 +101,19 @@ RenderTask::~RenderTask()
 }
 
 static const unsigned int kTileSize = 32;
+static const unsigned int kTileSplitMinSize = 8;
+static const float kCheckpointInterval = 300.0f;
+static const unsigned int kMaxPreviewDraftScale = 8;
 
 Raytracer::Raytracer(SceneInterface& scene, OutputImage* outputImage, const Params& settings, bool preview, unsigned int threads)
 	: ThreadPool(threads, false), m_scene(scene), m_pOutputImage(outputImage), m_useRemoteClients(false), m_pRenderer(nullptr), m_pFilter(nullptr),
 	  m_tileApronSize(0), m_pSampleGeneratorFactory(nullptr), m_progressive(settings.getBool("progressive")), m_extraChannels(0),
 	  m_statsType(eStatisticsNone), m_statsOutputType(eStatsOutputConsole), m_preview(preview), m_pRenderCamera(nullptr), m_pCameraRayCreator(nullptr),
 	  m_pHost(nullptr), m_pGlobalImageCache(nullptr), m_backgroundType(eBackgroundNone),
-	  m_pBackground(nullptr), m_lightSampling(eLSFullAllLights), m_sampleLights(false), m_lightSamples(0), m_motionBlur(false), m_depthOfField(false),
-	  m_pDebugPathCollection(nullptr)
+	  m_pBackground(nullptr), m_lightSampling(eLSFullAllLights), m_sampleLights(false), m_lightSamples(0), m_motionBlur(false),
+	  m_depthOfField(false), m_previewTimeBudget(0.0f), m_previewDraftScale(1), m_previewDraftPixelCost(0.0f), m_previewDraftTime(0),
+	  m_previewDraftPixels(0), m_checkpointInterval(kCheckpointInterval), m_checkpointResume(false), m_resumedFromCheckpoint(false),
+	  m_lastCheckpointTime(0), m_pDebugPathCollection(nullptr)
 {
 	initialise(outputImage, settings, false);
 
@@ -118,10 +126,20 @@ Raytracer::Raytracer(SceneInterface& scene, unsigned int threads, bool progressi
 	m_pOutputImage(nullptr), m_useRemoteClients(false), m_pRenderer(nullptr), m_pFilter(nullptr), m_tileApronSize(0), m_pSampleGeneratorFactory(nullptr),
 	m_progressive(progressive),	m_preview(true), m_pRenderCamera(nullptr), m_pCameraRayCreator(nullptr), m_pHost(nullptr), m_pGlobalImageCache(nullptr),
 	m_backgroundType(eBackgroundNone), m_pBackground(nullptr),
-	m_lightSampling(eLSFullAllLights), m_sampleLights(false), m_lightSamples(0), m_motionBlur(false), m_pDebugPathCollection(nullptr)
+	m_lightSampling(eLSFullAllLights), m_sampleLights(false), m_lightSamples(0), m_motionBlur(false),
+	m_previewTimeBudget(0.0f), m_previewDraftScale(1), m_previewDraftPixelCost(0.0f), m_previewDraftTime(0), m_previewDraftPixels(0),
+	m_checkpointInterval(kCheckpointInterval), m_checkpointResume(false), m_resumedFromCheckpoint(false), m_lastCheckpointTime(0),
+	m_pDebugPathCollection(nullptr)
 {
 	// assumes that initialise() is going to be called later on
 	m_tileOrder = 0;
+	m_initialTileState = eTSBlank;
+	m_tileCostOrdering = true;
+	m_tileSplitting = true;
+	m_tileSplitMinSize = kTileSplitMinSize;
+	m_progressTotalPixels = 0;
+	m_progressPixelsDone = 0;
+	m_numaInterleave = true;
 
 	if (GlobalContext::instance().getRenderThreadsLowPriority())
 		m_lowPriorityThreads = true;
@@ -184,6 +202,9 @@ void Raytracer::initialise(OutputImage* outputImage, const Params& settings, boo
 
 	m_timeSeed = std::clock();
 
+	// so the clock's calibration spin happens now, rather than in the first timing of a render phase
+	HighResClock::calibrate();
+
 	m_width = settings.getUInt("width");
 	m_height = settings.getUInt("height");
 
@@ -217,6 +238,21 @@ void Raytracer::initialise(OutputImage* outputImage, const Params& settings, boo
 	m_tileSize = settings.getUInt("tile_size", kTileSize);
 	m_tileOrder = settings.getUInt("tile_order", 3);
 
+	m_tileCostOrdering = settings.getBool("tile_cost_ordering", true);
+	m_tileSplitting = settings.getBool("tile_splitting", true);
+	// sub-tiles are rendered into the per-thread m_tileSize tiles, so can't be bigger than that
+	m_tileSplitMinSize = std::min(std::max(settings.getUInt("tile_split_min_size", kTileSplitMinSize), 1u), m_tileSize);
+
+	m_progressTotalPixels = 0;
+	m_progressPixelsDone = 0;
+
+	m_numaInterleave = settings.getBool("numaInterleave", true);
+
+	m_previewTimeBudget = settings.getFloat("previewTimeBudget", 0.0f);
+
+	m_checkpointInterval = settings.getFloat("checkpointInterval", kCheckpointInterval);
+	m_checkpointResume = settings.getBool("checkpointResume", false);
+
 	unsigned int imageFlags = COMPONENT_RGBA;
 	if (m_progressive || settings.getUInt("integrator") > 0)
 		imageFlags = imageFlags | COMPONENT_SAMPLES;
@@ -256,6 +292,35 @@ void Raytracer::initialise(OutputImage* outputImage, const Params& settings, boo
 		imageFlags |= COMPONENT_ID;
 	}
 
+	// adaptive sampling convergence channels - these are only filled in by DirectIllumination's adaptive path,
+	// so only allocate them when that's going to be used, otherwise they'd just be output as black
+	bool wantConvergenceChannels = settings.getBool("output_variance") || settings.getBool("output_sample_count");
+	if (wantConvergenceChannels)
+	{
+		unsigned int antiAliasing = settings.getUInt("antiAliasing");
+		bool adaptiveSampling = settings.getUInt("integrator", 0) == 0 && settings.getBool("adaptiveSampling", false) &&
+								antiAliasing * antiAliasing > 1 && !m_progressive;
+
+		if (adaptiveSampling)
+		{
+			if (settings.getBool("output_variance"))
+			{
+				m_extraChannels |= COMPONENT_VARIANCE;
+				imageFlags |= COMPONENT_VARIANCE;
+			}
+
+			if (settings.getBool("output_sample_count"))
+			{
+				m_extraChannels |= COMPONENT_SAMPLE_COUNT;
+				imageFlags |= COMPONENT_SAMPLE_COUNT;
+			}
+		}
+		else
+		{
+			GlobalContext::instance().getLogger().warning("Variance and sample count output channels are only available with non-progressive adaptive sampling in the direct illumination integrator - ignoring them.");
+		}
+	}
+
 	if (settings.getBool("deep"))
 	{
 		imageFlags |= COMPONENT_DEEP;
@@ -366,7 +431,7 @@ void Raytracer::initialise(OutputImage* outputImage, const Params& settings, boo
 	
 		// if we have more than one processor socket, initialise things differently
 		System::CPUInfo cpuInfo = System::getCPUInfo();
-		bool initOnThreads = cpuInfo.numSockets > 1 && m_numberOfThreads > 1;
+		bool initOnThreads = (cpuInfo.numSockets > 1 || cpuInfo.numNUMANodes > 1) && m_numberOfThreads > 1;
 	
 		if (initOnThreads)
 		{
@@ -760,9 +825,24 @@ void Raytracer::configureBackground()
 
 void Raytracer::renderScene(float time, const Params* pParams, bool waitForCompletion, bool isRestart)
 {
+	const bool profiling = !m_profileTracePath.empty() && waitForCompletion;
+	if (profiling)
+	{
+		Profiler::clear();
+		Profiler::setEnabled(true);
+	}
+
+	uint64_t phaseStartTicks = HighResClock::getTicks();
+
 	// build lights first, because createTileJobs() needs to know if there are lights for the DirectIllumination integrator
 	m_scene.buildRenderLights();
 
+	m_resumedFromCheckpoint = false;
+	if (isCheckpointing() && m_checkpointResume)
+	{
+		m_resumedFromCheckpoint = loadCheckpoint();
+	}
+
 	// create the tile jobs first, so that we can send stuff to remote clients to render
 	createTileJobs();
 
@@ -778,8 +858,11 @@ void Raytracer::renderScene(float time, const Params* pParams, bool waitForCompl
 
 	updateCameraRayCreator();
 
+	uint64_t preRenderStartTicks = HighResClock::getTicks();
+
 	{
 		Timer time1("Scene pre-renders", GlobalContext::instance().getLogger(), !m_preview);
+		PROFILE_SCOPE("Scene pre-renders");
 
 		m_pRenderCamera->init(m_width, m_height, time);
 
@@ -788,6 +871,15 @@ void Raytracer::renderScene(float time, const Params* pParams, bool waitForCompl
 
 		bool reRender = isRestart;
 
+		// on NUMA machines, spread the geometry and acceleration structures built here over all nodes' memory, rather than
+		// them all being on the main thread's node, with the render threads on the other nodes doing remote accesses
+		// for every traversal. The build threads inherit the policy.
+		bool numaInterleave = m_numaInterleave && System::getCPUInfo().numNUMANodes > 1;
+		if (numaInterleave && !System::setMemoryInterleaving(true))
+		{
+			numaInterleave = false;
+		}
+
 		if (pParams)
 		{
 			reRender = pParams->getBool("integrated_rerender", false);
@@ -815,9 +907,20 @@ void Raytracer::renderScene(float time, const Params* pParams, bool waitForCompl
 			requirements.reRender = reRender;
 			m_scene.doPreRenders(requirements);
 		}
+
+		if (numaInterleave)
+		{
+			System::setMemoryInterleaving(false);
+		}
 	}
 
-	m_timeSeed = std::clock();
+	uint64_t preRenderEndTicks = HighResClock::getTicks();
+
+	// resumed renders need to carry on with the same random sequences
+	if (!m_resumedFromCheckpoint)
+	{
+		m_timeSeed = std::clock();
+	}
 
 	// this is needed after the tasks have been added.
 	// sets up lights and lightsamples, and other things which are done
@@ -845,9 +948,23 @@ void Raytracer::renderScene(float time, const Params* pParams, bool waitForCompl
 		// explicitly turn on affinity setting for threads...
 		m_setAffinity = true;
 
+		uint64_t renderStartTicks = HighResClock::getTicks();
+
 		if (waitForCompletion)
 		{
 			startPool(POOL_WAIT_FOR_COMPLETION);
+
+			if (m_useRemoteClients)
+			{
+				// wait for the remote clients, then render any tiles left by clients which went away after the
+				// local threads finished
+				m_clientJobManager.wait();
+
+				if (queueReleasedRemoteTiles() > 0)
+				{
+					startPool(POOL_WAIT_FOR_COMPLETION);
+				}
+			}
 		}
 		else
 		{
@@ -855,6 +972,10 @@ void Raytracer::renderScene(float time, const Params* pParams, bool waitForCompl
 			return;
 		}
 
+		m_lastRenderPhaseTimes.setupSeconds = HighResClock::ticksToSeconds(preRenderStartTicks - phaseStartTicks);
+		m_lastRenderPhaseTimes.preRenderSeconds = HighResClock::ticksToSeconds(preRenderEndTicks - preRenderStartTicks);
+		m_lastRenderPhaseTimes.renderSeconds = HighResClock::ticksToSeconds(HighResClock::getTicks() - renderStartTicks);
+
 		if (m_pHost)
 		{
 			// call finished on the host, so it can finalise stuff
@@ -895,12 +1016,19 @@ void Raytracer::renderScene(float time, const Params* pParams, bool waitForCompl
 				totalStatistics.writeStatistics(statsPath, frameNumber);
 			}
 		}
+	}
+
+	if (profiling)
+	{
+		Profiler::setEnabled(false);
 
-		// if remote render, need to wait for results server
-		// TODO: this should probably be above...
-		if (m_useRemoteClients)
+		if (Profiler::writeChromeTrace(m_profileTracePath))
+		{
+			GlobalContext::instance().getLogger().notice("Profile trace written to: %s", m_profileTracePath.c_str());
+		}
+		else
 		{
-			m_clientJobManager.wait();
+			GlobalContext::instance().getLogger().error("Can't write profile trace to: %s", m_profileTracePath.c_str());
 		}
 	}
 }
@@ -930,9 +1058,39 @@ void Raytracer::createTileJobs()
 		initalState = eTSAA;
 	}
 
+	m_initialTileState = initalState;
+
+	m_progressTotalPixels = 0;
+	m_progressPixelsDone = 0;
+
+	m_tileCosts.beginRender(tilesX, tilesY, m_tileSize);
+
+	m_previewDraftScale = calculatePreviewDraftScale();
+
 	std::vector<TileCoord> aTiles;
 	TileTaskGeneratorFactory::generateTilePositions(tilesX, tilesY, aTiles, m_tileOrder);
 
+	if (m_tileCostOrdering)
+	{
+		// if we've got costs from the last render (or draft pass) of the same tile layout, issue the most expensive
+		// tiles first, so that they don't end up being the last ones to finish with the other threads idle.
+		m_tileCosts.sortTilesByCost(aTiles);
+	}
+
+	if (isCheckpointing())
+	{
+		std::vector<RenderCheckpoint::TileProgress>& aTileProgress = m_checkpoint.getTileProgress();
+		if (!m_resumedFromCheckpoint || aTileProgress.size() != tilesX * tilesY)
+		{
+			m_resumedFromCheckpoint = false;
+			aTileProgress.assign(tilesX * tilesY, RenderCheckpoint::TileProgress(initalState));
+		}
+
+		m_checkpoint.setRenderLayout(m_width, m_height, m_renderWindowX, m_renderWindowY, m_renderWindowWidth, m_renderWindowHeight, m_tileSize);
+
+		m_lastCheckpointTime = time(nullptr);
+	}
+
 	if (!m_useRemoteClients)
 	{
 		unsigned int taskIndex = 0;
@@ -942,82 +1100,106 @@ void Raytracer::createTileJobs()
 		{
 			const TileCoord& tc = *it;
 
+			TileState tileState = initalState;
+			unsigned int tileIterations = 0;
+
+			if (m_resumedFromCheckpoint)
+			{
+				const RenderCheckpoint::TileProgress& progress = m_checkpoint.getTileProgress()[tc.y * tilesX + tc.x];
+				if (progress.done)
+					continue;
+
+				tileState = progress.state;
+				tileIterations = progress.iterations;
+			}
+
 			unsigned int xPos = (tc.x * m_tileSize) + m_renderWindowX;
 			unsigned int yPos = (tc.y * m_tileSize) + m_renderWindowY;
 
 			unsigned int tileWidth = std::min(m_renderWindowX + width - xPos, m_tileSize);
 			unsigned int tileHeight = std::min(m_renderWindowY + height - yPos, m_tileSize);
 
-			RenderTask* pNewTask = new RenderTask(xPos, yPos, tileWidth, tileHeight, initalState, taskIndex++);
+			RenderTask* pNewTask = new RenderTask(xPos, yPos, tileWidth, tileHeight, tileState, taskIndex++);
+			pNewTask->setIterations(tileIterations);
+			pNewTask->setDraftScale(m_previewDraftScale);
 			addTaskNoLock(pNewTask);
+
+			m_progressTotalPixels += tileWidth * tileHeight;
 		}
 	}
 	else
 	{
-		// we're rendering some tiles remotely, so work out the ratio we're going to send over...
+		// we're rendering some tiles remotely. Local tasks are created for all tiles, and local threads claim them from
+		// the scheduler as they start them, skipping any a remote client has got.
+		// RenderClientJobManager only takes a fixed list of tiles, rather than pulling them on demand through
+		// RemoteTileSource, so the clients' share (by thread count) is taken from the back of the tile order up front.
+		m_remoteTileScheduler.reset(aTiles);
+
 		unsigned int remoteThreadsAvailable = m_clientJobManager.getTotalRenderClientThreads();
-		unsigned int localThreadsAvailable = m_numberOfThreads;
+		unsigned int totalThreads = remoteThreadsAvailable + m_numberOfThreads;
+		unsigned int numTasksToSend = (unsigned int)(((uint64_t)aTiles.size() * remoteThreadsAvailable) / std::max(totalThreads, 1u));
 
-		unsigned int totalThreads = remoteThreadsAvailable + localThreadsAvailable;
-		float ratioRemoteJobs = (float)totalThreads / (float)remoteThreadsAvailable;
-		unsigned int totalTasks = aTiles.size();
-		unsigned int numTasksToSend = (float)totalTasks / ratioRemoteJobs;
+		std::vector<unsigned int> aRemoteTileIndices;
+		m_remoteTileScheduler.requestRemoteTiles(0, numTasksToSend, aRemoteTileIndices);
 
-		unsigned int pickStride = totalTasks / numTasksToSend;
 		std::vector<TileCoord> aRemoteTiles;
-
-		bool inversePick = false;
-
-		// TODO:: fix this properly
-		if (pickStride == 1)
+		std::vector<unsigned int>::const_iterator itRemote = aRemoteTileIndices.begin();
+		for (; itRemote != aRemoteTileIndices.end(); ++itRemote)
 		{
-			// we're sending a larger ratio of tasks remotely than we're doing locally...
-			pickStride = totalTasks / (totalTasks - numTasksToSend);
-
-			inversePick = true;
+			aRemoteTiles.emplace_back(m_remoteTileScheduler.getTile(*itRemote));
 		}
 
-		unsigned int index = 0;
+		unsigned int taskIndex = 0;
 		std::vector<TileCoord>::iterator it = aTiles.begin();
 		for (; it != aTiles.end(); ++it)
 		{
 			const TileCoord& tc = *it;
 
-			if (!inversePick)
-			{
-				if (index++ % pickStride == 0)
-				{
-					// add to tiles we're going to send to the remote client to render...
-					aRemoteTiles.emplace_back(tc);
-					// continue to the next task...
-					continue;
-				}
-			}
-			else
-			{
-				if (index++ % pickStride != 0)
-				{
-					// add to tiles we're going to send to the remote client to render...
-					aRemoteTiles.emplace_back(tc);
-					// continue to the next task...
-					continue;
-				}
-			}
-
 			unsigned int xPos = (tc.x * m_tileSize) + m_renderWindowX;
 			unsigned int yPos = (tc.y * m_tileSize) + m_renderWindowY;
 
 			unsigned int tileWidth = std::min(m_renderWindowX + width - xPos, m_tileSize);
 			unsigned int tileHeight = std::min(m_renderWindowY + height - yPos, m_tileSize);
 
-			RenderTask* pNewTask = new RenderTask(xPos, yPos, tileWidth, tileHeight, initalState, index);
+			RenderTask* pNewTask = new RenderTask(xPos, yPos, tileWidth, tileHeight, initalState, taskIndex++);
 			addTaskNoLock(pNewTask);
+
+			m_progressTotalPixels += tileWidth * tileHeight;
 		}
 
 		m_clientJobManager.addTasks(aRemoteTiles);
 	}
 }
 
+unsigned int Raytracer::queueReleasedRemoteTiles()
+{
+	std::vector<unsigned int> aTileIndices;
+	if (m_remoteTileScheduler.takeReleasedTiles(aTileIndices) == 0)
+		return 0;
+
+	unsigned int width = m_renderWindowWidth;
+	unsigned int height = m_renderWindowHeight;
+
+	std::vector<unsigned int>::const_iterator it = aTileIndices.begin();
+	for (; it != aTileIndices.end(); ++it)
+	{
+		unsigned int tileIndex = *it;
+		const TileCoord& tc = m_remoteTileScheduler.getTile(tileIndex);
+
+		unsigned int xPos = (tc.x * m_tileSize) + m_renderWindowX;
+		unsigned int yPos = (tc.y * m_tileSize) + m_renderWindowY;
+
+		unsigned int tileWidth = std::min(m_renderWindowX + width - xPos, m_tileSize);
+		unsigned int tileHeight = std::min(m_renderWindowY + height - yPos, m_tileSize);
+
+		// task indices are the scheduler's tile indices
+		RenderTask* pNewTask = new RenderTask(xPos, yPos, tileWidth, tileHeight, m_initialTileState, tileIndex);
+		addTask(pNewTask);
+	}
+
+	return (unsigned int)aTileIndices.size();
+}
+
 void Raytracer::renderTile(OutputImageTile& outputTile, unsigned int x, unsigned int y, unsigned int r, unsigned int t, bool deep)
 {
 	RenderTask newTask(x, y, r - x, t- y, eTSBlank, 0);
@@ -1053,20 +1235,18 @@ void Raytracer::processExtraChannels(RenderTask* pTask, unsigned int threadID) c
 		unsigned int tileWidth = pTask->getWidth();
 		unsigned int tileHeight = pTask->getHeight();
 
+		std::vector<Ray> aRowRays(tileWidth);
+
 		for (unsigned int y = 0; y < tileHeight; y++)
 		{
-			unsigned int pixelYPos = y + startY;
-			float fPixelYPos = (float)pixelYPos + 0.5f;
-
 			if (!pTask->isActive())
 				return;
 
+			createPixelCentreCameraRays(m_pCameraRayCreator, startX, y + startY, tileWidth, &aRowRays[0]);
+
 			for (unsigned int x = 0; x < tileWidth; x++)
 			{
-				unsigned int pixelXPos = x + startX;
-				float fPixelXPos = (float)pixelXPos + 0.5f;
-
-				Ray viewRay = m_pCameraRayCreator->createBasicCameraRay(fPixelXPos, fPixelYPos);
+				Ray& viewRay = aRowRays[x];
 
 				if (m_motionBlur)
 				{
@@ -1080,25 +1260,10 @@ void Raytracer::processExtraChannels(RenderTask* pTask, unsigned int threadID) c
 				float depth;
 				HitResult hitResult = processRayExtra(*pRenderThreadCtx, shadingContext, viewRay, depth);
 
-				if (m_extraChannels & COMPONENT_DEPTH)
-					pOurImage->setDepthAt(x, y, depth);
+				PrimaryHitChannels primaryHit;
+				primaryHit.setFromHit(hitResult, depth, hitResult.objID);
 
-				if (m_extraChannels & COMPONENT_NORMAL)
-				{
-					Colour3f normal(hitResult.shaderNormal.x, hitResult.shaderNormal.y, hitResult.shaderNormal.z);
-					pOurImage->setNormalAt(x, y, normal);
-				}
-
-				if (m_extraChannels & COMPONENT_WPP)
-				{
-					Colour3f wpp(hitResult.hitPoint.x, hitResult.hitPoint.y, hitResult.hitPoint.z);
-					pOurImage->setWPPAt(x, y, wpp);
-				}
-
-				if (m_extraChannels & COMPONENT_ID)
-				{
-					pOurImage->setIDAt(x, y, (float)hitResult.objID);
-				}
+				setTilePixelExtraChannelsFromHit(primaryHit, m_extraChannels, pOurImage, x, y);
 			}
 		}
 
@@ -1107,6 +1272,16 @@ void Raytracer::processExtraChannels(RenderTask* pTask, unsigned int threadID) c
 	}
 }
 
+void Raytracer::copyExtraChannelsTile(RenderTask* pTask, unsigned int threadID) const
+{
+	if (!m_extraChannels)
+		return;
+
+	const OutputImageTile* pOurImage = m_aThreadTempImages[threadID];
+
+	m_pOutputImage->copyExtraTile(pTask->getStartX(), pTask->getStartY(), pTask->getWidth(), pTask->getHeight(), 0, 0, *pOurImage);
+}
+
 HitResult Raytracer::processRayExtra(RenderThreadContext& rtc, ShadingContext& shadingContext, Ray& viewRay, float& t) const
 {
 	HitResult hitResult;
@@ -1211,7 +1386,7 @@ void Raytracer::setupRenderThreadContextLightSampling()
 	unsigned int localisedSampleCount = std::min(numLights, 64u);
 
 	System::CPUInfo cpuInfo = System::getCPUInfo();
-	bool initOnThreads = cpuInfo.numSockets > 1;
+	bool initOnThreads = cpuInfo.numSockets > 1 || cpuInfo.numNUMANodes > 1;
 	bool haveInitialisedPerThreadData = false;
 
 	if (initOnThreads)
@@ -1282,7 +1457,61 @@ bool Raytracer::doTask(ThreadPoolTask* pTask, unsigned int threadID)
 
 	RenderTask* pThisTask = static_cast<RenderTask*>(pTask);
 
-	bool ret = m_pRenderer->processTask(pThisTask, threadID);
+	if (m_useRemoteClients && m_isActive && pThisTask->getState() == m_initialTileState && pThisTask->getIterations() == 0)
+	{
+		queueReleasedRemoteTiles();
+
+		if (!m_remoteTileScheduler.claimLocalTile(pThisTask->getTaskIndex()))
+		{
+			// a remote client's rendering this one
+			pThisTask->setDiscard(true);
+			m_progressPixelsDone += pThisTask->getWidth() * pThisTask->getHeight();
+			return true;
+		}
+	}
+
+	// sub-tiles would share their tile's checkpoint progress, so splitting isn't done while checkpointing
+	const bool checkpointing = isCheckpointing() && m_isActive;
+
+	if (m_tileSplitting && !checkpointing && splitTaskForTail(pThisTask))
+	{
+		// the sub-tiles will do the work
+		return true;
+	}
+
+	if (checkpointing)
+	{
+		// wait for any checkpoint being written - pthread rw locks generally prefer readers, so without this
+		// the writer could be starved by the other threads starting new tasks.
+		m_checkpointWriteGate.lock();
+		m_checkpointWriteGate.unlock();
+
+		m_checkpointLock.readLock();
+	}
+
+	TimerCounter tileTimer(true);
+
+	bool ret = false;
+	{
+		PROFILE_SCOPE("Tile");
+		ret = m_pRenderer->processTask(pThisTask, threadID);
+	}
+
+	recordTileCost(pThisTask, tileTimer.stopReset());
+
+	if (ret)
+	{
+		m_progressPixelsDone += pThisTask->getWidth() * pThisTask->getHeight();
+	}
+
+	if (checkpointing)
+	{
+		updateCheckpointTileProgress(pThisTask, ret);
+		m_checkpointLock.unlock();
+
+		writeCheckpointIfDue();
+	}
+
 #ifndef IMAGINE_EMBEDDED_MODE
 	if (m_pHost && !m_wasCancelled && !pThisTask->shouldDiscard())
 #else
@@ -1305,4 +1534,201 @@ bool Raytracer::doTask(ThreadPoolTask* pTask, unsigned int threadID)
 	return ret;
 }
 
+bool Raytracer::splitTaskForTail(RenderTask* pTask)
+{
+	// only split tiles which haven't been started yet, and only while the pool's running (i.e. not for renderTile())
+	if (!m_isActive || m_wasCancelled || pTask->getState() != m_initialTileState || pTask->getIterations() > 0)
+		return false;
+
+	unsigned int width = pTask->getWidth();
+	unsigned int height = pTask->getHeight();
+
+	bool splitX = width >= m_tileSplitMinSize * 2;
+	bool splitY = height >= m_tileSplitMinSize * 2;
+
+	if (!splitX && !splitY)
+		return false;
+
+	unsigned int startX = pTask->getStartX();
+	unsigned int startY = pTask->getStartY();
+
+	unsigned int subWidth = splitX ? width / 2 : width;
+	unsigned int subHeight = splitY ? height / 2 : height;
+
+	// the queue length check and the insert need to be done together, otherwise several threads could all see
+	// a short queue and split at the same time
+	m_lock.lock();
+
+	if (m_aTasks.size() >= m_numberOfThreads)
+	{
+		m_lock.unlock();
+		return false;
+	}
+
+	std::vector<ThreadPoolTask*> aSubTasks;
+
+	for (unsigned int subY = startY; subY < startY + height; subY += subHeight)
+	{
+		unsigned int thisHeight = std::min(subHeight, startY + height - subY);
+
+		for (unsigned int subX = startX; subX < startX + width; subX += subWidth)
+		{
+			unsigned int thisWidth = std::min(subWidth, startX + width - subX);
+
+			// keep the same task index, so that anything keyed off it still maps back to the original tile
+			RenderTask* pSubTask = new RenderTask(subX, subY, thisWidth, thisHeight, pTask->getState(), pTask->getTaskIndex());
+			pSubTask->setIterations(pTask->getIterations());
+			pSubTask->setDraftScale(pTask->getDraftScale());
+			pSubTask->setExtraChannelsDone(pTask->extraChannelsDone());
+			aSubTasks.emplace_back(pSubTask);
+		}
+	}
+
+	addTasksToFrontNoLock(aSubTasks);
+
+	m_lock.unlock();
+
+	return true;
+}
+
+void Raytracer::recordTileCost(RenderTask* pTask, uint64_t cost)
+{
+	if (m_wasCancelled || pTask->shouldDiscard())
+		return;
+
+	// sub-tiles get added to the tile they were split from
+	unsigned int tileX = (pTask->getStartX() - m_renderWindowX) / m_tileSize;
+	unsigned int tileY = (pTask->getStartY() - m_renderWindowY) / m_tileSize;
+
+	m_tileCosts.addCost(tileX, tileY, cost);
+}
+
+void Raytracer::recordPreviewDraftCost(uint64_t cost, unsigned int numPixels)
+{
+	if (m_wasCancelled)
+		return;
+
+	m_previewDraftCostLock.lock();
+
+	m_previewDraftTime += cost;
+	m_previewDraftPixels += numPixels;
+
+	m_previewDraftCostLock.unlock();
+}
+
+unsigned int Raytracer::calculatePreviewDraftScale()
+{
+	// fold in the cost of the last render's draft pass (if it got far enough to have one)
+	if (m_previewDraftPixels > 0)
+	{
+		m_previewDraftPixelCost = (float)m_previewDraftTime / (float)m_previewDraftPixels;
+
+		m_previewDraftTime = 0;
+		m_previewDraftPixels = 0;
+	}
+
+	if (m_previewTimeBudget <= 0.0f || m_previewDraftPixelCost <= 0.0f)
+		return 1;
+
+	float numPixels = (float)m_renderWindowWidth * (float)m_renderWindowHeight;
+	float estimatedDraftTime = m_previewDraftPixelCost * numPixels / (float)std::max(m_numberOfThreads, 1u) / 1000.0f;
+
+	unsigned int draftScale = 1;
+	while (draftScale < kMaxPreviewDraftScale && estimatedDraftTime / (float)(draftScale * draftScale) > m_previewTimeBudget)
+	{
+		draftScale *= 2;
+	}
+
+	return draftScale;
+}
+
+bool Raytracer::loadCheckpoint()
+{
+	RenderCheckpoint checkpoint;
+	if (!checkpoint.readFromFile(m_checkpointPath))
+	{
+		// there won't be one the first time around
+		GlobalContext::instance().getLogger().notice("No valid render checkpoint found at: %s - rendering from the start.", m_checkpointPath.c_str());
+		return false;
+	}
+
+	RenderCheckpoint currentLayout;
+	currentLayout.setRenderLayout(m_width, m_height, m_renderWindowX, m_renderWindowY, m_renderWindowWidth, m_renderWindowHeight, m_tileSize);
+
+	if (!checkpoint.hasSameRenderLayout(currentLayout))
+	{
+		GlobalContext::instance().getLogger().error("Render checkpoint: %s is for a different resolution, crop or tile size, so can't be resumed from.",
+													m_checkpointPath.c_str());
+		return false;
+	}
+
+	if (!checkpoint.readImageFromFile(m_checkpointPath, *m_pOutputImage))
+	{
+		GlobalContext::instance().getLogger().error("Can't read image from render checkpoint: %s - rendering from the start.", m_checkpointPath.c_str());
+		// it may have been partially read
+		m_pOutputImage->clearImage();
+		return false;
+	}
+
+	m_checkpoint = checkpoint;
+	m_timeSeed = checkpoint.getTimeSeed();
+
+	GlobalContext::instance().getLogger().notice("Resuming render from checkpoint: %s", m_checkpointPath.c_str());
+
+	return true;
+}
+
+void Raytracer::updateCheckpointTileProgress(RenderTask* pTask, bool taskFinished)
+{
+	if (m_wasCancelled || pTask->shouldDiscard())
+		return;
+
+	unsigned int tilesX = m_renderWindowWidth / m_tileSize;
+	if (m_renderWindowWidth % m_tileSize > 0)
+		tilesX ++;
+
+	unsigned int tileX = (pTask->getStartX() - m_renderWindowX) / m_tileSize;
+	unsigned int tileY = (pTask->getStartY() - m_renderWindowY) / m_tileSize;
+
+	// each tile only has one task in flight, so there's no need to lock this
+	RenderCheckpoint::TileProgress& progress = m_checkpoint.getTileProgress()[tileY * tilesX + tileX];
+	progress.state = pTask->getState();
+	progress.iterations = pTask->getIterations();
+	progress.done = taskFinished;
+}
+
+void Raytracer::writeCheckpointIfDue()
+{
+	if (m_checkpointInterval <= 0.0f || m_wasCancelled)
+		return;
+
+	// only one thread should write each checkpoint, so claim it by resetting the time
+	m_checkpointTimeLock.lock();
+	time_t currentTime = time(nullptr);
+	bool due = difftime(currentTime, m_lastCheckpointTime) >= m_checkpointInterval;
+	if (due)
+	{
+		m_lastCheckpointTime = currentTime;
+	}
+	m_checkpointTimeLock.unlock();
+
+	if (!due)
+		return;
+
+	m_checkpointWriteGate.lock();
+	// this waits for the other threads to finish their current tasks
+	m_checkpointLock.writeLock();
+
+	m_checkpoint.setTimeSeed(m_timeSeed);
+	bool written = m_checkpoint.writeToFile(m_checkpointPath, *m_pOutputImage);
+
+	m_checkpointLock.unlock();
+	m_checkpointWriteGate.unlock();
+
+	if (!written)
+	{
+		GlobalContext::instance().getLogger().error("Can't write render checkpoint: %s", m_checkpointPath.c_str());
+	}
+}
+
 } // namespace Imagine
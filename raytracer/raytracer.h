@@ -21,8 +21,11 @@
 
 #include <vector>
 #include <string>
+#include <ctime>
+#include <atomic>
 
 #include "utils/threads/thread_pool.h"
+#include "utils/threads/rw_lock.h"
 
 #include "scene_common.h"
 
@@ -30,6 +33,9 @@
 #include "colour/colour4f.h"
 
 #include "raytracer_common.h"
+#include "tile_cost_map.h"
+#include "render_checkpoint.h"
+#include "remote_tile_scheduler.h"
 
 #include "remote/render_client_job_manager.h"
 
@@ -78,12 +84,17 @@ public:
 
 	unsigned int getIterations() const { return m_iterationCount; }
 	void incrementIterations() { m_iterationCount++; }
+	void setIterations(unsigned int iterations) { m_iterationCount = iterations; }
 
 	unsigned int getTaskIndex() const { return m_taskIndex; }
 
 	bool shouldDiscard() const { return m_discard; }
 	void setDiscard(bool discard) { m_discard = discard; }
 
+	// for time-budgeted previews, the pixel block size the next draft pass of the tile should be rendered at
+	unsigned int getDraftScale() const { return m_draftScale; }
+	void setDraftScale(unsigned int draftScale) { m_draftScale = draftScale; }
+
 
 
 protected:
@@ -101,6 +112,8 @@ protected:
 	unsigned int	m_taskIndex;
 
 	bool			m_discard;
+
+	unsigned int	m_draftScale;
 };
 
 class Raytracer : public ThreadPool
@@ -134,9 +147,31 @@ public:
 
 	void setStatisticsOutputPath(const std::string& statsOutputPath) { m_statsOutputPath = statsOutputPath; }
 
+	// if set, the render's state is periodically saved to this path, and (with the "checkpointResume" setting)
+	// renders are resumed from it if it exists.
+	void setCheckpointPath(const std::string& checkpointPath) { m_checkpointPath = checkpointPath; }
+
+	// if set, profiling zones are recorded during the render, and written to this path as Chrome trace JSON
+	// once it's finished (only for renders which wait for completion)
+	void setProfileTracePath(const std::string& profileTracePath) { m_profileTracePath = profileTracePath; }
+
 	// render the scene as an entire image
 	void renderScene(float time, const Params* pParams, bool waitForCompletion, bool isRestart = false);
 
+	// wall-clock times of the phases of the last renderScene() call which waited for completion
+	struct RenderPhaseTimes
+	{
+		RenderPhaseTimes() : setupSeconds(0.0), preRenderSeconds(0.0), renderSeconds(0.0)
+		{
+		}
+
+		double		setupSeconds; // lights and tile jobs
+		double		preRenderSeconds; // geometry and acceleration structure builds
+		double		renderSeconds;
+	};
+
+	const RenderPhaseTimes& getLastRenderPhaseTimes() const { return m_lastRenderPhaseTimes; }
+
 	// render just a single tile - currently used for scanline rendering in Nuke
 	void renderTile(OutputImageTile& outputTile, unsigned int x, unsigned int y, unsigned int r, unsigned int t, bool deep);
 
@@ -146,7 +181,10 @@ public:
 
 	void taskDone();
 
+	// traces separate camera rays for the extra channels - renderers which capture the primary hits of their
+	// beauty samples (via PrimaryHitChannels) should set the values themselves and just call copyExtraChannelsTile().
 	void processExtraChannels(RenderTask* pTask, unsigned int threadID) const;
+	void copyExtraChannelsTile(RenderTask* pTask, unsigned int threadID) const;
 
 	HitResult processRayExtra(RenderThreadContext& rtc, ShadingContext& shadingContext, Ray& viewRay, float& t) const;
 
@@ -163,6 +201,9 @@ public:
 
 	bool isProgressive() const { return m_progressive; }
 
+	// full resolution draft pass render time (in microseconds) of a tile, for choosing the draft scale of the next render
+	void recordPreviewDraftCost(uint64_t cost, unsigned int numPixels);
+
 	void setDebugPathCollection(DebugPathCollection* pDPC) { m_pDebugPathCollection = pDPC;}
 	DebugPathCollection* getDebugPathCollection() const { return m_pDebugPathCollection; }
 	
@@ -172,12 +213,34 @@ public:
 protected:
 	virtual bool doTask(ThreadPoolTask* pTask, unsigned int threadID);
 
+	// if there aren't enough queued tasks left to keep all threads busy, splits the (unstarted) task into
+	// sub-tiles which are added to the front of the queue. Returns true if the task was split.
+	bool splitTaskForTail(RenderTask* pTask);
+
+	void recordTileCost(RenderTask* pTask, uint64_t cost);
+
+	// adds local tasks for tiles which remote clients went away with after local threads had skipped them.
+	// Returns the number of tasks added.
+	unsigned int queueReleasedRemoteTiles();
+
+	// the pixel block size to render the first draft passes at so that they should take less than the preview time budget,
+	// based on the cost of the last render's draft pass
+	unsigned int calculatePreviewDraftScale();
+
+	bool isCheckpointing() const { return !m_checkpointPath.empty() && !m_useRemoteClients; }
+	// restores the output image and tile progress from the checkpoint file if it matches the current render
+	bool loadCheckpoint();
+	void updateCheckpointTileProgress(RenderTask* pTask, bool taskFinished);
+	void writeCheckpointIfDue();
+
 protected:
 	SceneInterface&			m_scene;
 	OutputImage*			m_pOutputImage;
 
 	bool					m_useRemoteClients;
 	RenderClientJobManager	m_clientJobManager;
+	// tiles are shared out between local threads and remote clients dynamically through this
+	RemoteTileScheduler		m_remoteTileScheduler;
 
 	Mutex					m_imageLock;
 
@@ -195,6 +258,10 @@ protected:
 	StatisticsOutputType	m_statsOutputType;
 	std::string				m_statsOutputPath;
 
+	std::string				m_profileTracePath;
+
+	RenderPhaseTimes		m_lastRenderPhaseTimes;
+
 	// these are used for each thread to write into its own tile, which is then copied to
 	// the target image when the tile is complete.
 	std::vector<OutputImageTile*>		m_aThreadTempImages;
@@ -246,6 +313,43 @@ protected:
 	unsigned int			m_tileSize;
 	unsigned int			m_tileOrder;
 
+	TileState				m_initialTileState;
+
+	//! per-tile render times from the last render, used to issue expensive tiles first
+	TileCostMap				m_tileCosts;
+	bool					m_tileCostOrdering;
+
+	bool					m_tileSplitting;
+	unsigned int			m_tileSplitMinSize;
+
+	//! non-progressive render progress, in pixels rather than tasks, so that splitting tiles doesn't make it go backwards
+	uint64_t				m_progressTotalPixels;
+	std::atomic<uint64_t>	m_progressPixelsDone;
+
+	//! interleave memory allocated by the scene pre-renders over all NUMA nodes
+	bool					m_numaInterleave;
+
+	//! time-budgeted preview draft passes
+	float					m_previewTimeBudget; // milliseconds, 0 to disable
+	unsigned int			m_previewDraftScale;
+	float					m_previewDraftPixelCost; // microseconds per pixel, from the last render
+	Mutex					m_previewDraftCostLock;
+	uint64_t				m_previewDraftTime;
+	uint64_t				m_previewDraftPixels;
+
+	//! checkpointing, so that interrupted renders can be resumed
+	std::string				m_checkpointPath;
+	float					m_checkpointInterval; // seconds
+	bool					m_checkpointResume;
+	bool					m_resumedFromCheckpoint;
+	RenderCheckpoint		m_checkpoint;
+	time_t					m_lastCheckpointTime;
+	Mutex					m_checkpointTimeLock;
+	// read-locked by tasks while they're rendering, and write-locked while writing the checkpoint,
+	// so that the image and tile progress saved are consistent with each other.
+	RWLock					m_checkpointLock;
+	Mutex					m_checkpointWriteGate;
+
 	DebugPathCollection*	m_pDebugPathCollection;
 };
 
@@ -17,8 +17,12 @@
 */
 
 #include "raytracer_ambient_occlusion.h"
+
+#include <algorithm>
+
 #include "render_thread_context.h"
 #include "raytracer.h"
+#include "ray_sorting.h"
 
 #include "core/ray.h"
 #include "core/normal.h"
@@ -27,6 +31,7 @@
 #include "sampling/geometry_sampler.h"
 
 #include "utils/maths/rng.h"
+#include "utils/profiler.h"
 
 #include "scene_interface.h"
 
@@ -157,6 +162,102 @@ float RaytracerAmbientOcclusion::getOcclusionAtPointStandAlone(const HitResult&
 	return occVal;
 }
 
+void RaytracerAmbientOcclusion::getOcclusionAtPoints(const OcclusionPoint* pPoints, unsigned int numPoints, RNG& rng,
+													 std::vector<OcclusionStreamRay>& aRays, std::vector<unsigned int>& aNumOccluded,
+													 float* pOcclusion) const
+{
+	if (numPoints == 0)
+		return;
+
+	PROFILE_SCOPE("Ambient occlusion stream");
+
+	aNumOccluded.assign(numPoints, 0);
+	aRays.resize(numPoints * m_totalSamples);
+
+	std::vector<Sample2D> aHemisphereSamples;
+
+	unsigned int rayIndex = 0;
+	for (unsigned int pointIndex = 0; pointIndex < numPoints; pointIndex++)
+	{
+		aHemisphereSamples.clear();
+		m_sampler.generate2DSamples(aHemisphereSamples, rng);
+
+		for (unsigned int i = 0; i < m_totalSamples; i++)
+		{
+			const Sample2D& sample = aHemisphereSamples[i];
+
+			OcclusionStreamRay& streamRay = aRays[rayIndex++];
+			streamRay.direction = uniformSampleHemisphereN(sample.x, sample.y, pPoints[pointIndex].normal);
+			streamRay.pointIndex = pointIndex;
+		}
+	}
+
+	traceOcclusionStream(m_pScene, aRays, pPoints, numPoints, aNumOccluded.data());
+
+	for (unsigned int pointIndex = 0; pointIndex < numPoints; pointIndex++)
+	{
+		pOcclusion[pointIndex] = (float)aNumOccluded[pointIndex] * m_fInvTotalSamples;
+	}
+}
+
+void RaytracerAmbientOcclusion::traceOcclusionStream(const SceneInterface* pScene, std::vector<OcclusionStreamRay>& aRays,
+													 const OcclusionPoint* pPoints, unsigned int numPoints, unsigned int* pNumOccluded)
+{
+	Point boundsMin = pPoints[0].position;
+	Point boundsMax = pPoints[0].position;
+
+	for (unsigned int i = 1; i < numPoints; i++)
+	{
+		boundsMin.x = std::min(boundsMin.x, pPoints[i].position.x);
+		boundsMin.y = std::min(boundsMin.y, pPoints[i].position.y);
+		boundsMin.z = std::min(boundsMin.z, pPoints[i].position.z);
+
+		boundsMax.x = std::max(boundsMax.x, pPoints[i].position.x);
+		boundsMax.y = std::max(boundsMax.y, pPoints[i].position.y);
+		boundsMax.z = std::max(boundsMax.z, pPoints[i].position.z);
+	}
+
+	const float extent = std::max(std::max(boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y), boundsMax.z - boundsMin.z);
+	const float quantiseScale = (extent > 0.0f) ? 1023.0f / extent : 0.0f;
+
+	std::vector<OcclusionStreamRay>::iterator itRay = aRays.begin();
+	for (; itRay != aRays.end(); ++itRay)
+	{
+		OcclusionStreamRay& streamRay = *itRay;
+
+		uint32_t octant = getRayDirectionOctant(streamRay.direction);
+
+		const Point& origin = pPoints[streamRay.pointIndex].position;
+		uint32_t quantisedX = (uint32_t)((origin.x - boundsMin.x) * quantiseScale);
+		uint32_t quantisedY = (uint32_t)((origin.y - boundsMin.y) * quantiseScale);
+		uint32_t quantisedZ = (uint32_t)((origin.z - boundsMin.z) * quantiseScale);
+
+		uint32_t morton = calculateMortonCode(quantisedX, quantisedY, quantisedZ);
+
+		streamRay.sortKey = (octant << 29) | (morton >> 1);
+	}
+
+	std::sort(aRays.begin(), aRays.end());
+
+	// there's no packet traversal, so these are traced one at a time, but consecutive rays now mostly visit the same nodes
+	for (itRay = aRays.begin(); itRay != aRays.end(); ++itRay)
+	{
+		const OcclusionStreamRay& streamRay = *itRay;
+
+		const OcclusionPoint& point = pPoints[streamRay.pointIndex];
+
+		Ray occlusionRay(point.position, streamRay.direction, RAY_ALL);
+		occlusionRay.tMin = point.tMin;
+		// Ray needs inverse direction for BBox testing
+		occlusionRay.calculateInverseDirection();
+
+		if (pScene->doesOcclude(occlusionRay))
+		{
+			pNumOccluded[streamRay.pointIndex] ++;
+		}
+	}
+}
+
 void RaytracerAmbientOcclusion::setSampleCount(unsigned int samples)
 {
 	m_numSamples = samples;
@@ -20,9 +20,13 @@
 #define RAYTRACER_AMBIENT_OCCLUSION_H
 
 #include <vector>
+#include <inttypes.h>
 
 #include "sampling/cached_sampler.h"
 
+#include "core/point.h"
+#include "core/normal.h"
+
 namespace Imagine
 {
 
@@ -42,9 +46,40 @@ public:
 
 	float getOcclusionAtPointStandAlone(const HitResult& hitResult, RNG& rng) const;
 
+	struct OcclusionPoint
+	{
+		Point		position;
+		Normal		normal;
+		float		tMin;
+	};
+
+	struct OcclusionStreamRay
+	{
+		Normal		direction;
+		uint32_t	pointIndex;
+		// direction octant, then Morton code of the origin
+		uint32_t	sortKey;
+
+		bool operator<(const OcclusionStreamRay& other) const
+		{
+			return sortKey < other.sortKey;
+		}
+	};
+
+	// occlusion for many shading points (i.e. a tile's worth) at once - the occlusion rays from all the points are
+	// traced together as one stream, sorted so rays with nearby origins and the same direction octant are consecutive.
+	// aRays and aNumOccluded are working storage, so they can be re-used between calls.
+	void getOcclusionAtPoints(const OcclusionPoint* pPoints, unsigned int numPoints, RNG& rng, std::vector<OcclusionStreamRay>& aRays,
+							  std::vector<unsigned int>& aNumOccluded, float* pOcclusion) const;
+
 	void setSampleCount(unsigned int samples);
 	void setDistanceAttenuation(float distAttenuation) { m_distanceAttenuation = distAttenuation; }
 
+protected:
+	// sorts the rays so that ones with the same direction signs (which traverse the BVH children in the same order)
+	// and nearby origins are traced consecutively, and adds the number of occluded rays for each point to pNumOccluded.
+	static void traceOcclusionStream(const SceneInterface* pScene, std::vector<OcclusionStreamRay>& aRays, const OcclusionPoint* pPoints,
+									 unsigned int numPoints, unsigned int* pNumOccluded);
 
 protected:
 	const SceneInterface*	m_pScene;
@@ -312,6 +312,28 @@ struct HitResult
 	const ShadingContext*		pShadingContext;
 };
 
+// the values of the first camera ray hit needed for the extra (non-anti-aliased) channels, which renderers
+// can capture while tracing the beauty samples, rather than needing a separate pass of camera rays
+struct PrimaryHitChannels
+{
+	PrimaryHitChannels() : depth(0.0f), objID(0u)
+	{
+	}
+
+	void setFromHit(const HitResult& hitResult, float t, uint32_t objectID)
+	{
+		hitPoint = hitResult.hitPoint;
+		shaderNormal = hitResult.shaderNormal;
+		depth = t;
+		objID = objectID;
+	}
+
+	Point						hitPoint;
+	Normal						shaderNormal;
+	float						depth;
+	uint32_t					objID; // 0 for misses
+};
+
 struct SelectionHitResult
 {
 	SelectionHitResult() : m_count(0), m_faceIndex(0)
@@ -0,0 +1,253 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#include "remote_tile_scheduler.h"
+
+namespace Imagine
+{
+
+RemoteTileScheduler::RemoteTileScheduler() : m_remoteSearchEnd(0), m_issueSequence(0), m_remoteTilesOutstanding(0),
+	m_releasedSkippedTiles(0)
+{
+}
+
+void RemoteTileScheduler::reset(const std::vector<TileCoord>& aTiles)
+{
+	m_lock.lock();
+
+	m_aTiles = aTiles;
+	m_aTileStatus.clear();
+	m_aTileStatus.resize(aTiles.size());
+
+	m_remoteSearchEnd = (unsigned int)aTiles.size();
+	m_issueSequence = 0;
+	m_remoteTilesOutstanding = 0;
+	m_releasedSkippedTiles = 0;
+
+	m_lock.unlock();
+}
+
+bool RemoteTileScheduler::claimLocalTile(unsigned int tileIndex)
+{
+	m_lock.lock();
+
+	TileStatus& status = m_aTileStatus[tileIndex];
+
+	// sub-tiles from tail-splitting share their tile's index, so it might already be ours
+	bool claimed = status.owner == eTileUnclaimed || status.owner == eTileLocal;
+	if (claimed)
+	{
+		if (status.owner == eTileUnclaimed && status.localSkipped)
+		{
+			m_releasedSkippedTiles--;
+		}
+
+		status.owner = eTileLocal;
+		status.localSkipped = false;
+	}
+	else
+	{
+		status.localSkipped = true;
+	}
+
+	m_lock.unlock();
+
+	return claimed;
+}
+
+unsigned int RemoteTileScheduler::requestRemoteTiles(unsigned int clientID, unsigned int maxTiles, std::vector<unsigned int>& aTileIndices)
+{
+	unsigned int tilesAdded = 0;
+
+	m_lock.lock();
+
+	// first of all, unclaimed tiles from the back of the order
+	while (tilesAdded < maxTiles && m_remoteSearchEnd > 0)
+	{
+		unsigned int tileIndex = --m_remoteSearchEnd;
+		TileStatus& status = m_aTileStatus[tileIndex];
+
+		if (status.owner != eTileUnclaimed)
+		{
+			// local threads have reached this far, so everything before this will be claimed too, other than
+			// anything released by clients going away, which the loop below will pick up
+			m_remoteSearchEnd = 0;
+			break;
+		}
+
+		status.owner = eTileRemote;
+		status.aClientIDs[0] = clientID;
+		status.issueCount = 1;
+		status.issueSequence = m_issueSequence++;
+
+		aTileIndices.emplace_back(tileIndex);
+		tilesAdded++;
+		m_remoteTilesOutstanding++;
+	}
+
+	// then anything released by clients which went away, followed by speculative copies of stragglers
+	while (tilesAdded < maxTiles)
+	{
+		unsigned int bestIndex = (unsigned int)-1;
+
+		for (unsigned int i = 0; i < (unsigned int)m_aTileStatus.size(); i++)
+		{
+			const TileStatus& status = m_aTileStatus[i];
+
+			if (status.owner == eTileUnclaimed)
+			{
+				bestIndex = i;
+				break;
+			}
+
+			if (status.owner != eTileRemote || status.issueCount >= kMaxTileIssues || status.isIssuedTo(clientID))
+				continue;
+
+			if (bestIndex == (unsigned int)-1 || status.issueSequence < m_aTileStatus[bestIndex].issueSequence)
+			{
+				bestIndex = i;
+			}
+		}
+
+		if (bestIndex == (unsigned int)-1)
+			break;
+
+		TileStatus& status = m_aTileStatus[bestIndex];
+		if (status.owner == eTileUnclaimed)
+		{
+			if (status.localSkipped)
+			{
+				// another client can have it instead of a local thread
+				status.localSkipped = false;
+				m_releasedSkippedTiles--;
+			}
+
+			status.owner = eTileRemote;
+			status.aClientIDs[0] = clientID;
+			status.issueCount = 1;
+			status.issueSequence = m_issueSequence++;
+			m_remoteTilesOutstanding++;
+		}
+		else
+		{
+			status.aClientIDs[status.issueCount++] = clientID;
+		}
+
+		aTileIndices.emplace_back(bestIndex);
+		tilesAdded++;
+	}
+
+	m_lock.unlock();
+
+	return tilesAdded;
+}
+
+bool RemoteTileScheduler::completeRemoteTile(unsigned int tileIndex)
+{
+	m_lock.lock();
+
+	TileStatus& status = m_aTileStatus[tileIndex];
+
+	bool firstResult = status.owner == eTileRemote;
+	if (firstResult)
+	{
+		status.owner = eTileRemoteDone;
+		m_remoteTilesOutstanding--;
+	}
+
+	m_lock.unlock();
+
+	return firstResult;
+}
+
+void RemoteTileScheduler::releaseClientTiles(unsigned int clientID)
+{
+	m_lock.lock();
+
+	std::vector<TileStatus>::iterator it = m_aTileStatus.begin();
+	for (; it != m_aTileStatus.end(); ++it)
+	{
+		TileStatus& status = *it;
+
+		if (status.owner != eTileRemote || !status.isIssuedTo(clientID))
+			continue;
+
+		// remove the client from the tile's list
+		unsigned int lastIndex = status.issueCount - 1;
+		for (unsigned int i = 0; i < lastIndex; i++)
+		{
+			if (status.aClientIDs[i] == clientID)
+			{
+				status.aClientIDs[i] = status.aClientIDs[lastIndex];
+				break;
+			}
+		}
+		status.issueCount--;
+
+		// if there's a speculative copy elsewhere, that can carry on
+		if (status.issueCount > 0)
+			continue;
+
+		status.owner = eTileUnclaimed;
+		m_remoteTilesOutstanding--;
+
+		if (status.localSkipped)
+		{
+			m_releasedSkippedTiles++;
+		}
+	}
+
+	m_lock.unlock();
+}
+
+unsigned int RemoteTileScheduler::takeReleasedTiles(std::vector<unsigned int>& aTileIndices)
+{
+	unsigned int tilesAdded = 0;
+
+	m_lock.lock();
+
+	for (unsigned int i = 0; i < (unsigned int)m_aTileStatus.size() && m_releasedSkippedTiles > 0; i++)
+	{
+		TileStatus& status = m_aTileStatus[i];
+
+		if (status.owner != eTileUnclaimed || !status.localSkipped)
+			continue;
+
+		// the re-queued task will claim it as normal, unless a client gets it first
+		status.localSkipped = false;
+		m_releasedSkippedTiles--;
+
+		aTileIndices.emplace_back(i);
+		tilesAdded++;
+	}
+
+	m_lock.unlock();
+
+	return tilesAdded;
+}
+
+unsigned int RemoteTileScheduler::getRemoteTilesOutstanding()
+{
+	m_lock.lock();
+	unsigned int outstanding = m_remoteTilesOutstanding;
+	m_lock.unlock();
+
+	return outstanding;
+}
+
+} // namespace Imagine
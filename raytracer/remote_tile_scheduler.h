@@ -0,0 +1,127 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#ifndef REMOTE_TILE_SCHEDULER_H
+#define REMOTE_TILE_SCHEDULER_H
+
+#include <vector>
+
+#include "utils/threads/mutex.h"
+
+#include "tile_task_generator.h"
+#include "remote_tile_source.h"
+
+namespace Imagine
+{
+
+// Shares the tiles of a render dynamically between the local render threads and remote render clients, rather than
+// splitting them up front by thread count, so that whichever side is faster for a given scene ends up doing more.
+// Local threads work forwards through the tile order, claiming each tile as they start it, while remote clients pull
+// small batches on demand from the back of the order (through RemoteTileSource), so the two only meet at the end.
+// Once there are no unclaimed tiles left, requests from remote clients get speculative copies of the tiles which have
+// been outstanding longest on other clients, and whichever result comes back first is used.
+// Tiles claimed by local threads are never re-issued, as local threads write directly into the output image.
+// Tiles released by clients going away are re-issued to the other clients, or rendered locally if the local threads
+// have already skipped them (see takeReleasedTiles()).
+
+class RemoteTileScheduler : public RemoteTileSource
+{
+public:
+	RemoteTileScheduler();
+
+	// aTiles is in the order they'll be issued to the local threads - tile indices are positions in this
+	void reset(const std::vector<TileCoord>& aTiles);
+
+	// called by local threads before starting a tile. Returns false if a remote client's already got it,
+	// in which case the local task should be skipped
+	bool claimLocalTile(unsigned int tileIndex);
+
+	// gets up to maxTiles tiles for a remote client to render, returning how many were added to aTileIndices.
+	// 0 means there's nothing left for this client to do.
+	virtual unsigned int requestRemoteTiles(unsigned int clientID, unsigned int maxTiles, std::vector<unsigned int>& aTileIndices);
+
+	// returns true if this is the first result for the tile, so should be used - otherwise it should be thrown away
+	virtual bool completeRemoteTile(unsigned int tileIndex);
+
+	// a client's gone away, so any tiles it had which haven't been done (and which no other client has a copy of)
+	// go back to being available
+	virtual void releaseClientTiles(unsigned int clientID);
+
+	// gets tiles released by clients which local threads have already skipped, so local tasks need re-queueing for
+	// them. Returns how many were added to aTileIndices.
+	unsigned int takeReleasedTiles(std::vector<unsigned int>& aTileIndices);
+
+	virtual const TileCoord& getTile(unsigned int tileIndex) const { return m_aTiles[tileIndex]; }
+
+	unsigned int getRemoteTilesOutstanding();
+
+	// copies of a tile which can be outstanding at once, including the original
+	static const unsigned int kMaxTileIssues = 2;
+
+protected:
+	enum TileOwner
+	{
+		eTileUnclaimed,
+		eTileLocal,
+		eTileRemote,
+		eTileRemoteDone
+	};
+
+	struct TileStatus
+	{
+		TileStatus() : owner(eTileUnclaimed), issueCount(0), issueSequence(0), localSkipped(false)
+		{
+		}
+
+		bool isIssuedTo(unsigned int clientID) const
+		{
+			for (unsigned int i = 0; i < issueCount; i++)
+			{
+				if (aClientIDs[i] == clientID)
+					return true;
+			}
+
+			return false;
+		}
+
+		TileOwner		owner;
+		// the clients which currently have a copy of the tile
+		unsigned int	aClientIDs[kMaxTileIssues];
+		unsigned int	issueCount;
+		// when it was first issued, for finding the longest-outstanding ones
+		unsigned int	issueSequence;
+		// a local thread's skipped the tile's task because a client had it
+		bool			localSkipped;
+	};
+
+	Mutex						m_lock;
+
+	std::vector<TileCoord>		m_aTiles;
+	std::vector<TileStatus>		m_aTileStatus;
+
+	// remote clients take from the back, so this is one past the next candidate
+	unsigned int				m_remoteSearchEnd;
+	unsigned int				m_issueSequence;
+	unsigned int				m_remoteTilesOutstanding;
+	// released tiles with localSkipped set, so takeReleasedTiles() doesn't need to look otherwise
+	unsigned int				m_releasedSkippedTiles;
+};
+
+} // namespace Imagine
+
+#endif // REMOTE_TILE_SCHEDULER_H
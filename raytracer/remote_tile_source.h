@@ -0,0 +1,58 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#ifndef REMOTE_TILE_SOURCE_H
+#define REMOTE_TILE_SOURCE_H
+
+#include <vector>
+
+#include "tile_task_generator.h"
+
+namespace Imagine
+{
+
+// What remote render client code needs to pull tiles to render on demand, rather than being given a fixed list
+// up front, so it doesn't need to know about the local side of the scheduling.
+
+class RemoteTileSource
+{
+public:
+	RemoteTileSource()
+	{
+	}
+
+	virtual ~RemoteTileSource()
+	{
+	}
+
+	// gets up to maxTiles tiles for a remote client to render, returning how many were added to aTileIndices.
+	// 0 means there's nothing left for this client to do.
+	virtual unsigned int requestRemoteTiles(unsigned int clientID, unsigned int maxTiles, std::vector<unsigned int>& aTileIndices) = 0;
+
+	// returns true if this is the first result for the tile, so should be used - otherwise it should be thrown away
+	virtual bool completeRemoteTile(unsigned int tileIndex) = 0;
+
+	// a client's gone away, so any tiles it had which haven't been done should go back to being available
+	virtual void releaseClientTiles(unsigned int clientID) = 0;
+
+	virtual const TileCoord& getTile(unsigned int tileIndex) const = 0;
+};
+
+} // namespace Imagine
+
+#endif // REMOTE_TILE_SOURCE_H
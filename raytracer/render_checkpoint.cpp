@@ -0,0 +1,224 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#include "render_checkpoint.h"
+
+#include <cstdio>
+
+#include "image/image_common.h"
+#include "image/output_image.h"
+
+#include "utils/io/file_stream.h"
+
+namespace Imagine
+{
+
+static const unsigned int kCheckpointMagic = 0x50434D49; // "IMCP"
+static const unsigned int kCheckpointEndMagic = 0x444E4549; // "IEND"
+static const unsigned int kCheckpointVersion = 1;
+
+RenderCheckpoint::RenderCheckpoint() : m_width(0), m_height(0), m_renderWindowX(0), m_renderWindowY(0),
+	m_renderWindowWidth(0), m_renderWindowHeight(0), m_tileSize(0), m_timeSeed(0)
+{
+}
+
+void RenderCheckpoint::setRenderLayout(unsigned int width, unsigned int height, unsigned int renderWindowX, unsigned int renderWindowY,
+									   unsigned int renderWindowWidth, unsigned int renderWindowHeight, unsigned int tileSize)
+{
+	m_width = width;
+	m_height = height;
+	m_renderWindowX = renderWindowX;
+	m_renderWindowY = renderWindowY;
+	m_renderWindowWidth = renderWindowWidth;
+	m_renderWindowHeight = renderWindowHeight;
+	m_tileSize = tileSize;
+}
+
+bool RenderCheckpoint::hasSameRenderLayout(const RenderCheckpoint& other) const
+{
+	return m_width == other.m_width && m_height == other.m_height &&
+			m_renderWindowX == other.m_renderWindowX && m_renderWindowY == other.m_renderWindowY &&
+			m_renderWindowWidth == other.m_renderWindowWidth && m_renderWindowHeight == other.m_renderWindowHeight &&
+			m_tileSize == other.m_tileSize;
+}
+
+bool RenderCheckpoint::writeToFile(const std::string& filePath, const OutputImage& image) const
+{
+	std::string tempFilePath = filePath + ".tmp";
+
+	{
+		FileStream fileStream;
+		if (!fileStream.open(tempFilePath, FileStream::eWrite))
+			return false;
+
+		storeHeader(&fileStream);
+
+		unsigned int imageWidth = image.getWidth();
+		unsigned int imageHeight = image.getHeight();
+		bool haveSamples = (image.getComponents() & COMPONENT_SAMPLES) != 0;
+
+		fileStream.storeUInt(imageWidth);
+		fileStream.storeUInt(imageHeight);
+		fileStream.storeBool(haveSamples);
+
+		for (unsigned int y = 0; y < imageHeight; y++)
+		{
+			fileStream.write(image.colourRowPtr(y), sizeof(Colour4f) * imageWidth);
+
+			if (haveSamples)
+			{
+				fileStream.write(image.samplesRowPtr(y), sizeof(float) * imageWidth);
+			}
+		}
+
+		fileStream.storeUInt(kCheckpointEndMagic);
+
+		if (fileStream.isInError())
+		{
+			fileStream.close();
+			remove(tempFilePath.c_str());
+			return false;
+		}
+	}
+
+	return rename(tempFilePath.c_str(), filePath.c_str()) == 0;
+}
+
+bool RenderCheckpoint::readFromFile(const std::string& filePath)
+{
+	FileStream fileStream;
+	if (!fileStream.open(filePath, FileStream::eRead))
+		return false;
+
+	return loadHeader(&fileStream);
+}
+
+bool RenderCheckpoint::readImageFromFile(const std::string& filePath, OutputImage& image) const
+{
+	FileStream fileStream;
+	if (!fileStream.open(filePath, FileStream::eRead))
+		return false;
+
+	// skip over the header, which has already been read
+	RenderCheckpoint header;
+	if (!header.loadHeader(&fileStream))
+		return false;
+
+	unsigned int imageWidth = 0;
+	unsigned int imageHeight = 0;
+	bool haveSamples = false;
+
+	fileStream.loadUInt(imageWidth);
+	fileStream.loadUInt(imageHeight);
+	fileStream.loadBool(haveSamples);
+
+	bool imageHasSamples = (image.getComponents() & COMPONENT_SAMPLES) != 0;
+
+	if (imageWidth != image.getWidth() || imageHeight != image.getHeight() || haveSamples != imageHasSamples)
+		return false;
+
+	for (unsigned int y = 0; y < imageHeight; y++)
+	{
+		if (!fileStream.read(image.colourRowPtr(y), sizeof(Colour4f) * imageWidth))
+			return false;
+
+		if (haveSamples)
+		{
+			if (!fileStream.read(image.samplesRowPtr(y), sizeof(float) * imageWidth))
+				return false;
+		}
+	}
+
+	unsigned int endMagic = 0;
+	fileStream.loadUInt(endMagic);
+
+	return endMagic == kCheckpointEndMagic && !fileStream.isInError();
+}
+
+void RenderCheckpoint::storeHeader(Stream* pStream) const
+{
+	pStream->storeUInt(kCheckpointMagic);
+	pStream->storeUInt(kCheckpointVersion);
+
+	pStream->storeUInt(m_width);
+	pStream->storeUInt(m_height);
+	pStream->storeUInt(m_renderWindowX);
+	pStream->storeUInt(m_renderWindowY);
+	pStream->storeUInt(m_renderWindowWidth);
+	pStream->storeUInt(m_renderWindowHeight);
+	pStream->storeUInt(m_tileSize);
+
+	pStream->storeUInt(m_timeSeed);
+
+	pStream->storeUInt((unsigned int)m_aTileProgress.size());
+
+	std::vector<TileProgress>::const_iterator it = m_aTileProgress.begin();
+	for (; it != m_aTileProgress.end(); ++it)
+	{
+		const TileProgress& progress = *it;
+
+		pStream->storeEnum((unsigned int)progress.state);
+		pStream->storeUInt(progress.iterations);
+		pStream->storeBool(progress.done);
+	}
+}
+
+bool RenderCheckpoint::loadHeader(Stream* pStream)
+{
+	unsigned int magic = 0;
+	unsigned int version = 0;
+	pStream->loadUInt(magic);
+	pStream->loadUInt(version);
+
+	if (magic != kCheckpointMagic || version != kCheckpointVersion)
+		return false;
+
+	pStream->loadUInt(m_width);
+	pStream->loadUInt(m_height);
+	pStream->loadUInt(m_renderWindowX);
+	pStream->loadUInt(m_renderWindowY);
+	pStream->loadUInt(m_renderWindowWidth);
+	pStream->loadUInt(m_renderWindowHeight);
+	pStream->loadUInt(m_tileSize);
+
+	unsigned int timeSeed = 0;
+	pStream->loadUInt(timeSeed);
+	m_timeSeed = timeSeed;
+
+	unsigned int numTiles = 0;
+	pStream->loadUInt(numTiles);
+
+	if (pStream->isInError())
+		return false;
+
+	m_aTileProgress.resize(numTiles);
+
+	std::vector<TileProgress>::iterator it = m_aTileProgress.begin();
+	for (; it != m_aTileProgress.end(); ++it)
+	{
+		TileProgress& progress = *it;
+
+		progress.state = (TileState)pStream->loadEnumChar();
+		pStream->loadUInt(progress.iterations);
+		pStream->loadBool(progress.done);
+	}
+
+	return !pStream->isInError();
+}
+
+} // namespace Imagine
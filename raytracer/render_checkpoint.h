@@ -0,0 +1,106 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#ifndef RENDER_CHECKPOINT_H
+#define RENDER_CHECKPOINT_H
+
+#include <string>
+#include <vector>
+#include <inttypes.h>
+
+#include "raytracer_common.h"
+
+namespace Imagine
+{
+
+class OutputImage;
+class Stream;
+
+// Snapshot of a progressive render's state, so that an interrupted render (i.e. a pre-empted farm job) can be resumed
+// from it. This contains the accumulated colour and sample weights of the output image, and the TileState and iteration
+// count of each tile, along with the render's time seed.
+// Renderers seed their per-tile RNGs from the time seed combined with the ID of the thread rendering the tile and its
+// position, and which thread gets which tile isn't fixed, so a resumed render is statistically equivalent to an
+// uninterrupted one, but not bit-identical to it.
+
+class RenderCheckpoint
+{
+public:
+	RenderCheckpoint();
+
+	struct TileProgress
+	{
+		TileProgress() : state(eTSBlank), iterations(0), done(false)
+		{
+		}
+
+		TileProgress(TileState initialState) : state(initialState), iterations(0), done(false)
+		{
+		}
+
+		TileState		state;
+		unsigned int	iterations;
+		bool			done;
+	};
+
+	// the layout of the render the checkpoint is for - checkpoints can only be resumed by renders with the same layout
+	void setRenderLayout(unsigned int width, unsigned int height, unsigned int renderWindowX, unsigned int renderWindowY,
+						 unsigned int renderWindowWidth, unsigned int renderWindowHeight, unsigned int tileSize);
+
+	bool hasSameRenderLayout(const RenderCheckpoint& other) const;
+
+	void setTimeSeed(uint32_t timeSeed) { m_timeSeed = timeSeed; }
+	uint32_t getTimeSeed() const { return m_timeSeed; }
+
+	std::vector<TileProgress>& getTileProgress() { return m_aTileProgress; }
+	const std::vector<TileProgress>& getTileProgress() const { return m_aTileProgress; }
+
+	// writes to a temporary file first which is then renamed, so that being killed while writing the
+	// checkpoint doesn't lose the previous one
+	bool writeToFile(const std::string& filePath, const OutputImage& image) const;
+
+	// only reads the header and tile progress - the image is only read by readImageFromFile() once
+	// the layout is known to match
+	bool readFromFile(const std::string& filePath);
+	bool readImageFromFile(const std::string& filePath, OutputImage& image) const;
+
+protected:
+	void storeHeader(Stream* pStream) const;
+	bool loadHeader(Stream* pStream);
+
+protected:
+	unsigned int				m_width;
+	unsigned int				m_height;
+
+	unsigned int				m_renderWindowX;
+	unsigned int				m_renderWindowY;
+	unsigned int				m_renderWindowWidth;
+	unsigned int				m_renderWindowHeight;
+
+	unsigned int				m_tileSize;
+
+	uint32_t					m_timeSeed;
+
+	// indexed by tile position within the render window (tileY * tilesX + tileX), as the order tasks are
+	// created in can differ between renders
+	std::vector<TileProgress>	m_aTileProgress;
+};
+
+} // namespace Imagine
+
+#endif // RENDER_CHECKPOINT_H
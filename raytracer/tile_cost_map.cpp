@@ -0,0 +1,114 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#include "tile_cost_map.h"
+
+#include <algorithm>
+
+namespace Imagine
+{
+
+class TileCostSortPredicate
+{
+public:
+	TileCostSortPredicate(const std::vector<uint64_t>& aCosts, unsigned int tilesX) : m_aCosts(aCosts), m_tilesX(tilesX)
+	{
+	}
+
+	bool operator()(const TileCoord& lhs, const TileCoord& rhs) const
+	{
+		return m_aCosts[lhs.y * m_tilesX + lhs.x] > m_aCosts[rhs.y * m_tilesX + rhs.x];
+	}
+
+protected:
+	const std::vector<uint64_t>&	m_aCosts;
+	unsigned int					m_tilesX;
+};
+
+TileCostMap::TileCostMap() : m_tilesX(0), m_tilesY(0), m_tileSize(0), m_haveCurrentCosts(false), m_havePreviousCosts(false)
+{
+}
+
+void TileCostMap::beginRender(unsigned int tilesX, unsigned int tilesY, unsigned int tileSize)
+{
+	m_lock.lock();
+
+	if (tilesX == m_tilesX && tilesY == m_tilesY && tileSize == m_tileSize)
+	{
+		// if the last render was cancelled before any tiles finished, keep what we had before that
+		if (m_haveCurrentCosts)
+		{
+			m_aPreviousCosts.swap(m_aCurrentCosts);
+			m_havePreviousCosts = true;
+		}
+	}
+	else
+	{
+		m_tilesX = tilesX;
+		m_tilesY = tilesY;
+		m_tileSize = tileSize;
+
+		m_aPreviousCosts.assign((size_t)tilesX * tilesY, 0);
+		m_havePreviousCosts = false;
+	}
+
+	m_aCurrentCosts.assign((size_t)tilesX * tilesY, 0);
+	m_haveCurrentCosts = false;
+
+	m_lock.unlock();
+}
+
+void TileCostMap::addCost(unsigned int tileX, unsigned int tileY, uint64_t cost)
+{
+	if (tileX >= m_tilesX || tileY >= m_tilesY)
+		return;
+
+	m_lock.lock();
+
+	m_aCurrentCosts[tileY * m_tilesX + tileX] += cost;
+	m_haveCurrentCosts = true;
+
+	m_lock.unlock();
+}
+
+void TileCostMap::sortTilesByCost(std::vector<TileCoord>& aTiles) const
+{
+	if (!m_havePreviousCosts)
+		return;
+
+	std::stable_sort(aTiles.begin(), aTiles.end(), TileCostSortPredicate(m_aPreviousCosts, m_tilesX));
+}
+
+void TileCostMap::clear()
+{
+	m_lock.lock();
+
+	m_tilesX = 0;
+	m_tilesY = 0;
+	m_tileSize = 0;
+
+	m_aCurrentCosts.clear();
+	m_aPreviousCosts.clear();
+
+	m_haveCurrentCosts = false;
+	m_havePreviousCosts = false;
+
+	m_lock.unlock();
+}
+
+} // namespace Imagine
@@ -0,0 +1,71 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#ifndef TILE_COST_MAP_H
+#define TILE_COST_MAP_H
+
+#include <vector>
+#include <inttypes.h>
+
+#include "utils/threads/mutex.h"
+
+#include "tile_task_generator.h"
+
+namespace Imagine
+{
+
+// records how long each tile took to render, so that the next render (or the final render after a
+// draft pass) of the same tile layout can issue the most expensive tiles first. Costs of sub-tiles
+// created by tail-end splitting are accumulated into the tile they came from.
+
+class TileCostMap
+{
+public:
+	TileCostMap();
+
+	// called before tiles are generated for a new render: if the layout matches the previous one, the costs
+	// recorded during that render become the ones used for ordering, otherwise all costs are discarded.
+	void beginRender(unsigned int tilesX, unsigned int tilesY, unsigned int tileSize);
+
+	void addCost(unsigned int tileX, unsigned int tileY, uint64_t cost);
+
+	bool hasPreviousCosts() const { return m_havePreviousCosts; }
+
+	// stable sorts tiles by previous cost, most expensive first, so the original tile order
+	// is kept for tiles of equal cost
+	void sortTilesByCost(std::vector<TileCoord>& aTiles) const;
+
+	void clear();
+
+protected:
+	unsigned int			m_tilesX;
+	unsigned int			m_tilesY;
+	unsigned int			m_tileSize;
+
+	Mutex					m_lock;
+
+	bool					m_haveCurrentCosts;
+	bool					m_havePreviousCosts;
+
+	std::vector<uint64_t>	m_aCurrentCosts;
+	std::vector<uint64_t>	m_aPreviousCosts;
+};
+
+} // namespace Imagine
+
+#endif // TILE_COST_MAP_H
@@ -0,0 +1,117 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#include "remote_tile_payload.h"
+
+#include <cstring>
+#include <inttypes.h>
+
+#include "image/half_conversion.h"
+
+#include "utils/io/message_channel.h"
+
+namespace Imagine
+{
+
+static const unsigned int kTileHeaderSize = sizeof(uint32_t) * 4;
+
+void encodeRemoteTilePayload(const RemoteTileHeader& header, const Colour4f* pPixels, unsigned int rowStride,
+							 std::vector<unsigned char>& payload)
+{
+	const size_t numValues = (size_t)header.width * header.height * 4;
+
+	payload.resize(kTileHeaderSize + numValues * sizeof(half));
+
+	uint32_t headerValues[4] = { header.x, header.y, header.width, header.height };
+	memcpy(payload.data(), headerValues, kTileHeaderSize);
+
+	unsigned char* pLowBytes = payload.data() + kTileHeaderSize;
+	unsigned char* pHighBytes = pLowBytes + numValues;
+
+	std::vector<half> aHalfRow(header.width * 4);
+
+	for (unsigned int y = 0; y < header.height; y++)
+	{
+		const Colour4f* pRow = pPixels + (size_t)y * rowStride;
+		convertFloatToHalf(&pRow->r, aHalfRow.data(), aHalfRow.size());
+
+		std::vector<half>::const_iterator itValue = aHalfRow.begin();
+		for (; itValue != aHalfRow.end(); ++itValue)
+		{
+			uint16_t bits;
+			memcpy(&bits, &(*itValue), sizeof(uint16_t));
+
+			*pLowBytes++ = (unsigned char)(bits & 0xFF);
+			*pHighBytes++ = (unsigned char)(bits >> 8);
+		}
+	}
+}
+
+bool decodeRemoteTilePayload(const std::vector<unsigned char>& payload, RemoteTileHeader& header, std::vector<Colour4f>& aPixels)
+{
+	if (payload.size() < kTileHeaderSize)
+		return false;
+
+	uint32_t headerValues[4];
+	memcpy(headerValues, payload.data(), kTileHeaderSize);
+
+	header.x = headerValues[0];
+	header.y = headerValues[1];
+	header.width = headerValues[2];
+	header.height = headerValues[3];
+
+	const size_t numValues = (size_t)header.width * header.height * 4;
+	if (payload.size() != kTileHeaderSize + numValues * sizeof(half))
+		return false;
+
+	aPixels.resize((size_t)header.width * header.height);
+
+	const unsigned char* pLowBytes = payload.data() + kTileHeaderSize;
+	const unsigned char* pHighBytes = pLowBytes + numValues;
+
+	std::vector<half> aHalfRow(header.width * 4);
+
+	for (unsigned int y = 0; y < header.height; y++)
+	{
+		std::vector<half>::iterator itValue = aHalfRow.begin();
+		for (; itValue != aHalfRow.end(); ++itValue)
+		{
+			uint16_t bits = (uint16_t)*pLowBytes++ | ((uint16_t)*pHighBytes++ << 8);
+			memcpy(&(*itValue), &bits, sizeof(uint16_t));
+		}
+
+		Colour4f* pRow = aPixels.data() + (size_t)y * header.width;
+		convertHalfToFloat(aHalfRow.data(), &pRow->r, aHalfRow.size());
+	}
+
+	return true;
+}
+
+bool sendRemoteTileResult(MessageChannel& channel, unsigned int tileIndex, const RemoteTileHeader& header, const Colour4f* pPixels,
+						  unsigned int rowStride)
+{
+	MessageChannel::Message message;
+	message.type = eRemoteMessageTileResult;
+	message.id = tileIndex;
+
+	encodeRemoteTilePayload(header, pPixels, rowStride, message.payload);
+
+	return channel.sendMessage(message, true);
+}
+
+} // namespace Imagine
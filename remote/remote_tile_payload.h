@@ -0,0 +1,69 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#ifndef REMOTE_TILE_PAYLOAD_H
+#define REMOTE_TILE_PAYLOAD_H
+
+#include <vector>
+
+#include "colour/colour4f.h"
+
+namespace Imagine
+{
+
+class MessageChannel;
+
+// message types used over the MessageChannel between the host and render clients
+enum RemoteMessageType
+{
+	eRemoteMessageScene				= 1,	// serialised scene and render settings, compressed
+	eRemoteMessageTileRequest		= 2,	// list of tiles for the client to render
+	eRemoteMessageTileResult		= 3,	// rendered tile pixels, see below
+	eRemoteMessageRenderFinished	= 4
+};
+
+struct RemoteTileHeader
+{
+	RemoteTileHeader() : x(0), y(0), width(0), height(0)
+	{
+	}
+
+	unsigned int	x;
+	unsigned int	y;
+	unsigned int	width;
+	unsigned int	height;
+};
+
+// Tile results are sent as half floats, with the two bytes of each half split into separate planes (all the low
+// bytes, then all the high bytes), as the high bytes (sign, exponent and top of the mantissa) are very similar between
+// neighbouring pixels, so that halves the data before compression, and then compresses much better than interleaved.
+
+// pPixels is the top left pixel of the tile, with rowStride pixels between the start of each row
+void encodeRemoteTilePayload(const RemoteTileHeader& header, const Colour4f* pPixels, unsigned int rowStride,
+							 std::vector<unsigned char>& payload);
+
+// aPixels is resized to width x height of the tile
+bool decodeRemoteTilePayload(const std::vector<unsigned char>& payload, RemoteTileHeader& header, std::vector<Colour4f>& aPixels);
+
+// convenience for render clients - encodes and queues the tile on the channel's send thread with compression
+bool sendRemoteTileResult(MessageChannel& channel, unsigned int tileIndex, const RemoteTileHeader& header, const Colour4f* pPixels,
+						  unsigned int rowStride);
+
+} // namespace Imagine
+
+#endif // REMOTE_TILE_PAYLOAD_H
@@ -34,6 +34,8 @@
 
 #include "scene.h"
 
+#include "utils/params.h"
+
 namespace Imagine
 {
 
@@ -155,6 +157,23 @@ bool DataChartBuilder::controlChanged(const std::string& name, PostChangedAction
 	return true;
 }
 
+void DataChartBuilder::applyParams(const Params& params)
+{
+	SceneBuilder::applyParams(params);
+
+	m_type = (unsigned char)params.getUInt("type", m_type);
+	m_dataType = (unsigned char)params.getUInt("dataType", m_dataType);
+	m_autoDetectCounts = params.getBool("autodetect_counts", m_autoDetectCounts);
+	m_width = params.getFloat("width", m_width);
+	m_depth = params.getFloat("depth", m_depth);
+	m_height = params.getFloat("height", m_height);
+	m_normaliseHeight = params.getBool("normalise_height", m_normaliseHeight);
+	m_xItems = params.getUInt("xItems", m_xItems);
+	m_yItems = params.getUInt("yItems", m_yItems);
+	m_gapType = (unsigned char)params.getUInt("gapType", m_gapType);
+	m_gapValue = params.getFloat("gapValue", m_gapValue);
+}
+
 void DataChartBuilder::createScene(Scene& scene)
 {
 	if (m_type == 0)
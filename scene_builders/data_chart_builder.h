@@ -45,6 +45,9 @@ public:
 
 	virtual void createScene(Scene& scene);
 
+	virtual void applyParams(const Params& params);
+	void setDataFile(const std::string& dataFile) { m_dataFile = dataFile; }
+
 	
 protected:
 	void create3DSurfacePlot(Scene& scene);
@@ -43,6 +43,7 @@
 #include "utils/system.h"
 #include "utils/string_helpers.h"
 #include "utils/timer.h"
+#include "utils/params.h"
 
 namespace Imagine
 {
@@ -253,17 +254,31 @@ void InstanceShapeBuilder::buildParameters(Parameters& parameters, unsigned int
 	parameters.addParameter(new BasicParameter<std::string>("save_path", "Save path", &m_savePath, eParameterFile, eParameterFileParamGeneralSave));
 }
 
+void InstanceShapeBuilder::applyParams(const Params& params)
+{
+	SceneBuilder::applyParams(params);
+
+	m_scale = params.getFloat("scale", m_scale);
+	m_objectType = (ObjectType)params.getUInt("object", (unsigned int)m_objectType);
+	m_drawAsBBox = params.getBool("set_to_bbox", m_drawAsBBox);
+	m_addToGroup = params.getBool("add_to_group", m_addToGroup);
+	m_useBakedInstances = params.getBool("use_baked_instances", m_useBakedInstances);
+	m_gap = params.getFloat("gap", m_gap);
+	m_parallelBuild = params.getBool("parallel_build", m_parallelBuild);
+}
+
 void InstanceShapeBuilder::createScene(Scene& scene)
 {
 	// get the currently selected object
-	Object* pCurrentSelObject = SelectionManager::instance().getMainSelectedObject();
+	Object* pCurrentSelObject = getSourceObject();
 	if (!pCurrentSelObject)
 		return;
 
-	if (m_objectType == eSecondSelectedObject && SelectionManager::instance().getSelection().getSelectionCount() == 1)
+	// an explicit source object means there's no selection to get a second object from
+	if (m_objectType == eSecondSelectedObject && (m_pSourceObject || SelectionManager::instance().getSelection().getSelectionCount() == 1))
 		return;
 
-	Object* pSecondSelectedObject = SelectionManager::instance().getSelection().getSelectedObjectAtIndex(1);
+	Object* pSecondSelectedObject = m_pSourceObject ? nullptr : SelectionManager::instance().getSelection().getSelectedObjectAtIndex(1);
 
 	Object* pNewHolderObject = nullptr;
 
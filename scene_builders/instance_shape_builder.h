@@ -119,6 +119,8 @@ public:
 	virtual void buildParameters(Parameters& parameters, unsigned int flags);
 
 	virtual void createScene(Scene& scene);
+
+	virtual void applyParams(const Params& params);
 	
 protected:
 
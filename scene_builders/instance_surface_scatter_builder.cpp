@@ -36,6 +36,7 @@
 #include "materials/standard_material.h"
 
 #include "utils/maths/rng.h"
+#include "utils/params.h"
 
 namespace Imagine
 {
@@ -123,15 +124,36 @@ void InstanceSurfaceScatterBuilder::buildParameters(Parameters& parameters, unsi
 
 }
 
+void InstanceSurfaceScatterBuilder::applyParams(const Params& params)
+{
+	SceneBuilder::applyParams(params);
+
+	m_width = params.getFloat("width", m_width);
+	m_depth = params.getFloat("depth", m_depth);
+	m_raycastStartHeight = params.getFloat("start_height", m_raycastStartHeight);
+	m_targetInstanceCount = params.getUInt("target_instance_count", m_targetInstanceCount);
+	m_exactNumber = params.getBool("exact_number", m_exactNumber);
+	m_distribution = params.getUInt("distribution", m_distribution);
+	m_surfaceYOffset = params.getFloat("surface_y_offset", m_surfaceYOffset);
+	m_uniformScaleVariation = params.getFloat("uscale_variation", m_uniformScaleVariation);
+	m_alignToSurface = params.getBool("align_to_surface", m_alignToSurface);
+	m_randomYRotation = params.getBool("random_y_rotation", m_randomYRotation);
+	m_addToGroup = params.getBool("add_to_group", m_addToGroup);
+	m_useBakedInstances = params.getBool("use_baked_instances", m_useBakedInstances);
+	m_alternatingMaterials = params.getBool("alternating_materials", m_alternatingMaterials);
+	m_numMaterials = params.getUInt("num_materials", m_numMaterials);
+}
+
 void InstanceSurfaceScatterBuilder::createScene(Scene& scene)
 {
 	TestPosInfo posInfo;
 
-	posInfo.pCurrentSelectedObject = SelectionManager::instance().getMainSelectedObject();
+	posInfo.pCurrentSelectedObject = getSourceObject();
 	if (!posInfo.pCurrentSelectedObject)
 		return;
 
-	posInfo.numSelectedItems = SelectionManager::instance().getSelection().getSelectionCount();
+	// an explicit source object means there's no selection to pick others from
+	posInfo.numSelectedItems = m_pSourceObject ? 1 : SelectionManager::instance().getSelection().getSelectionCount();
 
 	posInfo.randomlyPickObject = m_randomlyUseMultipleSelection && (posInfo.numSelectedItems > 1);
 
@@ -257,7 +279,7 @@ void InstanceSurfaceScatterBuilder::createScene(Scene& scene)
 
 void InstanceSurfaceScatterBuilder::generateCandidateStartPoints(std::vector<Point>& points) const
 {
-	uint32_t timeSeed = std::clock();
+	uint32_t timeSeed = getRandomSeed();
 
 	RNG rng(timeSeed);
 
@@ -46,6 +46,8 @@ public:
 
 	virtual void createScene(Scene& scene);
 
+	virtual void applyParams(const Params& params);
+
 
 protected:
 	void generateCandidateStartPoints(std::vector<Point>& points) const;
@@ -31,6 +31,7 @@
 #include "utils/string_helpers.h"
 
 #include "utils/timer.h"
+#include "utils/params.h"
 
 #include "scene.h"
 
@@ -74,6 +75,16 @@ void MengerSpongeBuilder::buildParameters(Parameters& parameters, unsigned int f
 	parameters.addParameter(new BasicParameter<std::string>("save_path", "Save path", &m_savePath, eParameterFile, eParameterFileParamGeneralSave));
 }
 
+void MengerSpongeBuilder::applyParams(const Params& params)
+{
+	SceneBuilder::applyParams(params);
+
+	m_iterations = params.getUInt("iterations", m_iterations);
+	m_overallWidth = params.getFloat("overallWidth", m_overallWidth);
+	m_makeGroup = params.getBool("make_group", m_makeGroup);
+	m_gap = params.getFloat("gap", m_gap);
+}
+
 void MengerSpongeBuilder::createScene(Scene& scene)
 {
 	if (m_iterations == 1)
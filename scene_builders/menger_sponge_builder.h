@@ -44,6 +44,8 @@ public:
 
 	virtual void createScene(Scene& scene);
 
+	virtual void applyParams(const Params& params);
+
 protected:
 	void generateSubCubes(std::vector<Object*>& cubes, const BoundaryBox& overallBBox,
 						  int levelsRemaining, int levelCount, std::vector<float>& subCubeSizes, std::vector<Point>* savePositions);
@@ -21,6 +21,7 @@
 #include <ctime>
 
 #include "utils/maths/rng.h"
+#include "utils/params.h"
 
 #include "scene.h"
 
@@ -111,6 +112,18 @@ bool PointCloudBuilder::controlChanged(const std::string& name, PostChangedActio
 	return true;
 }
 
+void PointCloudBuilder::applyParams(const Params& params)
+{
+	SceneBuilder::applyParams(params);
+
+	m_pointRadius = params.getFloat("point_radius", m_pointRadius);
+	m_type = (unsigned char)params.getUInt("type", m_type);
+	m_distribution = params.getUInt("distribution", m_distribution);
+	m_boundShape = params.getUInt("bounds_shape", m_boundShape);
+	m_numberOfPoints = params.getUInt("points_count", m_numberOfPoints);
+	m_sampleRadius = params.getFloat("sample_radius", m_sampleRadius);
+}
+
 void PointCloudBuilder::createScene(Scene& scene)
 {
 	std::vector<Point> aFinalItemPositions;
@@ -126,7 +139,7 @@ void PointCloudBuilder::createScene(Scene& scene)
 		PreRenderRequirements rendRequirements(true, GeometryInstanceBuildRequirements(eAccelStructureStatusRendering), 1.0f);
 		scene.doPreRenders(rendRequirements);
 		
-		uint32_t timeSeed = std::clock();
+		uint32_t timeSeed = getRandomSeed();
 	
 		RNG rng(timeSeed);
 	
@@ -228,7 +241,7 @@ void PointCloudBuilder::createScene(Scene& scene)
 		// get points from selection.
 		
 		// get the currently selected object
-		const Object* pCurrentSelObject = SelectionManager::instance().getMainSelectedObject();
+		const Object* pCurrentSelObject = getSourceObject();
 		if (!pCurrentSelObject)
 			return;
 		
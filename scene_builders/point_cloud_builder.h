@@ -37,6 +37,8 @@ public:
 
 	virtual void createScene(Scene& scene);
 
+	virtual void applyParams(const Params& params);
+
 protected:
 	float			m_pointRadius;
 	unsigned char	m_type;
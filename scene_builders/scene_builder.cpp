@@ -18,13 +18,18 @@
 
 #include "scene_builder.h"
 
+#include <ctime>
+
 #include "object.h"
 #include "scene.h"
+#include "selection_manager.h"
+
+#include "utils/params.h"
 
 namespace Imagine
 {
 
-SceneBuilder::SceneBuilder() : ParametersInterface()
+SceneBuilder::SceneBuilder() : ParametersInterface(), m_pSourceObject(nullptr), m_fixedSeed(0)
 {
 }
 
@@ -38,4 +43,25 @@ void SceneBuilder::addObject(Scene& scene, Object* pObject)
 	scene.addObject(pObject, false, true, true); // don't set name, but set object ID and lookup map
 }
 
+void SceneBuilder::applyParams(const Params& params)
+{
+	m_fixedSeed = params.getUInt("seed", m_fixedSeed);
+}
+
+Object* SceneBuilder::getSourceObject() const
+{
+	if (m_pSourceObject)
+		return m_pSourceObject;
+
+	return SelectionManager::instance().getMainSelectedObject();
+}
+
+uint32_t SceneBuilder::getRandomSeed() const
+{
+	if (m_fixedSeed != 0)
+		return m_fixedSeed;
+
+	return std::clock();
+}
+
 } // namespace Imagine
@@ -19,6 +19,8 @@
 #ifndef SCENE_BUILDER_H
 #define SCENE_BUILDER_H
 
+#include <inttypes.h>
+
 #include "scene_builder_factory.h"
 
 #include "parameter.h"
@@ -28,6 +30,7 @@ namespace Imagine
 
 class Scene;
 class Object;
+class Params;
 
 class SceneBuilder : public ParametersInterface
 {
@@ -46,9 +49,26 @@ public:
 
 	virtual void createScene(Scene& scene) = 0;
 
+	// for use without the UI (batch builds, benchmarks): sets the builder's values using the same names as its
+	// parameters. A non-zero "seed" makes the random distributions repeatable, rather than seeded from the time.
+	virtual void applyParams(const Params& params);
+
+	// without the UI, the object builders which work on the selected object should use this one instead
+	void setSourceObject(Object* pObject) { m_pSourceObject = pObject; }
+
 	void addObject(Scene& scene, Object* pObject);
 
 	virtual bool hasParameterUndo() const { return false; }
+
+protected:
+	// the object set with setSourceObject(), otherwise the main selected object
+	Object* getSourceObject() const;
+
+	uint32_t getRandomSeed() const;
+
+protected:
+	Object*			m_pSourceObject;
+	uint32_t		m_fixedSeed;
 };
 
 } // namespace Imagine
@@ -30,6 +30,7 @@
 #include "sampling/sampler_common.h"
 
 #include "utils/maths/rng.h"
+#include "utils/params.h"
 
 namespace Imagine
 {
@@ -64,6 +65,17 @@ void SimpleCityBuilder::buildParameters(Parameters& parameters, unsigned int fla
 	parameters.addParameter(new EnumParameter("distribution", "distribution", (unsigned char*)&m_distribution, distributionOptions));
 }
 
+void SimpleCityBuilder::applyParams(const Params& params)
+{
+	SceneBuilder::applyParams(params);
+
+	m_width = params.getUInt("width", m_width);
+	m_depth = params.getUInt("depth", m_depth);
+	m_numberOfBuildings = params.getUInt("num_buildings", m_numberOfBuildings);
+	m_maxStories = params.getUInt("max_stories", m_maxStories);
+	m_distribution = params.getUInt("distribution", m_distribution);
+}
+
 void SimpleCityBuilder::createScene(Scene& scene)
 {
 	Object* pGround = new Plane(float(m_depth), float(m_width));
@@ -71,7 +83,7 @@ void SimpleCityBuilder::createScene(Scene& scene)
 
 	addObject(scene, pGround);
 
-	uint32_t timeSeed = std::clock();
+	uint32_t timeSeed = getRandomSeed();
 
 	RNG rng(timeSeed);
 
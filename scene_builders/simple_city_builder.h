@@ -36,6 +36,8 @@ public:
 
 	virtual void createScene(Scene& scene);
 
+	virtual void applyParams(const Params& params);
+
 protected:
 	unsigned int	m_width;
 	unsigned int	m_depth;
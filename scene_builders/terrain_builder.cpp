@@ -24,6 +24,7 @@
 #include "geometry/standard_geometry_instance.h"
 
 #include "utils/file_helpers.h"
+#include "utils/params.h"
 
 #include "image/image_1f.h"
 
@@ -113,6 +114,18 @@ bool TerrainBuilder::controlChanged(const std::string& name, PostChangedActions&
 	return true;
 }
 
+void TerrainBuilder::applyParams(const Params& params)
+{
+	SceneBuilder::applyParams(params);
+
+	m_width = params.getUInt("width", m_width);
+	m_depth = params.getUInt("depth", m_depth);
+	m_Xdivisions = params.getUInt("x_divisions", m_Xdivisions);
+	m_Ydivisions = params.getUInt("y_divisions", m_Ydivisions);
+	m_maxHeight = params.getFloat("max_height", m_maxHeight);
+	m_heightSource = (HeightSource)params.getUInt("height_source", (unsigned int)m_heightSource);
+}
+
 void TerrainBuilder::createScene(Scene& scene)
 {
 	Mesh* pNewMesh = new Mesh();
@@ -45,6 +45,8 @@ public:
 
 	virtual void createScene(Scene& scene);
 
+	virtual void applyParams(const Params& params);
+
 	virtual bool controlChanged(const std::string& name, PostChangedActions& postChangedActions);
 
 protected:
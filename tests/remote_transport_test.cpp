@@ -0,0 +1,432 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+// Loopback test of the remote render transport (LZ codec, MessageChannel and tile payloads), with the client and
+// host ends in the same process. Returns non-zero if anything fails.
+// Needs utils/socket, utils/io/lz_compression, utils/io/message_channel, remote/remote_tile_payload and utils/threads.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <inttypes.h>
+#include <unistd.h>
+
+#include "utils/socket.h"
+#include "utils/io/lz_compression.h"
+#include "utils/io/message_channel.h"
+
+#include "remote/remote_tile_payload.h"
+
+using namespace Imagine;
+
+static const int kFirstPort = 45120;
+static const int kPortAttempts = 20;
+
+static unsigned int g_failures = 0;
+
+static void check(bool condition, const char* description)
+{
+	if (!condition)
+	{
+		fprintf(stderr, "FAILED: %s\n", description);
+		g_failures++;
+	}
+}
+
+// a connected pair of sockets over loopback
+struct LoopbackConnection
+{
+	LoopbackConnection() : pClient(nullptr), pHost(nullptr)
+	{
+	}
+
+	bool connect()
+	{
+		for (int port = kFirstPort; port < kFirstPort + kPortAttempts; port++)
+		{
+			if (!listenSocket.create() || !listenSocket.bind(port) || !listenSocket.listen(1))
+			{
+				listenSocket.close();
+				continue;
+			}
+
+			pClient = new Socket("127.0.0.1", port);
+			pHost = new Socket();
+
+			if (pClient->connect() && listenSocket.accept(pHost))
+				return true;
+
+			delete pClient;
+			delete pHost;
+			pClient = nullptr;
+			pHost = nullptr;
+			listenSocket.close();
+		}
+
+		return false;
+	}
+
+	Socket		listenSocket;
+	Socket*		pClient;
+	Socket*		pHost;
+};
+
+// MessageChannel's frame header, for writing frames by hand
+struct RawFrameHeader
+{
+	uint32_t	magic;
+	uint32_t	type;
+	uint32_t	id;
+	uint32_t	flags;
+	uint32_t	payloadSize;
+	uint32_t	wireSize;
+};
+
+static void fillTestData(std::vector<unsigned char>& aData, size_t size, unsigned int mode)
+{
+	aData.resize(size);
+	for (size_t i = 0; i < size; i++)
+	{
+		if (mode == 0)
+			aData[i] = (unsigned char)rand();
+		else if (mode == 1)
+			aData[i] = (unsigned char)(i % 7);
+		else if (mode == 2)
+			aData[i] = (unsigned char)(rand() % 4);
+		else
+			aData[i] = (i > 20 && rand() % 5) ? aData[i - 1 - rand() % 20] : (unsigned char)rand();
+	}
+}
+
+static void testLZCodec()
+{
+	srand(1);
+
+	size_t totalSize = 0;
+	size_t totalCompressedSize = 0;
+
+	for (unsigned int test = 0; test < 2000; test++)
+	{
+		size_t size = (size_t)rand() % (test < 500 ? 64 : 200000);
+
+		std::vector<unsigned char> aSource;
+		fillTestData(aSource, size, test % 4);
+
+		std::vector<unsigned char> aCompressed(getLZCompressionBound(size));
+		size_t compressedSize = compressLZ(aSource.data(), size, aCompressed.data(), aCompressed.size());
+		check(compressedSize > 0 || size == 0, "LZ: compression fits in the bound");
+
+		std::vector<unsigned char> aDecompressed(size + 1);
+		bool decompressed = decompressLZ(aCompressed.data(), compressedSize, aDecompressed.data(), size);
+		check(decompressed && (size == 0 || memcmp(aDecompressed.data(), aSource.data(), size) == 0), "LZ: round trip");
+
+		if (size > 1)
+		{
+			check(!decompressLZ(aCompressed.data(), compressedSize, aDecompressed.data(), size - 1), "LZ: wrong size is rejected");
+		}
+
+		// corrupt data needs to fail cleanly
+		if (compressedSize > 3)
+		{
+			aCompressed[rand() % compressedSize] ^= 0x5a;
+			decompressLZ(aCompressed.data(), compressedSize, aDecompressed.data(), size);
+		}
+
+		totalSize += size;
+		totalCompressedSize += compressedSize;
+	}
+
+	fprintf(stderr, "LZ codec: ratio %.3f\n", (double)totalCompressedSize / (double)totalSize);
+}
+
+static void testCompressedMessages()
+{
+	LoopbackConnection connection;
+	if (!connection.connect())
+	{
+		check(false, "compressed messages: loopback connection");
+		return;
+	}
+
+	MessageChannel client(connection.pClient, true, 4);
+	MessageChannel host(connection.pHost, true);
+	check(client.start() && host.start(), "compressed messages: channels start");
+
+	const unsigned int imageSize = 256;
+	const unsigned int tileSize = 64;
+	const unsigned int numTiles = 200;
+
+	std::vector<Colour4f> aImage(imageSize * imageSize);
+	for (unsigned int y = 0; y < imageSize; y++)
+	{
+		for (unsigned int x = 0; x < imageSize; x++)
+		{
+			aImage[y * imageSize + x] = Colour4f((float)x / 255.0f, (float)y / 255.0f, 0.5f * sinf((float)x * 0.1f) + 0.5f, 1.0f);
+		}
+	}
+
+	// tiles from the client, more than its send queue holds, so sends overlap with the host receiving
+	for (unsigned int i = 0; i < numTiles; i++)
+	{
+		RemoteTileHeader header;
+		header.x = (i % 4) * tileSize;
+		header.y = ((i / 4) % 4) * tileSize;
+		header.width = tileSize;
+		header.height = tileSize;
+
+		check(sendRemoteTileResult(client, i, header, &aImage[header.y * imageSize + header.x], imageSize),
+			  "compressed messages: tile send");
+	}
+
+	// and a big, very compressible message the other way at the same time
+	std::vector<unsigned char> aScene;
+	fillTestData(aScene, 8 * 1024 * 1024, 1);
+	check(host.sendMessage(eRemoteMessageScene, 0, aScene.data(), aScene.size(), true), "compressed messages: scene send");
+
+	unsigned int tilesReceived = 0;
+	float maxError = 0.0f;
+
+	for (unsigned int i = 0; i < numTiles; i++)
+	{
+		MessageChannel::Message message;
+		if (!host.receiveMessage(message))
+			break;
+
+		RemoteTileHeader header;
+		std::vector<Colour4f> aPixels;
+		if (message.type != eRemoteMessageTileResult || message.id != i || !decodeRemoteTilePayload(message.payload, header, aPixels))
+			continue;
+
+		tilesReceived++;
+
+		for (unsigned int y = 0; y < header.height; y++)
+		{
+			for (unsigned int x = 0; x < header.width; x++)
+			{
+				const Colour4f& received = aPixels[y * header.width + x];
+				const Colour4f& original = aImage[(header.y + y) * imageSize + header.x + x];
+
+				float error = fabsf(received.r - original.r) + fabsf(received.g - original.g) + fabsf(received.b - original.b);
+				maxError = std::max(maxError, error);
+			}
+		}
+	}
+
+	check(tilesReceived == numTiles, "compressed messages: all tiles received in order");
+	// half float precision
+	check(maxError < 0.005f, "compressed messages: tile pixels match");
+
+	MessageChannel::Message sceneMessage;
+	check(client.receiveMessage(sceneMessage) && sceneMessage.type == eRemoteMessageScene && sceneMessage.payload == aScene,
+		  "compressed messages: scene received intact");
+
+	size_t payloadBytes = 0;
+	size_t wireBytes = 0;
+	host.getSendStatistics(payloadBytes, wireBytes);
+	check(payloadBytes == aScene.size() && wireBytes < payloadBytes / 4, "compressed messages: scene was compressed");
+
+	client.getSendStatistics(payloadBytes, wireBytes);
+	fprintf(stderr, "Tile results: %u tiles, compression ratio %.3f, max error %f\n", tilesReceived,
+			(double)wireBytes / (double)payloadBytes, maxError);
+
+	client.stop();
+	host.stop();
+}
+
+static void sendInPieces(Socket& socket, const std::vector<unsigned char>& aData, const size_t* pSplitPoints, unsigned int numSplitPoints)
+{
+	size_t start = 0;
+	for (unsigned int i = 0; i <= numSplitPoints; i++)
+	{
+		size_t end = (i < numSplitPoints) ? pSplitPoints[i] : aData.size();
+
+		socket.sendAll(aData.data() + start, end - start);
+		start = end;
+
+		// give the receive thread time to pick up the partial data
+		usleep(20000);
+	}
+}
+
+static void appendFrame(std::vector<unsigned char>& aStream, unsigned int type, unsigned int id, const std::vector<unsigned char>& aPayload,
+						bool compress)
+{
+	RawFrameHeader header;
+	header.magic = 0x4D46494D;
+	header.type = type;
+	header.id = id;
+	header.flags = compress ? 1 : 0;
+	header.payloadSize = (uint32_t)aPayload.size();
+
+	std::vector<unsigned char> aWireData;
+	if (compress)
+	{
+		aWireData.resize(getLZCompressionBound(aPayload.size()));
+		aWireData.resize(compressLZ(aPayload.data(), aPayload.size(), aWireData.data(), aWireData.size()));
+	}
+	else
+	{
+		aWireData = aPayload;
+	}
+
+	header.wireSize = (uint32_t)aWireData.size();
+
+	const unsigned char* pHeader = (const unsigned char*)&header;
+	aStream.insert(aStream.end(), pHeader, pHeader + sizeof(RawFrameHeader));
+	aStream.insert(aStream.end(), aWireData.begin(), aWireData.end());
+}
+
+static void testSplitFrames()
+{
+	LoopbackConnection connection;
+	if (!connection.connect())
+	{
+		check(false, "split frames: loopback connection");
+		return;
+	}
+
+	// the host end is written to by hand
+	MessageChannel client(connection.pClient, true);
+	check(client.start(), "split frames: channel starts");
+
+	std::vector<unsigned char> aPayload1;
+	std::vector<unsigned char> aPayload2;
+	fillTestData(aPayload1, 100000, 0);
+	fillTestData(aPayload2, 50000, 3);
+
+	std::vector<unsigned char> aStream;
+	appendFrame(aStream, 7, 1, aPayload1, false);
+	size_t secondFrameStart = aStream.size();
+	appendFrame(aStream, 8, 2, aPayload2, true);
+
+	// split in the middle of the first header, in the middle of the first payload, spanning the frame boundary,
+	// and in the middle of the second (compressed) payload
+	const size_t aSplitPoints[] = { 10, sizeof(RawFrameHeader) + 5000, secondFrameStart + 3, secondFrameStart + sizeof(RawFrameHeader) + 100 };
+	sendInPieces(*connection.pHost, aStream, aSplitPoints, 4);
+
+	MessageChannel::Message message1;
+	MessageChannel::Message message2;
+	check(client.receiveMessage(message1) && message1.type == 7 && message1.id == 1 && message1.payload == aPayload1,
+		  "split frames: uncompressed frame reassembled");
+	check(client.receiveMessage(message2) && message2.type == 8 && message2.id == 2 && message2.payload == aPayload2,
+		  "split frames: compressed frame reassembled");
+
+	// and a frame cut off part way through by the other end going away
+	std::vector<unsigned char> aTruncatedStream;
+	appendFrame(aTruncatedStream, 9, 3, aPayload1, false);
+	connection.pHost->sendAll(aTruncatedStream.data(), aTruncatedStream.size() / 2);
+	connection.pHost->close();
+
+	MessageChannel::Message message3;
+	check(!client.receiveMessage(message3), "split frames: truncated frame isn't delivered");
+	check(!client.isConnected(), "split frames: truncated frame disconnects");
+
+	client.stop();
+
+	delete connection.pHost;
+}
+
+static void testPeerDisconnect()
+{
+	LoopbackConnection connection;
+	if (!connection.connect())
+	{
+		check(false, "peer disconnect: loopback connection");
+		return;
+	}
+
+	MessageChannel client(connection.pClient, true, 4);
+	check(client.start(), "peer disconnect: channel starts");
+
+	// fill the socket buffers, with the host not reading anything, so the send thread is blocked part way through
+	// a send when the host goes away
+	std::vector<unsigned char> aPayload;
+	fillTestData(aPayload, 16 * 1024 * 1024, 0);
+
+	for (unsigned int i = 0; i < 2; i++)
+	{
+		check(client.sendMessage(1, i, aPayload.data(), aPayload.size(), false), "peer disconnect: initial sends");
+	}
+
+	usleep(200000);
+
+	connection.pHost->close();
+	delete connection.pHost;
+
+	// sends to a closed peer need to fail (rather than SIGPIPE killing the process) and disconnect the channel
+	unsigned int sendsAccepted = 0;
+	for (unsigned int i = 0; i < 1000; i++)
+	{
+		if (!client.sendMessage(1, i, aPayload.data(), 1024 * 1024, false))
+			break;
+
+		sendsAccepted++;
+	}
+
+	client.waitForSendsToComplete();
+
+	check(sendsAccepted < 1000, "peer disconnect: sends fail once the peer's gone");
+	check(!client.isConnected(), "peer disconnect: channel disconnects");
+
+	MessageChannel::Message message;
+	check(!client.receiveMessage(message), "peer disconnect: nothing received");
+
+	client.stop();
+
+	// and the other way round: the peer channel stopping cleanly
+	LoopbackConnection connection2;
+	if (!connection2.connect())
+	{
+		check(false, "peer disconnect: second loopback connection");
+		return;
+	}
+
+	MessageChannel client2(connection2.pClient, true);
+	MessageChannel host2(connection2.pHost, true);
+	check(client2.start() && host2.start(), "peer disconnect: second channels start");
+
+	check(host2.sendMessage(2, 1, aPayload.data(), 1000, true), "peer disconnect: final send");
+	host2.stop();
+
+	MessageChannel::Message finalMessage;
+	check(client2.receiveMessage(finalMessage) && finalMessage.id == 1 && finalMessage.payload.size() == 1000,
+		  "peer disconnect: messages sent before stop() arrive");
+	check(!client2.receiveMessage(finalMessage), "peer disconnect: receive fails after the peer stops");
+	check(!client2.isConnected(), "peer disconnect: channel sees the peer stop");
+
+	client2.stop();
+}
+
+int main(int argc, char** argv)
+{
+	testLZCodec();
+	testCompressedMessages();
+	testSplitFrames();
+	testPeerDisconnect();
+
+	if (g_failures > 0)
+	{
+		fprintf(stderr, "%u checks failed.\n", g_failures);
+		return 1;
+	}
+
+	fprintf(stderr, "All checks passed.\n");
+	return 0;
+}
@@ -830,7 +830,8 @@ Texture* TextureWidget::generateFloatTexture() const
 	ImageReader* pImageReader = FileIORegistry::instance().createImageReaderForExtension(extension);
 	if (pImageReader)
 	{
-		Image* pDisplacementMapImage = pImageReader->readGreyscaleImage(filePath, Image::IMAGE_FLAGS_EXACT);
+		// the texture is only looked up, so if the image is constant (i.e. a flat fill), a 1x1 image does just as well
+		Image* pDisplacementMapImage = pImageReader->readGreyscaleImage(filePath, Image::IMAGE_FLAGS_EXACT | Image::IMAGE_FLAGS_ALLOW_CONSTANT_COLLAPSE);
 		delete pImageReader;
 
 		if (!pDisplacementMapImage)
@@ -883,7 +884,8 @@ Texture* TextureWidget::generateColourTexture() const
 	ImageReader* pImageReader = FileIORegistry::instance().createImageReaderForExtension(extension);
 	if (pImageReader)
 	{
-		Image* pDisplacementMapImage = pImageReader->readColourImage(filePath, Image::IMAGE_FORMAT_NATIVE);
+		// the texture is only looked up, so if the image is constant (i.e. a flat fill), a 1x1 image does just as well
+		Image* pDisplacementMapImage = pImageReader->readColourImage(filePath, Image::IMAGE_FORMAT_NATIVE | Image::IMAGE_FLAGS_ALLOW_CONSTANT_COLLAPSE);
 		delete pImageReader;
 
 		if (!pDisplacementMapImage)
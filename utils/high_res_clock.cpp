@@ -0,0 +1,92 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#include "high_res_clock.h"
+
+#if HIGH_RES_CLOCK_TSC_AVAILABLE
+#include <cpuid.h>
+#endif
+
+namespace Imagine
+{
+
+// how long to spin for when calibrating the TSC rate against the system clock
+static const uint64_t kCalibrationNanoseconds = 10 * 1000 * 1000;
+
+void HighResClock::calibrate()
+{
+	getMicrosecondsPerTick();
+}
+
+double HighResClock::getTicksPerSecond()
+{
+	// only calibrated once, the first time it's needed
+	static const double ticksPerSecond = calibrateTicksPerSecond();
+	return ticksPerSecond;
+}
+
+double HighResClock::getMicrosecondsPerTick()
+{
+	static const double microsecondsPerTick = 1000000.0 / getTicksPerSecond();
+	return microsecondsPerTick;
+}
+
+bool HighResClock::isInvariantTSCAvailable()
+{
+#if HIGH_RES_CLOCK_TSC_AVAILABLE
+	unsigned int eax = 0;
+	unsigned int ebx = 0;
+	unsigned int ecx = 0;
+	unsigned int edx = 0;
+
+	if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) == 0 || eax < 0x80000007)
+		return false;
+
+	if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 0)
+		return false;
+
+	// bit 8 of EDX is the invariant TSC flag
+	return (edx & (1 << 8)) != 0;
+#else
+	return false;
+#endif
+}
+
+double HighResClock::calibrateTicksPerSecond()
+{
+	if (!isUsingTSC())
+	{
+		// ticks are nanoseconds
+		return 1000000000.0;
+	}
+
+	uint64_t startNanoseconds = getSystemClockNanoseconds();
+	uint64_t startTicks = getTicks();
+
+	uint64_t endNanoseconds = startNanoseconds;
+	while (endNanoseconds - startNanoseconds < kCalibrationNanoseconds)
+	{
+		endNanoseconds = getSystemClockNanoseconds();
+	}
+
+	uint64_t endTicks = getTicks();
+
+	return (double)(endTicks - startTicks) * 1000000000.0 / (double)(endNanoseconds - startNanoseconds);
+}
+
+} // namespace Imagine
@@ -0,0 +1,100 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#ifndef HIGH_RES_CLOCK_H
+#define HIGH_RES_CLOCK_H
+
+#include <ctime>
+#include <inttypes.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HIGH_RES_CLOCK_TSC_AVAILABLE 1
+#else
+#define HIGH_RES_CLOCK_TSC_AVAILABLE 0
+#endif
+
+namespace Imagine
+{
+
+// Cheap, high-resolution monotonic tick counter for timing small sections of code.
+// Where the CPU has an invariant TSC (constant rate, and synchronised between cores), this is just rdtsc, which is
+// a handful of cycles - otherwise it's clock_gettime() with CLOCK_MONOTONIC_RAW, which is still nanosecond resolution
+// and is done through the vDSO without a syscall.
+// Ticks aren't in any particular unit: the conversion functions use a rate calibrated against the system clock
+// (by spinning for a short while), so calibrate() should be called during setup, before anything is timed.
+
+class HighResClock
+{
+public:
+	static inline uint64_t getTicks()
+	{
+#if HIGH_RES_CLOCK_TSC_AVAILABLE
+		if (isUsingTSC())
+		{
+			return __rdtsc();
+		}
+#endif
+
+		return getSystemClockNanoseconds();
+	}
+
+	// calibrates the tick rate if it hasn't been already
+	static void calibrate();
+
+	static double getTicksPerSecond();
+
+	static uint64_t ticksToMicroseconds(uint64_t ticks)
+	{
+		return (uint64_t)((double)ticks * getMicrosecondsPerTick());
+	}
+
+	static double ticksToSeconds(uint64_t ticks)
+	{
+		return (double)ticks / getTicksPerSecond();
+	}
+
+	static bool isUsingTSC()
+	{
+		// function-local, so it's initialised on first use, rather than whenever static initialisation gets to it
+		static const bool useTSC = isInvariantTSCAvailable();
+		return useTSC;
+	}
+
+protected:
+	static inline uint64_t getSystemClockNanoseconds()
+	{
+		timespec timeValue;
+#ifdef CLOCK_MONOTONIC_RAW
+		clock_gettime(CLOCK_MONOTONIC_RAW, &timeValue);
+#else
+		clock_gettime(CLOCK_MONOTONIC, &timeValue);
+#endif
+		return (uint64_t)timeValue.tv_sec * 1000000000ull + (uint64_t)timeValue.tv_nsec;
+	}
+
+	static double getMicrosecondsPerTick();
+
+	static bool isInvariantTSCAvailable();
+
+	static double calibrateTicksPerSecond();
+};
+
+} // namespace Imagine
+
+#endif // HIGH_RES_CLOCK_H
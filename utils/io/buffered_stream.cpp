@@ -0,0 +1,183 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#include "buffered_stream.h"
+
+namespace Imagine
+{
+
+BufferedStream::BufferedStream(Stream* pStream, size_t bufferSize) : Stream(), m_pStream(pStream), m_pBuffer(nullptr),
+	m_bufferSize(std::max(bufferSize, (size_t)64)), m_bufferPos(0), m_bufferEnd(0), m_writing(false)
+{
+	m_pBuffer = new unsigned char[m_bufferSize];
+}
+
+BufferedStream::~BufferedStream()
+{
+	flush();
+
+	if (m_pBuffer)
+	{
+		delete [] m_pBuffer;
+		m_pBuffer = nullptr;
+	}
+}
+
+bool BufferedStream::read(void* ptr, size_t size)
+{
+	if (m_writing)
+	{
+		if (!flush())
+			return false;
+
+		m_writing = false;
+	}
+
+	unsigned char* pDest = (unsigned char*)ptr;
+
+	while (size > 0)
+	{
+		size_t available = m_bufferEnd - m_bufferPos;
+		if (available == 0)
+		{
+			// large reads can go straight into the destination
+			if (size >= m_bufferSize)
+			{
+				if (!m_pStream->read(pDest, size))
+				{
+					m_inError = true;
+					return false;
+				}
+
+				return true;
+			}
+
+			m_bufferPos = 0;
+			m_bufferEnd = m_pStream->readSome(m_pBuffer, m_bufferSize);
+			if (m_bufferEnd == 0)
+			{
+				m_inError = true;
+				return false;
+			}
+
+			available = m_bufferEnd;
+		}
+
+		size_t bytesToCopy = std::min(available, size);
+		memcpy(pDest, m_pBuffer + m_bufferPos, bytesToCopy);
+
+		m_bufferPos += bytesToCopy;
+		pDest += bytesToCopy;
+		size -= bytesToCopy;
+	}
+
+	return true;
+}
+
+bool BufferedStream::write(const void* ptr, size_t size)
+{
+	if (!m_writing)
+	{
+		// discard anything not read yet
+		m_bufferPos = 0;
+		m_bufferEnd = 0;
+
+		m_writing = true;
+	}
+
+	if (m_bufferEnd + size > m_bufferSize)
+	{
+		if (!flush())
+			return false;
+	}
+
+	// large writes can go straight from the source
+	if (size >= m_bufferSize)
+	{
+		if (!m_pStream->write(ptr, size))
+		{
+			m_inError = true;
+			return false;
+		}
+
+		return true;
+	}
+
+	memcpy(m_pBuffer + m_bufferEnd, ptr, size);
+	m_bufferEnd += size;
+
+	return true;
+}
+
+size_t BufferedStream::readSome(void* ptr, size_t maxSize)
+{
+	if (m_writing || m_bufferPos == m_bufferEnd)
+	{
+		// nothing buffered, so read what we can directly
+		if (m_writing)
+		{
+			if (!flush())
+				return 0;
+
+			m_writing = false;
+		}
+
+		size_t bytesRead = m_pStream->readSome(ptr, maxSize);
+		if (bytesRead == 0)
+		{
+			m_inError = true;
+		}
+
+		return bytesRead;
+	}
+
+	size_t bytesToCopy = std::min(m_bufferEnd - m_bufferPos, maxSize);
+	memcpy(ptr, m_pBuffer + m_bufferPos, bytesToCopy);
+	m_bufferPos += bytesToCopy;
+
+	return bytesToCopy;
+}
+
+bool BufferedStream::canRead()
+{
+	return m_pStream && m_pStream->canRead();
+}
+
+bool BufferedStream::canWrite()
+{
+	return m_pStream && m_pStream->canWrite();
+}
+
+bool BufferedStream::flush()
+{
+	if (!m_writing || m_bufferEnd == 0)
+		return true;
+
+	size_t bufferedSize = m_bufferEnd;
+	m_bufferEnd = 0;
+
+	if (!m_pStream->write(m_pBuffer, bufferedSize))
+	{
+		m_inError = true;
+		return false;
+	}
+
+	return true;
+}
+
+} // namespace Imagine
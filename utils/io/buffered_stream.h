@@ -0,0 +1,68 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#ifndef BUFFERED_STREAM_H
+#define BUFFERED_STREAM_H
+
+#include "stream.h"
+
+namespace Imagine
+{
+
+// Wraps another Stream, batching up the many small per-value reads and writes into large ones on the underlying stream,
+// which for FileStream and SocketStream are otherwise an fread() / fwrite() or recv() / send() per value.
+// Reads and writes can be interleaved (i.e. request / response over a socket), but switching from reading to writing
+// discards any unread buffered data, so it's not suitable for reading and writing the same seekable file.
+
+class BufferedStream : public Stream
+{
+public:
+	// doesn't take ownership of pStream
+	BufferedStream(Stream* pStream, size_t bufferSize = kDefaultBufferSize);
+	// flushes anything still buffered
+	virtual ~BufferedStream();
+
+	virtual bool read(void* ptr, size_t size);
+	virtual bool write(const void* ptr, size_t size);
+
+	virtual size_t readSome(void* ptr, size_t maxSize);
+
+	virtual bool canRead();
+	virtual bool canWrite();
+
+	// writes any buffered data to the underlying stream - this needs to be done before waiting for a response over a socket
+	bool flush();
+
+	static const size_t kDefaultBufferSize = 64 * 1024;
+
+protected:
+	Stream*			m_pStream;
+
+	unsigned char*	m_pBuffer;
+	size_t			m_bufferSize;
+
+	// when reading, m_bufferPos to m_bufferEnd is the data not read yet - when writing, m_bufferEnd is the amount buffered
+	size_t			m_bufferPos;
+	size_t			m_bufferEnd;
+
+	bool			m_writing;
+};
+
+} // namespace Imagine
+
+#endif // BUFFERED_STREAM_H
@@ -74,6 +74,21 @@ inline static uint16_t reverseUInt16Bytes(uint16_t value)
 	return finalValue;
 }
 
+// reverses the byte order of each of the count elements of elementSize bytes, in place
+inline static void reverseElementBytes(void* pData, size_t elementSize, size_t count)
+{
+	if (elementSize <= 1)
+		return;
+
+	unsigned char* pBytes = (unsigned char*)pData;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		std::reverse(pBytes, pBytes + elementSize);
+		pBytes += elementSize;
+	}
+}
+
 }
 
 #endif // DATA_CONVERSION_H
@@ -37,16 +37,37 @@ FileStream::~FileStream()
 
 bool FileStream::read(void* ptr, size_t size)
 {
-	fread(ptr, 1, size, m_pFile);
+	if (fread(ptr, 1, size, m_pFile) != size)
+	{
+		m_inError = true;
+		return false;
+	}
+
 	return true;
 }
 
 bool FileStream::write(const void* ptr, size_t size)
 {
-	fwrite(ptr, 1, size, m_pFile);
+	if (fwrite(ptr, 1, size, m_pFile) != size)
+	{
+		m_inError = true;
+		return false;
+	}
+
 	return true;
 }
 
+size_t FileStream::readSome(void* ptr, size_t maxSize)
+{
+	size_t bytesRead = fread(ptr, 1, maxSize, m_pFile);
+	if (bytesRead == 0 && ferror(m_pFile))
+	{
+		m_inError = true;
+	}
+
+	return bytesRead;
+}
+
 bool FileStream::canRead()
 {
 	return m_pFile != nullptr;
@@ -0,0 +1,257 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#include "lz_compression.h"
+
+#include <cstring>
+#include <inttypes.h>
+
+namespace Imagine
+{
+
+static const unsigned int kHashTableBits = 12;
+static const unsigned int kMinMatchLength = 4;
+static const size_t kMaxOffset = 65535;
+// the last match has to start at least this far from the end, and the last 5 bytes are always literals
+static const size_t kMatchStartLimit = 12;
+static const size_t kLastLiterals = 5;
+// how quickly we skip ahead when not finding matches
+static const unsigned int kSkipTrigger = 6;
+
+static inline uint32_t read32(const unsigned char* pData)
+{
+	uint32_t value;
+	memcpy(&value, pData, sizeof(uint32_t));
+	return value;
+}
+
+static inline uint32_t hashSequence(uint32_t sequence)
+{
+	return (sequence * 2654435761u) >> (32 - kHashTableBits);
+}
+
+// writes a length continuation (after the 15 in the token), returning false if it won't fit
+static inline bool writeLengthExtension(unsigned char*& pOut, const unsigned char* pOutEnd, size_t length)
+{
+	while (length >= 255)
+	{
+		if (pOut >= pOutEnd)
+			return false;
+		*pOut++ = 255;
+		length -= 255;
+	}
+
+	if (pOut >= pOutEnd)
+		return false;
+	*pOut++ = (unsigned char)length;
+
+	return true;
+}
+
+static inline bool readLengthExtension(const unsigned char*& pIn, const unsigned char* pInEnd, size_t& length)
+{
+	unsigned char value = 255;
+	while (value == 255)
+	{
+		if (pIn >= pInEnd)
+			return false;
+		value = *pIn++;
+		length += value;
+	}
+
+	return true;
+}
+
+// writes a sequence - matchLength of 0 means the final literals-only sequence
+static bool writeSequence(unsigned char*& pOut, const unsigned char* pOutEnd, const unsigned char* pLiterals, size_t literalLength,
+						  size_t offset, size_t matchLength)
+{
+	if (pOut >= pOutEnd)
+		return false;
+
+	unsigned char* pToken = pOut++;
+
+	size_t tokenMatchLength = (matchLength > 0) ? matchLength - kMinMatchLength : 0;
+
+	*pToken = (unsigned char)(((literalLength < 15 ? literalLength : 15) << 4) | (tokenMatchLength < 15 ? tokenMatchLength : 15));
+
+	if (literalLength >= 15 && !writeLengthExtension(pOut, pOutEnd, literalLength - 15))
+		return false;
+
+	if (literalLength > (size_t)(pOutEnd - pOut))
+		return false;
+
+	if (literalLength > 0)
+	{
+		memcpy(pOut, pLiterals, literalLength);
+		pOut += literalLength;
+	}
+
+	if (matchLength == 0)
+		return true;
+
+	if (pOut + 2 > pOutEnd)
+		return false;
+
+	*pOut++ = (unsigned char)(offset & 0xFF);
+	*pOut++ = (unsigned char)(offset >> 8);
+
+	if (tokenMatchLength >= 15 && !writeLengthExtension(pOut, pOutEnd, tokenMatchLength - 15))
+		return false;
+
+	return true;
+}
+
+size_t getLZCompressionBound(size_t srcSize)
+{
+	return srcSize + (srcSize / 255) + 16;
+}
+
+size_t compressLZ(const void* pSrc, size_t srcSize, void* pDst, size_t dstCapacity)
+{
+	const unsigned char* pIn = (const unsigned char*)pSrc;
+	unsigned char* pOut = (unsigned char*)pDst;
+	const unsigned char* pOutEnd = pOut + dstCapacity;
+
+	size_t anchor = 0;
+
+	if (srcSize > kMatchStartLimit)
+	{
+		// positions + 1, so 0 means empty
+		uint32_t hashTable[1 << kHashTableBits];
+		memset(hashTable, 0, sizeof(hashTable));
+
+		const size_t matchStartEnd = srcSize - kMatchStartLimit;
+		const size_t matchEnd = srcSize - kLastLiterals;
+
+		size_t pos = 0;
+		unsigned int missCount = 0;
+
+		while (pos < matchStartEnd)
+		{
+			uint32_t sequence = read32(pIn + pos);
+			uint32_t hash = hashSequence(sequence);
+			size_t candidate = hashTable[hash];
+			hashTable[hash] = (uint32_t)(pos + 1);
+
+			if (candidate == 0 || pos + 1 - candidate > kMaxOffset || read32(pIn + candidate - 1) != sequence)
+			{
+				pos += 1 + (missCount++ >> kSkipTrigger);
+				continue;
+			}
+
+			candidate -= 1;
+			missCount = 0;
+
+			// extend backwards into the pending literals
+			while (pos > anchor && candidate > 0 && pIn[pos - 1] == pIn[candidate - 1])
+			{
+				pos--;
+				candidate--;
+			}
+
+			size_t matchLength = kMinMatchLength;
+			while (pos + matchLength < matchEnd && pIn[pos + matchLength] == pIn[candidate + matchLength])
+			{
+				matchLength++;
+			}
+
+			if (!writeSequence(pOut, pOutEnd, pIn + anchor, pos - anchor, pos - candidate, matchLength))
+				return 0;
+
+			pos += matchLength;
+			anchor = pos;
+
+			// seed the hash table with the position just before, as runs often continue from there
+			if (pos < matchStartEnd)
+			{
+				hashTable[hashSequence(read32(pIn + pos - 2))] = (uint32_t)(pos - 1);
+			}
+		}
+	}
+
+	if (!writeSequence(pOut, pOutEnd, pIn + anchor, srcSize - anchor, 0, 0))
+		return 0;
+
+	return pOut - (unsigned char*)pDst;
+}
+
+bool decompressLZ(const void* pSrc, size_t srcSize, void* pDst, size_t dstSize)
+{
+	const unsigned char* pIn = (const unsigned char*)pSrc;
+	const unsigned char* pInEnd = pIn + srcSize;
+	unsigned char* pOutStart = (unsigned char*)pDst;
+	unsigned char* pOut = pOutStart;
+	unsigned char* pOutEnd = pOut + dstSize;
+
+	while (pIn < pInEnd)
+	{
+		unsigned char token = *pIn++;
+
+		size_t literalLength = token >> 4;
+		if (literalLength == 15 && !readLengthExtension(pIn, pInEnd, literalLength))
+			return false;
+
+		if (literalLength > (size_t)(pInEnd - pIn) || literalLength > (size_t)(pOutEnd - pOut))
+			return false;
+
+		memcpy(pOut, pIn, literalLength);
+		pIn += literalLength;
+		pOut += literalLength;
+
+		// the last sequence is just literals
+		if (pIn == pInEnd)
+			break;
+
+		if (pIn + 2 > pInEnd)
+			return false;
+
+		size_t offset = (size_t)pIn[0] | ((size_t)pIn[1] << 8);
+		pIn += 2;
+
+		if (offset == 0 || offset > (size_t)(pOut - pOutStart))
+			return false;
+
+		size_t matchLength = token & 15;
+		if (matchLength == 15 && !readLengthExtension(pIn, pInEnd, matchLength))
+			return false;
+		matchLength += kMinMatchLength;
+
+		if (matchLength > (size_t)(pOutEnd - pOut))
+			return false;
+
+		const unsigned char* pMatch = pOut - offset;
+		if (offset >= matchLength)
+		{
+			memcpy(pOut, pMatch, matchLength);
+			pOut += matchLength;
+		}
+		else
+		{
+			// overlapping, so it's a repeating pattern - needs to be copied forwards a byte at a time
+			for (size_t i = 0; i < matchLength; i++)
+			{
+				*pOut++ = *pMatch++;
+			}
+		}
+	}
+
+	return pOut == pOutEnd;
+}
+
+} // namespace Imagine
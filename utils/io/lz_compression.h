@@ -0,0 +1,43 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#ifndef LZ_COMPRESSION_H
+#define LZ_COMPRESSION_H
+
+#include <cstddef>
+
+namespace Imagine
+{
+
+// Fast LZ77 block compression, along the lines of LZ4's block format: a token byte with 4-bit literal and match lengths
+// (extended with 255-continuation bytes), the literals, then a 2-byte offset back into a 64 KB window.
+// It's aimed at throughput rather than ratio, for compressing network payloads, so only does a single hash probe
+// per position, skipping ahead faster through data that isn't compressing.
+
+// worst-case compressed size for srcSize bytes of input
+size_t getLZCompressionBound(size_t srcSize);
+
+// returns the compressed size, or 0 if it didn't fit in dstCapacity
+size_t compressLZ(const void* pSrc, size_t srcSize, void* pDst, size_t dstCapacity);
+
+// dstSize must be the exact uncompressed size - returns false if the data's corrupt or doesn't decompress to that
+bool decompressLZ(const void* pSrc, size_t srcSize, void* pDst, size_t dstSize);
+
+} // namespace Imagine
+
+#endif // LZ_COMPRESSION_H
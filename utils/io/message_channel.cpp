@@ -0,0 +1,432 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#include "message_channel.h"
+
+#include <cstring>
+#include <algorithm>
+#include <inttypes.h>
+
+#include "lz_compression.h"
+
+#include "utils/socket.h"
+
+namespace Imagine
+{
+
+static const uint32_t kFrameMagic = 0x4D46494D; // "IMFM"
+
+static const uint32_t kFrameFlagCompressed = 1 << 0;
+
+// not worth trying to compress anything smaller than this
+static const size_t kMinCompressionSize = 256;
+// sanity limit on sizes in frame headers, so corrupt data doesn't make us try and allocate huge amounts
+static const size_t kMaxFrameSize = 1024 * 1024 * 1024;
+
+struct FrameHeader
+{
+	uint32_t	magic;
+	uint32_t	type;
+	uint32_t	id;
+	uint32_t	flags;
+	uint32_t	payloadSize;	// uncompressed
+	uint32_t	wireSize;		// what follows the header
+};
+
+void MessageChannel::SendThread::run()
+{
+	m_pChannel->sendLoop();
+}
+
+void MessageChannel::ReceiveThread::run()
+{
+	m_pChannel->receiveLoop();
+}
+
+MessageChannel::MessageChannel(Socket* pSocket, bool ownSocket, unsigned int maxQueuedSends) : m_pSocket(pSocket), m_ownSocket(ownSocket),
+	m_pSendThread(nullptr), m_pReceiveThread(nullptr), m_connected(false), m_stopping(false),
+	m_maxQueuedSends(std::max(maxQueuedSends, 1u)), m_sendsInProgress(0), m_payloadBytesSent(0), m_wireBytesSent(0)
+{
+}
+
+MessageChannel::~MessageChannel()
+{
+	stop();
+
+	if (m_ownSocket && m_pSocket)
+	{
+		delete m_pSocket;
+		m_pSocket = nullptr;
+	}
+}
+
+bool MessageChannel::start()
+{
+	if (m_pSendThread || !m_pSocket || !m_pSocket->isValid())
+		return false;
+
+	m_connected = true;
+	m_stopping = false;
+
+	m_pSendThread = new SendThread(this);
+	m_pReceiveThread = new ReceiveThread(this);
+
+	if (!m_pSendThread->start())
+	{
+		delete m_pSendThread;
+		m_pSendThread = nullptr;
+		delete m_pReceiveThread;
+		m_pReceiveThread = nullptr;
+
+		m_connected = false;
+		return false;
+	}
+
+	if (!m_pReceiveThread->start())
+	{
+		delete m_pReceiveThread;
+		m_pReceiveThread = nullptr;
+
+		stop();
+		return false;
+	}
+
+	return true;
+}
+
+void MessageChannel::stop()
+{
+	if (!m_pSendThread)
+		return;
+
+	m_sendLock.lock();
+	m_stopping = true;
+	m_sendAvailable.signal();
+	m_sendLock.unlock();
+
+	// this will send anything still queued before finishing
+	m_pSendThread->waitForCompletion();
+	delete m_pSendThread;
+	m_pSendThread = nullptr;
+
+	// wake up the receive thread if it's blocked in recv()
+	m_pSocket->shutdown();
+
+	if (m_pReceiveThread)
+	{
+		m_pReceiveThread->waitForCompletion();
+		delete m_pReceiveThread;
+		m_pReceiveThread = nullptr;
+	}
+
+	setDisconnected();
+
+	if (m_ownSocket)
+	{
+		m_pSocket->close();
+	}
+}
+
+bool MessageChannel::sendMessage(Message& message, bool compress)
+{
+	m_sendLock.lock();
+
+	while (m_connected && m_sendQueue.size() >= m_maxQueuedSends)
+	{
+		m_sendSpaceAvailable.reset();
+		m_sendLock.unlock();
+
+		m_sendSpaceAvailable.wait();
+
+		m_sendLock.lock();
+	}
+
+	if (!m_connected || m_stopping)
+	{
+		m_sendLock.unlock();
+		return false;
+	}
+
+	m_sendQueue.emplace_back(QueuedMessage());
+	QueuedMessage& queuedMessage = m_sendQueue.back();
+	queuedMessage.message.type = message.type;
+	queuedMessage.message.id = message.id;
+	queuedMessage.message.payload.swap(message.payload);
+	queuedMessage.compress = compress;
+
+	m_sendAvailable.signal();
+
+	m_sendLock.unlock();
+
+	return true;
+}
+
+bool MessageChannel::sendMessage(unsigned int type, unsigned int id, const void* pData, size_t size, bool compress)
+{
+	Message message;
+	message.type = type;
+	message.id = id;
+	message.payload.assign((const unsigned char*)pData, (const unsigned char*)pData + size);
+
+	return sendMessage(message, compress);
+}
+
+bool MessageChannel::receiveMessage(Message& message, bool wait)
+{
+	m_receiveLock.lock();
+
+	while (m_receiveQueue.empty())
+	{
+		if (!wait || !m_connected)
+		{
+			m_receiveLock.unlock();
+			return false;
+		}
+
+		m_receiveAvailable.reset();
+		m_receiveLock.unlock();
+
+		m_receiveAvailable.wait();
+
+		m_receiveLock.lock();
+	}
+
+	Message& frontMessage = m_receiveQueue.front();
+	message.type = frontMessage.type;
+	message.id = frontMessage.id;
+	message.payload.swap(frontMessage.payload);
+	m_receiveQueue.pop_front();
+
+	m_receiveLock.unlock();
+
+	return true;
+}
+
+void MessageChannel::waitForSendsToComplete()
+{
+	m_sendLock.lock();
+
+	while (m_connected && (!m_sendQueue.empty() || m_sendsInProgress > 0))
+	{
+		m_sendsComplete.reset();
+		m_sendLock.unlock();
+
+		m_sendsComplete.wait();
+
+		m_sendLock.lock();
+	}
+
+	m_sendLock.unlock();
+}
+
+unsigned int MessageChannel::getNumQueuedSends()
+{
+	m_sendLock.lock();
+	unsigned int numQueued = (unsigned int)m_sendQueue.size() + m_sendsInProgress;
+	m_sendLock.unlock();
+
+	return numQueued;
+}
+
+void MessageChannel::getSendStatistics(size_t& payloadBytes, size_t& wireBytes)
+{
+	m_sendLock.lock();
+	payloadBytes = m_payloadBytesSent;
+	wireBytes = m_wireBytesSent;
+	m_sendLock.unlock();
+}
+
+void MessageChannel::sendLoop()
+{
+	while (true)
+	{
+		m_sendLock.lock();
+
+		while (m_sendQueue.empty() && !m_stopping && m_connected)
+		{
+			m_sendAvailable.reset();
+			m_sendLock.unlock();
+
+			m_sendAvailable.wait();
+
+			m_sendLock.lock();
+		}
+
+		if (m_sendQueue.empty() || !m_connected)
+		{
+			m_sendLock.unlock();
+			break;
+		}
+
+		QueuedMessage queuedMessage;
+		queuedMessage.message.type = m_sendQueue.front().message.type;
+		queuedMessage.message.id = m_sendQueue.front().message.id;
+		queuedMessage.message.payload.swap(m_sendQueue.front().message.payload);
+		queuedMessage.compress = m_sendQueue.front().compress;
+		m_sendQueue.pop_front();
+		m_sendsInProgress++;
+
+		m_sendSpaceAvailable.broadcast();
+
+		m_sendLock.unlock();
+
+		bool sent = sendFrame(queuedMessage);
+
+		m_sendLock.lock();
+		m_sendsInProgress--;
+		if (m_sendQueue.empty())
+		{
+			m_sendsComplete.broadcast();
+		}
+		m_sendLock.unlock();
+
+		if (!sent)
+		{
+			setDisconnected();
+			break;
+		}
+	}
+}
+
+void MessageChannel::receiveLoop()
+{
+	while (m_connected)
+	{
+		Message message;
+		if (!receiveFrame(message))
+			break;
+
+		m_receiveLock.lock();
+
+		m_receiveQueue.emplace_back(Message());
+		Message& queuedMessage = m_receiveQueue.back();
+		queuedMessage.type = message.type;
+		queuedMessage.id = message.id;
+		queuedMessage.payload.swap(message.payload);
+
+		m_receiveAvailable.broadcast();
+
+		m_receiveLock.unlock();
+	}
+
+	setDisconnected();
+}
+
+bool MessageChannel::sendFrame(const QueuedMessage& queuedMessage)
+{
+	const std::vector<unsigned char>& payload = queuedMessage.message.payload;
+
+	if (payload.size() > kMaxFrameSize)
+		return false;
+
+	FrameHeader header;
+	header.magic = kFrameMagic;
+	header.type = queuedMessage.message.type;
+	header.id = queuedMessage.message.id;
+	header.flags = 0;
+	header.payloadSize = (uint32_t)payload.size();
+	header.wireSize = (uint32_t)payload.size();
+
+	// build the whole frame in one buffer so it goes out in a single send() - separate small header sends
+	// interact badly with Nagle's algorithm and delayed ACKs
+	size_t maxFrameSize = sizeof(FrameHeader) + std::max(payload.size(), getLZCompressionBound(payload.size()));
+	if (m_compressionBuffer.size() < maxFrameSize)
+	{
+		m_compressionBuffer.resize(maxFrameSize);
+	}
+
+	unsigned char* pFrameData = m_compressionBuffer.data() + sizeof(FrameHeader);
+
+	if (queuedMessage.compress && payload.size() >= kMinCompressionSize)
+	{
+		size_t compressedSize = compressLZ(payload.data(), payload.size(), pFrameData, maxFrameSize - sizeof(FrameHeader));
+		// only use it if it's actually smaller
+		if (compressedSize > 0 && compressedSize < payload.size())
+		{
+			header.flags |= kFrameFlagCompressed;
+			header.wireSize = (uint32_t)compressedSize;
+		}
+	}
+
+	if (!(header.flags & kFrameFlagCompressed) && !payload.empty())
+	{
+		memcpy(pFrameData, payload.data(), payload.size());
+	}
+
+	memcpy(m_compressionBuffer.data(), &header, sizeof(FrameHeader));
+
+	if (!m_pSocket->sendAll(m_compressionBuffer.data(), sizeof(FrameHeader) + header.wireSize))
+		return false;
+
+	m_sendLock.lock();
+	m_payloadBytesSent += header.payloadSize;
+	m_wireBytesSent += header.wireSize;
+	m_sendLock.unlock();
+
+	return true;
+}
+
+bool MessageChannel::receiveFrame(Message& message)
+{
+	FrameHeader header;
+	if (!m_pSocket->receiveAll(&header, sizeof(FrameHeader)))
+		return false;
+
+	if (header.magic != kFrameMagic || header.payloadSize > kMaxFrameSize || header.wireSize > kMaxFrameSize)
+		return false;
+
+	message.type = header.type;
+	message.id = header.id;
+	message.payload.resize(header.payloadSize);
+
+	if (!(header.flags & kFrameFlagCompressed))
+	{
+		if (header.wireSize != header.payloadSize)
+			return false;
+
+		return header.wireSize == 0 || m_pSocket->receiveAll(message.payload.data(), header.wireSize);
+	}
+
+	if (m_decompressionBuffer.size() < header.wireSize)
+	{
+		m_decompressionBuffer.resize(header.wireSize);
+	}
+
+	if (!m_pSocket->receiveAll(m_decompressionBuffer.data(), header.wireSize))
+		return false;
+
+	return decompressLZ(m_decompressionBuffer.data(), header.wireSize, message.payload.data(), message.payload.size());
+}
+
+void MessageChannel::setDisconnected()
+{
+	m_connected = false;
+
+	// wake anything waiting, so it can see we're disconnected
+	m_sendLock.lock();
+	m_sendAvailable.broadcast();
+	m_sendSpaceAvailable.broadcast();
+	m_sendsComplete.broadcast();
+	m_sendLock.unlock();
+
+	m_receiveLock.lock();
+	m_receiveAvailable.broadcast();
+	m_receiveLock.unlock();
+}
+
+} // namespace Imagine
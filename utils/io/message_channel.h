@@ -0,0 +1,159 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#ifndef MESSAGE_CHANNEL_H
+#define MESSAGE_CHANNEL_H
+
+#include <vector>
+#include <deque>
+
+#include "utils/threads/thread.h"
+#include "utils/threads/mutex.h"
+#include "utils/threads/event.h"
+
+namespace Imagine
+{
+
+class Socket;
+
+// Framed, optionally-compressed messages over a connected Socket, with the sending and receiving done on dedicated
+// threads, so callers (i.e. render threads) only ever queue messages or pick up ones which have already arrived,
+// and never block on the network themselves.
+// Sends are pipelined: any number of messages (up to the queue limit) can be in flight at once without waiting for
+// the other end, and compression happens on the send thread, so it overlaps with whatever the caller does next.
+// Both ends need to be the same endianness, as with SocketStream.
+
+class MessageChannel
+{
+public:
+	struct Message
+	{
+		Message() : type(0), id(0)
+		{
+		}
+
+		unsigned int				type;
+		unsigned int				id;
+		std::vector<unsigned char>	payload;
+	};
+
+	// pSocket must already be connected (or accepted)
+	MessageChannel(Socket* pSocket, bool ownSocket, unsigned int maxQueuedSends = kDefaultMaxQueuedSends);
+	~MessageChannel();
+
+	bool start();
+	// sends anything still queued, then shuts down the connection
+	void stop();
+
+	// takes the payload out of message (it'll be empty afterwards) rather than copying it. Only blocks if there are
+	// already maxQueuedSends messages waiting to go. Returns false if the connection's gone.
+	bool sendMessage(Message& message, bool compress);
+	bool sendMessage(unsigned int type, unsigned int id, const void* pData, size_t size, bool compress);
+
+	// returns false if there's nothing available (when not waiting), or the connection's gone and nothing's left
+	bool receiveMessage(Message& message, bool wait = true);
+
+	void waitForSendsToComplete();
+
+	bool isConnected() const { return m_connected; }
+
+	unsigned int getNumQueuedSends();
+
+	// payload bytes before and after compression, for seeing how effective it is
+	void getSendStatistics(size_t& payloadBytes, size_t& wireBytes);
+
+	static const unsigned int kDefaultMaxQueuedSends = 64;
+
+protected:
+	struct QueuedMessage
+	{
+		Message			message;
+		bool			compress;
+	};
+
+	class SendThread : public Thread
+	{
+	public:
+		SendThread(MessageChannel* pChannel) : Thread(), m_pChannel(pChannel)
+		{
+		}
+
+		virtual void run();
+
+	protected:
+		MessageChannel*	m_pChannel;
+	};
+
+	class ReceiveThread : public Thread
+	{
+	public:
+		ReceiveThread(MessageChannel* pChannel) : Thread(), m_pChannel(pChannel)
+		{
+		}
+
+		virtual void run();
+
+	protected:
+		MessageChannel*	m_pChannel;
+	};
+
+	void sendLoop();
+	void receiveLoop();
+
+	bool sendFrame(const QueuedMessage& queuedMessage);
+	bool receiveFrame(Message& message);
+
+	void setDisconnected();
+
+protected:
+	Socket*						m_pSocket;
+	bool						m_ownSocket;
+
+	SendThread*					m_pSendThread;
+	ReceiveThread*				m_pReceiveThread;
+
+	volatile bool				m_connected;
+	volatile bool				m_stopping;
+
+	// send side
+	Mutex						m_sendLock;
+	std::deque<QueuedMessage>	m_sendQueue;
+	unsigned int				m_maxQueuedSends;
+	unsigned int				m_sendsInProgress;
+	Event						m_sendAvailable;
+	Event						m_sendSpaceAvailable;
+	Event						m_sendsComplete;
+
+	size_t						m_payloadBytesSent;
+	size_t						m_wireBytesSent;
+
+	// re-used between sends, only touched by the send thread
+	std::vector<unsigned char>	m_compressionBuffer;
+
+	// receive side
+	Mutex						m_receiveLock;
+	std::deque<Message>			m_receiveQueue;
+	Event						m_receiveAvailable;
+
+	// only touched by the receive thread
+	std::vector<unsigned char>	m_decompressionBuffer;
+};
+
+} // namespace Imagine
+
+#endif // MESSAGE_CHANNEL_H
@@ -0,0 +1,201 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#include "mmap_file_stream.h"
+
+#include <cstdio>
+
+#ifndef _MSC_VER
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Imagine
+{
+
+MMapFileStream::MMapFileStream() : Stream(), m_pData(nullptr), m_size(0), m_position(0), m_mapped(false)
+{
+}
+
+MMapFileStream::MMapFileStream(const std::string& path) : Stream(), m_pData(nullptr), m_size(0), m_position(0), m_mapped(false)
+{
+	open(path);
+}
+
+MMapFileStream::~MMapFileStream()
+{
+	close();
+}
+
+bool MMapFileStream::read(void* ptr, size_t size)
+{
+	if (size > m_size - m_position)
+	{
+		m_inError = true;
+		return false;
+	}
+
+	memcpy(ptr, m_pData + m_position, size);
+	m_position += size;
+
+	return true;
+}
+
+bool MMapFileStream::write(const void* ptr, size_t size)
+{
+	m_inError = true;
+	return false;
+}
+
+size_t MMapFileStream::readSome(void* ptr, size_t maxSize)
+{
+	size_t bytesToCopy = std::min(m_size - m_position, maxSize);
+	if (bytesToCopy > 0)
+	{
+		memcpy(ptr, m_pData + m_position, bytesToCopy);
+		m_position += bytesToCopy;
+	}
+
+	return bytesToCopy;
+}
+
+bool MMapFileStream::canRead()
+{
+	return m_pData != nullptr;
+}
+
+bool MMapFileStream::canWrite()
+{
+	return false;
+}
+
+bool MMapFileStream::open(const std::string& filePath)
+{
+	close();
+
+	m_inError = false;
+
+#ifndef _MSC_VER
+	int fd = ::open(filePath.c_str(), O_RDONLY);
+	if (fd == -1)
+		return false;
+
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		// can't map empty files
+		::close(fd);
+		return false;
+	}
+
+	void* pMapped = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// the mapping keeps its own reference to the file
+	::close(fd);
+
+	if (pMapped == MAP_FAILED)
+		return false;
+
+	// we nearly always read through from start to finish, so let the kernel read ahead aggressively
+	madvise(pMapped, (size_t)fileStat.st_size, MADV_SEQUENTIAL);
+
+	m_pData = (const unsigned char*)pMapped;
+	m_size = (size_t)fileStat.st_size;
+	m_mapped = true;
+#else
+	FILE* pFile = fopen(filePath.c_str(), "rb");
+	if (!pFile)
+		return false;
+
+	fseek(pFile, 0, SEEK_END);
+	long fileSize = ftell(pFile);
+	fseek(pFile, 0, SEEK_SET);
+
+	if (fileSize <= 0)
+	{
+		fclose(pFile);
+		return false;
+	}
+
+	unsigned char* pBuffer = new unsigned char[fileSize];
+	if (fread(pBuffer, 1, fileSize, pFile) != (size_t)fileSize)
+	{
+		delete [] pBuffer;
+		fclose(pFile);
+		return false;
+	}
+
+	fclose(pFile);
+
+	m_pData = pBuffer;
+	m_size = (size_t)fileSize;
+	m_mapped = false;
+#endif
+
+	m_position = 0;
+
+	return true;
+}
+
+void MMapFileStream::close()
+{
+	if (!m_pData)
+		return;
+
+#ifndef _MSC_VER
+	if (m_mapped)
+	{
+		munmap((void*)m_pData, m_size);
+	}
+	else
+#endif
+	{
+		delete [] m_pData;
+	}
+
+	m_pData = nullptr;
+	m_size = 0;
+	m_position = 0;
+	m_mapped = false;
+}
+
+bool MMapFileStream::seek(size_t position)
+{
+	if (position > m_size)
+		return false;
+
+	m_position = position;
+	return true;
+}
+
+const void* MMapFileStream::readInPlace(size_t size)
+{
+	if (size > m_size - m_position)
+	{
+		m_inError = true;
+		return nullptr;
+	}
+
+	const void* pData = m_pData + m_position;
+	m_position += size;
+
+	return pData;
+}
+
+} // namespace Imagine
@@ -0,0 +1,69 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#ifndef MMAP_FILE_STREAM_H
+#define MMAP_FILE_STREAM_H
+
+#include "stream.h"
+
+namespace Imagine
+{
+
+// Read-only Stream of a memory-mapped file, so reads are just a memcpy() from the page cache rather than going through
+// stdio, and large payloads can be accessed in-place with readInPlace() without copying them at all.
+// On platforms without mmap(), the file's read into memory up-front instead.
+
+class MMapFileStream : public Stream
+{
+public:
+	MMapFileStream();
+	MMapFileStream(const std::string& path);
+	virtual ~MMapFileStream();
+
+	virtual bool read(void* ptr, size_t size);
+	// always fails - these are read-only
+	virtual bool write(const void* ptr, size_t size);
+
+	virtual size_t readSome(void* ptr, size_t maxSize);
+
+	virtual bool canRead();
+	virtual bool canWrite();
+
+	bool open(const std::string& filePath);
+	void close();
+
+	size_t getSize() const { return m_size; }
+	size_t getPosition() const { return m_position; }
+	bool seek(size_t position);
+
+	// returns a pointer to the next size bytes of the file and moves past them, or nullptr if there aren't that many left.
+	// The pointer's only valid while the stream is open.
+	const void* readInPlace(size_t size);
+
+protected:
+	const unsigned char*	m_pData;
+	size_t					m_size;
+	size_t					m_position;
+
+	// whether m_pData is mapped, or was allocated
+	bool					m_mapped;
+};
+
+} // namespace Imagine
+
+#endif // MMAP_FILE_STREAM_H
@@ -42,18 +42,30 @@ SocketStream::~SocketStream()
 	}
 }
 
-// TODO: these are crap - need to serialise to memory first then send/receive in chunks...
+// Note: these are a send / recv per value - wrap in a BufferedStream for anything non-trivial
 bool SocketStream::read(void* ptr, size_t size)
 {
 	return m_pSocket->recv(ptr, size);
 }
 
-// TODO: these are crap - need to serialise to memory first then send/receive in chunks...
 bool SocketStream::write(const void* ptr, size_t size)
 {
 	return m_pSocket->send(ptr, size);
 }
 
+size_t SocketStream::readSome(void* ptr, size_t maxSize)
+{
+	ssize_t bytesReceived = m_pSocket->receiveChunk(ptr, maxSize);
+	if (bytesReceived <= 0)
+	{
+		// 0 is the other end closing the connection
+		m_inError = true;
+		return 0;
+	}
+
+	return (size_t)bytesReceived;
+}
+
 bool SocketStream::canRead()
 {
 	return m_pSocket && m_pSocket->isValid();
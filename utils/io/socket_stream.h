@@ -35,6 +35,8 @@ public:
 	virtual bool read(void* ptr, size_t size);
 	virtual bool write(const void* ptr, size_t size);
 
+	virtual size_t readSome(void* ptr, size_t maxSize);
+
 	virtual bool canRead();
 	virtual bool canWrite();
 
@@ -29,6 +29,11 @@ Stream::~Stream()
 {
 }
 
+size_t Stream::readSome(void* ptr, size_t maxSize)
+{
+	return read(ptr, maxSize) ? maxSize : 0;
+}
+
 void Stream::storeString(const std::string& string)
 {
 	size_t size = string.size();
@@ -20,8 +20,13 @@
 #define STREAM_H
 
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <cstring>
 #include <inttypes.h>
 
+#include "data_conversion.h"
+
 namespace Imagine
 {
 
@@ -36,6 +41,10 @@ public:
 	virtual bool read(void* ptr, size_t size) = 0;
 	virtual bool write(const void* ptr, size_t size) = 0;
 
+	// reads up to maxSize bytes, returning the number read - 0 on error or the end of the stream. Unlike read(), this
+	// doesn't wait for the full amount, so is what buffering needs. The default just does a full read().
+	virtual size_t readSome(void* ptr, size_t maxSize);
+
 	virtual bool canRead() = 0;
 	virtual bool canWrite() = 0;
 
@@ -73,7 +82,73 @@ public:
 	void storeBool(const bool& value);
 	void loadBool(bool& value);
 
+	// bulk versions for arrays of plain-old-data values, which are done with a single write() / read() rather than per-value.
+	// If reverseByteOrder is set, the bytes of each element are reversed to convert between endiannesses, so this only
+	// makes sense for scalar types then.
+	template <typename T>
+	bool storeArray(const T* pValues, size_t count, bool reverseByteOrder = false)
+	{
+		if (!reverseByteOrder || sizeof(T) == 1)
+			return write(pValues, sizeof(T) * count);
+
+		// convert in chunks, so we don't need a copy of the whole array
+		unsigned char tempBuffer[kByteOrderChunkSize];
+		const size_t chunkItems = kByteOrderChunkSize / sizeof(T);
+
+		for (size_t start = 0; start < count; start += chunkItems)
+		{
+			size_t numItems = std::min(count - start, chunkItems);
+
+			memcpy(tempBuffer, pValues + start, sizeof(T) * numItems);
+			reverseElementBytes(tempBuffer, sizeof(T), numItems);
+
+			if (!write(tempBuffer, sizeof(T) * numItems))
+				return false;
+		}
+
+		return true;
+	}
+
+	template <typename T>
+	bool loadArray(T* pValues, size_t count, bool reverseByteOrder = false)
+	{
+		if (!read(pValues, sizeof(T) * count))
+			return false;
+
+		if (reverseByteOrder)
+		{
+			reverseElementBytes(pValues, sizeof(T), count);
+		}
+
+		return true;
+	}
+
+	// as above, but with the item count stored first
+	template <typename T>
+	bool storeVector(const std::vector<T>& aValues, bool reverseByteOrder = false)
+	{
+		unsigned int count = (unsigned int)aValues.size();
+		storeUInt(count);
+
+		return aValues.empty() || storeArray(aValues.data(), aValues.size(), reverseByteOrder);
+	}
+
+	template <typename T>
+	bool loadVector(std::vector<T>& aValues, bool reverseByteOrder = false)
+	{
+		unsigned int count = 0;
+		loadUInt(count);
+
+		if (m_inError)
+			return false;
+
+		aValues.resize(count);
+
+		return aValues.empty() || loadArray(aValues.data(), aValues.size(), reverseByteOrder);
+	}
+
 protected:
+	static const size_t kByteOrderChunkSize = 8192;
 
 	bool	m_inError;
 };
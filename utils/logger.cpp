@@ -20,6 +20,8 @@
 
 #include <ctime>
 #include <cstdarg>
+#include <cstring>
+#include <algorithm>
 #include <unistd.h>
 
 namespace Imagine
@@ -38,15 +40,51 @@ static const char* kLogLevelFullNames[] = { "Debug", "Info", "Warning", "Notice"
 static const char* kLogLevelColourCodes[] = { kCodeColourBlack, kCodeColourGreen, kCodeColourOrange,
 											  kCodeColourCyan, kCodeColourRed, kCodeColourRed, kCodeColourBlack, 0 };
 
-Logger::Logger() : m_pFileHandle(nullptr), m_pSecondaryStdErr(nullptr),
+// how long the writer thread sleeps for when there's nothing to write, in microseconds
+static const unsigned int kWriterIdleSleep = 2000;
+
+// repeated warnings from the same call site are limited to this many per window. Debug and info items are only
+// output when asked for, so are never limited, and notices and above are important enough to always be output
+static const uint32_t kRateLimitItemsPerWindow = 10;
+static const uint32_t kRateLimitWindowSeconds = 10;
+
+void Logger::LogWriterThread::run()
+{
+	m_pLogger->writerLoop();
+}
+
+Logger::Logger() : m_logOutputType(eLogStdErr), m_pFileHandle(nullptr), m_pSecondaryStdErr(nullptr),
 					m_initialised(false), m_logLevel(eLevelOff),
-					m_timeStampType(eTimeStampNone), m_colouredOutput(false)
+					m_timeStampType(eTimeStampNone), m_colouredOutput(false),
+					m_pQueueSlots(nullptr), m_enqueuePos(0), m_dequeuePos(0), m_droppedItems(0),
+					m_pWriterThread(nullptr), m_writerStop(false)
 {
+	m_pQueueSlots = new QueueSlot[kQueueSize];
+	for (unsigned int i = 0; i < kQueueSize; i++)
+	{
+		m_pQueueSlots[i].sequence.store(i, std::memory_order_relaxed);
+	}
 
+	for (unsigned int i = 0; i < kNumCallSiteLimits; i++)
+	{
+		CallSiteLimit& limit = m_callSiteLimits[i];
+		limit.format.store(nullptr, std::memory_order_relaxed);
+		limit.windowStart.store(0, std::memory_order_relaxed);
+		limit.count.store(0, std::memory_order_relaxed);
+		limit.suppressed.store(0, std::memory_order_relaxed);
+	}
 }
 
 Logger::~Logger()
 {
+	stopWriterThread();
+
+	if (m_pQueueSlots)
+	{
+		delete [] m_pQueueSlots;
+		m_pQueueSlots = nullptr;
+	}
+
 	if (m_logOutputType == eLogFile && m_pFileHandle)
 	{
 		fclose(m_pFileHandle);
@@ -73,8 +111,13 @@ bool Logger::initialiseFileLogger(const std::string& logPath, LogLevel level, Lo
 	if (!m_initialised)
 	{
 		m_logOutputType = eLogStdErr;
+		m_pFileHandle = stderr;
 		critical("Can't create/open log file: %s", m_logFilePath.c_str());
 	}
+	else
+	{
+		startWriterThread();
+	}
 
 	return m_initialised;
 }
@@ -107,6 +150,9 @@ bool Logger::initialiseConsoleLogger(LogOutputDestination logDest, LogLevel leve
 	m_colouredOutput = coloured && isatty(fileno(m_pFileHandle));
 
 	m_initialised = true;
+
+	startWriterThread();
+
 	return true;
 }
 
@@ -123,8 +169,6 @@ void Logger::setColouredOutput(bool colouredOutput, bool force)
 	m_colouredOutput = colouredOutput;
 }
 
-// TODO: with large amounts of logging, it might be beneficial performance-wise to check the log level
-//       short-circuit before doing the varargs stuff...
 void Logger::debug(const char* format, ...)
 {
 	va_list argPtr;
@@ -173,60 +217,325 @@ void Logger::critical(const char* format, ...)
 	va_end(argPtr);
 }
 
+void Logger::flush()
+{
+	if (!m_pWriterThread)
+	{
+		if (m_pFileHandle)
+		{
+			fflush(m_pFileHandle);
+		}
+		return;
+	}
+
+	uint64_t targetPos = m_enqueuePos.load(std::memory_order_acquire);
+
+	while (m_dequeuePos.load(std::memory_order_acquire) < targetPos)
+	{
+		usleep(kWriterIdleSleep / 4);
+	}
+}
+
 void Logger::outputLogItem(LogLevel itemLevel, const char* format, va_list args)
 {
-	if (itemLevel < m_logLevel)
+	if (itemLevel < m_logLevel || !m_pFileHandle)
+		return;
+
+	unsigned int suppressedCount = 0;
+	if (itemLevel == eLevelWarning && isRateLimited(format, suppressedCount))
 		return;
 
 	char szLogMessage[4096]; // needs to be more than long enough for full production Katana location names in the strings...
 
-	vsprintf(szLogMessage, format, args);
+	vsnprintf(szLogMessage, sizeof(szLogMessage), format, args);
 
-	if (m_logOutputType != eLogFile)
+	char szSuppressed[64];
+	szSuppressed[0] = 0;
+	if (suppressedCount > 0)
 	{
-		FILE* pFileTarget = m_pFileHandle;
+		snprintf(szSuppressed, sizeof(szSuppressed), " (%u similar messages suppressed)", suppressedCount);
+	}
 
-		// if we're configured to be split based on the log level, check if we need to change to stderr...
-		if (m_logOutputType == eLogStdOutOrStdErr && (itemLevel >= eLevelError && itemLevel < eLevelOff))
-		{
-			pFileTarget = m_pSecondaryStdErr;
-		}
+	// format the full line here, so the writer thread only has to write it out
+	char szLine[4096 + 256];
+	int lineLength = 0;
 
+	if (m_logOutputType != eLogFile)
+	{
 		// to console
 		if (m_colouredOutput)
 		{
-			// TODO: first two could be combined...
-			fprintf(pFileTarget, "%s[%s] %s%s\n", kLogLevelColourCodes[itemLevel], kLogLevelFullNames[itemLevel], szLogMessage, kCodeReset);
+			lineLength = snprintf(szLine, sizeof(szLine), "%s[%s] %s%s%s\n", kLogLevelColourCodes[itemLevel], kLogLevelFullNames[itemLevel],
+								  szLogMessage, szSuppressed, kCodeReset);
 		}
 		else
 		{
-			fprintf(pFileTarget, "[%s] %s\n", kLogLevelFullNames[itemLevel], szLogMessage);
+			lineLength = snprintf(szLine, sizeof(szLine), "[%s] %s%s\n", kLogLevelFullNames[itemLevel], szLogMessage, szSuppressed);
 		}
 	}
 	else
 	{
-		if (m_timeStampType == eTimeStampNone)
-		{
-			fprintf(m_pFileHandle, "[%s] %s\n", kLogLevelFullNames[itemLevel], szLogMessage);
-		}
-		else if (m_timeStampType == eTimeStampTime || m_timeStampType == eTimeStampTimeAndDate)
+		if (m_timeStampType == eTimeStampTime || m_timeStampType == eTimeStampTimeAndDate)
 		{
 			time_t time1;
 			time(&time1);
-			struct tm* pTimeinfo;
-			pTimeinfo = localtime(&time1);
+			struct tm timeInfo;
+			localtime_r(&time1, &timeInfo);
 
 			char szTime[64];
 			const char* timeFormat = (m_timeStampType == eTimeStampTime) ? "%H:%M:%S" : "%F %H:%M:%S";
-			strftime(szTime, 64, timeFormat, pTimeinfo);
-			fprintf(m_pFileHandle, "%s [%s] %s\n", szTime, kLogLevelFullNames[itemLevel], szLogMessage);
+			strftime(szTime, 64, timeFormat, &timeInfo);
+			lineLength = snprintf(szLine, sizeof(szLine), "%s [%s] %s%s\n", szTime, kLogLevelFullNames[itemLevel], szLogMessage, szSuppressed);
+		}
+		else
+		{
+			lineLength = snprintf(szLine, sizeof(szLine), "[%s] %s%s\n", kLogLevelFullNames[itemLevel], szLogMessage, szSuppressed);
+		}
+	}
+
+	if (lineLength <= 0)
+		return;
+
+	unsigned int length = std::min((unsigned int)lineLength, (unsigned int)sizeof(szLine) - 1);
+
+	if (m_pWriterThread && length <= kSlotLineSize)
+	{
+		if (enqueueLine(itemLevel, szLine, length))
+			return;
+
+		if (itemLevel < eLevelError)
+		{
+			m_droppedItems.fetch_add(1, std::memory_order_relaxed);
+			return;
 		}
 
-		if (m_logOutputType == eLogFile)
+		// important enough to wait for space
+		while (!enqueueLine(itemLevel, szLine, length))
 		{
-			fflush(m_pFileHandle);
+			Thread::yield();
 		}
+
+		if (itemLevel == eLevelCritical)
+		{
+			// make sure these get out, in case we're about to crash
+			flush();
+		}
+
+		return;
 	}
+
+	// too long for the queue (or there's no writer thread), so write it directly
+	m_writeLock.lock();
+	if (m_pWriterThread)
+	{
+		// anything still queued was logged before this, so needs to go out first
+		writeQueuedLinesLocked();
+	}
+	FILE* pTargetFile = getTargetFile(itemLevel);
+	fwrite(szLine, 1, length, pTargetFile);
+	fflush(pTargetFile);
+	m_writeLock.unlock();
+}
+
+bool Logger::isRateLimited(const char* format, unsigned int& suppressedCount)
+{
+	// string literals have unique addresses, so the format string pointer identifies the call site
+	uint64_t hash = ((uint64_t)(uintptr_t)format >> 3) * 0x9E3779B97F4A7C15ull;
+	unsigned int index = (unsigned int)(hash >> 56) % kNumCallSiteLimits;
+
+	CallSiteLimit* pLimit = nullptr;
+
+	// short linear probe - if the table's full, we just don't limit
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		CallSiteLimit& limit = m_callSiteLimits[(index + i) % kNumCallSiteLimits];
+
+		const char* existingFormat = limit.format.load(std::memory_order_acquire);
+		if (existingFormat == format)
+		{
+			pLimit = &limit;
+			break;
+		}
+
+		if (existingFormat == nullptr)
+		{
+			if (limit.format.compare_exchange_strong(existingFormat, format, std::memory_order_acq_rel) || existingFormat == format)
+			{
+				pLimit = &limit;
+				break;
+			}
+		}
+	}
+
+	if (!pLimit)
+		return false;
+
+	uint32_t now = (uint32_t)time(nullptr);
+	uint32_t windowStart = pLimit->windowStart.load(std::memory_order_relaxed);
+	if (now - windowStart >= kRateLimitWindowSeconds)
+	{
+		if (pLimit->windowStart.compare_exchange_strong(windowStart, now, std::memory_order_relaxed))
+		{
+			pLimit->count.store(0, std::memory_order_relaxed);
+			suppressedCount = pLimit->suppressed.exchange(0, std::memory_order_relaxed);
+		}
+	}
+
+	if (pLimit->count.fetch_add(1, std::memory_order_relaxed) >= kRateLimitItemsPerWindow)
+	{
+		pLimit->suppressed.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	return false;
+}
+
+FILE* Logger::getTargetFile(LogLevel itemLevel) const
+{
+	// if we're configured to be split based on the log level, check if we need to change to stderr...
+	if (m_logOutputType == eLogStdOutOrStdErr && (itemLevel >= eLevelError && itemLevel < eLevelOff))
+	{
+		return m_pSecondaryStdErr;
+	}
+
+	return m_pFileHandle;
+}
+
+bool Logger::enqueueLine(LogLevel itemLevel, const char* line, unsigned int length)
+{
+	// bounded MPMC queue (Vyukov), only used with a single consumer: each slot's sequence says whether it's free
+	// for the producer at that position, or ready for the consumer
+	uint64_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+	QueueSlot* pSlot = nullptr;
+
+	while (true)
+	{
+		pSlot = &m_pQueueSlots[pos & (kQueueSize - 1)];
+		uint64_t sequence = pSlot->sequence.load(std::memory_order_acquire);
+		int64_t difference = (int64_t)sequence - (int64_t)pos;
+
+		if (difference == 0)
+		{
+			if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (difference < 0)
+		{
+			// full
+			return false;
+		}
+		else
+		{
+			pos = m_enqueuePos.load(std::memory_order_relaxed);
+		}
+	}
+
+	pSlot->level = itemLevel;
+	pSlot->length = length;
+	memcpy(pSlot->line, line, length);
+
+	pSlot->sequence.store(pos + 1, std::memory_order_release);
+
+	return true;
+}
+
+void Logger::startWriterThread()
+{
+	if (m_pWriterThread)
+		return;
+
+	m_writerStop = false;
+
+	m_pWriterThread = new LogWriterThread(this);
+	if (!m_pWriterThread->start())
+	{
+		// just write directly
+		delete m_pWriterThread;
+		m_pWriterThread = nullptr;
+	}
+}
+
+void Logger::stopWriterThread()
+{
+	if (!m_pWriterThread)
+		return;
+
+	m_writerStop = true;
+
+	m_pWriterThread->waitForCompletion();
+	delete m_pWriterThread;
+	m_pWriterThread = nullptr;
+}
+
+void Logger::writerLoop()
+{
+	while (true)
+	{
+		unsigned int linesWritten = writeQueuedLines();
+
+		if (linesWritten == 0)
+		{
+			if (m_writerStop)
+				break;
+
+			usleep(kWriterIdleSleep);
+		}
+	}
+
+	// anything which came in while we were stopping
+	writeQueuedLines();
+}
+
+unsigned int Logger::writeQueuedLines()
+{
+	m_writeLock.lock();
+	unsigned int linesWritten = writeQueuedLinesLocked();
+	m_writeLock.unlock();
+
+	return linesWritten;
+}
+
+unsigned int Logger::writeQueuedLinesLocked()
+{
+	unsigned int linesWritten = 0;
+
+	uint64_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+
+	while (true)
+	{
+		QueueSlot& slot = m_pQueueSlots[pos & (kQueueSize - 1)];
+		if (slot.sequence.load(std::memory_order_acquire) != pos + 1)
+			break;
+
+		fwrite(slot.line, 1, slot.length, getTargetFile(slot.level));
+
+		// free the slot for the producer a full lap later
+		slot.sequence.store(pos + kQueueSize, std::memory_order_release);
+		pos++;
+		linesWritten++;
+
+		m_dequeuePos.store(pos, std::memory_order_release);
+	}
+
+	uint32_t droppedItems = m_droppedItems.exchange(0, std::memory_order_relaxed);
+	if (droppedItems > 0)
+	{
+		fprintf(getTargetFile(eLevelWarning), "[%s] %u log messages dropped as the log queue was full.\n", kLogLevelFullNames[eLevelWarning],
+				droppedItems);
+		linesWritten++;
+	}
+
+	// one flush per batch, rather than per line
+	if (linesWritten > 0)
+	{
+		fflush(m_pFileHandle);
+		if (m_pSecondaryStdErr)
+		{
+			fflush(m_pSecondaryStdErr);
+		}
+	}
+
+	return linesWritten;
 }
 
 } // namespace Imagine
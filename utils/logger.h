@@ -20,12 +20,24 @@
 #define LOGGER_H
 
 #include <string>
+#include <atomic>
+#include <cstdarg>
 
 #include <stdio.h>
+#include <inttypes.h>
+
+#include "utils/threads/thread.h"
+#include "utils/threads/mutex.h"
 
 namespace Imagine
 {
 
+// Log items are formatted on the calling thread, and then queued in a lock-free ring buffer for a background thread to
+// write out in batches, so render threads never wait on console / file I/O or fight over the output. Lines which are
+// too long for a ring slot are written directly instead, after anything already queued (under a lock, so lines never
+// get interleaved). Items at Error level and above wait for space in the queue if it's full, anything else is dropped
+// (and counted). Repeated Warning items from the same call site (format string) are rate-limited.
+
 class Logger
 {
 public:
@@ -75,10 +87,63 @@ public:
 	void error(const char* format, ...);
 	void critical(const char* format, ...);
 
+	// waits until everything logged so far has been written out
+	void flush();
+
 protected:
 
 	void outputLogItem(LogLevel itemLevel, const char* format, va_list args);
 
+	// returns true if the item should be suppressed. suppressedCount is set to the number suppressed in the last window
+	// from this call site, if it's just ended
+	bool isRateLimited(const char* format, unsigned int& suppressedCount);
+
+	FILE* getTargetFile(LogLevel itemLevel) const;
+
+	bool enqueueLine(LogLevel itemLevel, const char* line, unsigned int length);
+
+	void startWriterThread();
+	void stopWriterThread();
+
+	void writerLoop();
+	// writes out everything in the queue, returning how many lines were written
+	unsigned int writeQueuedLines();
+	// as above, but m_writeLock must already be held
+	unsigned int writeQueuedLinesLocked();
+
+	static const unsigned int kQueueSize = 2048; // must be a power of two
+	static const unsigned int kSlotLineSize = 500;
+	static const unsigned int kNumCallSiteLimits = 256;
+
+	struct QueueSlot
+	{
+		std::atomic<uint64_t>	sequence;
+		LogLevel				level;
+		unsigned int			length;
+		char					line[kSlotLineSize];
+	};
+
+	struct CallSiteLimit
+	{
+		std::atomic<const char*>	format;
+		std::atomic<uint32_t>		windowStart;
+		std::atomic<uint32_t>		count;
+		std::atomic<uint32_t>		suppressed;
+	};
+
+	class LogWriterThread : public Thread
+	{
+	public:
+		LogWriterThread(Logger* pLogger) : Thread(), m_pLogger(pLogger)
+		{
+		}
+
+		virtual void run();
+
+	protected:
+		Logger*		m_pLogger;
+	};
+
 protected:
 	LogOutputDestination	m_logOutputType;
 	std::string				m_logFilePath; // will only be valid if LogOutputDestination == eLogFile
@@ -95,6 +160,20 @@ protected:
 	LogTimeStampType		m_timeStampType;
 
 	bool					m_colouredOutput;
+
+	QueueSlot*				m_pQueueSlots;
+	std::atomic<uint64_t>	m_enqueuePos;
+	// only modified with m_writeLock held
+	std::atomic<uint64_t>	m_dequeuePos;
+	std::atomic<uint32_t>	m_droppedItems;
+
+	LogWriterThread*		m_pWriterThread;
+	std::atomic<bool>		m_writerStop;
+
+	// held while writing, so directly-written long lines don't get interleaved with queued ones
+	Mutex					m_writeLock;
+
+	CallSiteLimit			m_callSiteLimits[kNumCallSiteLimits];
 };
 
 } // namespace Imagine
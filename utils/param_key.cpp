@@ -0,0 +1,102 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#include "param_key.h"
+
+#include <string.h>
+
+namespace Imagine
+{
+
+ParamKey::ParamKey(const char* name)
+{
+	m_id = ParamKeyRegistry::instance().intern(name, hashName(name));
+}
+
+ParamKey::ParamKey(const std::string& name)
+{
+	m_id = ParamKeyRegistry::instance().intern(name.c_str(), hashName(name.c_str()));
+}
+
+bool ParamKeyRegistry::InternedName::operator==(const InternedName& rhs) const
+{
+	if (hash != rhs.hash)
+		return false;
+
+	if (name == rhs.name)
+		return true;
+
+	return name && rhs.name && strcmp(name, rhs.name) == 0;
+}
+
+unsigned int ParamKeyRegistry::intern(const char* name, HashValue hash)
+{
+	unsigned int id = 0;
+	if (m_ids.find(InternedName(hash, name), id))
+		return id;
+
+	m_lock.lock();
+
+	// another thread might have added it since we looked
+	if (m_ids.find(InternedName(hash, name), id))
+	{
+		m_lock.unlock();
+		return id;
+	}
+
+	id = (unsigned int)m_aNames.size();
+	m_aNames.emplace_back(name);
+
+	m_ids.insert(InternedName(hash, m_aNames.back().c_str()), id);
+
+	m_lock.unlock();
+
+	return id;
+}
+
+bool ParamKeyRegistry::findID(const char* name, HashValue hash, unsigned int& id) const
+{
+	return m_ids.find(InternedName(hash, name), id);
+}
+
+std::string ParamKeyRegistry::getName(unsigned int id) const
+{
+	std::string name;
+
+	m_lock.lock();
+
+	if (id < m_aNames.size())
+	{
+		name = m_aNames[id];
+	}
+
+	m_lock.unlock();
+
+	return name;
+}
+
+size_t ParamKeyRegistry::getNameCount() const
+{
+	m_lock.lock();
+	size_t count = m_aNames.size();
+	m_lock.unlock();
+
+	return count;
+}
+
+} // namespace Imagine
@@ -0,0 +1,136 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#ifndef PARAM_KEY_H
+#define PARAM_KEY_H
+
+#include <string>
+#include <deque>
+
+#include "core/hash.h"
+
+#include "utils/sharded_open_map.h"
+#include "utils/threads/mutex.h"
+
+namespace Imagine
+{
+
+// Interned name of a Params item: each distinct name is given a small integer ID the first time it's seen, which
+// Params stores and compares instead of the string.
+// Keys for fixed names are meant to be created once (i.e. as static consts next to the code which uses them),
+// so the interning cost is only paid once, and lookups with them are then just integer comparisons:
+//
+//   static const ParamKey kTileSizeKey("tile_size");
+//   unsigned int tileSize = settings.getUInt(kTileSizeKey, 32);
+
+class ParamKey
+{
+public:
+	explicit ParamKey(const char* name);
+	explicit ParamKey(const std::string& name);
+
+	unsigned int getID() const
+	{
+		return m_id;
+	}
+
+	bool operator==(const ParamKey& rhs) const
+	{
+		return m_id == rhs.m_id;
+	}
+
+	// FNV-1a. This is done at runtime, but only when a key is created or a name is looked up through the string API,
+	// which is why keys for fixed names should be created once.
+	static HashValue hashName(const char* name)
+	{
+		HashValue hash = 0xcbf29ce484222325ULL;
+		for (; *name != 0; name++)
+		{
+			hash = (hash ^ (HashValue)(unsigned char)*name) * 0x100000001b3ULL;
+		}
+		return hash;
+	}
+
+protected:
+	unsigned int		m_id;
+};
+
+// Global name <-> ID table for ParamKey. Looking up a name is lock-free, so the string API of Params can be
+// used from multiple threads at once, only new names take a lock.
+// IDs are never freed, so this is only meant for parameter names, of which there are a limited number.
+
+class ParamKeyRegistry
+{
+public:
+	static ParamKeyRegistry& instance()
+	{
+		static ParamKeyRegistry registry;
+		return registry;
+	}
+
+	unsigned int intern(const char* name, HashValue hash);
+
+	// doesn't add the name if it hasn't been seen before, so lookups of names nothing has set don't grow the table
+	bool findID(const char* name, HashValue hash, unsigned int& id) const;
+
+	std::string getName(unsigned int id) const;
+
+	size_t getNameCount() const;
+
+protected:
+	ParamKeyRegistry() : m_ids(4, 256)
+	{
+	}
+
+	struct InternedName
+	{
+		InternedName() : hash(0), name(nullptr)
+		{
+		}
+
+		InternedName(HashValue nameHash, const char* nameString) : hash(nameHash), name(nameString)
+		{
+		}
+
+		bool operator==(const InternedName& rhs) const;
+
+		HashValue		hash;
+		// for items in the table, points to the copy owned by the registry
+		const char*		name;
+	};
+
+	struct InternedNameHasher
+	{
+		HashValue operator()(const InternedName& name) const
+		{
+			return name.hash;
+		}
+	};
+
+protected:
+	ShardedOpenMap<InternedName, unsigned int, InternedNameHasher>	m_ids;
+
+	mutable Mutex					m_lock;
+	// indexed by ID. std::deque, as the strings mustn't move once the table's pointing to them.
+	// Only accessed with the lock held.
+	std::deque<std::string>			m_aNames;
+};
+
+} // namespace Imagine
+
+#endif // PARAM_KEY_H
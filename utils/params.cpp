@@ -30,6 +30,8 @@ void Params::load(Stream* stream)
 	unsigned int numItems = 0;
 	stream->loadUIntFromUChar(numItems);
 
+	m_aParams.reserve(numItems);
+
 	for (unsigned int i = 0; i < numItems; i++)
 	{
 		std::string name;
@@ -38,7 +40,7 @@ void Params::load(Stream* stream)
 		ParamsValue newValue;
 		newValue.load(stream);
 
-		m_aParams[name] = newValue;
+		setValue(internName(name), newValue, true);
 	}
 }
 
@@ -48,14 +50,17 @@ void Params::store(Stream* stream) const
 
 	stream->storeUIntAsUChar(numItems);
 
-	std::map<std::string, ParamsValue>::const_iterator it = m_aParams.begin();
+	// the names are stored rather than the IDs, as the IDs depend on the order names were interned in
+	ParamKeyRegistry& registry = ParamKeyRegistry::instance();
+
+	std::vector<Item>::const_iterator it = m_aParams.begin();
 	for (; it != m_aParams.end(); ++it)
 	{
-		const std::string& name = (*it).first;
+		const std::string name = registry.getName((*it).keyID);
 
 		stream->storeString(name);
 
-		const ParamsValue& value = (*it).second;
+		const ParamsValue& value = (*it).value;
 
 		value.store(stream);
 	}
@@ -63,20 +68,21 @@ void Params::store(Stream* stream) const
 
 void Params::mergeOverwrite(const Params& params)
 {
-	std::map<std::string, ParamsValue>::const_iterator it = params.m_aParams.begin();
+	std::vector<Item>::const_iterator it = params.m_aParams.begin();
 	for (; it != params.m_aParams.end(); ++it)
 	{
-		const std::string& name = (*it).first;
-		const ParamsValue& value = (*it).second;
-
-		m_aParams[name] = value;
+		setValue((*it).keyID, (*it).value, true);
 	}
 }
 
 bool Params::hasKey(const std::string& key) const
 {
-	std::map<std::string, ParamsValue>::const_iterator itFind = m_aParams.find(key);
-	return itFind != m_aParams.end();
+	return findValue(key) != nullptr;
+}
+
+bool Params::hasKey(const ParamKey& key) const
+{
+	return findValue(key.getID()) != nullptr;
 }
 
 } // namespace Imagine
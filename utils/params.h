@@ -20,12 +20,16 @@
 #define PARAMS_H
 
 #include <string>
-#include <map>
+#include <vector>
 
 #include "params_value.h"
+#include "param_key.h"
 
 // Simple (and by-design limited) class to provide collections of fixed values that can be looked up
-// by name
+// by name.
+// Names are interned to ParamKey IDs, and the items are stored in a flat array sorted by ID, so lookups with
+// a ParamKey don't involve any string comparisons. The std::string versions of the functions intern / look up
+// the name each time, so code which does lots of lookups should use static ParamKeys instead.
 
 namespace Imagine
 {
@@ -41,73 +45,136 @@ public:
 
 	void add(const std::string& name, bool value)
 	{
-		m_aParams[name] = ParamsValue(value);
+		setValue(internName(name), ParamsValue(value), true);
 	}
 
 	void add(const std::string& name, int value)
 	{
-		m_aParams[name] = ParamsValue((unsigned int)value);
+		setValue(internName(name), ParamsValue((unsigned int)value), true);
 	}
 
 	void add(const std::string& name, unsigned int value)
 	{
-		m_aParams[name] = ParamsValue(value);
+		setValue(internName(name), ParamsValue(value), true);
 	}
 
 	void add(const std::string& name, float value)
 	{
-		m_aParams[name] = ParamsValue(value);
+		setValue(internName(name), ParamsValue(value), true);
+	}
+
+	void add(const ParamKey& key, bool value)
+	{
+		setValue(key.getID(), ParamsValue(value), true);
+	}
+
+	void add(const ParamKey& key, int value)
+	{
+		setValue(key.getID(), ParamsValue((unsigned int)value), true);
+	}
+
+	void add(const ParamKey& key, unsigned int value)
+	{
+		setValue(key.getID(), ParamsValue(value), true);
+	}
+
+	void add(const ParamKey& key, float value)
+	{
+		setValue(key.getID(), ParamsValue(value), true);
 	}
 	
 	void addIfNotSet(const std::string& name, bool value)
 	{
-		if (m_aParams.find(name) == m_aParams.end())
-			m_aParams[name] = ParamsValue(value);
+		setValue(internName(name), ParamsValue(value), false);
 	}
 
 	void addIfNotSet(const std::string& name, int value)
 	{
-		if (m_aParams.find(name) == m_aParams.end())
-			m_aParams[name] = ParamsValue((unsigned int)value);
+		setValue(internName(name), ParamsValue((unsigned int)value), false);
 	}
 
 	void addIfNotSet(const std::string& name, unsigned int value)
 	{
-		if (m_aParams.find(name) == m_aParams.end())
-			m_aParams[name] = ParamsValue(value);
+		setValue(internName(name), ParamsValue(value), false);
 	}
 
 	void addIfNotSet(const std::string& name, float value)
 	{
-		if (m_aParams.find(name) == m_aParams.end())
-			m_aParams[name] = ParamsValue(value);
+		setValue(internName(name), ParamsValue(value), false);
+	}
+
+	void addIfNotSet(const ParamKey& key, bool value)
+	{
+		setValue(key.getID(), ParamsValue(value), false);
+	}
+
+	void addIfNotSet(const ParamKey& key, int value)
+	{
+		setValue(key.getID(), ParamsValue((unsigned int)value), false);
+	}
+
+	void addIfNotSet(const ParamKey& key, unsigned int value)
+	{
+		setValue(key.getID(), ParamsValue(value), false);
+	}
+
+	void addIfNotSet(const ParamKey& key, float value)
+	{
+		setValue(key.getID(), ParamsValue(value), false);
 	}
 
 	bool getBool(const std::string& name, bool defaultValue = false) const
 	{
-		std::map<std::string, ParamsValue>::const_iterator it = m_aParams.find(name);
-		if (it == m_aParams.end() || it->second.getType() != ParamsValue::eBool)
+		const ParamsValue* pValue = findValue(name);
+		if (!pValue || pValue->getType() != ParamsValue::eBool)
 			return defaultValue;
 
-		return it->second.getBool();
+		return pValue->getBool();
 	}
 
 	unsigned int getUInt(const std::string& name, unsigned int defaultValue = 0) const
 	{
-		std::map<std::string, ParamsValue>::const_iterator it = m_aParams.find(name);
-		if (it == m_aParams.end() || it->second.getType() != ParamsValue::eUInt)
+		const ParamsValue* pValue = findValue(name);
+		if (!pValue || pValue->getType() != ParamsValue::eUInt)
 			return defaultValue;
 
-		return it->second.getUInt();
+		return pValue->getUInt();
 	}
 
 	float getFloat(const std::string& name, float defaultValue = 0.0f) const
 	{
-		std::map<std::string, ParamsValue>::const_iterator it = m_aParams.find(name);
-		if (it == m_aParams.end() || it->second.getType() != ParamsValue::eFloat)
+		const ParamsValue* pValue = findValue(name);
+		if (!pValue || pValue->getType() != ParamsValue::eFloat)
+			return defaultValue;
+
+		return pValue->getFloat();
+	}
+
+	bool getBool(const ParamKey& key, bool defaultValue = false) const
+	{
+		const ParamsValue* pValue = findValue(key.getID());
+		if (!pValue || pValue->getType() != ParamsValue::eBool)
 			return defaultValue;
 
-		return it->second.getFloat();
+		return pValue->getBool();
+	}
+
+	unsigned int getUInt(const ParamKey& key, unsigned int defaultValue = 0) const
+	{
+		const ParamsValue* pValue = findValue(key.getID());
+		if (!pValue || pValue->getType() != ParamsValue::eUInt)
+			return defaultValue;
+
+		return pValue->getUInt();
+	}
+
+	float getFloat(const ParamKey& key, float defaultValue = 0.0f) const
+	{
+		const ParamsValue* pValue = findValue(key.getID());
+		if (!pValue || pValue->getType() != ParamsValue::eFloat)
+			return defaultValue;
+
+		return pValue->getFloat();
 	}
 	
 	bool isEmpty() const
@@ -121,9 +188,93 @@ public:
 	void mergeOverwrite(const Params& params);
 
 	bool hasKey(const std::string& key) const;
+	bool hasKey(const ParamKey& key) const;
+
+protected:
+	struct Item
+	{
+		Item(unsigned int itemKeyID, const ParamsValue& itemValue) : keyID(itemKeyID), value(itemValue)
+		{
+		}
+
+		unsigned int	keyID;
+		ParamsValue		value;
+	};
+
+	static unsigned int internName(const std::string& name)
+	{
+		return ParamKeyRegistry::instance().intern(name.c_str(), ParamKey::hashName(name.c_str()));
+	}
+
+	// returns the index of the first item with a key ID >= keyID
+	unsigned int findItemIndex(unsigned int keyID) const
+	{
+		// items are generally few enough that a linear scan of the IDs is quicker than a binary search
+		unsigned int numItems = (unsigned int)m_aParams.size();
+		if (numItems <= kLinearSearchItems)
+		{
+			unsigned int index = 0;
+			while (index < numItems && m_aParams[index].keyID < keyID)
+			{
+				index++;
+			}
+
+			return index;
+		}
+
+		unsigned int lower = 0;
+		unsigned int upper = numItems;
+		while (lower < upper)
+		{
+			unsigned int middle = (lower + upper) / 2;
+			if (m_aParams[middle].keyID < keyID)
+				lower = middle + 1;
+			else
+				upper = middle;
+		}
+
+		return lower;
+	}
+
+	const ParamsValue* findValue(unsigned int keyID) const
+	{
+		unsigned int index = findItemIndex(keyID);
+		if (index == m_aParams.size() || m_aParams[index].keyID != keyID)
+			return nullptr;
+
+		return &m_aParams[index].value;
+	}
+
+	const ParamsValue* findValue(const std::string& name) const
+	{
+		unsigned int keyID = 0;
+		// if the name's never been interned, nothing can have set it
+		if (!ParamKeyRegistry::instance().findID(name.c_str(), ParamKey::hashName(name.c_str()), keyID))
+			return nullptr;
+
+		return findValue(keyID);
+	}
+
+	void setValue(unsigned int keyID, const ParamsValue& value, bool overwrite)
+	{
+		unsigned int index = findItemIndex(keyID);
+		if (index < m_aParams.size() && m_aParams[index].keyID == keyID)
+		{
+			if (overwrite)
+			{
+				m_aParams[index].value = value;
+			}
+			return;
+		}
+
+		m_aParams.insert(m_aParams.begin() + index, Item(keyID, value));
+	}
+
+	static const unsigned int kLinearSearchItems = 16;
 
 protected:
-	std::map<std::string, ParamsValue>	m_aParams;
+	// sorted by keyID
+	std::vector<Item>	m_aParams;
 };
 
 } // namespace Imagine
@@ -0,0 +1,138 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#include "profiler.h"
+
+#include <cstdio>
+
+namespace Imagine
+{
+
+volatile bool Profiler::s_enabled = false;
+Mutex Profiler::s_lock;
+std::vector<Profiler::ThreadBuffer*> Profiler::s_aThreadBuffers;
+uint64_t Profiler::s_baseTicks = 0;
+
+static thread_local void* s_pThisThreadBuffer = nullptr;
+
+void Profiler::clear()
+{
+	s_lock.lock();
+
+	std::vector<ThreadBuffer*>::iterator it = s_aThreadBuffers.begin();
+	for (; it != s_aThreadBuffers.end(); ++it)
+	{
+		ThreadBuffer* pBuffer = *it;
+		pBuffer->writePos = 0;
+	}
+
+	s_baseTicks = HighResClock::getTicks();
+
+	s_lock.unlock();
+}
+
+void Profiler::recordZone(const char* name, uint64_t startTicks, uint64_t endTicks)
+{
+	ThreadBuffer* pBuffer = getThreadBuffer();
+
+	ZoneEvent& event = pBuffer->aEvents[pBuffer->writePos % kEventsPerThread];
+	event.name = name;
+	event.startTicks = startTicks;
+	event.endTicks = endTicks;
+
+	pBuffer->writePos++;
+}
+
+Profiler::ThreadBuffer* Profiler::getThreadBuffer()
+{
+	if (!s_pThisThreadBuffer)
+	{
+		s_lock.lock();
+
+		ThreadBuffer* pNewBuffer = new ThreadBuffer((unsigned int)s_aThreadBuffers.size());
+		s_aThreadBuffers.emplace_back(pNewBuffer);
+
+		if (s_baseTicks == 0)
+		{
+			s_baseTicks = HighResClock::getTicks();
+		}
+
+		s_lock.unlock();
+
+		s_pThisThreadBuffer = pNewBuffer;
+	}
+
+	return (ThreadBuffer*)s_pThisThreadBuffer;
+}
+
+bool Profiler::writeChromeTrace(const std::string& path)
+{
+	FILE* pFile = fopen(path.c_str(), "w");
+	if (!pFile)
+		return false;
+
+	s_lock.lock();
+
+	fprintf(pFile, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	double microsecondsPerTick = 1000000.0 / HighResClock::getTicksPerSecond();
+
+	bool firstEvent = true;
+
+	std::vector<ThreadBuffer*>::const_iterator it = s_aThreadBuffers.begin();
+	for (; it != s_aThreadBuffers.end(); ++it)
+	{
+		const ThreadBuffer* pBuffer = *it;
+
+		if (pBuffer->writePos == 0)
+			continue;
+
+		fprintf(pFile, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"Thread %u\"}}",
+				firstEvent ? "" : ",\n", pBuffer->threadIndex, pBuffer->threadIndex);
+		firstEvent = false;
+
+		// if the buffer's wrapped, only the most recent kEventsPerThread are still there
+		uint64_t startPos = (pBuffer->writePos > kEventsPerThread) ? pBuffer->writePos - kEventsPerThread : 0;
+
+		for (uint64_t pos = startPos; pos < pBuffer->writePos; pos++)
+		{
+			const ZoneEvent& event = pBuffer->aEvents[pos % kEventsPerThread];
+
+			// anything from before the last clear()
+			if (event.startTicks < s_baseTicks)
+				continue;
+
+			double startTime = (double)(event.startTicks - s_baseTicks) * microsecondsPerTick;
+			double duration = (double)(event.endTicks - event.startTicks) * microsecondsPerTick;
+
+			fprintf(pFile, ",\n{\"name\":\"%s\",\"cat\":\"imagine\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%u}",
+					event.name, startTime, duration, pBuffer->threadIndex);
+		}
+	}
+
+	fprintf(pFile, "\n]}\n");
+
+	s_lock.unlock();
+
+	bool success = !ferror(pFile);
+	fclose(pFile);
+
+	return success;
+}
+
+} // namespace Imagine
@@ -0,0 +1,118 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <string>
+#include <vector>
+#include <inttypes.h>
+
+#include "high_res_clock.h"
+
+#include "utils/threads/mutex.h"
+
+namespace Imagine
+{
+
+// Records timed zones (with PROFILE_SCOPE()) into per-thread ring buffers, which can be written out as Chrome trace
+// JSON (for chrome://tracing or Perfetto) to see timelines of what each thread was doing. Zones nest, so they show up
+// hierarchically. When profiling's disabled, a zone is just a check of a flag.
+// Each thread's buffer holds the most recent kEventsPerThread zones - older ones get overwritten.
+// Zone names must be string literals (or otherwise outlive the profiling), as only the pointer's stored.
+
+class Profiler
+{
+public:
+	static void setEnabled(bool enabled) { s_enabled = enabled; }
+	static bool isEnabled() { return s_enabled; }
+
+	// discards everything recorded so far
+	static void clear();
+
+	// this should only be done when nothing's being recorded
+	static bool writeChromeTrace(const std::string& path);
+
+	static void recordZone(const char* name, uint64_t startTicks, uint64_t endTicks);
+
+	static const unsigned int kEventsPerThread = 64 * 1024;
+
+protected:
+	struct ZoneEvent
+	{
+		const char*		name;
+		uint64_t		startTicks;
+		uint64_t		endTicks;
+	};
+
+	struct ThreadBuffer
+	{
+		ThreadBuffer(unsigned int index) : threadIndex(index), writePos(0)
+		{
+			aEvents.resize(kEventsPerThread);
+		}
+
+		unsigned int			threadIndex;
+		std::vector<ZoneEvent>	aEvents;
+		// total written - the position in aEvents is this modulo the size
+		uint64_t				writePos;
+	};
+
+	static ThreadBuffer* getThreadBuffer();
+
+protected:
+	static volatile bool				s_enabled;
+
+	// buffers are kept after their threads finish, so their zones still get written out
+	static Mutex						s_lock;
+	static std::vector<ThreadBuffer*>	s_aThreadBuffers;
+	// so times in the trace start from around 0
+	static uint64_t						s_baseTicks;
+};
+
+class ProfileScope
+{
+public:
+	ProfileScope(const char* name) : m_name(name), m_startTicks(0)
+	{
+		if (Profiler::isEnabled())
+		{
+			m_startTicks = HighResClock::getTicks();
+		}
+	}
+
+	~ProfileScope()
+	{
+		if (m_startTicks != 0)
+		{
+			Profiler::recordZone(m_name, m_startTicks, HighResClock::getTicks());
+		}
+	}
+
+protected:
+	const char*		m_name;
+	uint64_t		m_startTicks;
+};
+
+#define PROFILE_SCOPE_CONCAT_INNER(a, b) a##b
+#define PROFILE_SCOPE_CONCAT(a, b) PROFILE_SCOPE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_SCOPE_CONCAT(profileScope, __LINE__)(name)
+
+} // namespace Imagine
+
+#endif // PROFILER_H
@@ -21,6 +21,8 @@
 
 #include <vector>
 #include <map>
+#include <functional>
+#include <inttypes.h>
 
 // clang on OS X can use std::unordered_map without -std=c++11, so use this corner case for the moment
 // so we can build on both Linux and OS X, and still use GCC 4.4 on Linux without C++11 support
@@ -54,10 +56,45 @@ namespace Imagine
 // and isn't a drop-in replacement, as the iterators contain locking semantics which make certain things
 // ([] operators) very tricky to do in the same way - i.e. provide direct access to the .second items.
 
-// It's also only currently templated on the store value type, not the key
+// The key type comes from the store adapter (HashValue by default), and the shard is picked from the key's hash
+// from the Hasher, which for HashValue keys is just the value itself.
+
+// For read-mostly uses, ShardedOpenMap (in sharded_open_map.h) has lock-free lookups.
+
+template <class Key>
+struct ShardedMapHasher
+{
+	HashValue operator()(const Key& key) const
+	{
+		return (HashValue)std::hash<Key>()(key);
+	}
+};
+
+template <>
+struct ShardedMapHasher<HashValue>
+{
+	HashValue operator()(const HashValue& key) const
+	{
+		return key;
+	}
+};
+
+// per-shard counters, to show whether more shards (or a lock-free map) are needed
+struct ShardStatistics
+{
+	ShardStatistics() : lockAcquisitions(0), lockContentions(0), tableResizes(0), items(0)
+	{
+	}
+
+	uint64_t		lockAcquisitions;
+	// acquisitions which had to wait for another thread to release the lock
+	uint64_t		lockContentions;
+	uint64_t		tableResizes;
+	uint64_t		items;
+};
 
 // store adapters, containing the actual associative containers themselves
-template <class Value>
+template <class Value, class Key = HashValue>
 class SARBMap
 {
 public:
@@ -66,7 +103,8 @@ public:
 	{
 	}
 
-	typedef std::map<HashValue, Value> StoreType_t;
+	typedef Key Key_t;
+	typedef std::map<Key, Value> StoreType_t;
 	typedef typename StoreType_t::iterator	iterator;
 
 	void init()
@@ -93,12 +131,17 @@ public:
 		m_store.clear();
 	}
 
-	iterator find(HashValue value)
+	size_t size() const
+	{
+		return m_store.size();
+	}
+
+	iterator find(const Key& key)
 	{
-		return m_store.find(value);
+		return m_store.find(key);
 	}
 
-	iterator insertScoped(const std::pair<HashValue, Value>& values)
+	iterator insertScoped(const std::pair<Key, Value>& values)
 	{
 		return m_store.insert(values).first;
 	}
@@ -113,11 +156,11 @@ public:
 	}
 
 protected:
-	std::map<HashValue, Value>	m_store;
+	StoreType_t	m_store;
 };
 
 #if ENABLE_UNORDERED_MAP
-template <class Value>
+template <class Value, class Key = HashValue>
 class SAUnorderedMap
 {
 public:
@@ -126,7 +169,8 @@ public:
 	{
 	}
 
-	typedef unordered_map<HashValue, Value> StoreType_t;
+	typedef Key Key_t;
+	typedef unordered_map<Key, Value> StoreType_t;
 	typedef typename StoreType_t::iterator	iterator;
 
 	void init()
@@ -153,12 +197,17 @@ public:
 		m_store.clear();
 	}
 
-	iterator find(HashValue value)
+	size_t size() const
+	{
+		return m_store.size();
+	}
+
+	iterator find(const Key& key)
 	{
-		return m_store.find(value);
+		return m_store.find(key);
 	}
 
-	iterator insertScoped(const std::pair<HashValue, Value>& values)
+	iterator insertScoped(const std::pair<Key, Value>& values)
 	{
 		return m_store.insert(values).first;
 	}
@@ -173,10 +222,12 @@ protected:
 };
 #endif
 
-template <class Value, class StoreAdapter>
+template <class Value, class StoreAdapter, class Hasher = ShardedMapHasher<typename StoreAdapter::Key_t> >
 class ShardedMap
 {
 public:
+	typedef typename StoreAdapter::Key_t Key_t;
+
 	ShardedMap() : m_shardCount(1u)
 	{
 		m_aShards.resize(1);
@@ -283,7 +334,7 @@ public:
 			}
 		}
 
-		friend class ShardedMap<Value, StoreAdapter>;
+		friend class ShardedMap<Value, StoreAdapter, Hasher>;
 
 		void lock()
 		{
@@ -294,7 +345,7 @@ public:
 				return;
 
 			Shard& shardItem = m_pShardMap->m_aShards[m_shardIndex];
-			shardItem.m_lock.lock();
+			lockShard(shardItem);
 
 			m_holdLock = true;
 		}
@@ -405,19 +456,19 @@ public:
 	}
 
 	// ideally, this would be const, but...
-	iterator find(HashValue value)
+	iterator find(const Key_t& key)
 	{
 		// mix the hash value, and use the mixed result to work out the shard
 		// this is important so that we get good distribution of keys for both the shards
 		// and the storage maps, and helps prevent clustering
-		HashValue shardHash = mixHash(value);
+		HashValue shardHash = mixHash(m_hasher(key));
 		unsigned int shardIndex = getShardIndex(shardHash);
 
 		Shard& shard = m_aShards[shardIndex];
-		shard.m_lock.lock();
+		lockShard(shard);
 
 		// now try and find item in inner map
-		typename StoreAdapter::iterator itFind = shard.m_store.find(value);
+		typename StoreAdapter::iterator itFind = shard.m_store.find(key);
 		if (itFind == shard.m_store.itEnd())
 		{
 			// we don't have it
@@ -433,14 +484,14 @@ public:
 		return itResult;
 	}
 
-	// return an iterator pointing to the start of the shard that the hashvalue
+	// return an iterator pointing to the start of the shard that the key
 	// should belong in, or the next non-empty shard if the target one is empty
-	iterator itShardForHash(HashValue value)
+	iterator itShardForHash(const Key_t& key)
 	{
 		// mix the hash value, and use the mixed result to work out the shard
 		// this is important so that we get good distribution of keys for both the shards
 		// and the storage maps, and helps prevent clustering
-		HashValue shardHash = mixHash(value);
+		HashValue shardHash = mixHash(m_hasher(key));
 		unsigned int shardIndex = getShardIndex(shardHash);
 
 		iterator it(this, -1u);
@@ -499,17 +550,17 @@ public:
 
 	// returns an iterator which holds the lock on the shard
 	// until the iterator goes out of scope
-	iterator insert(std::pair<HashValue, Value> values)
+	iterator insert(std::pair<Key_t, Value> values)
 	{
 		// mix the hash value, and use the mixed result to work out the shard
 		// this is important so that we get good distribution of keys for both the shards
 		// and the storage maps, and helps prevent clustering
-		HashValue shardHash = mixHash(values.first);
+		HashValue shardHash = mixHash(m_hasher(values.first));
 
 		unsigned int shardIndex = getShardIndex(shardHash);
 
 		Shard& shard = m_aShards[shardIndex];
-		shard.m_lock.lock();
+		lockShard(shard);
 
 		typename StoreAdapter::StoreType_t::iterator itNewItem = shard.m_store.insertScoped(values);
 
@@ -567,12 +618,32 @@ public:
 		{
 			Shard& shard = m_aShards[i];
 
-			shard.m_lock.lock();
+			lockShard(shard);
 			shard.m_store.clear();
 			shard.m_lock.unlock();
 		}
 	}
 
+	void getShardStatistics(std::vector<ShardStatistics>& aStatistics)
+	{
+		aStatistics.resize(m_shardCount);
+
+		for (unsigned int i = 0; i < m_shardCount; i++)
+		{
+			Shard& shard = m_aShards[i];
+
+			shard.m_lock.lock();
+
+			ShardStatistics& statistics = aStatistics[i];
+			statistics.lockAcquisitions = shard.m_lockAcquisitions;
+			statistics.lockContentions = shard.m_lockContentions;
+			statistics.tableResizes = 0;
+			statistics.items = (uint64_t)shard.m_store.size();
+
+			shard.m_lock.unlock();
+		}
+	}
+
 protected:
 	unsigned int getShardIndex(HashValue value) const
 	{
@@ -600,15 +671,36 @@ protected:
 	class Shard
 	{
 	public:
+		Shard() : m_lockAcquisitions(0), m_lockContentions(0)
+		{
+		}
+
 		StoreAdapter	m_store;
 		// this is quite large on linux, but using a spin lock doesn't seem to be any faster, so I don't think it matters. On other
 		// platforms where Futexes don't exist, this might be a different story...
 		Mutex			m_lock;
+
+		// only modified with the lock held
+		uint64_t		m_lockAcquisitions;
+		uint64_t		m_lockContentions;
 	};
 
+	static void lockShard(Shard& shard)
+	{
+		if (!shard.m_lock.tryLock())
+		{
+			shard.m_lock.lock();
+			shard.m_lockContentions++;
+		}
+
+		shard.m_lockAcquisitions++;
+	}
+
 	std::vector<Shard>	m_aShards;
 
 	unsigned int		m_shardCount;
+
+	Hasher				m_hasher;
 };
 
 } // namespace Imagine
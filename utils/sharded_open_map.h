@@ -0,0 +1,433 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#ifndef SHARDED_OPEN_MAP_H
+#define SHARDED_OPEN_MAP_H
+
+#include <atomic>
+#include <vector>
+
+#include "sharded_map.h"
+
+#include "utils/threads/mutex.h"
+#include "utils/threads/epoch_domain.h"
+
+namespace Imagine
+{
+
+// Sharded map for read-mostly use (i.e. caches of textures or images by HashValue), where lookups don't take any
+// locks, so don't serialise with each other: each shard is an open-addressing (linear probing) hash table,
+// which writers modify with the shard's lock held, and replace with a bigger one when it gets too full. Readers are
+// protected from tables being freed underneath them with an EpochDomain.
+// To make that work without locks, values are copied out by find(), rather than giving access to them in place,
+// so Value should be cheap to copy (i.e. a pointer), and a key's value can't be changed once inserted - only erased.
+// Erased items leave tombstones behind, which are cleared out when the table is next rebuilt.
+
+template <class Key, class Value, class Hasher = ShardedMapHasher<Key> >
+class ShardedOpenMap
+{
+public:
+	ShardedOpenMap(unsigned int numShards = 16, unsigned int initialShardCapacity = 64) : m_shardCount(numShards > 0 ? numShards : 1),
+		m_initialShardCapacity(roundUpToPowerOfTwo(initialShardCapacity))
+	{
+		m_pShards = new Shard[m_shardCount];
+
+		for (unsigned int i = 0; i < m_shardCount; i++)
+		{
+			m_pShards[i].pTable.store(new Table(m_initialShardCapacity), std::memory_order_relaxed);
+		}
+	}
+
+	~ShardedOpenMap()
+	{
+		for (unsigned int i = 0; i < m_shardCount; i++)
+		{
+			delete m_pShards[i].pTable.load(std::memory_order_relaxed);
+		}
+
+		delete [] m_pShards;
+	}
+
+	// lock-free
+	bool find(const Key& key, Value& value) const
+	{
+		HashValue hash = mixHash(m_hasher(key));
+		const Shard& shard = m_pShards[getShardIndex(hash)];
+
+		EpochReadScope readScope(m_epochDomain);
+
+		const Table* pTable = shard.pTable.load(std::memory_order_acquire);
+
+		unsigned int slotIndex = getStartSlotIndex(hash, pTable);
+		for (unsigned int i = 0; i < pTable->capacity; i++)
+		{
+			const Slot& slot = pTable->pSlots[slotIndex];
+			unsigned int state = slot.state.load(std::memory_order_acquire);
+
+			if (state == eSlotEmpty)
+				return false;
+
+			// slots being written to are skipped, as an insert isn't finished until it's marked full
+			if (state == eSlotFull && slot.key == key)
+			{
+				value = slot.value;
+				return true;
+			}
+
+			slotIndex = (slotIndex + 1) & pTable->mask;
+		}
+
+		return false;
+	}
+
+	bool contains(const Key& key) const
+	{
+		Value value;
+		return find(key, value);
+	}
+
+	// returns false (and doesn't change the existing value) if the key's already in the map
+	bool insert(const Key& key, const Value& value)
+	{
+		HashValue hash = mixHash(m_hasher(key));
+		Shard& shard = m_pShards[getShardIndex(hash)];
+
+		lockShard(shard);
+
+		Table* pTable = shard.pTable.load(std::memory_order_relaxed);
+
+		unsigned int emptySlotIndex = -1u;
+		if (findSlotLocked(key, hash, pTable, emptySlotIndex) != -1u)
+		{
+			shard.lock.unlock();
+			return false;
+		}
+
+		Table* pRetiredTable = nullptr;
+
+		// keep the table at most half used (including tombstones), otherwise probe lengths get long
+		if ((shard.usedSlots + 1) * 2 > pTable->capacity)
+		{
+			pRetiredTable = pTable;
+			pTable = rebuildTableLocked(shard, pTable);
+			shard.pTable.store(pTable, std::memory_order_release);
+
+			findSlotLocked(key, hash, pTable, emptySlotIndex);
+		}
+
+		Slot& slot = pTable->pSlots[emptySlotIndex];
+		slot.state.store(eSlotWriting, std::memory_order_relaxed);
+		slot.key = key;
+		slot.value = value;
+		// readers only look at the key and value once they see this
+		slot.state.store(eSlotFull, std::memory_order_release);
+
+		shard.items++;
+		shard.usedSlots++;
+
+		shard.lock.unlock();
+
+		if (pRetiredTable)
+		{
+			m_epochDomain.synchronise();
+			delete pRetiredTable;
+		}
+
+		return true;
+	}
+
+	bool erase(const Key& key)
+	{
+		HashValue hash = mixHash(m_hasher(key));
+		Shard& shard = m_pShards[getShardIndex(hash)];
+
+		lockShard(shard);
+
+		Table* pTable = shard.pTable.load(std::memory_order_relaxed);
+
+		unsigned int emptySlotIndex = -1u;
+		unsigned int slotIndex = findSlotLocked(key, hash, pTable, emptySlotIndex);
+		if (slotIndex == -1u)
+		{
+			shard.lock.unlock();
+			return false;
+		}
+
+		// the key and value are left as they are, as readers might be copying them, and the slot doesn't get reused
+		// until the table's rebuilt
+		pTable->pSlots[slotIndex].state.store(eSlotDeleted, std::memory_order_release);
+
+		shard.items--;
+
+		shard.lock.unlock();
+
+		return true;
+	}
+
+	void clear()
+	{
+		std::vector<Table*> aRetiredTables;
+
+		for (unsigned int i = 0; i < m_shardCount; i++)
+		{
+			Shard& shard = m_pShards[i];
+
+			lockShard(shard);
+
+			aRetiredTables.emplace_back(shard.pTable.load(std::memory_order_relaxed));
+			shard.pTable.store(new Table(m_initialShardCapacity), std::memory_order_release);
+
+			shard.items = 0;
+			shard.usedSlots = 0;
+
+			shard.lock.unlock();
+		}
+
+		m_epochDomain.synchronise();
+
+		typename std::vector<Table*>::iterator it = aRetiredTables.begin();
+		for (; it != aRetiredTables.end(); ++it)
+		{
+			delete *it;
+		}
+	}
+
+	size_t size() const
+	{
+		size_t totalItems = 0;
+
+		for (unsigned int i = 0; i < m_shardCount; i++)
+		{
+			Shard& shard = m_pShards[i];
+
+			shard.lock.lock();
+			totalItems += shard.items;
+			shard.lock.unlock();
+		}
+
+		return totalItems;
+	}
+
+	void getShardStatistics(std::vector<ShardStatistics>& aStatistics) const
+	{
+		aStatistics.resize(m_shardCount);
+
+		for (unsigned int i = 0; i < m_shardCount; i++)
+		{
+			Shard& shard = m_pShards[i];
+
+			shard.lock.lock();
+
+			ShardStatistics& statistics = aStatistics[i];
+			statistics.lockAcquisitions = shard.lockAcquisitions;
+			statistics.lockContentions = shard.lockContentions;
+			statistics.tableResizes = shard.tableResizes;
+			statistics.items = shard.items;
+
+			shard.lock.unlock();
+		}
+	}
+
+	// lookups which had to retry because a table was being replaced at the same time
+	uint64_t getReadRetries() const
+	{
+		return m_epochDomain.getReadRetries();
+	}
+
+protected:
+	enum SlotState
+	{
+		eSlotEmpty,
+		eSlotWriting,
+		eSlotFull,
+		eSlotDeleted
+	};
+
+	struct Slot
+	{
+		Slot() : key(), value()
+		{
+			state.store(eSlotEmpty, std::memory_order_relaxed);
+		}
+
+		std::atomic<unsigned int>	state;
+		Key							key;
+		Value						value;
+	};
+
+	struct Table
+	{
+		// capacity must be a power of two
+		Table(unsigned int tableCapacity) : capacity(tableCapacity), mask(tableCapacity - 1)
+		{
+			pSlots = new Slot[capacity];
+		}
+
+		~Table()
+		{
+			delete [] pSlots;
+		}
+
+		unsigned int		capacity;
+		unsigned int		mask;
+		Slot*				pSlots;
+	};
+
+	class Shard
+	{
+	public:
+		Shard() : items(0), usedSlots(0), lockAcquisitions(0), lockContentions(0), tableResizes(0)
+		{
+			pTable.store(nullptr, std::memory_order_relaxed);
+		}
+
+		std::atomic<Table*>		pTable;
+
+		mutable Mutex			lock;
+
+		// all only modified with the lock held
+		uint64_t				items;
+		// full slots and tombstones
+		uint64_t				usedSlots;
+
+		uint64_t				lockAcquisitions;
+		uint64_t				lockContentions;
+		uint64_t				tableResizes;
+
+		// so different shards' tables and locks aren't in the same cache line
+		unsigned char			padding[64];
+	};
+
+	static void lockShard(Shard& shard)
+	{
+		if (!shard.lock.tryLock())
+		{
+			shard.lock.lock();
+			shard.lockContentions++;
+		}
+
+		shard.lockAcquisitions++;
+	}
+
+	// returns the index of the key's slot if it's in the table, otherwise -1u with emptySlotIndex set to where it
+	// should go. Assumes the shard's lock is held.
+	static unsigned int findSlotLocked(const Key& key, HashValue hash, const Table* pTable, unsigned int& emptySlotIndex)
+	{
+		unsigned int slotIndex = getStartSlotIndex(hash, pTable);
+		for (unsigned int i = 0; i < pTable->capacity; i++)
+		{
+			const Slot& slot = pTable->pSlots[slotIndex];
+			unsigned int state = slot.state.load(std::memory_order_relaxed);
+
+			if (state == eSlotEmpty)
+			{
+				emptySlotIndex = slotIndex;
+				return -1u;
+			}
+
+			if (state == eSlotFull && slot.key == key)
+				return slotIndex;
+
+			slotIndex = (slotIndex + 1) & pTable->mask;
+		}
+
+		// can't happen, as the table's always kept at most half used
+		emptySlotIndex = -1u;
+		return -1u;
+	}
+
+	// creates a new table with just the current items in, with room for at least as many again.
+	// Assumes the shard's lock is held.
+	Table* rebuildTableLocked(Shard& shard, const Table* pOldTable) const
+	{
+		unsigned int newCapacity = roundUpToPowerOfTwo((unsigned int)(shard.items + 1) * 4);
+		if (newCapacity < m_initialShardCapacity)
+		{
+			newCapacity = m_initialShardCapacity;
+		}
+
+		Table* pNewTable = new Table(newCapacity);
+
+		for (unsigned int i = 0; i < pOldTable->capacity; i++)
+		{
+			const Slot& oldSlot = pOldTable->pSlots[i];
+			if (oldSlot.state.load(std::memory_order_relaxed) != eSlotFull)
+				continue;
+
+			unsigned int emptySlotIndex = -1u;
+			findSlotLocked(oldSlot.key, mixHash(m_hasher(oldSlot.key)), pNewTable, emptySlotIndex);
+
+			Slot& newSlot = pNewTable->pSlots[emptySlotIndex];
+			newSlot.key = oldSlot.key;
+			newSlot.value = oldSlot.value;
+			newSlot.state.store(eSlotFull, std::memory_order_relaxed);
+		}
+
+		shard.usedSlots = shard.items;
+		shard.tableResizes++;
+
+		return pNewTable;
+	}
+
+	unsigned int getShardIndex(HashValue hash) const
+	{
+		return (unsigned int)(hash % m_shardCount);
+	}
+
+	static unsigned int getStartSlotIndex(HashValue hash, const Table* pTable)
+	{
+		// the low bits have been used for the shard index
+		return (unsigned int)(hash >> 32) & pTable->mask;
+	}
+
+	static unsigned int roundUpToPowerOfTwo(unsigned int value)
+	{
+		unsigned int result = 2;
+		while (result < value)
+		{
+			result <<= 1;
+		}
+
+		return result;
+	}
+
+	// taken from MurmurHash3
+	static HashValue mixHash(HashValue val)
+	{
+		val ^= val >> 33;
+		val *= uint64_t(0xff51afd7ed558ccd);
+		val ^= val >> 33;
+		val *= uint64_t(0xc4ceb9fe1a85ec53);
+		val ^= val >> 33;
+
+		return val;
+	}
+
+protected:
+	Shard*					m_pShards;
+	unsigned int			m_shardCount;
+	unsigned int			m_initialShardCapacity;
+
+	Hasher					m_hasher;
+
+	mutable EpochDomain		m_epochDomain;
+};
+
+} // namespace Imagine
+
+#endif // SHARDED_OPEN_MAP_H
@@ -26,6 +26,22 @@ namespace Imagine
 const int MAX_SEND_LENGTH = 1024;
 const int MAX_RECV_LENGTH = 4096;
 
+// sending to a peer which has gone away raises SIGPIPE by default, which kills the process, rather than the send
+// failing with EPIPE. Linux can suppress it per-send, macOS only per-socket (SO_NOSIGPIPE - see setNoSigPipe()).
+#ifdef MSG_NOSIGNAL
+const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+const int SEND_FLAGS = 0;
+#endif
+
+static void setNoSigPipe(int sock)
+{
+#ifdef SO_NOSIGPIPE
+	int on = 1;
+	::setsockopt(sock, SOL_SOCKET, SO_NOSIGPIPE, (const char*)&on, sizeof(on));
+#endif
+}
+
 Socket::Socket() : m_sock(-1), m_port(-1)
 {
 	memset(&m_addr, 0, sizeof(m_addr));
@@ -59,6 +75,8 @@ bool Socket::create()
 	if (::setsockopt(m_sock, SOL_SOCKET, SO_REUSEADDR, (const char*)&on, sizeof(on)) == -1)
 		return false;
 
+	setNoSigPipe(m_sock);
+
 	return true;
 }
 
@@ -167,6 +185,8 @@ bool Socket::accept(Socket& sock) const
 	if (sock.m_sock <= 0)
 		return false;
 
+	setNoSigPipe(sock.m_sock);
+
 	return true;
 }
 
@@ -181,6 +201,8 @@ bool Socket::accept(Socket* sock) const
 	if (sock->m_sock <= 0)
 		return false;
 
+	setNoSigPipe(sock->m_sock);
+
 	return true;
 }
 
@@ -189,7 +211,7 @@ bool Socket::send(const std::string& data) const
 	if (!isValid())
 		return false;
 
-	int bytesSent = ::send(m_sock, data.c_str(), data.size(), 0);
+	int bytesSent = ::send(m_sock, data.c_str(), data.size(), SEND_FLAGS);
 
 	if (bytesSent == -1)
 		return false;
@@ -231,7 +253,7 @@ int Socket::recv(std::string& data) const
 // these are currently only designed to handle small data sizes
 bool Socket::send(const void* ptr, size_t size)
 {
-	size_t sizeSent = ::send(m_sock, ptr, size, 0);
+	size_t sizeSent = ::send(m_sock, ptr, size, SEND_FLAGS);
 	return sizeSent == size;
 }
 
@@ -248,7 +270,60 @@ ssize_t Socket::receiveChunk(void* ptr, size_t targetSize)
 
 ssize_t Socket::sendChunk(void* ptr, size_t targetSize)
 {
-	return ::send(m_sock, ptr, targetSize, 0);
+	return ::send(m_sock, ptr, targetSize, SEND_FLAGS);
+}
+
+bool Socket::sendAll(const void* ptr, size_t size)
+{
+	const char* pData = (const char*)ptr;
+
+	while (size > 0)
+	{
+		ssize_t sizeSent = ::send(m_sock, pData, size, SEND_FLAGS);
+		if (sizeSent < 0 && errno == EINTR)
+			continue;
+
+		if (sizeSent <= 0)
+			return false;
+
+		pData += sizeSent;
+		size -= sizeSent;
+	}
+
+	return true;
+}
+
+bool Socket::receiveAll(void* ptr, size_t size)
+{
+	char* pData = (char*)ptr;
+
+	while (size > 0)
+	{
+		ssize_t sizeReceived = ::recv(m_sock, pData, size, 0);
+		if (sizeReceived < 0 && errno == EINTR)
+			continue;
+
+		// 0 is the other end closing the connection
+		if (sizeReceived <= 0)
+			return false;
+
+		pData += sizeReceived;
+		size -= sizeReceived;
+	}
+
+	return true;
+}
+
+void Socket::shutdown()
+{
+	if (isValid())
+	{
+#ifdef _MSC_VER
+		::shutdown(m_sock, SD_BOTH);
+#else
+		::shutdown(m_sock, SHUT_RDWR);
+#endif
+	}
 }
 
 std::string Socket::getClientHost()
@@ -85,6 +85,13 @@ public:
 
 	ssize_t sendChunk(void* ptr, size_t targetSize);
 
+	//! loop until all of size has been sent / received, so can be used for large payloads
+	bool sendAll(const void* ptr, size_t size);
+	bool receiveAll(void* ptr, size_t size);
+
+	//! stops any further sends / receives, waking up anything blocked in recv() on another thread
+	void shutdown();
+
 	bool isValid() const { return m_sock != -1; }
 
 	std::string getClientHost();
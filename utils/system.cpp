@@ -32,6 +32,9 @@
 #include <unistd.h>
 #include <sys/time.h>
 #include <sys/resource.h>
+#if __linux__
+#include <sys/syscall.h>
+#endif
 #endif
 #else
 #include <windows.h>
@@ -114,6 +117,7 @@ System::CPUInfo System::getCPUInfo()
 	System::CPUInfo info;
 #if __linux__
 	getLinuxCPUInfo(info);
+	getLinuxNUMAInfo(info);
 #else
 	info.numSockets = 1;
 #endif
@@ -282,6 +286,54 @@ bool System::setProcessPriority(ProcessPriority priority)
 	return true;
 }
 
+bool System::setMemoryInterleaving(bool interleave)
+{
+#if __linux__ && defined(SYS_set_mempolicy)
+	// from linux/mempolicy.h - we call the syscall directly so as to not need libnuma
+	static const int kMemPolicyDefault = 0;
+	static const int kMemPolicyInterleave = 3;
+
+	if (!interleave)
+	{
+		return syscall(SYS_set_mempolicy, kMemPolicyDefault, nullptr, 0) == 0;
+	}
+
+	std::vector<unsigned int> aNodes;
+
+	char szNodesOnline[256];
+	memset(szNodesOnline, 0, 256);
+
+	FILE* pFile = fopen("/sys/devices/system/node/online", "r");
+	if (!pFile)
+		return false;
+
+	bool haveNodes = fgets(szNodesOnline, 256, pFile) != nullptr;
+	fclose(pFile);
+
+	if (!haveNodes || !parseLinuxIndexList(szNodesOnline, aNodes) || aNodes.empty())
+		return false;
+
+	static const unsigned int kMaxNodes = 1024;
+	static const unsigned int kBitsPerMaskItem = sizeof(unsigned long) * 8;
+	unsigned long nodeMask[kMaxNodes / kBitsPerMaskItem];
+	memset(nodeMask, 0, sizeof(nodeMask));
+
+	std::vector<unsigned int>::const_iterator itNode = aNodes.begin();
+	for (; itNode != aNodes.end(); ++itNode)
+	{
+		unsigned int node = *itNode;
+		if (node < kMaxNodes)
+		{
+			nodeMask[node / kBitsPerMaskItem] |= 1ul << (node % kBitsPerMaskItem);
+		}
+	}
+
+	return syscall(SYS_set_mempolicy, kMemPolicyInterleave, nodeMask, (unsigned long)kMaxNodes) == 0;
+#else
+	return false;
+#endif
+}
+
 #if __linux__
 bool System::getLinuxCPUInfo(CPUInfo& info)
 {
@@ -363,6 +415,96 @@ bool System::getLinuxInfoToken(const char* cpuInfoLine, const char* token, unsig
 	return false;
 }
 
+bool System::getLinuxNUMAInfo(CPUInfo& info)
+{
+	char szList[1024];
+	memset(szList, 0, 1024);
+
+	FILE* pFile = fopen("/sys/devices/system/node/online", "r");
+	if (!pFile)
+		return false;
+
+	bool haveList = fgets(szList, 1024, pFile) != nullptr;
+	fclose(pFile);
+
+	std::vector<unsigned int> aNodes;
+	if (!haveList || !parseLinuxIndexList(szList, aNodes) || aNodes.empty())
+		return false;
+
+	info.numNUMANodes = (unsigned int)aNodes.size();
+
+	std::vector<unsigned int>::const_iterator itNode = aNodes.begin();
+	for (; itNode != aNodes.end(); ++itNode)
+	{
+		unsigned int node = *itNode;
+
+		char szPath[128];
+		sprintf(szPath, "/sys/devices/system/node/node%u/cpulist", node);
+
+		pFile = fopen(szPath, "r");
+		if (!pFile)
+			continue;
+
+		memset(szList, 0, 1024);
+		haveList = fgets(szList, 1024, pFile) != nullptr;
+		fclose(pFile);
+
+		std::vector<unsigned int> aCPUs;
+		if (!haveList || !parseLinuxIndexList(szList, aCPUs))
+			continue;
+
+		std::vector<unsigned int>::const_iterator itCPU = aCPUs.begin();
+		for (; itCPU != aCPUs.end(); ++itCPU)
+		{
+			unsigned int cpu = *itCPU;
+			if (cpu >= info.aCPUNUMANodes.size())
+			{
+				info.aCPUNUMANodes.resize(cpu + 1, 0);
+			}
+
+			info.aCPUNUMANodes[cpu] = node;
+		}
+	}
+
+	return true;
+}
+
+bool System::parseLinuxIndexList(const char* indexList, std::vector<unsigned int>& aIndices)
+{
+	const char* pCurrent = indexList;
+
+	while (*pCurrent != 0 && *pCurrent != '\n')
+	{
+		char* pEnd = nullptr;
+		unsigned long start = strtoul(pCurrent, &pEnd, 10);
+		if (pEnd == pCurrent)
+			return false;
+
+		unsigned long end = start;
+		pCurrent = pEnd;
+
+		if (*pCurrent == '-')
+		{
+			pCurrent++;
+			end = strtoul(pCurrent, &pEnd, 10);
+			if (pEnd == pCurrent || end < start)
+				return false;
+
+			pCurrent = pEnd;
+		}
+
+		for (unsigned long index = start; index <= end; index++)
+		{
+			aIndices.emplace_back((unsigned int)index);
+		}
+
+		if (*pCurrent == ',')
+			pCurrent++;
+	}
+
+	return true;
+}
+
 #endif
 
 } // namespace Imagine
@@ -20,6 +20,7 @@
 #define SYSTEM_H
 
 #include <string>
+#include <vector>
 
 namespace Imagine
 {
@@ -31,13 +32,17 @@ public:
 
 	struct CPUInfo
 	{
-		CPUInfo() : numSockets(0), numCores(0), numThreads(0)
+		CPUInfo() : numSockets(0), numCores(0), numThreads(0), numNUMANodes(1)
 		{
 		}
 
 		unsigned int	numSockets;
 		unsigned int	numCores;
 		unsigned int	numThreads;
+
+		unsigned int	numNUMANodes;
+		// the NUMA node of each logical CPU, indexed by CPU number (may be empty if it couldn't be worked out)
+		std::vector<unsigned int>	aCPUNUMANodes;
 	};
 
 	struct ProcessMemInfo
@@ -73,10 +78,18 @@ public:
 
 	static bool setProcessPriority(ProcessPriority priority);
 
+	// sets the calling thread's memory policy so that new allocations (by it, and threads it creates afterwards) are
+	// interleaved page by page over all NUMA nodes, or back to the default of the node of the CPU touching them first.
+	// Returns false if not supported.
+	static bool setMemoryInterleaving(bool interleave);
+
 
 private:
 	static bool getLinuxCPUInfo(CPUInfo& info);
 	static bool getLinuxInfoToken(const char* cpuInfoLine, const char* token, unsigned int& value);
+	static bool getLinuxNUMAInfo(CPUInfo& info);
+	// parses kernel CPU / node lists, i.e. "0-63,128-191"
+	static bool parseLinuxIndexList(const char* indexList, std::vector<unsigned int>& aIndices);
 };
 
 } // namespace Imagine
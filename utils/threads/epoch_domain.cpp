@@ -0,0 +1,99 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#include "epoch_domain.h"
+
+#include <thread>
+
+namespace Imagine
+{
+
+static std::atomic<unsigned int> s_nextReaderSlot(0);
+static thread_local unsigned int s_threadReaderSlot = -1u;
+
+EpochDomain::EpochDomain()
+{
+	m_epoch.store(0, std::memory_order_relaxed);
+	m_readRetries.store(0, std::memory_order_relaxed);
+}
+
+unsigned int EpochDomain::enterRead()
+{
+	ReaderSlot& slot = m_aReaderSlots[getThreadReaderSlot()];
+
+	while (true)
+	{
+		uint64_t epoch = m_epoch.load(std::memory_order_seq_cst);
+		unsigned int parity = (unsigned int)(epoch & 1);
+
+		slot.activeReaders[parity].fetch_add(1, std::memory_order_seq_cst);
+
+		// if the epoch's moved on since we read it, synchronise() might have already checked our slot, so it
+		// wouldn't know about us
+		if (m_epoch.load(std::memory_order_seq_cst) == epoch)
+		{
+			return (getThreadReaderSlot() << 1) | parity;
+		}
+
+		slot.activeReaders[parity].fetch_sub(1, std::memory_order_release);
+		m_readRetries.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void EpochDomain::exitRead(unsigned int token)
+{
+	ReaderSlot& slot = m_aReaderSlots[token >> 1];
+	slot.activeReaders[token & 1].fetch_sub(1, std::memory_order_release);
+}
+
+void EpochDomain::synchronise()
+{
+	m_synchroniseLock.lock();
+
+	// readers entering from now on are in the new epoch, and will see anything the caller's published before this,
+	// so only ones which entered in the previous epoch need waiting for. Readers from the epoch before that were
+	// all waited for by the last call.
+	uint64_t epoch = m_epoch.load(std::memory_order_relaxed);
+	m_epoch.store(epoch + 1, std::memory_order_seq_cst);
+
+	unsigned int parity = (unsigned int)(epoch & 1);
+
+	for (unsigned int i = 0; i < kReaderSlots; i++)
+	{
+		const ReaderSlot& slot = m_aReaderSlots[i];
+
+		while (slot.activeReaders[parity].load(std::memory_order_acquire) != 0)
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	m_synchroniseLock.unlock();
+}
+
+unsigned int EpochDomain::getThreadReaderSlot()
+{
+	if (s_threadReaderSlot == -1u)
+	{
+		s_threadReaderSlot = s_nextReaderSlot.fetch_add(1, std::memory_order_relaxed) % kReaderSlots;
+	}
+
+	return s_threadReaderSlot;
+}
+
+} // namespace Imagine
@@ -0,0 +1,100 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#ifndef EPOCH_DOMAIN_H
+#define EPOCH_DOMAIN_H
+
+#include <atomic>
+#include <inttypes.h>
+
+#include "mutex.h"
+
+namespace Imagine
+{
+
+// Epoch-based protection of memory read without locks (similar to RCU): readers mark the sections where they're
+// reading with enterRead() / exitRead() (or an EpochReadScope), which is a couple of uncontended atomic operations
+// on a per-thread counter. A writer which has unlinked something readers might still be using calls synchronise(),
+// which waits until every reader which could have seen it has left its read section, after which it can be freed.
+// synchronise() is relatively slow, so it's only meant for rare events, like replacing a hash table with a bigger one.
+// Read sections should be short, and mustn't call synchronise() themselves.
+
+class EpochDomain
+{
+public:
+	EpochDomain();
+
+	// returns a token which needs to be given to exitRead()
+	unsigned int enterRead();
+	void exitRead(unsigned int token);
+
+	void synchronise();
+
+	// how many times readers had to retry entering because synchronise() was advancing the epoch
+	uint64_t getReadRetries() const { return m_readRetries.load(std::memory_order_relaxed); }
+
+	static const unsigned int kReaderSlots = 64;
+
+protected:
+	// Threads are spread over the slots, and more than one thread can share a slot, so these are counts
+	// of the readers active, for each parity of the epoch they entered in.
+	struct ReaderSlot
+	{
+		ReaderSlot()
+		{
+			activeReaders[0].store(0, std::memory_order_relaxed);
+			activeReaders[1].store(0, std::memory_order_relaxed);
+		}
+
+		std::atomic<unsigned int>	activeReaders[2];
+		// so different threads' slots aren't in the same cache line
+		unsigned char				padding[64 - 2 * sizeof(std::atomic<unsigned int>)];
+	};
+
+	static unsigned int getThreadReaderSlot();
+
+protected:
+	std::atomic<uint64_t>		m_epoch;
+	std::atomic<uint64_t>		m_readRetries;
+
+	ReaderSlot					m_aReaderSlots[kReaderSlots];
+
+	Mutex						m_synchroniseLock;
+};
+
+class EpochReadScope
+{
+public:
+	EpochReadScope(EpochDomain& domain) : m_domain(domain)
+	{
+		m_token = m_domain.enterRead();
+	}
+
+	~EpochReadScope()
+	{
+		m_domain.exitRead(m_token);
+	}
+
+protected:
+	EpochDomain&		m_domain;
+	unsigned int		m_token;
+};
+
+} // namespace Imagine
+
+#endif // EPOCH_DOMAIN_H
@@ -68,4 +68,13 @@ void Mutex::unlock()
 #endif
 }
 
+bool Mutex::tryLock()
+{
+#ifdef _MSC_VER
+	return WaitForSingleObject(m_mutex, 0) == WAIT_OBJECT_0;
+#else
+	return pthread_mutex_trylock(&m_mutex) == 0;
+#endif
+}
+
 } // namespace Imagine
@@ -36,6 +36,9 @@ public:
 
 	void lock();
 	void unlock();
+
+	// returns false without waiting if another thread holds the lock
+	bool tryLock();
 	
 	friend class Event;
 
@@ -0,0 +1,92 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#include "parallel_range.h"
+
+#include <algorithm>
+
+#include "utils/system.h"
+
+namespace Imagine
+{
+
+static const unsigned int kRangesPerThread = 4;
+
+ParallelRangeRunner::ParallelRangeRunner(unsigned int threads) : ThreadPool(threads > 0 ? threads : System::getNumberOfThreads(), false)
+{
+}
+
+unsigned int ParallelRangeRunner::getRangeCount(size_t numItems, size_t minItemsPerRange) const
+{
+	if (minItemsPerRange == 0)
+	{
+		minItemsPerRange = 1;
+	}
+
+	size_t maxRanges = numItems / minItemsPerRange;
+	size_t wantedRanges = (size_t)m_numberOfThreads * kRangesPerThread;
+
+	if (m_numberOfThreads <= 1 || maxRanges <= 1)
+		return 1;
+
+	return (unsigned int)std::min(maxRanges, wantedRanges);
+}
+
+void ParallelRangeRunner::getRange(size_t numItems, unsigned int numRanges, unsigned int rangeIndex, size_t& start, size_t& end)
+{
+	size_t rangeSize = numItems / numRanges;
+	size_t remainder = numItems % numRanges;
+
+	// the first remainder ranges get one extra item each
+	start = rangeSize * rangeIndex + std::min((size_t)rangeIndex, remainder);
+	end = start + rangeSize + ((rangeIndex < remainder) ? 1 : 0);
+}
+
+void ParallelRangeRunner::run(ParallelRangeFunction& function, size_t numItems, unsigned int numRanges)
+{
+	if (numItems == 0)
+		return;
+
+	if (numRanges <= 1)
+	{
+		function.processRange(0, 0, numItems);
+		return;
+	}
+
+	for (unsigned int i = 0; i < numRanges; i++)
+	{
+		size_t start;
+		size_t end;
+		getRange(numItems, numRanges, i, start, end);
+
+		addTaskNoLock(new ParallelRangeTask(&function, i, start, end));
+	}
+
+	startPool(POOL_WAIT_FOR_COMPLETION);
+}
+
+bool ParallelRangeRunner::doTask(ThreadPoolTask* pTask, unsigned int threadID)
+{
+	ParallelRangeTask* pRangeTask = static_cast<ParallelRangeTask*>(pTask);
+
+	pRangeTask->m_pFunction->processRange(pRangeTask->m_rangeIndex, pRangeTask->m_start, pRangeTask->m_end);
+
+	return true;
+}
+
+} // namespace Imagine
@@ -0,0 +1,93 @@
+/*
+ Imagine
+ Copyright 2020 Peter Pearson.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ You may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ ---------
+*/
+
+#ifndef PARALLEL_RANGE_H
+#define PARALLEL_RANGE_H
+
+#include <cstddef>
+
+#include "thread_pool.h"
+
+namespace Imagine
+{
+
+// Runs a function over [0, numItems) split into contiguous ranges on a ThreadPool, for data-parallel processing of
+// big arrays (i.e. geometry import post-processing). The split only depends on the number of items and ranges,
+// so multi-pass algorithms (i.e. radix sort histograms then scatters) can rely on range N covering the same items
+// in each pass.
+
+class ParallelRangeFunction
+{
+public:
+	ParallelRangeFunction()
+	{
+	}
+
+	virtual ~ParallelRangeFunction()
+	{
+	}
+
+	// called from the worker threads at the same time for different ranges, so must only write to state
+	// belonging to the range (or rangeIndex)
+	virtual void processRange(unsigned int rangeIndex, size_t start, size_t end) = 0;
+};
+
+class ParallelRangeTask : public ThreadPoolTask
+{
+public:
+	ParallelRangeTask(ParallelRangeFunction* pFunction, unsigned int rangeIndex, size_t start, size_t end)
+		: m_pFunction(pFunction), m_rangeIndex(rangeIndex), m_start(start), m_end(end)
+	{
+	}
+
+	virtual ~ParallelRangeTask() { }
+
+	ParallelRangeFunction*	m_pFunction;
+	unsigned int			m_rangeIndex;
+	size_t					m_start;
+	size_t					m_end;
+};
+
+class ParallelRangeRunner : public ThreadPool
+{
+public:
+	// threads of 0 means use all of them
+	ParallelRangeRunner(unsigned int threads = 0);
+	virtual ~ParallelRangeRunner() { }
+
+	// how many ranges to split numItems into, with at least minItemsPerRange items in each (apart from
+	// with fewer items than that in total), and a few per thread so uneven ranges balance out
+	unsigned int getRangeCount(size_t numItems, size_t minItemsPerRange) const;
+
+	static void getRange(size_t numItems, unsigned int numRanges, unsigned int rangeIndex, size_t& start, size_t& end);
+
+	// blocks until all ranges have been processed. With only one range, it's run on the calling thread.
+	void run(ParallelRangeFunction& function, size_t numItems, unsigned int numRanges);
+
+	unsigned int getThreadCount() const
+	{
+		return m_numberOfThreads;
+	}
+
+protected:
+	virtual bool doTask(ThreadPoolTask* pTask, unsigned int threadID);
+};
+
+} // namespace Imagine
+
+#endif // PARALLEL_RANGE_H
@@ -367,6 +367,19 @@ void ThreadPool::addTaskNoLock(ThreadPoolTask* pTask)
 	m_aTasks.emplace_back(pTask);
 }
 
+void ThreadPool::addTasksToFrontNoLock(const std::vector<ThreadPoolTask*>& aTasks)
+{
+	std::vector<ThreadPoolTask*>::const_reverse_iterator it = aTasks.rbegin();
+	for (; it != aTasks.rend(); ++it)
+	{
+		ThreadPoolTask* pTask = *it;
+
+		pTask->setThreadPool(this);
+
+		m_aTasks.emplace_front(pTask);
+	}
+}
+
 ThreadPoolTask* ThreadPool::getNextTask()
 {
 	ThreadPoolTask* pTask = nullptr;
@@ -173,6 +173,10 @@ protected:
 
 	void addTaskNoLock(ThreadPoolTask* pTask);
 
+	// adds the tasks to the front of the queue (in the order given), so they'll be the next ones picked up.
+	// m_lock must already be held.
+	void addTasksToFrontNoLock(const std::vector<ThreadPoolTask*>& aTasks);
+
 	void addRequeuedTasks(RequeuedTasks& rqt);
 
 	void deleteThreads();
@@ -19,7 +19,9 @@
 #ifndef TIME_COUNTER_H
 #define TIME_COUNTER_H
 
-#include <sys/time.h>
+#include <inttypes.h>
+
+#include "high_res_clock.h"
 
 namespace Imagine
 {
@@ -30,7 +32,7 @@ namespace Imagine
 class TimerCounter
 {
 public:
-	TimerCounter(bool startTimer = false) : m_count(0)
+	TimerCounter(bool startTimer = false) : m_startTicks(0), m_count(0)
 	{
 		if (startTimer)
 		{
@@ -44,21 +46,12 @@ public:
 
 	void start()
 	{
-		//
-//		struct timespec requestStart, requestEnd;
-//		clock_gettime(CLOCK_REALTIME, &requestStart);
-		gettimeofday(&m_startTime, nullptr);
+		m_startTicks = HighResClock::getTicks();
 	}
 
 	void stop()
 	{
-		timeval endTime;
-		gettimeofday(&endTime, nullptr);
-
-		double mseconds = (endTime.tv_sec - m_startTime.tv_sec) * 1000000;
-		mseconds += (endTime.tv_usec - m_startTime.tv_usec);
-
-		m_count += mseconds;
+		m_count += HighResClock::getTicks() - m_startTicks;
 	}
 
 	void reset()
@@ -66,24 +59,27 @@ public:
 		m_count = 0;
 	}
 
+	// in microseconds
 	uint64_t stopReset()
 	{
 		stop();
-		uint64_t localCount = m_count;
+		uint64_t localCount = getTimeCount();
 
 		reset();
 
 		return localCount;
 	}
 
+	// in microseconds
 	uint64_t getTimeCount() const
 	{
-		return m_count;
+		return HighResClock::ticksToMicroseconds(m_count);
 	}
 
 protected:
-	timeval			m_startTime;
+	uint64_t		m_startTicks;
 
+	// in HighResClock ticks
 	uint64_t		m_count;
 };
 
@@ -150,24 +146,18 @@ public:
 class ThreadTimeCounterReal : public ThreadTimeCounter
 {
 public:
-	ThreadTimeCounterReal() : m_count(0)
+	ThreadTimeCounterReal() : m_startTicks(0), m_count(0)
 	{
 	}
 
 	virtual void start()
 	{
-		gettimeofday(&m_startTime, nullptr);
+		m_startTicks = HighResClock::getTicks();
 	}
 
 	virtual void stop()
 	{
-		timeval endTime;
-		gettimeofday(&endTime, nullptr);
-
-		double mseconds = (endTime.tv_sec - m_startTime.tv_sec) * 1000000;
-		mseconds += (endTime.tv_usec - m_startTime.tv_usec);
-
-		m_count += mseconds;
+		m_count += HighResClock::getTicks() - m_startTicks;
 	}
 
 	virtual void reset()
@@ -175,24 +165,27 @@ public:
 		m_count = 0;
 	}
 
+	// in microseconds
 	virtual uint64_t stopReset()
 	{
 		stop();
-		uint64_t localCount = m_count;
+		uint64_t localCount = getTimeCount();
 
 		reset();
 
 		return localCount;
 	}
 
+	// in microseconds
 	virtual uint64_t getTimeCount() const
 	{
-		return m_count;
+		return HighResClock::ticksToMicroseconds(m_count);
 	}
 
 protected:
-	timeval			m_startTime;
+	uint64_t		m_startTicks;
 
+	// in HighResClock ticks
 	uint64_t		m_count;
 };
 
@@ -20,6 +20,7 @@
 #define VARIANCE_TRACKER_H
 
 #include <cmath>
+#include <algorithm>
 
 #include "colour/colour4f.h"
 
@@ -75,6 +76,31 @@ public:
 		return std::sqrt(getVariance());
 	}
 
+	unsigned int getSampleCount() const
+	{
+		return m_sampleCount;
+	}
+
+	// standard error of the mean, relative to the mean (with minMean as a floor, so that near-black
+	// values aren't held to an impossible standard)
+	float getRelativeStandardError(float minMean) const
+	{
+		if (m_sampleCount <= 1)
+			return 0.0f;
+
+		float standardError = std::sqrt(getVariance() / (float)m_sampleCount);
+		return standardError / std::max(std::fabs(m_currentMean), minMean);
+	}
+
+	void reset()
+	{
+		m_sampleCount = 0;
+		m_lastMean = 0.0f;
+		m_lastMeanSquare = 0.0f;
+		m_currentMean = 0.0f;
+		m_currentMeanSquare = 0.0f;
+	}
+
 protected:
 	unsigned int		m_sampleCount;
 